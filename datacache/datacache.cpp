@@ -48,6 +48,7 @@ EXPOSE_SINGLE_INTERFACE_GLOBALVAR( CDataCache, IDataCache, DATACACHE_INTERFACE_V
 ConVar developer( "developer", "0", FCVAR_INTERNAL_USE );
 static ConVar mem_force_flush( "mem_force_flush", "0", FCVAR_CHEAT, "Force cache flush of unlocked resources on every alloc" );
 static std::atomic_int g_iDontForceFlush;
+static ConVar datacache_lockfree( "datacache_lockfree", "1", 0, "Find items, nested locks and LRU touches without the cache mutex" );
 
 //-----------------------------------------------------------------------------
 // DataCacheItem_t
@@ -61,6 +62,7 @@ void DataCacheItem_t::DestroyResource()
 	{
 		pSection->DiscardItemData( this, DC_AGE_DISCARD );
 	}
+	g_DataCache.UnpublishItem( this );
 	delete this; 
 }
 
@@ -150,6 +152,8 @@ void CDataCacheSection::EnsureCapacity( size_t nBytes, size_t nItems )
 {
 	VPROF( "CDataCacheSection::EnsureCapacity" );
 
+	m_pSharedCache->FlushDeferredTouches();
+
 	if ( m_limits.nMaxItems != std::numeric_limits<size_t>::max() ||
 		 m_limits.nMaxBytes != std::numeric_limits<size_t>::max() )
 	{
@@ -211,7 +215,11 @@ bool CDataCacheSection::AddEx( DataCacheClientID_t clientId, const void *pItemDa
 
 	Assert( hMem != 0 && hMem != DC_INVALID_HANDLE );
 
-	AccessItem( hMem )->hLRU = hMem;
+	DataCacheItem_t *pItem = AccessItem( hMem );
+	pItem->hLRU = hMem;
+	// Matches lock resource was created with.
+	pItem->nLockCount.store( 1, std::memory_order_relaxed );
+	m_pSharedCache->PublishItem( pItem );
 
 	if ( pHandle )
 	{
@@ -338,7 +346,7 @@ DataCacheRemoveResult_t CDataCacheSection::Remove( DataCacheHandle_t handle, con
 //-----------------------------------------------------------------------------
 bool CDataCacheSection::IsPresent( DataCacheHandle_t handle )
 {
-	return ( m_LRU.GetResource_NoLockNoLRUTouch( handle ) != NULL );
+	return ( FindItem( handle ) != NULL );
 }
 
 
@@ -354,14 +362,76 @@ void *CDataCacheSection::Lock( DataCacheHandle_t handle )
 
 	if ( handle != DC_INVALID_HANDLE )
 	{
-		DataCacheItem_t *pItem = m_LRU.LockResource( handle );
+		DataCacheItem_t *pItem = LockItem( handle );
 		if ( pItem )
 		{
-			if ( m_LRU.LockCount( handle ) == 1 )
+			return const_cast<void *>(pItem->pItemData);
+		}
+	}
+
+	return NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Adds a lock to an item. First lock also locks it in LRU, under the
+//			mutex, and nested ones only bump item lock count.
+//-----------------------------------------------------------------------------
+DataCacheItem_t *CDataCacheSection::LockItem( DataCacheHandle_t handle )
+{
+	if ( datacache_lockfree.GetBool() )
+	{
+		DataCacheItem_t *pItem = LockNested( handle );
+		if ( pItem )
+		{
+			return pItem;
+		}
+	}
+
+	AUTO_LOCK( m_mutex );
+
+	DataCacheItem_t *pItem = AccessItem( handle );
+	if ( pItem )
+	{
+		// Nested lock can race with us, but nothing but us moves count from 0.
+		if ( pItem->nLockCount.fetch_add( 1, std::memory_order_acquire ) == 0 )
+		{
+			m_LRU.LockResource( handle );
+			NoteLock( pItem->size );
+		}
+	}
+	return pItem;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Adds a lock to an already locked item without the mutex.
+//-----------------------------------------------------------------------------
+DataCacheItem_t *CDataCacheSection::LockNested( DataCacheHandle_t handle )
+{
+	DataCacheItem_t *pItem = FindItem( handle );
+	if ( !pItem )
+	{
+		return NULL;
+	}
+
+	int nLocks = pItem->nLockCount.load( std::memory_order_relaxed );
+	while ( nLocks > 0 )
+	{
+		if ( pItem->nLockCount.compare_exchange_weak( nLocks, nLocks + 1, std::memory_order_acquire, std::memory_order_relaxed ) )
+		{
+			// Locked item can't go away, but slot may have been reused since
+			// FindItem.  Give lock back to whoever owns it now.
+			if ( pItem->hLRU == handle )
 			{
-				NoteLock( pItem->size );
+				return pItem;
 			}
-			return const_cast<void *>(pItem->pItemData);
+
+			if ( pItem->pSection )
+			{
+				pItem->pSection->Unlock( pItem->hLRU );
+			}
+			return NULL;
 		}
 	}
 
@@ -369,6 +439,32 @@ void *CDataCacheSection::Lock( DataCacheHandle_t handle )
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Drops a lock which is not the last one without the mutex.
+//-----------------------------------------------------------------------------
+bool CDataCacheSection::UnlockNested( DataCacheHandle_t handle, int &iNewLockCount )
+{
+	// Caller holds a lock, so item is live.
+	DataCacheItem_t *pItem = FindItem( handle );
+	if ( !pItem )
+	{
+		return false;
+	}
+
+	int nLocks = pItem->nLockCount.load( std::memory_order_relaxed );
+	while ( nLocks > 1 )
+	{
+		if ( pItem->nLockCount.compare_exchange_weak( nLocks, nLocks - 1, std::memory_order_release, std::memory_order_relaxed ) )
+		{
+			iNewLockCount = nLocks - 1;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: Unlock a previous lock.
 //-----------------------------------------------------------------------------
@@ -380,14 +476,32 @@ int CDataCacheSection::Unlock( DataCacheHandle_t handle )
 	if ( handle != DC_INVALID_HANDLE )
 	{
 		AssertMsg( AccessItem( handle ) != nullptr, "Attempted to unlock nonexistent cache entry" );
+
+		if ( datacache_lockfree.GetBool() && UnlockNested( handle, iNewLockCount ) )
+		{
+			return iNewLockCount;
+		}
+
 		size_t nBytesUnlocked = 0;
 
 		{
 			AUTO_LOCK(m_mutex);
-			iNewLockCount = m_LRU.UnlockResource( handle );
-			if ( iNewLockCount == 0 )
+			DataCacheItem_t *pItem = AccessItem( handle );
+			if ( pItem )
 			{
-				nBytesUnlocked = AccessItem( handle )->size;
+				// Nested lock and unlock can race with us, but only we take count to 0.
+				int nLocks = pItem->nLockCount.load( std::memory_order_relaxed );
+				Assert( nLocks > 0 );
+				while ( nLocks > 0 && !pItem->nLockCount.compare_exchange_weak( nLocks, nLocks - 1, std::memory_order_release, std::memory_order_relaxed ) )
+				{
+				}
+
+				if ( nLocks == 1 )
+				{
+					m_LRU.UnlockResource( handle );
+					nBytesUnlocked = pItem->size;
+				}
+				iNewLockCount = max( nLocks - 1, 0 );
 			}
 		}
 
@@ -435,6 +549,16 @@ void *CDataCacheSection::Get( DataCacheHandle_t handle, bool bFrameLock )
 		if ( bFrameLock && IsFrameLocking() )
 			return FrameLock( handle );
 
+		if ( datacache_lockfree.GetBool() )
+		{
+			const void *pItemData = FindItemData( handle );
+			if ( pItemData )
+			{
+				m_pSharedCache->DeferTouch( handle );
+			}
+			return const_cast<void *>( pItemData );
+		}
+
 		AUTO_LOCK( m_mutex );
 		DataCacheItem_t *pItem = m_LRU.GetResource_NoLock( handle );
 		if ( pItem )
@@ -459,6 +583,11 @@ void *CDataCacheSection::GetNoTouch( DataCacheHandle_t handle, bool bFrameLock )
 		if ( bFrameLock && IsFrameLocking() )
 			return FrameLock( handle );
 
+		if ( datacache_lockfree.GetBool() )
+		{
+			return const_cast<void *>( FindItemData( handle ) );
+		}
+
 		AUTO_LOCK( m_mutex );
 		DataCacheItem_t *pItem = m_LRU.GetResource_NoLockNoLRUTouch( handle );
 		if ( pItem )
@@ -521,29 +650,23 @@ void *CDataCacheSection::FrameLock( DataCacheHandle_t handle )
 	FrameLock_t *pFrameLock = m_ThreadFrameLock.Get();
 	if ( pFrameLock )
 	{
-		DataCacheItem_t *pItem = m_LRU.LockResource( handle );
+		// Lock is kept as the frame lock on first time, otherwise it only pins
+		// item while we look at it.
+		DataCacheItem_t *pItem = LockItem( handle );
 		if ( pItem )
 		{
+			pResult = const_cast<void *>(pItem->pItemData);
+
 			int iThread = pFrameLock->m_iThread;
 			if ( pItem->pNextFrameLocked[iThread] == DC_NO_NEXT_LOCKED )
 			{
-				// dimhotepus: Fix status by incrementing locked on first time lock.
-				// Lock below increments status stats on first lock (count = 1), but
-				// LockResource above already incremented lock counter and second
-				// LockResource inside Lock will increment it further (count = 2) 
-				// even for first time lock.
-				if ( m_LRU.LockCount( handle ) == 1 )
-				{
-					NoteLock( pItem->size );
-				}
-
 				pItem->pNextFrameLocked[iThread] = pFrameLock->m_pFirst;
 				pFrameLock->m_pFirst = pItem;
-				Lock( handle );
 			}
-
-			pResult = const_cast<void *>(pItem->pItemData);
-			m_LRU.UnlockResource( handle );
+			else
+			{
+				Unlock( handle );
+			}
 		}
 	}
 
@@ -576,6 +699,8 @@ int CDataCacheSection::EndFrameLocking()
 
 		m_FreeFrameLocks.Push( pFrameLock );
 		m_ThreadFrameLock.Set( NULL );
+
+		m_pSharedCache->FlushDeferredTouches();
 		return 0;
 	}
 	else
@@ -599,7 +724,9 @@ int *CDataCacheSection::GetFrameUnlockCounterPtr()
 //-----------------------------------------------------------------------------
 int CDataCacheSection::GetLockCount( DataCacheHandle_t handle )
 {
-	return m_LRU.LockCount( handle );
+	AUTO_LOCK( m_mutex );
+	DataCacheItem_t *pItem = AccessItem( handle );
+	return pItem ? pItem->nLockCount.load( std::memory_order_relaxed ) : 0;
 }
 
 
@@ -608,7 +735,20 @@ int CDataCacheSection::GetLockCount( DataCacheHandle_t handle )
 //-----------------------------------------------------------------------------
 int CDataCacheSection::BreakLock( DataCacheHandle_t handle )
 {
-	return m_LRU.BreakLock( handle );
+	AUTO_LOCK( m_mutex );
+	DataCacheItem_t *pItem = AccessItem( handle );
+	if ( !pItem )
+	{
+		return 0;
+	}
+
+	int nBroken = pItem->nLockCount.exchange( 0, std::memory_order_acq_rel );
+	m_LRU.BreakLock( handle );
+	if ( nBroken )
+	{
+		NoteUnlock( pItem->size );
+	}
+	return nBroken;
 }
 
 
@@ -617,7 +757,14 @@ int CDataCacheSection::BreakLock( DataCacheHandle_t handle )
 //-----------------------------------------------------------------------------
 bool CDataCacheSection::Touch( DataCacheHandle_t handle )
 {
-	m_LRU.TouchResource( handle );
+	if ( datacache_lockfree.GetBool() )
+	{
+		m_pSharedCache->DeferTouch( handle );
+	}
+	else
+	{
+		m_LRU.TouchResource( handle );
+	}
 	return true;
 }
 
@@ -833,10 +980,13 @@ bool CDataCacheSection::DiscardItem( memhandle_t hItem, DataCacheNotificationTyp
 	DataCacheItem_t *pItem = AccessItem( hItem );
 	if ( DiscardItemData( pItem, type ) )
 	{
+		if ( pItem->nLockCount.exchange( 0, std::memory_order_acq_rel ) )
+		{
+			NoteUnlock( pItem->size );
+		}
 		if ( m_LRU.LockCount( hItem ) )
 		{
 			m_LRU.BreakLock( hItem );
-			NoteUnlock( pItem->size );
 		}
 
 		FrameLock_t *pFrameLock = m_ThreadFrameLock.Get();
@@ -1167,6 +1317,7 @@ void CDataCache::EnsureCapacity( size_t nBytes )
 {
 	VPROF( "CDataCache::EnsureCapacity" );
 
+	FlushDeferredTouches();
 	m_LRU.EnsureCapacity( nBytes );
 }
 
@@ -1178,10 +1329,69 @@ size_t CDataCache::Purge( size_t nBytes )
 {
 	VPROF( "CDataCache::Purge" );
 
+	FlushDeferredTouches();
 	return m_LRU.Purge( nBytes );
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Makes item visible to lock-free FindItem.
+//-----------------------------------------------------------------------------
+void CDataCache::PublishItem( DataCacheItem_t *pItem )
+{
+	m_ItemsBySlot[(uintp)pItem->hLRU & 0xFFFF].store( pItem, std::memory_order_release );
+}
+
+void CDataCache::UnpublishItem( DataCacheItem_t *pItem )
+{
+	// Slot may already be taken by item which reused LRU index.
+	DataCacheItem_t *pExpected = pItem;
+	m_ItemsBySlot[(uintp)pItem->hLRU & 0xFFFF].compare_exchange_strong( pExpected, nullptr, std::memory_order_release, std::memory_order_relaxed );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Touches are only a hint for eviction order, so ones from lock-free
+//			Get are batched per thread. Pending ones are applied before this
+//			thread evicts anything, or when batch is full or frame lock ends.
+//-----------------------------------------------------------------------------
+struct DeferredTouches_t
+{
+	memhandle_t handles[32];
+	intp nHandles;
+};
+
+static thread_local DeferredTouches_t t_DeferredTouches;
+
+void CDataCache::DeferTouch( memhandle_t handle )
+{
+	DeferredTouches_t &touches = t_DeferredTouches;
+	touches.handles[touches.nHandles++] = handle;
+
+	if ( touches.nHandles == ssize( touches.handles ) )
+	{
+		FlushDeferredTouches();
+	}
+}
+
+void CDataCache::FlushDeferredTouches()
+{
+	DeferredTouches_t &touches = t_DeferredTouches;
+	if ( !touches.nHandles )
+	{
+		return;
+	}
+
+	AUTO_LOCK( m_mutex );
+	// Stale handles are skipped by LRU.
+	for ( intp i = 0; i < touches.nHandles; i++ )
+	{
+		m_LRU.TouchResource( touches.handles[i] );
+	}
+	touches.nHandles = 0;
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: Empty the cache. Returns bytes released, will remove locked items if force specified
 //-----------------------------------------------------------------------------
@@ -1342,7 +1552,7 @@ void CDataCache::OutputItemReport( memhandle_t hItem )
 		pSection->GetName(), 
 		pItem->clientId, pItem->pItemData, hItem,
 		( name[0] ) ? name : "unknown",
-		( m_LRU.LockCount( hItem ) ) ? CFmtStr( "Locked %d", m_LRU.LockCount( hItem ) ).operator const char*() : "" );
+		( pItem->nLockCount ) ? CFmtStr( "Locked %d", pItem->nLockCount.load() ).operator const char*() : "" );
 }
 
 
@@ -11,6 +11,8 @@
 #pragma once
 #endif
 
+#include <atomic>
+
 #include "tier0/tslist.h"
 #include "tier1/datamanager.h"
 #include "tier1/utlhash.h"
@@ -46,7 +48,8 @@ struct DataCacheItem_t : DataCacheItemData_t
 {
 	DataCacheItem_t( const DataCacheItemData_t &data ) 
 	  : DataCacheItemData_t( data ),
-		hLRU( INVALID_MEMHANDLE )
+		hLRU( INVALID_MEMHANDLE ),
+		nLockCount( 0 )
 	{
 		memset( pNextFrameLocked, 0xff, sizeof(pNextFrameLocked) );
 	}
@@ -58,6 +61,9 @@ struct DataCacheItem_t : DataCacheItemData_t
 	size_t Size() const															{ return size; }
 
 	memhandle_t		 hLRU;
+	// Section locks.  LRU holds a single lock while this is non-zero, so nested
+	// locks and unlocks are done here without the cache mutex.
+	std::atomic_int	 nLockCount;
 	DataCacheItem_t *pNextFrameLocked[DC_MAX_THREADS_FRAMELOCKED];
 
 	DECLARE_FIXEDSIZE_ALLOCATOR_MT(DataCacheItem_t);
@@ -165,6 +171,11 @@ private:
 	memhandle_t GetFirstLockedItem();
 	memhandle_t GetNextItem( memhandle_t );
 	DataCacheItem_t *AccessItem( memhandle_t hCurrent );
+	DataCacheItem_t *FindItem( DataCacheHandle_t handle );
+	const void *FindItemData( DataCacheHandle_t handle );
+	DataCacheItem_t *LockItem( DataCacheHandle_t handle );
+	DataCacheItem_t *LockNested( DataCacheHandle_t handle );
+	bool UnlockNested( DataCacheHandle_t handle, int &iNewLockCount );
 	bool DiscardItem( memhandle_t hItem, DataCacheNotificationType_t type );
 	bool DiscardItemData( DataCacheItem_t *pItem, DataCacheNotificationType_t type );
 	void NoteAdd( size_t size );
@@ -282,11 +293,21 @@ private:
 	//-----------------------------------------------------
 
 	friend class CDataCacheSection;
+	friend void DataCacheItem_t::DestroyResource();
 
 	//-----------------------------------------------------
 
 	DataCacheItem_t *AccessItem( memhandle_t hCurrent );
 
+	// Lock-free lookup of live items, see m_ItemsBySlot
+	DataCacheItem_t *FindItem( memhandle_t handle );
+	void PublishItem( DataCacheItem_t *pItem );
+	void UnpublishItem( DataCacheItem_t *pItem );
+
+	// LRU promotions are batched per thread and applied under one mutex lock
+	void DeferTouch( memhandle_t handle );
+	void FlushDeferredTouches();
+
 	bool IsInFlush() const { return m_bInFlush; }
 	intp FindSectionIndex( const char *pszSection );
 
@@ -301,6 +322,11 @@ private:
 	CUtlVector<CDataCacheSection *>	m_Sections;
 	bool							m_bInFlush;
 	CThreadFastMutex &				m_mutex;
+
+	// Live items by low word of their LRU handle (LRU index + 1).  Items come
+	// from a fixed size pool which never releases memory, so a stale pointer
+	// is still readable and is rejected by comparing hLRU with the handle.
+	std::atomic<DataCacheItem_t *>	m_ItemsBySlot[std::numeric_limits<unsigned short>::max() + 1];
 };
 
 //---------------------------------------------------------
@@ -314,6 +340,12 @@ inline DataCacheItem_t *CDataCache::AccessItem( memhandle_t hCurrent )
 	return m_LRU.GetResource_NoLockNoLRUTouch( hCurrent ); 
 }
 
+inline DataCacheItem_t *CDataCache::FindItem( memhandle_t handle )
+{
+	DataCacheItem_t *pItem = m_ItemsBySlot[(uintp)handle & 0xFFFF].load( std::memory_order_acquire );
+	return ( pItem && pItem->hLRU == handle ) ? pItem : nullptr;
+}
+
 //-----------------------------------------------------------------------------
 
 inline IDataCache *CDataCacheSection::GetSharedCache()	
@@ -326,6 +358,25 @@ inline DataCacheItem_t *CDataCacheSection::AccessItem( memhandle_t hCurrent )
 	return m_pSharedCache->AccessItem( hCurrent ); 
 }
 
+inline DataCacheItem_t *CDataCacheSection::FindItem( DataCacheHandle_t handle ) 
+{ 
+	return m_pSharedCache->FindItem( handle ); 
+}
+
+inline const void *CDataCacheSection::FindItemData( DataCacheHandle_t handle )
+{
+	DataCacheItem_t *pItem = FindItem( handle );
+	if ( !pItem )
+	{
+		return NULL;
+	}
+
+	const void *pItemData = pItem->pItemData;
+	// Item could have been discarded and its memory reused while we read.
+	std::atomic_thread_fence( std::memory_order_acquire );
+	return pItem->hLRU == handle ? pItemData : NULL;
+}
+
 // Note: if status updates are moved out of a mutexed section, will need to change these to use interlocked instructions
 
 inline void CDataCacheSection::NoteSizeChanged( size_t oldSize, size_t newSize )
@@ -33,6 +33,7 @@
 #include "phyfile.h"
 #include "studiobyteswap.h"
 #include "filesystem/IQueuedLoader.h"
+#include "mdlsharedcache.h"
 
 // XXX remove this later. (henryg)
 #if 0 && defined(_DEBUG) && defined(_WIN32) && !defined(_X360)
@@ -370,6 +371,7 @@ public:
 	}
 
 	void *AllocData( MDLCacheDataType_t type, int size );
+	void *ShareData( MDLHandle_t handle, MDLCacheDataType_t type, void *pData, intp size );
 	void FreeData( MDLCacheDataType_t type, void *pData );
 	void CacheData( DataCacheHandle_t *c, void *pData, intp size, const char *name, MDLCacheDataType_t type, DataCacheClientID_t id = (DataCacheClientID_t)-1 );
 	void *CheckData( DataCacheHandle_t c, MDLCacheDataType_t type );
@@ -659,6 +661,11 @@ InitReturnVal_t CMDLCache::Init()
 		m_pAnimBlockCacheSection = g_pDataCache->AddSection( this, MODEL_CACHE_ANIMBLOCK_SECTION_NAME, limits );
 	}
 
+	if ( CommandLine()->FindParm( "-mdlsharedcache" ) && !g_MDLSharedCache.IsEnabled() )
+	{
+		g_MDLSharedCache.Enable( CommandLine()->ParmValue( "-mdlsharedcache", "" ) );
+	}
+
 	m_bLostVideoMemory = false;
 	m_bInitialized = true;
 
@@ -708,6 +715,8 @@ void CMDLCache::Shutdown()
 		m_pAnimBlockCacheSection = NULL;
 	}
 
+	g_MDLSharedCache.Shutdown();
+
 	BaseClass::Shutdown();
 }
 
@@ -1883,14 +1892,6 @@ studiohdr_t *CMDLCache::UnserializeMDL( MDLHandle_t handle, void *pData, int nDa
 	if ( !pHdr )
 		return NULL;
 
-	CacheData( &m_MDLDict[handle]->m_MDLCache, pHdr, pStudioHdrIn->length, GetModelName( handle ), MDLCACHE_STUDIOHDR, MakeCacheID( handle, MDLCACHE_STUDIOHDR) );
-
-	if ( mod_lock_mdls_on_load.GetBool() )
-	{
-		GetCacheSection( MDLCACHE_STUDIOHDR )->Lock( m_MDLDict[handle]->m_MDLCache );
-		m_MDLDict[handle]->m_nFlags |= STUDIODATA_FLAGS_LOCKED_MDL;
-	}
-
 	// FIXME: Is there any way we can compute the size to load *before* loading in
 	// and read directly into cache memory? It would be nice to reduce cache overhead here.
 	// move the complete, relocatable model to the cache
@@ -1905,6 +1906,20 @@ studiohdr_t *CMDLCache::UnserializeMDL( MDLHandle_t handle, void *pData, int nDa
 		pHdr->flags |= STUDIOHDR_FLAGS_FLEXES_CONVERTED;
 	}
 
+	// the back link differs between instances, share model without it and
+	// let copy-on-write give this instance its own first page
+	pHdr->virtualModel = 0;
+	pHdr = (studiohdr_t *)ShareData( handle, MDLCACHE_STUDIOHDR, pHdr, pStudioHdrIn->length );
+	pHdr->virtualModel = (int)(uintp)handle;
+
+	CacheData( &m_MDLDict[handle]->m_MDLCache, pHdr, pStudioHdrIn->length, GetModelName( handle ), MDLCACHE_STUDIOHDR, MakeCacheID( handle, MDLCACHE_STUDIOHDR) );
+
+	if ( mod_lock_mdls_on_load.GetBool() )
+	{
+		GetCacheSection( MDLCACHE_STUDIOHDR )->Lock( m_MDLDict[handle]->m_MDLCache );
+		m_MDLDict[handle]->m_nFlags |= STUDIODATA_FLAGS_LOCKED_MDL;
+	}
+
 	if ( m_pCacheNotify )
 	{
 		m_pCacheNotify->OnDataLoaded( MDLCACHE_STUDIOHDR, handle );
@@ -3087,16 +3102,19 @@ vertexFileHeader_t *CMDLCache::BuildAndCacheVertexData( studiohdr_t *pStudioHdr,
 	pVvdHdr = (vertexFileHeader_t *)AllocData( MDLCACHE_VERTEXES, cacheLength );
 	MemAlloc_PopAllocDbgInfo();
 
-	GetCacheSection( MDLCACHE_VERTEXES )->BeginFrameLocking();
-
-	CacheData( &m_MDLDict[handle]->m_VertexCache, pVvdHdr, cacheLength, pStudioHdr->pszName(), MDLCACHE_VERTEXES, MakeCacheID( handle, MDLCACHE_VERTEXES) );
-
 	// expected 32 byte alignment
 	Assert( ((size_t)pVvdHdr & 0x1F) == 0 );
 
 	// load minimum vertexes and fixup
 	Studio_LoadVertexes( pRawVvdHdr, pVvdHdr, rootLOD, bNeedsTangentS );
 
+	// vertexes are never written after fixup, identical ones are shared whole
+	pVvdHdr = (vertexFileHeader_t *)ShareData( handle, MDLCACHE_VERTEXES, pVvdHdr, cacheLength );
+
+	GetCacheSection( MDLCACHE_VERTEXES )->BeginFrameLocking();
+
+	CacheData( &m_MDLDict[handle]->m_VertexCache, pVvdHdr, cacheLength, pStudioHdr->pszName(), MDLCACHE_VERTEXES, MakeCacheID( handle, MDLCACHE_VERTEXES) );
+
 	GetCacheSection( MDLCACHE_VERTEXES )->EndFrameLocking();
 
 	return pVvdHdr;
@@ -3190,6 +3208,20 @@ void *CMDLCache::AllocData( MDLCacheDataType_t type, int size )
 }
 
 
+//-----------------------------------------------------------------------------
+// Swaps allocated item for mapping shared with other instances, if any
+//-----------------------------------------------------------------------------
+void *CMDLCache::ShareData( MDLHandle_t handle, MDLCacheDataType_t type, void *pData, intp size )
+{
+	void *pShared = g_MDLSharedCache.Attach( type, GetModelName( handle ), pData, size );
+	if ( !pShared )
+		return pData;
+
+	_aligned_free( pData );
+	return pShared;
+}
+
+
 //-----------------------------------------------------------------------------
 // Caches an item
 //-----------------------------------------------------------------------------
@@ -3254,7 +3286,10 @@ void CMDLCache::FreeData( MDLCacheDataType_t type, void *pData )
 {
 	if ( type != MDLCACHE_ANIMBLOCK )
 	{
-		_aligned_free( (void *)pData );
+		if ( !g_MDLSharedCache.Detach( pData ) )
+		{
+			_aligned_free( (void *)pData );
+		}
 	}
 	else
 	{
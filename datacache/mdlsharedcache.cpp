@@ -0,0 +1,458 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Host wide cache of immutable model data shared by co-located
+//			instances.
+//
+//===========================================================================//
+
+#include "mdlsharedcache.h"
+
+#include "tier0/dbg.h"
+#include "tier1/checksum_crc.h"
+#include "tier1/checksum_md5.h"
+#include "tier1/convar.h"
+#include "tier1/strtools.h"
+
+#ifdef IS_WINDOWS_PC
+#include "winlite.h"
+#elif defined( POSIX )
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+CMDLSharedCache g_MDLSharedCache;
+
+// Blobs no instance mapped for this long belong to models nobody loads anymore.
+static constexpr int64 MAX_UNUSED_BLOB_AGE = 7 * 24 * 60 * 60;
+// Temp files this old were left by an instance that died while writing.
+static constexpr int64 MAX_TEMP_FILE_AGE = 60 * 60;
+
+CMDLSharedCache::CMDLSharedCache()
+	: m_bEnabled( false ), m_nMappedBytes( 0 ), m_nWritten( 0 ), m_nReused( 0 ), m_nFailed( 0 ), m_nMismatched( 0 )
+{
+}
+
+CMDLSharedCache::~CMDLSharedCache()
+{
+	Shutdown();
+}
+
+//-----------------------------------------------------------------------------
+// Picks and creates cache directory
+//-----------------------------------------------------------------------------
+bool CMDLSharedCache::Enable( const char *pszDirectory )
+{
+	char szDirectory[MAX_PATH];
+
+	if ( !V_isempty( pszDirectory ) )
+	{
+		V_strcpy_safe( szDirectory, pszDirectory );
+	}
+	else
+	{
+#ifdef IS_WINDOWS_PC
+		char szTempPath[MAX_PATH];
+		if ( !GetTempPathA( sizeof( szTempPath ), szTempPath ) )
+		{
+			Warning( "MDLSharedCache: No temp directory, model sharing is off.\n" );
+			return false;
+		}
+		V_ComposeFileName( szTempPath, "srcds_mdlcache", szDirectory );
+#else
+		// tmpfs, so blobs are page cache pages every instance maps
+		V_strcpy_safe( szDirectory, "/dev/shm/srcds_mdlcache" );
+#endif
+	}
+
+	V_StripTrailingSlash( szDirectory );
+
+#ifdef IS_WINDOWS_PC
+	const bool bHasDirectory = CreateDirectoryA( szDirectory, NULL ) || GetLastError() == ERROR_ALREADY_EXISTS;
+#elif defined( POSIX )
+	// other users may map blobs, but only the owner writes them
+	bool bHasDirectory = mkdir( szDirectory, 0755 ) == 0;
+	if ( !bHasDirectory && errno == EEXIST )
+	{
+		// don't map blobs anybody can plant
+		struct stat st;
+		bHasDirectory = lstat( szDirectory, &st ) == 0 && S_ISDIR( st.st_mode ) &&
+			( st.st_mode & ( S_IWGRP | S_IWOTH ) ) == 0;
+	}
+#else
+	const bool bHasDirectory = false;
+#endif
+
+	if ( !bHasDirectory )
+	{
+		Warning( "MDLSharedCache: Can't create %s, model sharing is off.\n", szDirectory );
+		return false;
+	}
+
+	m_Directory = szDirectory;
+	m_bEnabled = true;
+
+	const int nAged = RemoveBlobFiles( "", ".bin", NULL, MAX_UNUSED_BLOB_AGE ) +
+		RemoveBlobFiles( "", ".tmp", NULL, MAX_TEMP_FILE_AGE );
+
+	DevMsg( "MDLSharedCache: Sharing models through %s, removed %d unused blobs.\n", szDirectory, nAged );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Maps shared blob with the same contents
+//-----------------------------------------------------------------------------
+void *CMDLSharedCache::Attach( int nType, const char *pszModelName, const void *pData, intp nSize )
+{
+	if ( !m_bEnabled || !pData || nSize < MIN_SHARED_SIZE )
+		return NULL;
+
+	char szPrefix[32];
+	GetBlobPrefix( nType, pszModelName, szPrefix, sizeof( szPrefix ) );
+
+	char szFileName[MAX_PATH];
+	if ( !GetBlobFileName( szPrefix, pData, nSize, szFileName, sizeof( szFileName ) ) )
+		return NULL;
+
+	bool bWritten = false;
+	void *pShared = MapBlobFile( szFileName, nSize );
+	if ( pShared )
+	{
+		// keep blob from aging out while models use it
+		TouchBlobFile( szFileName );
+	}
+	else if ( WriteBlobFile( szFileName, pData, nSize ) )
+	{
+		bWritten = true;
+		pShared = MapBlobFile( szFileName, nSize );
+
+		// Blobs of older versions of this model.  Instances which still map
+		// them keep their pages, the files are only gone for new loads.
+		RemoveBlobFiles( szPrefix, ".bin", V_UnqualifiedFileName( szFileName ), 0 );
+	}
+
+	// md5 collision or blob file written by incompatible build
+	const bool bMismatched = pShared && memcmp( pShared, pData, nSize ) != 0;
+	if ( bMismatched )
+	{
+		UnmapBlob( pShared, nSize );
+		pShared = NULL;
+	}
+
+	AUTO_LOCK( m_Mutex );
+
+	if ( !pShared )
+	{
+		if ( bMismatched )
+		{
+			++m_nMismatched;
+			Warning( "MDLSharedCache: %s differs from loaded data, not shared.\n", szFileName );
+		}
+		else
+		{
+			++m_nFailed;
+		}
+		return NULL;
+	}
+
+	Mapping_t mapping;
+	mapping.m_nSize = nSize;
+	mapping.m_nType = nType;
+	m_Mappings.Insert( pShared, mapping );
+
+	m_nMappedBytes += nSize;
+	if ( bWritten )
+	{
+		++m_nWritten;
+	}
+	else
+	{
+		++m_nReused;
+	}
+
+	return pShared;
+}
+
+bool CMDLSharedCache::Detach( void *pData )
+{
+	if ( !m_bEnabled || !pData )
+		return false;
+
+	intp nSize;
+	{
+		AUTO_LOCK( m_Mutex );
+
+		UtlHashHandle_t h = m_Mappings.Find( pData );
+		if ( h == m_Mappings.InvalidHandle() )
+			return false;
+
+		nSize = m_Mappings[h].m_nSize;
+		m_nMappedBytes -= nSize;
+		m_Mappings.RemoveByHandle( h );
+	}
+
+	UnmapBlob( pData, nSize );
+	return true;
+}
+
+void CMDLSharedCache::Shutdown()
+{
+	AUTO_LOCK( m_Mutex );
+
+	// All blobs are detached when their cache items are freed.
+	Assert( m_Mappings.Count() == 0 );
+
+	FOR_EACH_HASHTABLE( m_Mappings, h )
+	{
+		UnmapBlob( const_cast<void *>( m_Mappings.Key( h ) ), m_Mappings[h].m_nSize );
+	}
+	m_Mappings.Purge();
+	m_nMappedBytes = 0;
+
+	m_bEnabled = false;
+}
+
+void CMDLSharedCache::PrintStatus()
+{
+	if ( !m_bEnabled )
+	{
+		Msg( "Model sharing is off, run with -mdlsharedcache [directory] to turn it on.\n" );
+		return;
+	}
+
+	AUTO_LOCK( m_Mutex );
+
+	Msg( "Model sharing through %s:\n", m_Directory.Get() );
+	Msg( "  %d blobs mapped, %.2f MiB.\n", m_Mappings.Count(), m_nMappedBytes / ( 1024.0 * 1024.0 ) );
+	Msg( "  %d mapped from other instances, %d written by this one.\n", m_nReused, m_nWritten );
+	Msg( "  %d failed, %d differed from blob files.\n", m_nFailed, m_nMismatched );
+}
+
+//-----------------------------------------------------------------------------
+// Blobs of all versions of the same model data start with the same prefix
+//-----------------------------------------------------------------------------
+void CMDLSharedCache::GetBlobPrefix( int nType, const char *pszModelName, char *pszPrefix, intp nMaxLen )
+{
+	char szModelName[MAX_PATH];
+	V_strcpy_safe( szModelName, pszModelName ? pszModelName : "" );
+	V_FixSlashes( szModelName, '/' );
+	V_strlower( szModelName );
+
+	const CRC32_t crc = CRC32_ProcessSingleBuffer( szModelName, V_strlen( szModelName ) );
+	V_snprintf( pszPrefix, nMaxLen, "%d_%08x_", nType, crc );
+}
+
+bool CMDLSharedCache::GetBlobFileName( const char *pszPrefix, const void *pData, intp nSize, char *pszFileName, intp nMaxLen ) const
+{
+	MD5Value_t md5;
+	MD5_ProcessSingleBuffer( pData, static_cast<unsigned>( nSize ), md5 );
+
+	char szMD5[MD5_DIGEST_LENGTH * 2 + 1];
+	V_binarytohex( md5.bits, sizeof( md5.bits ), szMD5 );
+
+	return V_snprintf( pszFileName, nMaxLen, "%s%c%s%zd_%s.bin",
+		m_Directory.Get(), CORRECT_PATH_SEPARATOR, pszPrefix, nSize, szMD5 ) < nMaxLen;
+}
+
+//-----------------------------------------------------------------------------
+// Removes files named <pszPrefix>*<pszSuffix> not modified for nMinAge
+// seconds, except pszKeep.  Returns number of removed files.
+//-----------------------------------------------------------------------------
+int CMDLSharedCache::RemoveBlobFiles( const char *pszPrefix, const char *pszSuffix, const char *pszKeep, int64 nMinAge ) const
+{
+	const int64 nNow = static_cast<int64>( time( NULL ) );
+	int nRemoved = 0;
+
+	auto ShouldRemove = [&]( const char *pszName, int64 nModified )
+	{
+		return V_strncmp( pszName, pszPrefix, V_strlen( pszPrefix ) ) == 0 &&
+			V_strEndsWith( pszName, pszSuffix ) &&
+			( !pszKeep || V_strcmp( pszName, pszKeep ) != 0 ) &&
+			nNow - nModified >= nMinAge;
+	};
+
+	char szPath[MAX_PATH];
+
+#ifdef IS_WINDOWS_PC
+	char szWildcard[MAX_PATH];
+	V_sprintf_safe( szWildcard, "%s%c%s*%s", m_Directory.Get(), CORRECT_PATH_SEPARATOR, pszPrefix, pszSuffix );
+
+	WIN32_FIND_DATAA findData;
+	HANDLE hFind = FindFirstFileA( szWildcard, &findData );
+	if ( hFind == INVALID_HANDLE_VALUE )
+		return 0;
+
+	do
+	{
+		if ( findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+			continue;
+
+		// FILETIME is 100ns ticks since 1601
+		ULARGE_INTEGER nModified;
+		nModified.LowPart = findData.ftLastWriteTime.dwLowDateTime;
+		nModified.HighPart = findData.ftLastWriteTime.dwHighDateTime;
+		const int64 nModifiedUnix = static_cast<int64>( nModified.QuadPart / 10000000ULL ) - 11644473600LL;
+
+		if ( !ShouldRemove( findData.cFileName, nModifiedUnix ) )
+			continue;
+
+		// fails while another instance maps it, that one is still in use
+		V_ComposeFileName( m_Directory.Get(), findData.cFileName, szPath, sizeof( szPath ) );
+		if ( DeleteFileA( szPath ) )
+		{
+			++nRemoved;
+		}
+	} while ( FindNextFileA( hFind, &findData ) );
+
+	FindClose( hFind );
+#elif defined( POSIX )
+	DIR *pDir = opendir( m_Directory.Get() );
+	if ( !pDir )
+		return 0;
+
+	while ( const dirent *pEntry = readdir( pDir ) )
+	{
+		V_ComposeFileName( m_Directory.Get(), pEntry->d_name, szPath, sizeof( szPath ) );
+
+		struct stat st;
+		if ( lstat( szPath, &st ) != 0 || !S_ISREG( st.st_mode ) )
+			continue;
+
+		// mappings keep unlinked files alive
+		if ( ShouldRemove( pEntry->d_name, st.st_mtime ) && unlink( szPath ) == 0 )
+		{
+			++nRemoved;
+		}
+	}
+
+	closedir( pDir );
+#endif
+
+	return nRemoved;
+}
+
+void CMDLSharedCache::TouchBlobFile( const char *pszFileName )
+{
+#ifdef IS_WINDOWS_PC
+	HANDLE hFile = CreateFileA( pszFileName, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hFile == INVALID_HANDLE_VALUE )
+		return;
+
+	FILETIME now;
+	GetSystemTimeAsFileTime( &now );
+	SetFileTime( hFile, NULL, NULL, &now );
+	CloseHandle( hFile );
+#elif defined( POSIX )
+	// fails for blobs written by other users, those age by their writer's loads
+	utime( pszFileName, NULL );
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Writes blob to temp file and renames it in place, so other instances never
+// map a partially written blob
+//-----------------------------------------------------------------------------
+bool CMDLSharedCache::WriteBlobFile( const char *pszFileName, const void *pData, intp nSize ) const
+{
+	char szTempName[MAX_PATH];
+#ifdef IS_WINDOWS_PC
+	V_sprintf_safe( szTempName, "%s.%lu.%lu.tmp", pszFileName, GetCurrentProcessId(), (unsigned long)ThreadGetCurrentId() );
+#else
+	V_sprintf_safe( szTempName, "%s.%lu.%lu.tmp", pszFileName, (unsigned long)getpid(), (unsigned long)ThreadGetCurrentId() );
+#endif
+
+	FILE *fp = fopen( szTempName, "wb" );
+	if ( !fp )
+		return false;
+
+	const bool bWritten = fwrite( pData, 1, nSize, fp ) == (size_t)nSize;
+	const bool bClosed = fclose( fp ) == 0;
+
+	if ( !bWritten || !bClosed )
+	{
+		remove( szTempName );
+		return false;
+	}
+
+#ifdef IS_WINDOWS_PC
+	// another instance may have won, its blob has the same contents
+	if ( !MoveFileExA( szTempName, pszFileName, 0 ) )
+	{
+		DeleteFileA( szTempName );
+	}
+#else
+	if ( rename( szTempName, pszFileName ) != 0 )
+	{
+		remove( szTempName );
+	}
+#endif
+
+	return true;
+}
+
+void *CMDLSharedCache::MapBlobFile( const char *pszFileName, intp nSize )
+{
+#ifdef IS_WINDOWS_PC
+	HANDLE hFile = CreateFileA( pszFileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hFile == INVALID_HANDLE_VALUE )
+		return NULL;
+
+	void *pData = NULL;
+	LARGE_INTEGER nFileSize;
+	if ( GetFileSizeEx( hFile, &nFileSize ) && nFileSize.QuadPart == nSize )
+	{
+		HANDLE hMapping = CreateFileMappingA( hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+		if ( hMapping )
+		{
+			pData = MapViewOfFile( hMapping, FILE_MAP_COPY, 0, 0, 0 );
+			// the view keeps the mapping alive
+			CloseHandle( hMapping );
+		}
+	}
+	CloseHandle( hFile );
+
+	return pData;
+#elif defined( POSIX )
+	int fd = open( pszFileName, O_RDONLY | O_CLOEXEC );
+	if ( fd < 0 )
+		return NULL;
+
+	struct stat st;
+	void *pData = MAP_FAILED;
+	if ( fstat( fd, &st ) == 0 && st.st_size == nSize )
+	{
+		// private writable, pages are copied only when this process writes them
+		pData = mmap( nullptr, nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+	}
+	// the mapping keeps the file alive
+	close( fd );
+
+	return pData != MAP_FAILED ? pData : NULL;
+#else
+	return NULL;
+#endif
+}
+
+void CMDLSharedCache::UnmapBlob( void *pData, [[maybe_unused]] intp nSize )
+{
+#ifdef IS_WINDOWS_PC
+	UnmapViewOfFile( pData );
+#elif defined( POSIX )
+	munmap( pData, nSize );
+#endif
+}
+
+CON_COMMAND( mdlcache_shared_status, "Prints model data shared with other instances through -mdlsharedcache." )
+{
+	g_MDLSharedCache.PrintStatus();
+}
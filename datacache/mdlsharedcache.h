@@ -0,0 +1,85 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Host wide cache of immutable model data, so co-located instances
+//			map identical studiohdr / vertex blobs instead of each keeping
+//			a heap copy.
+//
+//===========================================================================//
+
+#ifndef MDLSHAREDCACHE_H
+#define MDLSHAREDCACHE_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier0/threadtools.h"
+#include "tier1/utlhashtable.h"
+#include "tier1/utlstring.h"
+
+//-----------------------------------------------------------------------------
+// Blobs are stored as <type>_<model name crc>_<size>_<content md5>.bin files
+// in a cache directory (tmpfs on Linux), written once by the first instance
+// which loads them and mapped copy-on-write by every instance after that.
+// Pages stay shared with other instances until this process writes to them
+// (studiohdr back link, activity fixups), which only privatizes the pages
+// written to.
+//
+// Writing a blob removes blobs of older versions of the same model, and
+// blobs no instance mapped for a week are removed when the cache is enabled.
+//-----------------------------------------------------------------------------
+class CMDLSharedCache
+{
+public:
+	// Smaller blobs don't fill a page, sharing them saves nothing.
+	enum { MIN_SHARED_SIZE = 4096 };
+
+	CMDLSharedCache();
+	~CMDLSharedCache();
+
+	// Turns cache on.  pszDirectory may be empty for default directory.
+	bool Enable( const char *pszDirectory );
+	bool IsEnabled() const { return m_bEnabled; }
+
+	// Returns shared mapping with the same contents as pData or NULL when
+	// blob can't be shared.  Caller frees its copy when mapping is returned.
+	void *Attach( int nType, const char *pszModelName, const void *pData, intp nSize );
+
+	// Unmaps shared blob.  Returns false when pData is not a shared blob.
+	bool Detach( void *pData );
+
+	void Shutdown();
+	void PrintStatus();
+
+private:
+	struct Mapping_t
+	{
+		intp m_nSize;
+		int m_nType;
+	};
+
+	static void GetBlobPrefix( int nType, const char *pszModelName, char *pszPrefix, intp nMaxLen );
+	bool GetBlobFileName( const char *pszPrefix, const void *pData, intp nSize, char *pszFileName, intp nMaxLen ) const;
+	bool WriteBlobFile( const char *pszFileName, const void *pData, intp nSize ) const;
+	int RemoveBlobFiles( const char *pszPrefix, const char *pszSuffix, const char *pszKeep, int64 nMinAge ) const;
+	static void TouchBlobFile( const char *pszFileName );
+	static void *MapBlobFile( const char *pszFileName, intp nSize );
+	static void UnmapBlob( void *pData, intp nSize );
+
+	bool m_bEnabled;
+	CUtlString m_Directory;
+
+	CThreadFastMutex m_Mutex;
+	CUtlHashtable<const void *, Mapping_t> m_Mappings;
+
+	// Stats.
+	intp m_nMappedBytes;
+	int m_nWritten;
+	int m_nReused;
+	int m_nFailed;
+	int m_nMismatched;
+};
+
+extern CMDLSharedCache g_MDLSharedCache;
+
+#endif // MDLSHAREDCACHE_H
@@ -0,0 +1,198 @@
+"""
+Compares memory use of N co-located dedicated servers running the same map
+with and without -mdlsharedcache.
+
+Launches N headless instances on consecutive ports, waits until the map is
+loaded, samples memory of every instance and prints a comparison. Linux
+reads /proc/<pid>/smaps_rollup; Pss (shared pages split between the processes
+which map them) summed over instances is the host wide cost. Other platforms
+need psutil and report Rss / private bytes only.
+
+usage: mdlcache_rss_compare.py --srcds ./srcds_linux --game hl2mp --map dm_lockdown
+           [--instances 16] [--port 27015] [--settle 60] [--cache-dir DIR] [-- extra args]
+
+Run srcds_linux directly (not srcds_run) with LD_LIBRARY_PATH set up, so the
+launched pid is the server itself. Children of launched processes are counted
+too.
+"""
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def default_cache_dir():
+	if sys.platform.startswith( 'linux' ):
+		return '/dev/shm/srcds_mdlcache_compare'
+	return os.path.join( tempfile.gettempdir(), 'srcds_mdlcache_compare' )
+
+
+def process_tree( pid ):
+	pids = [ pid ]
+	for task in os.listdir( '/proc/%d/task' % pid ):
+		try:
+			with open( '/proc/%d/task/%s/children' % ( pid, task ) ) as f:
+				for child in f.read().split():
+					pids += process_tree( int( child ) )
+		except OSError:
+			pass
+	return pids
+
+
+def sample_linux( pid ):
+	"""Returns dict of kB values summed over pid and its children."""
+	totals = {}
+	for p in process_tree( pid ):
+		try:
+			with open( '/proc/%d/smaps_rollup' % p ) as f:
+				for line in f:
+					fields = line.split()
+					if len( fields ) == 3 and fields[2] == 'kB':
+						key = fields[0].rstrip( ':' )
+						totals[key] = totals.get( key, 0 ) + int( fields[1] )
+		except OSError:
+			pass
+	return {
+		'rss': totals.get( 'Rss', 0 ),
+		'pss': totals.get( 'Pss', 0 ),
+		'private': totals.get( 'Private_Clean', 0 ) + totals.get( 'Private_Dirty', 0 ),
+	}
+
+
+def sample_psutil( pid ):
+	import psutil
+	rss = 0
+	private = 0
+	try:
+		proc = psutil.Process( pid )
+		for p in [ proc ] + proc.children( recursive=True ):
+			info = p.memory_info()
+			rss += info.rss // 1024
+			private += getattr( info, 'private', info.rss ) // 1024
+	except psutil.Error:
+		pass
+	return { 'rss': rss, 'pss': None, 'private': private }
+
+
+def sample( pid ):
+	if sys.platform.startswith( 'linux' ):
+		return sample_linux( pid )
+	return sample_psutil( pid )
+
+
+def directory_size_kb( path ):
+	total = 0
+	for root, dirs, files in os.walk( path ):
+		for name in files:
+			try:
+				total += os.path.getsize( os.path.join( root, name ) )
+			except OSError:
+				pass
+	return total // 1024
+
+
+def run_instances( args, shared ):
+	procs = []
+	logs = []
+	for i in range( args.instances ):
+		cmd = [ args.srcds, '-game', args.game, '-console', '-norestart', '-nohltv',
+			'-port', str( args.port + i ), '+maxplayers', '2', '+map', args.map ]
+		if shared:
+			cmd += [ '-mdlsharedcache', args.cache_dir ]
+		cmd += args.extra
+
+		log = open( os.path.join( args.log_dir, '%s_%02d.log' % ( 'shared' if shared else 'private', i ) ), 'w' )
+		logs.append( log )
+		procs.append( subprocess.Popen( cmd, cwd=args.cwd, stdin=subprocess.DEVNULL, stdout=log, stderr=subprocess.STDOUT ) )
+
+		# stagger, so instances don't all miss the cache at once
+		time.sleep( args.stagger )
+
+	print( '  waiting %d s for %d instances to load %s...' % ( args.settle, args.instances, args.map ) )
+	time.sleep( args.settle )
+
+	samples = []
+	for proc in procs:
+		if proc.poll() is not None:
+			print( '  instance %d exited with %d, see logs in %s' % ( procs.index( proc ), proc.returncode, args.log_dir ) )
+			continue
+		samples.append( sample( proc.pid ) )
+
+	for proc in procs:
+		proc.terminate()
+	for proc in procs:
+		try:
+			proc.wait( 15 )
+		except subprocess.TimeoutExpired:
+			proc.kill()
+			proc.wait()
+	for log in logs:
+		log.close()
+
+	return samples
+
+
+def summarize( samples, key ):
+	values = [ s[key] for s in samples if s[key] is not None ]
+	if not values:
+		return None
+	return sum( values ), sum( values ) // len( values )
+
+
+def main():
+	parser = argparse.ArgumentParser( description='Compares memory of N dedicated servers with and without -mdlsharedcache.' )
+	parser.add_argument( '--srcds', required=True, help='dedicated server executable' )
+	parser.add_argument( '--game', required=True )
+	parser.add_argument( '--map', required=True )
+	parser.add_argument( '--instances', type=int, default=16 )
+	parser.add_argument( '--port', type=int, default=27015 )
+	parser.add_argument( '--settle', type=int, default=60, help='seconds to wait for map load' )
+	parser.add_argument( '--stagger', type=float, default=0.5, help='seconds between launches' )
+	parser.add_argument( '--cache-dir', default=default_cache_dir() )
+	parser.add_argument( '--cwd', default=None, help='working directory of instances' )
+	parser.add_argument( '--log-dir', default=None )
+	parser.add_argument( 'extra', nargs='*', help='extra server arguments, after --' )
+	args = parser.parse_args()
+
+	if not sys.platform.startswith( 'linux' ):
+		try:
+			import psutil
+		except ImportError:
+			print( 'psutil is required outside of Linux.' )
+			return 1
+
+	if args.log_dir is None:
+		args.log_dir = tempfile.mkdtemp( prefix='mdlcache_rss_' )
+
+	results = {}
+	for shared in ( False, True ):
+		if shared:
+			# start from an empty cache, first instance writes every blob
+			shutil.rmtree( args.cache_dir, ignore_errors=True )
+		print( '%s model data:' % ( 'Shared' if shared else 'Private' ) )
+		results[shared] = run_instances( args, shared )
+
+	cache_kb = directory_size_kb( args.cache_dir )
+
+	print( '' )
+	print( '%d instances of %s on %s, kB (total / per instance):' % ( args.instances, args.game, args.map ) )
+	print( '  %-8s | %-24s | %-24s | %s' % ( 'metric', 'private', 'shared', 'saved' ) )
+	for key in ( 'rss', 'pss', 'private' ):
+		off = summarize( results[False], key )
+		on = summarize( results[True], key )
+		if off is None or on is None:
+			continue
+		saved = off[0] - on[0]
+		print( '  %-8s | %12d / %9d | %12d / %9d | %d (%.1f%%)' % ( key, off[0], off[1], on[0], on[1],
+			saved, 100.0 * saved / off[0] if off[0] else 0.0 ) )
+	print( '  shared cache directory %s holds %d kB, counted once per host.' % ( args.cache_dir, cache_kb ) )
+	print( '  logs in %s' % args.log_dir )
+	return 0
+
+
+if __name__ == '__main__':
+	sys.exit( main() )
@@ -0,0 +1,145 @@
+"""
+Compares full vis times of vvis builds or settings over a set of maps.
+
+For each map, the .bsp and the .prt vbsp wrote next to it are copied to a
+scratch directory, since vvis writes the visibility back into the .bsp. Then
+each configuration runs full vis on a fresh copy. Reports PortalFlow and total
+wall time per map and summed.
+
+The new configuration runs with -costflow: expensive portals first and work
+stealing. Without --baseline-vvis, the baseline is the same vvis run with
+-linearflow -noavx2: sorted portal order without cost scheduling or work
+stealing, and 64 bit bit string operations. Pass an older vvis to compare
+against it instead.
+
+Vis data of both configurations is compared too. Expensive portals read the
+portalvis of portals other threads already finished, so thread timing can
+change a few bits between any two runs, as it always could.
+
+usage: vvis_time_compare.py --vvis ./vvis.exe --game ../hl2 maps/d1_trainstation_01.bsp ...
+           [--baseline-vvis old/vvis.exe] [--threads N] [--runs 1] [-- extra args]
+"""
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+
+PORTALFLOW_TIME = re.compile( r'^PortalFlow\w*:.*\((\d+(?:\.\d+)?)s\)', re.MULTILINE )
+
+
+def run_vvis( exe, extra, args, bsp, scratch ):
+	name = os.path.basename( bsp )
+	work_bsp = os.path.join( scratch, name )
+	shutil.copyfile( bsp, work_bsp )
+	shutil.copyfile( os.path.splitext( bsp )[0] + '.prt', os.path.splitext( work_bsp )[0] + '.prt' )
+
+	cmd = [ exe, '-game', args.game ]
+	if args.threads:
+		cmd += [ '-threads', str( args.threads ) ]
+	cmd += extra + args.extra + [ work_bsp ]
+
+	start = time.perf_counter()
+	result = subprocess.run( cmd, stdin=subprocess.DEVNULL, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True, errors='replace' )
+	total = time.perf_counter() - start
+
+	if result.returncode != 0:
+		print( '  %s exited with %d:' % ( ' '.join( cmd ), result.returncode ) )
+		print( result.stdout[-2000:] )
+		return None
+
+	match = PORTALFLOW_TIME.search( result.stdout )
+	return {
+		'portalflow': float( match.group( 1 ) ) if match else None,
+		'total': total,
+		'bsp': work_bsp,
+	}
+
+
+def read_visdata( bsp ):
+	"""Returns the visibility lump, to check both configurations wrote the same vis."""
+	with open( bsp, 'rb' ) as f:
+		header = f.read( 8 + 64 * 16 )
+	lump_vis = 4
+	offset = 8 + lump_vis * 16
+	fileofs = int.from_bytes( header[offset:offset + 4], 'little' )
+	filelen = int.from_bytes( header[offset + 4:offset + 8], 'little' )
+	with open( bsp, 'rb' ) as f:
+		f.seek( fileofs )
+		return f.read( filelen )
+
+
+def best_of( runs, key ):
+	values = [ r[key] for r in runs if r and r[key] is not None ]
+	return min( values ) if values else None
+
+
+def main():
+	parser = argparse.ArgumentParser( description='Compares full vis times of vvis configurations.' )
+	parser.add_argument( '--vvis', required=True, help='vvis executable to measure' )
+	parser.add_argument( '--baseline-vvis', default=None, help='vvis executable to compare against' )
+	parser.add_argument( '--game', required=True )
+	parser.add_argument( '--threads', type=int, default=0 )
+	parser.add_argument( '--runs', type=int, default=1, help='runs per configuration, best time counts' )
+	parser.add_argument( 'maps', nargs='+', help='.bsp files, each with its .prt' )
+
+	# extra vvis arguments follow --
+	argv = sys.argv[1:]
+	extra = []
+	if '--' in argv:
+		extra = argv[argv.index( '--' ) + 1:]
+		argv = argv[:argv.index( '--' )]
+	args = parser.parse_args( argv )
+	args.extra = extra
+
+	if args.baseline_vvis:
+		configs = [ ( 'baseline', args.baseline_vvis, [] ), ( 'new', args.vvis, [ '-costflow' ] ) ]
+	else:
+		configs = [ ( 'baseline', args.vvis, [ '-linearflow', '-noavx2' ] ), ( 'new', args.vvis, [ '-costflow' ] ) ]
+
+	totals = { name: [ 0.0, 0.0 ] for name, _, _ in configs }
+
+	print( '  %-32s | %-21s | %-21s | %s' % ( 'map', 'baseline flow / total', 'new flow / total', 'speedup' ) )
+	for bsp in args.maps:
+		results = {}
+		visdata = {}
+		for name, exe, extra in configs:
+			runs = []
+			for _ in range( args.runs ):
+				scratch = tempfile.mkdtemp( prefix='vvis_compare_' )
+				try:
+					run = run_vvis( exe, extra, args, bsp, scratch )
+					if run:
+						visdata[name] = read_visdata( run['bsp'] )
+					runs.append( run )
+				finally:
+					shutil.rmtree( scratch, ignore_errors=True )
+			results[name] = ( best_of( runs, 'portalflow' ), best_of( runs, 'total' ) )
+
+		base, new = results['baseline'], results['new']
+		if base[1] is None or new[1] is None:
+			print( '  %-32s | failed' % os.path.basename( bsp ) )
+			continue
+
+		for name in totals:
+			totals[name][0] += results[name][0] or 0.0
+			totals[name][1] += results[name][1]
+
+		same = visdata.get( 'baseline' ) == visdata.get( 'new' )
+		print( '  %-32s | %8.2fs / %8.2fs | %8.2fs / %8.2fs | %.2fx%s' % ( os.path.basename( bsp ),
+			base[0] or 0.0, base[1], new[0] or 0.0, new[1], base[1] / new[1] if new[1] else 0.0,
+			'' if same else '  (vis data differs)' ) )
+
+	base, new = totals['baseline'], totals['new']
+	print( '  %-32s | %8.2fs / %8.2fs | %8.2fs / %8.2fs | %.2fx' % ( 'all maps', base[0], base[1], new[0], new[1],
+		base[1] / new[1] if new[1] else 0.0 ) )
+	return 0
+
+
+if __name__ == '__main__':
+	sys.exit( main() )
@@ -2047,6 +2047,25 @@ void CM_BoxTraceAgainstLeafList( const Ray_t &ray, int *pLeafList, intp nLeafCou
 	Assert( !ray.m_IsRay || trace.allsolid || ( trace.fraction >= trace.fractionleftsolid ) );
 }
 
+//-----------------------------------------------------------------------------
+// Fills in global trace data of a ray
+//-----------------------------------------------------------------------------
+static inline void CM_SetupTraceInfo( TraceInfo_t *pTraceInfo, const Ray_t& ray, int brushmask )
+{
+	pTraceInfo->m_bDispHit = false;
+	pTraceInfo->m_DispStabDir.Init();
+	pTraceInfo->m_contents = brushmask;
+	VectorCopy (ray.m_Start, pTraceInfo->m_start);
+	VectorAdd  (ray.m_Start, ray.m_Delta, pTraceInfo->m_end);
+	VectorMultiply (ray.m_Extents, -1.0f, pTraceInfo->m_mins);
+	VectorCopy (ray.m_Extents, pTraceInfo->m_maxs);
+	VectorCopy (ray.m_Extents, pTraceInfo->m_extents);
+	pTraceInfo->m_delta = ray.m_Delta;
+	pTraceInfo->m_invDelta = ray.InvDelta();
+	pTraceInfo->m_ispoint = ray.m_IsRay;
+	pTraceInfo->m_isswept = ray.m_IsSwept;
+}
+
 void CM_BoxTrace( const Ray_t& ray, int headnode, int brushmask, bool computeEndpt, trace_t& tr )
 {
 	VPROF("BoxTrace");
@@ -2071,18 +2090,7 @@ void CM_BoxTrace( const Ray_t& ray, int headnode, int brushmask, bool computeEnd
 		return;
 	}
 
-	pTraceInfo->m_bDispHit = false;
-	pTraceInfo->m_DispStabDir.Init();
-	pTraceInfo->m_contents = brushmask;
-	VectorCopy (ray.m_Start, pTraceInfo->m_start);
-	VectorAdd  (ray.m_Start, ray.m_Delta, pTraceInfo->m_end);
-	VectorMultiply (ray.m_Extents, -1.0f, pTraceInfo->m_mins);
-	VectorCopy (ray.m_Extents, pTraceInfo->m_maxs);
-	VectorCopy (ray.m_Extents, pTraceInfo->m_extents);
-	pTraceInfo->m_delta = ray.m_Delta;
-	pTraceInfo->m_invDelta = ray.InvDelta();
-	pTraceInfo->m_ispoint = ray.m_IsRay;
-	pTraceInfo->m_isswept = ray.m_IsSwept;
+	CM_SetupTraceInfo( pTraceInfo, ray, brushmask );
 
 	if (!ray.m_IsSwept)
 	{
@@ -2107,6 +2115,207 @@ void CM_BoxTrace( const Ray_t& ray, int headnode, int brushmask, bool computeEnd
 }
 
 
+//-----------------------------------------------------------------------------
+// Packet tracing. Swept rays of a packet walk the collision BSP together while
+// all of them are fully on one side of node planes. When rays diverge the packet
+// is split into front and back sub packets, and rays crossing the plane are
+// unbundled: each finishes with CM_RecursiveHullCheck from that node, which is
+// exactly where the serial walk would start splitting it too.
+//-----------------------------------------------------------------------------
+#define TRACE_PACKET_GROUP_SIZE		4	// rays per fltx4
+#define TRACE_PACKET_MAX_GROUPS		2
+#define TRACE_PACKET_MAX_RAYS		( TRACE_PACKET_GROUP_SIZE * TRACE_PACKET_MAX_GROUPS )
+
+struct TracePacket_t
+{
+	// x, y, z of ray starts, ends and extents per fltx4 group
+	fltx4				m_Start[TRACE_PACKET_MAX_GROUPS][3];
+	fltx4				m_End[TRACE_PACKET_MAX_GROUPS][3];
+	fltx4				m_Extents[TRACE_PACKET_MAX_GROUPS][3];
+	TraceInfo_t			*m_pTraceInfos[TRACE_PACKET_MAX_RAYS];
+	CCollisionBSPData	*m_pBSPData;
+};
+
+static void CM_UnbundleTracePacket( const TracePacket_t &packet, int num, unsigned nRayMask )
+{
+	for ( int i = 0; nRayMask; ++i, nRayMask >>= 1 )
+	{
+		if ( nRayMask & 1 )
+		{
+			CM_RecursiveHullCheck( packet.m_pTraceInfos[i], num, 0, 1 );
+		}
+	}
+}
+
+template <int GROUPS>
+static void CM_RecursiveHullCheckPacket( const TracePacket_t &packet, int num, unsigned nRayMask )
+{
+	// nothing to share once a single ray is left
+	while ( num >= 0 && ( nRayMask & ( nRayMask - 1 ) ) != 0 )
+	{
+		const cnode_t *node = packet.m_pBSPData->map_rootnode + num;
+		const cplane_t *plane = node->plane;
+
+		const fltx4 normalX = ReplicateX4( plane->normal.x );
+		const fltx4 normalY = ReplicateX4( plane->normal.y );
+		const fltx4 normalZ = ReplicateX4( plane->normal.z );
+		const fltx4 dist = ReplicateX4( plane->dist );
+
+		unsigned nFront = 0, nBack = 0;
+		for ( int g = 0; g < GROUPS; ++g )
+		{
+			// Same operation order as DotProduct. SIMD may still round differently, so rays
+			// within DIST_EPSILON of the plane are unbundled and the scalar walk picks the side.
+			const fltx4 t1 = SubSIMD( AddSIMD( AddSIMD( MulSIMD( normalX, packet.m_Start[g][0] ), MulSIMD( normalY, packet.m_Start[g][1] ) ), MulSIMD( normalZ, packet.m_Start[g][2] ) ), dist );
+			const fltx4 t2 = SubSIMD( AddSIMD( AddSIMD( MulSIMD( normalX, packet.m_End[g][0] ), MulSIMD( normalY, packet.m_End[g][1] ) ), MulSIMD( normalZ, packet.m_End[g][2] ) ), dist );
+
+			const fltx4 offsetX = MulSIMD( normalX, packet.m_Extents[g][0] );
+			const fltx4 offsetY = MulSIMD( normalY, packet.m_Extents[g][1] );
+			const fltx4 offsetZ = MulSIMD( normalZ, packet.m_Extents[g][2] );
+			const fltx4 offset = AddSIMD( AddSIMD( AddSIMD( MaxSIMD( offsetX, NegSIMD( offsetX ) ), MaxSIMD( offsetY, NegSIMD( offsetY ) ) ), MaxSIMD( offsetZ, NegSIMD( offsetZ ) ) ), Four_DistEpsilons );
+			const fltx4 negOffset = NegSIMD( offset );
+
+			const fltx4 front = AndSIMD( CmpGtSIMD( t1, offset ), CmpGtSIMD( t2, offset ) );
+			const fltx4 back = AndSIMD( CmpLtSIMD( t1, negOffset ), CmpLtSIMD( t2, negOffset ) );
+
+			nFront |= static_cast<unsigned>( TestSignSIMD( front ) ) << ( g * TRACE_PACKET_GROUP_SIZE );
+			nBack |= static_cast<unsigned>( TestSignSIMD( back ) ) << ( g * TRACE_PACKET_GROUP_SIZE );
+		}
+
+		nFront &= nRayMask;
+		nBack &= nRayMask;
+
+		if ( nFront == nRayMask )
+		{
+			num = node->children[0];
+			continue;
+		}
+		if ( nBack == nRayMask )
+		{
+			num = node->children[1];
+			continue;
+		}
+
+		// packet diverges
+		CM_UnbundleTracePacket( packet, num, nRayMask & ~( nFront | nBack ) );
+
+		if ( nFront )
+		{
+			CM_RecursiveHullCheckPacket<GROUPS>( packet, node->children[0], nFront );
+		}
+		if ( nBack )
+		{
+			CM_RecursiveHullCheckPacket<GROUPS>( packet, node->children[1], nBack );
+		}
+		return;
+	}
+
+	// leaf reached or single ray left
+	CM_UnbundleTracePacket( packet, num, nRayMask );
+}
+
+void CM_BoxTraceRays( const Ray_t *pRays, int nRays, int headnode, int brushmask, bool computeEndpt, trace_t *pTraces )
+{
+	VPROF("BoxTraceRays");
+
+	CCollisionBSPData *pBSPData = GetCollisionBSPData();
+
+	for ( int iFirstRay = 0; iFirstRay < nRays; iFirstRay += TRACE_PACKET_MAX_RAYS )
+	{
+		const int nPacketRays = min( nRays - iFirstRay, TRACE_PACKET_MAX_RAYS );
+		const Ray_t *pPacketRays = pRays + iFirstRay;
+		trace_t *pPacketTraces = pTraces + iFirstRay;
+
+		alignas(16) float flStart[TRACE_PACKET_MAX_GROUPS][3][TRACE_PACKET_GROUP_SIZE] = {};
+		alignas(16) float flEnd[TRACE_PACKET_MAX_GROUPS][3][TRACE_PACKET_GROUP_SIZE] = {};
+		alignas(16) float flExtents[TRACE_PACKET_MAX_GROUPS][3][TRACE_PACKET_GROUP_SIZE] = {};
+
+		TracePacket_t packet;
+		packet.m_pBSPData = pBSPData;
+
+		unsigned nRayMask = 0;
+		for ( int i = 0; i < nPacketRays; ++i )
+		{
+			const Ray_t &ray = pPacketRays[i];
+
+			packet.m_pTraceInfos[i] = NULL;
+
+			// position tests and unloaded map take the regular path
+			if ( !ray.m_IsSwept || !pBSPData->numnodes )
+			{
+				CM_BoxTrace( ray, headnode, brushmask, computeEndpt, pPacketTraces[i] );
+				continue;
+			}
+
+			// for multi-check avoidance
+			TraceInfo_t *pTraceInfo = BeginTrace();
+
+#ifdef COUNT_COLLISIONS
+			// for statistics, may be zeroed
+			g_CollisionCounts.m_Traces++;
+#endif
+
+			CM_ClearTrace( &pTraceInfo->m_trace );
+			pTraceInfo->m_pBSPData = pBSPData;
+			CM_SetupTraceInfo( pTraceInfo, ray, brushmask );
+
+			const int iGroup = i / TRACE_PACKET_GROUP_SIZE;
+			const int iLane = i % TRACE_PACKET_GROUP_SIZE;
+			for ( int j = 0; j < 3; ++j )
+			{
+				flStart[iGroup][j][iLane] = pTraceInfo->m_start[j];
+				flEnd[iGroup][j][iLane] = pTraceInfo->m_end[j];
+				flExtents[iGroup][j][iLane] = pTraceInfo->m_extents[j];
+			}
+
+			packet.m_pTraceInfos[i] = pTraceInfo;
+			nRayMask |= 1u << i;
+		}
+
+		if ( nRayMask )
+		{
+			const int nGroups = ( nPacketRays + TRACE_PACKET_GROUP_SIZE - 1 ) / TRACE_PACKET_GROUP_SIZE;
+			for ( int iGroup = 0; iGroup < nGroups; ++iGroup )
+			{
+				for ( int j = 0; j < 3; ++j )
+				{
+					packet.m_Start[iGroup][j] = LoadAlignedSIMD( flStart[iGroup][j] );
+					packet.m_End[iGroup][j] = LoadAlignedSIMD( flEnd[iGroup][j] );
+					packet.m_Extents[iGroup][j] = LoadAlignedSIMD( flExtents[iGroup][j] );
+				}
+			}
+
+			if ( nGroups == 1 )
+			{
+				CM_RecursiveHullCheckPacket<1>( packet, headnode, nRayMask );
+			}
+			else
+			{
+				CM_RecursiveHullCheckPacket<TRACE_PACKET_MAX_GROUPS>( packet, headnode, nRayMask );
+			}
+		}
+
+		for ( int i = 0; i < nPacketRays; ++i )
+		{
+			TraceInfo_t *pTraceInfo = packet.m_pTraceInfos[i];
+			if ( !pTraceInfo )
+				continue;
+
+			// Compute the trace start + end points
+			if ( computeEndpt )
+			{
+				CM_ComputeTraceEndpoints( pPacketRays[i], pTraceInfo->m_trace );
+			}
+
+			// Copy off the results
+			pPacketTraces[i] = pTraceInfo->m_trace;
+			EndTrace( pTraceInfo );
+			Assert( !pPacketRays[i].m_IsRay || pPacketTraces[i].allsolid || (pPacketTraces[i].fraction >= pPacketTraces[i].fractionleftsolid) );
+		}
+	}
+}
+
+
 void CM_TransformedBoxTrace( const Ray_t& ray, int headnode, int brushmask,
 							const Vector& origin, QAngle const& angles, trace_t& tr )
 {
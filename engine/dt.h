@@ -169,6 +169,12 @@ public:
 	// Write the next property index. Returns the number of bits used.
 	void		WritePropIndex( int iProp );
 
+	// Write the next property index followed by the low nBits of nValue, in one write if they fit.
+	void		WritePropIndexAndBits( int iProp, uint32 nValue, int nBits );
+
+	// Props up to iProp were copied, with their indices, from another encoding of the same object.
+	void		SetLastPropIndex( int iProp );
+
 	// Access the buffer it's outputting to.
 	bf_write*	GetBitBuf();
 
@@ -188,6 +194,12 @@ inline bf_write* CDeltaBitsWriter::GetBitBuf()
 	return m_pBuf;
 }
 
+inline void CDeltaBitsWriter::SetLastPropIndex( int iProp )
+{
+	Assert( iProp >= m_iLastProp && iProp < MAX_DATATABLE_PROPS );
+	m_iLastProp = iProp;
+}
+
 FORCEINLINE void CDeltaBitsWriter::WritePropIndex( int iProp )
 {
 	Assert( iProp >= 0 && iProp < MAX_DATATABLE_PROPS );
@@ -202,6 +214,29 @@ FORCEINLINE void CDeltaBitsWriter::WritePropIndex( int iProp )
 	m_pBuf->WriteUBitLong( diff*8 - 8 + 4 + n*2 + 1, 8 + n*4 + 4 + 2 + 1 );
 }
 
+FORCEINLINE void CDeltaBitsWriter::WritePropIndexAndBits( int iProp, uint32 nValue, int nBits )
+{
+	Assert( iProp >= 0 && iProp < MAX_DATATABLE_PROPS );
+	Assert( nBits > 0 && nBits <= 32 );
+	unsigned int diff = iProp - m_iLastProp;
+	m_iLastProp = iProp;
+	Assert( diff > 0 && diff <= MAX_DATATABLE_PROPS );
+	// Same index encoding as WritePropIndex. The buffer is written LSB first, so the
+	// value can go above the index bits.
+	int n = ((diff < 0x11u) ? -1 : 0) + ((diff < 0x101u) ? -1 : 0);
+	uint32 nIndex = diff*8 - 8 + 4 + n*2 + 1;
+	int nIndexBits = 8 + n*4 + 4 + 2 + 1;
+	if ( nIndexBits + nBits <= 32 )
+	{
+		m_pBuf->WriteUBitLong( nIndex | ( nValue << nIndexBits ), nIndexBits + nBits, false );
+	}
+	else
+	{
+		m_pBuf->WriteUBitLong( nIndex, nIndexBits );
+		m_pBuf->WriteUBitLong( nValue, nBits, false );
+	}
+}
+
 inline CDeltaBitsWriter::~CDeltaBitsWriter()
 {
 	m_pBuf->WriteOneBit( 0 );
@@ -337,6 +372,9 @@ public:
 };
 
 
+#define PROP_INDEX_VECTOR_ELEM_MARKER 0x8000
+
+
 // ----------------------------------------------------------------------------- //
 // CSendTablePrecalc
 // ----------------------------------------------------------------------------- //
@@ -404,12 +442,20 @@ public:
 	// from the server entity to the client entity.
 	CFastLocalTransferInfo	m_FastLocalTransfer;
 
+	// How to encode each of m_Props, compiled in SendTable_Init.
+	CUtlVector<CSendPropEncoder> m_Encoders;
+
 	// This tells how many data table properties there are without SPROP_PROXY_ALWAYS_YES.
 	// Arrays allocated with this size can be indexed by CSendNode::GetDataTableProxyIndex().
 	int						m_nDataTableProxies;
 	
 	// Map prop offsets to indices for properties that can use it.
+	// Vector elements are marked with PROP_INDEX_VECTOR_ELEM_MARKER.
 	CUtlMap<unsigned short, unsigned short> m_PropOffsetToIndexMap;
+
+	// Props that must be re-encoded whenever the entity changes, because they're not in
+	// m_PropOffsetToIndexMap or their proxy may return something new without a change to their offset.
+	CVarBitVec				m_AlwaysDirtyProps;
 };
 
 
@@ -1268,6 +1268,263 @@ void Int64_SkipProp( const SendProp *pProp, bf_read *pIn )
 
 
 
+// ---------------------------------------------------------------------------------------- //
+// Compiled property encoders.
+// ---------------------------------------------------------------------------------------- //
+
+// Size of the int the proxy reads, negative if signed. Zero if it isn't a standard int proxy.
+static int GetStandardIntProxyBytes( SendVarProxyFn fn, const CStandardSendProxiesV1 *pSendProxies )
+{
+	if ( fn == pSendProxies->m_Int8ToInt32 )
+		return -1;
+	if ( fn == pSendProxies->m_Int16ToInt32 )
+		return -2;
+	if ( fn == pSendProxies->m_Int32ToInt32 )
+		return -4;
+	if ( fn == pSendProxies->m_UInt8ToInt32 )
+		return 1;
+	if ( fn == pSendProxies->m_UInt16ToInt32 )
+		return 2;
+	if ( fn == pSendProxies->m_UInt32ToInt32 )
+		return 4;
+	return 0;
+}
+
+static SendPropEncodeFloat_t GetFloatEncodeOp( const SendProp *pProp )
+{
+	int flags = pProp->GetFlags();
+	if ( flags & SPROP_COORD )
+		return SENDPROP_FLOAT_COORD;
+	if ( flags & ( SPROP_COORD_MP | SPROP_COORD_MP_LOWPRECISION | SPROP_COORD_MP_INTEGRAL ) )
+		return SENDPROP_FLOAT_COORD_MP;
+	if ( flags & SPROP_NORMAL )
+		return SENDPROP_FLOAT_NORMAL;
+	if ( flags & SPROP_NOSCALE )
+		return SENDPROP_FLOAT_NOSCALE;
+	return pProp->m_nBits <= 22 ? SENDPROP_FLOAT_RANGE : SENDPROP_FLOAT_RANGE_WIDE;
+}
+
+void SendProp_CompileEncoder( const SendProp *pProp, const CStandardSendProxiesV1 *pSendProxies, CSendPropEncoder *pEncoder )
+{
+	pEncoder->m_Op = SENDPROP_ENCODE_PROXY;
+	pEncoder->m_FloatOp = SENDPROP_FLOAT_RANGE_WIDE;
+	pEncoder->m_nIntBytes = 0;
+	pEncoder->m_nBits = 0;
+	pEncoder->m_nPreserveBits = 0;
+	pEncoder->m_Offset = pProp->GetOffset();
+
+	if ( !pSendProxies )
+		return;
+
+	int flags = pProp->GetFlags();
+	SendVarProxyFn fn = pProp->GetProxyFn();
+
+	switch ( pProp->GetType() )
+	{
+		case DPT_Int:
+		{
+			int nIntBytes = GetStandardIntProxyBytes( fn, pSendProxies );
+			if ( !nIntBytes )
+				return;
+
+			if ( flags & SPROP_VARINT )
+			{
+				pEncoder->m_Op = ( flags & SPROP_UNSIGNED ) ? SENDPROP_ENCODE_UVARINT : SENDPROP_ENCODE_VARINT;
+			}
+			else
+			{
+				if ( pProp->m_nBits <= 0 || pProp->m_nBits > 32 )
+					return;
+
+				// See Int_Encode.
+				pEncoder->m_Op = SENDPROP_ENCODE_INT;
+				pEncoder->m_nBits = pProp->m_nBits;
+				pEncoder->m_nPreserveBits = ( 0x7FFFFFFF >> ( 32 - pProp->m_nBits ) ) | ( ( flags & SPROP_UNSIGNED ) ? 0xFFFFFFFF : 0 );
+			}
+			pEncoder->m_nIntBytes = nIntBytes;
+			break;
+		}
+
+		case DPT_Float:
+			if ( fn != pSendProxies->m_FloatToFloat )
+				return;
+			pEncoder->m_Op = SENDPROP_ENCODE_FLOAT;
+			break;
+
+		case DPT_Vector:
+			if ( fn != pSendProxies->m_VectorToVector )
+				return;
+			pEncoder->m_Op = SENDPROP_ENCODE_VECTOR;
+			break;
+
+		default:
+			return;
+	}
+
+	if ( pEncoder->m_Op == SENDPROP_ENCODE_FLOAT || pEncoder->m_Op == SENDPROP_ENCODE_VECTOR )
+	{
+		pEncoder->m_FloatOp = GetFloatEncodeOp( pProp );
+		if ( pEncoder->m_FloatOp == SENDPROP_FLOAT_RANGE )
+		{
+			pEncoder->m_nBits = pProp->m_nBits;
+		}
+	}
+}
+
+// What the standard int proxies put in DVariant::m_Int.
+static FORCEINLINE int LoadCompiledInt( const CSendPropEncoder &encoder, const unsigned char *pData )
+{
+	switch ( encoder.m_nIntBytes )
+	{
+		case -1:	return *((const char*)pData);
+		case -2:	return *((const short*)pData);
+		case 1:		return *((const unsigned char*)pData);
+		case 2:		return *((const unsigned short*)pData);
+		default:	return *((const int*)pData);
+	}
+}
+
+// Same as EncodeFloat, with the flags already sorted out.
+static FORCEINLINE void EncodeCompiledFloat( const CSendPropEncoder &encoder, const SendProp *pProp, float fVal, bf_write *pOut, int objectID )
+{
+	switch ( encoder.m_FloatOp )
+	{
+		case SENDPROP_FLOAT_COORD:
+			pOut->WriteBitCoord( fVal );
+			return;
+
+		case SENDPROP_FLOAT_COORD_MP:
+		{
+			int flags = pProp->GetFlags();
+			pOut->WriteBitCoordMP( fVal, ((flags >> 15) & 1), ((flags >> 14) & 1) );
+			return;
+		}
+
+		case SENDPROP_FLOAT_NORMAL:
+			pOut->WriteBitNormal( fVal );
+			return;
+
+		case SENDPROP_FLOAT_NOSCALE:
+		{
+			union { float f; uint32 u; } convert = { fVal };
+			pOut->WriteUBitLong( convert.u, 32 );
+			return;
+		}
+
+		case SENDPROP_FLOAT_RANGE:
+			if ( fVal >= pProp->m_fLowValue && fVal <= pProp->m_fHighValue )
+			{
+				pOut->WriteUBitLong( FastFloatToSmallInt( (fVal - pProp->m_fLowValue) * pProp->m_fHighLowMul ), encoder.m_nBits );
+				return;
+			}
+			break;
+	}
+
+	// Wide ranges, and values EncodeFloat clamps and warns about.
+	EncodeFloat( pProp, fVal, pOut, objectID );
+}
+
+void SendProp_EncodeCompiled( const CSendPropEncoder &encoder, const SendProp *pProp, const unsigned char *pStructBase, 
+	int iProp, CDeltaBitsWriter *pOut, int objectID )
+{
+	const unsigned char *pData = pStructBase + encoder.m_Offset;
+	bf_write *pBuf = pOut->GetBitBuf();
+
+	switch ( encoder.m_Op )
+	{
+		case SENDPROP_ENCODE_INT:
+		{
+			// See Int_Encode.
+			int nValue = LoadCompiledInt( encoder, pData );
+			int nSignExtension = ( nValue >> 31 ) & ~encoder.m_nPreserveBits;
+			int nEncoded = ( nValue & encoder.m_nPreserveBits ) | nSignExtension;
+			AssertMsg3( nEncoded == nValue, "Prop %s needs more bits? Expected %i == %i", pProp->GetName(), nEncoded, nValue );
+
+			pOut->WritePropIndexAndBits( iProp, nEncoded, encoder.m_nBits );
+			break;
+		}
+
+		case SENDPROP_ENCODE_VARINT:
+			pOut->WritePropIndex( iProp );
+			pBuf->WriteSignedVarInt32( LoadCompiledInt( encoder, pData ) );
+			break;
+
+		case SENDPROP_ENCODE_UVARINT:
+			pOut->WritePropIndex( iProp );
+			pBuf->WriteVarInt32( LoadCompiledInt( encoder, pData ) );
+			break;
+
+		case SENDPROP_ENCODE_FLOAT:
+		{
+			float fVal = *((const float*)pData);
+			Assert( IsFinite( fVal ) );
+
+			if ( encoder.m_FloatOp == SENDPROP_FLOAT_RANGE && fVal >= pProp->m_fLowValue && fVal <= pProp->m_fHighValue )
+			{
+				pOut->WritePropIndexAndBits( iProp, FastFloatToSmallInt( (fVal - pProp->m_fLowValue) * pProp->m_fHighLowMul ), encoder.m_nBits );
+			}
+			else
+			{
+				pOut->WritePropIndex( iProp );
+				EncodeCompiledFloat( encoder, pProp, fVal, pBuf, objectID );
+			}
+			break;
+		}
+
+		case SENDPROP_ENCODE_VECTOR:
+		{
+			const Vector &v = *((const Vector*)pData);
+			Assert( v.IsValid() );
+
+			// See Vector_Encode.
+			pOut->WritePropIndex( iProp );
+			EncodeCompiledFloat( encoder, pProp, v[0], pBuf, objectID );
+			EncodeCompiledFloat( encoder, pProp, v[1], pBuf, objectID );
+			if ( ( pProp->GetFlags() & SPROP_NORMAL ) == 0 )
+			{
+				EncodeCompiledFloat( encoder, pProp, v[2], pBuf, objectID );
+			}
+			else
+			{
+				pBuf->WriteOneBit( v[2] <= -NORMAL_RESOLUTION );
+			}
+			break;
+		}
+
+		default:
+			AssertMsg1( false, "SendProp_EncodeCompiled: prop %s has no compiled encoder", pProp->GetName() );
+			break;
+	}
+}
+
+bool SendProp_IsZeroCompiled( const CSendPropEncoder &encoder, const unsigned char *pStructBase )
+{
+	const unsigned char *pData = pStructBase + encoder.m_Offset;
+
+	switch ( encoder.m_Op )
+	{
+		case SENDPROP_ENCODE_INT:
+		case SENDPROP_ENCODE_VARINT:
+		case SENDPROP_ENCODE_UVARINT:
+			return LoadCompiledInt( encoder, pData ) == 0;
+
+		case SENDPROP_ENCODE_FLOAT:
+			return *((const float*)pData) == 0;
+
+		case SENDPROP_ENCODE_VECTOR:
+		{
+			const float *v = (const float*)pData;
+			return ( v[0] == 0 ) && ( v[1] == 0 ) && ( v[2] == 0 );
+		}
+
+		default:
+			Assert( false );
+			return false;
+	}
+}
+
+
+
 PropTypeFns g_PropTypeFns[DPT_NUMSendPropTypes] =
 {
 	// DPT_Int
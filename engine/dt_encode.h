@@ -91,4 +91,58 @@ extern PropTypeFns g_PropTypeFns[DPT_NUMSendPropTypes];
 int	DecodeBits( DecodeInfo *pInfo, unsigned char *pOut );
 
 
+// ---------------------------------------------------------------------------------------- //
+// Compiled property encoders.
+//
+// A property whose proxy is one of the CStandardSendProxies just copies the variable into
+// the DVariant, so it can be encoded straight from the entity instead. These write exactly
+// the bits the proxy followed by g_PropTypeFns[].Encode would.
+// ---------------------------------------------------------------------------------------- //
+
+class CStandardSendProxiesV1;
+class CDeltaBitsWriter;
+
+enum SendPropEncodeOp_t
+{
+	SENDPROP_ENCODE_PROXY=0,		// Call the proxy, then g_PropTypeFns[].Encode.
+	SENDPROP_ENCODE_INT,			// m_nBits wide int.
+	SENDPROP_ENCODE_VARINT,			// SPROP_VARINT int.
+	SENDPROP_ENCODE_UVARINT,		// SPROP_VARINT | SPROP_UNSIGNED int.
+	SENDPROP_ENCODE_FLOAT,
+	SENDPROP_ENCODE_VECTOR
+};
+
+// How a float or each vector component is written, in the order EncodeFloat checks the flags.
+enum SendPropEncodeFloat_t
+{
+	SENDPROP_FLOAT_COORD=0,
+	SENDPROP_FLOAT_COORD_MP,
+	SENDPROP_FLOAT_NORMAL,
+	SENDPROP_FLOAT_NOSCALE,
+	SENDPROP_FLOAT_RANGE,			// Clamped range float of at most 22 bits.
+	SENDPROP_FLOAT_RANGE_WIDE		// Clamped range float of more bits, left to EncodeFloat.
+};
+
+class CSendPropEncoder
+{
+public:
+	unsigned char	m_Op;			// SendPropEncodeOp_t
+	unsigned char	m_FloatOp;		// SendPropEncodeFloat_t
+	signed char		m_nIntBytes;	// Size of an int variable, negative if it is signed.
+	unsigned char	m_nBits;
+	int				m_nPreserveBits;// Int_Encode's mask of the int bits kept as they are.
+	int				m_Offset;		// Of the variable from the struct base its datatable proxy returned.
+};
+
+// Choose the encoder for pProp. With no pSendProxies, every property calls its proxy.
+void SendProp_CompileEncoder( const SendProp *pProp, const CStandardSendProxiesV1 *pSendProxies, CSendPropEncoder *pEncoder );
+
+// Write the property index and the value for an encoder that isn't SENDPROP_ENCODE_PROXY.
+void SendProp_EncodeCompiled( const CSendPropEncoder &encoder, const SendProp *pProp, const unsigned char *pStructBase, 
+	int iProp, CDeltaBitsWriter *pOut, int objectID );
+
+// Same as g_PropTypeFns[].IsZero on the value the proxy would have returned.
+bool SendProp_IsZeroCompiled( const CSendPropEncoder &encoder, const unsigned char *pStructBase );
+
+
 #endif // DATATABLE_ENCODE_H
@@ -8,6 +8,7 @@
 #include "filesystem.h"
 #include "dt_instrumentation_server.h"
 #include "dt_send.h"
+#include "tier0/threadtools.h"
 #include "tier1/utlstring.h"
 #include "utllinkedlist.h"
 #include "dt.h"
@@ -38,6 +39,14 @@ public:
 
 	CCycleCount		m_nWriteDeltaPropsCycles;
 
+	// How many entity deltas were reused from / missed in the shared delta cache.
+	int				m_nDeltaCacheHits;
+	int				m_nDeltaCacheMisses;
+
+	// How many entities were packed from scratch or by splicing their dirty props into the previous packet.
+	int				m_nFullRepacks;
+	int				m_nPartialRepacks;
+
 	// Used to determine how much the class uses manual mode.
 	int m_nChangeAutoDetects;
 	int m_nNoChanges;
@@ -60,6 +69,9 @@ static char const *g_pServerDTIFilename = 0;
 static bool g_bFirstHookTimer = true;
 static CCycleCount g_ServerDTITimer;
 
+// Snapshots can be written from several send jobs at once (sv_parallel_sendsnapshot).
+static CThreadFastMutex g_ServerDTIMutex;
+
 
 
 void ServerDTI_Init( char const *pFilename )
@@ -113,6 +125,13 @@ void ServerDTI_Flush()
 
 			"\tWriteDeltaProps ms"
 
+			"\tDeltaCache hits"
+			"\tDeltaCache misses"
+			"\t%% DeltaCache hit"
+
+			"\tFull repacks"
+			"\tPartial repacks"
+
 			"\t%% manual mode"
 
 			"\tTotal"
@@ -122,6 +141,8 @@ void ServerDTI_Flush()
 
 		// Calculate totals.
 		CCycleCount totalCalcDelta, totalEncode, totalShouldTransmit, totalDeltaProps;
+		int64 totalDeltaCacheHits = 0, totalDeltaCacheMisses = 0;
+		int64 totalFullRepacks = 0, totalPartialRepacks = 0;
 		totalCalcDelta.Init();
 		totalEncode.Init();
 		totalShouldTransmit.Init();
@@ -134,6 +155,10 @@ void ServerDTI_Flush()
 			CCycleCount::Add( pTable->m_nEncodeCycles, totalEncode, totalEncode );
 			CCycleCount::Add( pTable->m_nShouldTransmitCycles, totalShouldTransmit, totalShouldTransmit );
 			CCycleCount::Add( pTable->m_nWriteDeltaPropsCycles, totalDeltaProps, totalDeltaProps );
+			totalDeltaCacheHits += pTable->m_nDeltaCacheHits;
+			totalDeltaCacheMisses += pTable->m_nDeltaCacheMisses;
+			totalFullRepacks += pTable->m_nFullRepacks;
+			totalPartialRepacks += pTable->m_nPartialRepacks;
 		}
 	
 
@@ -148,6 +173,8 @@ void ServerDTI_Flush()
 			CCycleCount::Add( pTable->m_nEncodeCycles, pTable->m_nCalcDeltaCycles, total );
 			CCycleCount::Add( pTable->m_nShouldTransmitCycles, total, total );
 
+			const int nDeltaCacheLookups = pTable->m_nDeltaCacheHits + pTable->m_nDeltaCacheMisses;
+
 			g_pFileSystem->FPrintf( fp, 
 				"%s"
 
@@ -162,6 +189,13 @@ void ServerDTI_Flush()
 
 				"\t%.3f"
 
+				"\t%d"
+				"\t%d"
+				"\t%.2f"
+
+				"\t%d"
+				"\t%d"
+
 				"\t%.2f"
 
 				"\t%.3f"
@@ -179,6 +213,13 @@ void ServerDTI_Flush()
 				pTable->m_nShouldTransmitCycles.GetMillisecondsF(),
 
 				pTable->m_nWriteDeltaPropsCycles.GetMillisecondsF(),
+
+				pTable->m_nDeltaCacheHits,
+				pTable->m_nDeltaCacheMisses,
+				nDeltaCacheLookups ? (float)pTable->m_nDeltaCacheHits * 100.0f / nDeltaCacheLookups : 0.0f,
+
+				pTable->m_nFullRepacks,
+				pTable->m_nPartialRepacks,
 				
 				(float)pTable->m_nNoChanges * 100.0f / (pTable->m_nNoChanges + pTable->m_nChangeAutoDetects),
 
@@ -230,6 +271,30 @@ void ServerDTI_Flush()
 			totalDeltaProps.GetMillisecondsF(),
 			totalDeltaProps.GetMillisecondsF() * 100.0 / runningTime.GetMillisecondsF()
 			);
+
+		g_pFileSystem->FPrintf( fp,
+			"Total DeltaCache hits:"
+			"\t%lld"
+			"\tMisses:"
+			"\t%lld"
+			"\tHit rate:"
+			"\t%.3f\n",
+			totalDeltaCacheHits,
+			totalDeltaCacheMisses,
+			totalDeltaCacheHits + totalDeltaCacheMisses ? totalDeltaCacheHits * 100.0 / ( totalDeltaCacheHits + totalDeltaCacheMisses ) : 0.0
+			);
+
+		g_pFileSystem->FPrintf( fp,
+			"Total full repacks:"
+			"\t%lld"
+			"\tPartial repacks:"
+			"\t%lld"
+			"\tPartial rate:"
+			"\t%.3f\n",
+			totalFullRepacks,
+			totalPartialRepacks,
+			totalFullRepacks + totalPartialRepacks ? totalPartialRepacks * 100.0 / ( totalFullRepacks + totalPartialRepacks ) : 0.0
+			);
 		
 		g_pFileSystem->Close( fp );
 
@@ -300,6 +365,8 @@ void ServerDTI_AddEntityEncodeEvent( SendTable *pSendTable, float distToPlayer )
 
 	int iDist = (int)( distToPlayer / DELTA_DISTANCE_BAND );
 	iDist = clamp( iDist, 0, NUM_DELTA_DISTANCE_BANDS - 1 );
+
+	AUTO_LOCK( g_ServerDTIMutex );
 	pTable->m_DistanceDeltaCounts[iDist]++;
 }
 
@@ -311,6 +378,8 @@ void _ServerDTI_HookTimer( const SendTable *pSendTable, ServerDTITimerType timer
 
 	CDTISendTable *pTable = pPrecalc->m_pDTITable;		
 
+	AUTO_LOCK( g_ServerDTIMutex );
+
 	if ( g_bFirstHookTimer )
 	{
 		g_ServerDTITimer.Sample();
@@ -355,3 +424,34 @@ void _ServerDTI_RegisterNetworkStateChange( SendTable *pSendTable, bool bStateCh
 		++pTable->m_nNoChanges;
 }
 
+void _ServerDTI_AddDeltaCacheEvent( const SendTable *pSendTable, bool bHit )
+{
+	CSendTablePrecalc *pPrecalc = pSendTable->m_pPrecalc;
+	if ( !pPrecalc || !pPrecalc->m_pDTITable )
+		return;
+
+	CDTISendTable *pTable = pPrecalc->m_pDTITable;
+
+	AUTO_LOCK( g_ServerDTIMutex );
+
+	if ( bHit )
+		++pTable->m_nDeltaCacheHits;
+	else
+		++pTable->m_nDeltaCacheMisses;
+}
+
+void _ServerDTI_AddEntityRepackEvent( const SendTable *pSendTable, bool bPartial )
+{
+	CSendTablePrecalc *pPrecalc = pSendTable->m_pPrecalc;
+	if ( !pPrecalc || !pPrecalc->m_pDTITable )
+		return;
+
+	CDTISendTable *pTable = pPrecalc->m_pDTITable;
+
+	AUTO_LOCK( g_ServerDTIMutex );
+
+	if ( bPartial )
+		++pTable->m_nPartialRepacks;
+	else
+		++pTable->m_nFullRepacks;
+}
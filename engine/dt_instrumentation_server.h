@@ -56,6 +56,12 @@ void ServerDTI_AddEntityEncodeEvent( SendTable *pTable, float distToPlayer );
 // Used to tell if the entity is using manual or auto mode.
 void ServerDTI_RegisterNetworkStateChange( SendTable *pTable, bool bStateChanged );
 
+// Used to tell how often entity deltas are shared between clients (g_EntityDeltaCache).
+void ServerDTI_AddDeltaCacheEvent( const SendTable *pTable, bool bHit );
+
+// Used to tell how often SV_PackEntity could re-encode only the entity's dirty props.
+void ServerDTI_AddEntityRepackEvent( const SendTable *pTable, bool bPartial );
+
 
 // ------------------------------------------------------------------------------------------ // 
 // Helper class to place timers easily.
@@ -108,4 +114,22 @@ inline void ServerDTI_RegisterNetworkStateChange( SendTable *pTable, bool bState
 	}
 }
 
+inline void ServerDTI_AddDeltaCacheEvent( const SendTable *pTable, bool bHit )
+{
+	if ( g_bServerDTIEnabled )
+	{
+		extern void _ServerDTI_AddDeltaCacheEvent( const SendTable *pTable, bool bHit );
+		_ServerDTI_AddDeltaCacheEvent( pTable, bHit );
+	}
+}
+
+inline void ServerDTI_AddEntityRepackEvent( const SendTable *pTable, bool bPartial )
+{
+	if ( g_bServerDTIEnabled )
+	{
+		extern void _ServerDTI_AddEntityRepackEvent( const SendTable *pTable, bool bPartial );
+		_ServerDTI_AddEntityRepackEvent( pTable, bPartial );
+	}
+}
+
 #endif // DATATABLE_INSTRUMENTATION_SERVER_H
@@ -18,9 +18,6 @@
 #include "tier0/memdbgon.h"
 
 
-#define PROP_INDEX_VECTOR_ELEM_MARKER 0x8000
-
-
 static ConVar dt_UsePartialChangeEnts( 
 	"dt_UsePartialChangeEnts",
 	"1",
@@ -216,9 +213,7 @@ void LocalTransfer_InitFastCopy(
 {
 	CSendTablePrecalc *pPrecalc = pSendTable->m_pPrecalc;
 
-	// Setup the offset-to-index map.
-	pPrecalc->m_PropOffsetToIndexMap.RemoveAll();
-	BuildPropOffsetToIndexMap( pPrecalc, pSendProxies );
+	// The offset-to-index map was set up by SendTable_Init.
 
 	// Clear the old lists.
 	pPrecalc->m_FastLocalTransfer.m_FastInt32.Purge();
@@ -487,7 +482,9 @@ void LocalTransfer_TransferEntity(
 	unsigned short propIndices[MAX_CHANGE_OFFSETS*3];
 	
 	// This code tries to only copy fields expressly marked as "changed" (by having the field offsets added to the changeoffsets vectors)
+	// A full list may have overflowed into the edict's dirty props, which this doesn't look at.
 	if ( pEdict->GetChangeInfoSerialNumber() == g_pSharedChangeInfo->m_iSerialNumber &&
+		 pCI->m_nChangeOffsets < MAX_CHANGE_OFFSETS &&
 		 !bNewlyCreated &&
 		 !bJustEnteredPVS &&
 		 dt_UsePartialChangeEnts.GetInt()
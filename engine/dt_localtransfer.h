@@ -17,6 +17,12 @@
 
 
 class CBaseEdict;
+class CSendTablePrecalc;
+
+
+// Fills pPrecalc->m_PropOffsetToIndexMap with the offset of each prop that can be reached
+// without calling a pointer modifying datatable proxy.
+void BuildPropOffsetToIndexMap( CSendTablePrecalc *pPrecalc, const CStandardSendProxies *pSendProxies );
 
 
 // This sets up the ability to copy an entity with the specified SendTable directly
@@ -15,6 +15,7 @@
 #include "dt_encode.h"
 #include "dt_instrumentation_server.h"
 #include "dt_stack.h"
+#include "dt_localtransfer.h"
 #include "common.h"
 #include "packed_entity.h"
 
@@ -242,8 +243,9 @@ CRC32_t	g_SendTableCRC = 0;
 // SendTable functions.
 // ------------------------------------------------------------------------ //
 
-static bool s_debug_info_shown = false;
-static int  s_debug_bits_start = 0;
+// Per thread as snapshots may be written from parallel send jobs.
+static thread_local bool s_debug_info_shown = false;
+static thread_local int  s_debug_bits_start = 0;
 
 
 static inline void ShowEncodeDeltaWatchInfo( 
@@ -256,7 +258,7 @@ static inline void ShowEncodeDeltaWatchInfo(
 	if ( !ShouldWatchThisProp( pTable, objectID, pProp->GetName()) )
 		return;
 	
-	static int lastframe = -1;
+	static thread_local int lastframe = -1;
 	if ( host_framecount != lastframe )
 	{
 		lastframe = host_framecount;
@@ -289,7 +291,7 @@ static inline void ShowEncodeDeltaWatchInfo(
 }
 
 
-static FORCEINLINE void SendTable_EncodeProp( CEncodeInfo * pInfo, unsigned long iProp )
+static FORCEINLINE void SendTable_EncodePropWithProxy( CEncodeInfo * pInfo, unsigned long iProp )
 {
 	// Call their proxy to get the property's value.
 	DVariant var;
@@ -319,7 +321,7 @@ static FORCEINLINE void SendTable_EncodeProp( CEncodeInfo * pInfo, unsigned long
 }
 
 
-static bool SendTable_IsPropZero( CEncodeInfo *pInfo, unsigned long iProp )
+static bool SendTable_IsPropZeroWithProxy( CEncodeInfo *pInfo, unsigned long iProp )
 {
 	const SendProp *pProp = pInfo->GetCurProp();
 
@@ -340,6 +342,30 @@ static bool SendTable_IsPropZero( CEncodeInfo *pInfo, unsigned long iProp )
 }
 
 
+// Props with a standard proxy are encoded straight from the entity, see SendProp_CompileEncoder.
+static FORCEINLINE void SendTable_EncodeProp( CEncodeInfo * pInfo, unsigned long iProp )
+{
+	const CSendPropEncoder &encoder = pInfo->m_pPrecalc->m_Encoders[iProp];
+	if ( encoder.m_Op == SENDPROP_ENCODE_PROXY )
+	{
+		SendTable_EncodePropWithProxy( pInfo, iProp );
+		return;
+	}
+
+	SendProp_EncodeCompiled( encoder, pInfo->GetCurProp(), pInfo->GetCurStructBase(), iProp, &pInfo->m_DeltaBitsWriter, pInfo->GetObjectID() );
+}
+
+
+static bool SendTable_IsPropZero( CEncodeInfo *pInfo, unsigned long iProp )
+{
+	const CSendPropEncoder &encoder = pInfo->m_pPrecalc->m_Encoders[iProp];
+	if ( encoder.m_Op == SENDPROP_ENCODE_PROXY )
+		return SendTable_IsPropZeroWithProxy( pInfo, iProp );
+
+	return SendProp_IsZeroCompiled( encoder, pInfo->GetCurStructBase() );
+}
+
+
 int SendTable_CullPropsFromProxies( 
 	const SendTable *pTable,
 	
@@ -406,7 +432,8 @@ int SendTable_WriteAllDeltaProps(
 }
 
 
-bool SendTable_Encode(
+template< bool bCompiled >
+static bool SendTable_EncodeProps(
 	const SendTable *pTable,
 	const void *pStruct, 
 	bf_write *pOut, 
@@ -442,17 +469,205 @@ bool SendTable_Encode(
 
 		info.SeekToProp( iProp );
         
-		// skip empty prop if we only encode non-zero values
-		if ( bNonZeroOnly && SendTable_IsPropZero(&info, iProp) )
-			continue;
+		if ( bCompiled )
+		{
+			// skip empty prop if we only encode non-zero values
+			if ( bNonZeroOnly && SendTable_IsPropZero(&info, iProp) )
+				continue;
+
+			SendTable_EncodeProp( &info, iProp );
+		}
+		else
+		{
+			if ( bNonZeroOnly && SendTable_IsPropZeroWithProxy(&info, iProp) )
+				continue;
 
-		SendTable_EncodeProp( &info, iProp );
+			SendTable_EncodePropWithProxy( &info, iProp );
+		}
 	}
 
 	return !pOut->IsOverflowed();
 }
 
 
+bool SendTable_Encode(
+	const SendTable *pTable,
+	const void *pStruct, 
+	bf_write *pOut, 
+	int objectID,
+	CUtlMemory<CSendProxyRecipients> *pRecipients,
+	bool bNonZeroOnly
+	)
+{
+	return SendTable_EncodeProps<true>( pTable, pStruct, pOut, objectID, pRecipients, bNonZeroOnly );
+}
+
+
+bool SendTable_EncodeWithProxies(
+	const SendTable *pTable,
+	const void *pStruct, 
+	bf_write *pOut, 
+	int objectID,
+	CUtlMemory<CSendProxyRecipients> *pRecipients,
+	bool bNonZeroOnly
+	)
+{
+	return SendTable_EncodeProps<false>( pTable, pStruct, pOut, objectID, pRecipients, bNonZeroOnly );
+}
+
+
+// Copies the encoded props between iStartBit and iEndBit of a previous state, the last of which is iLastProp.
+static inline void SendTable_CopyPropRun( CEncodeInfo *pInfo, const bf_read &prevBits, int iStartBit, int iEndBit, int iLastProp )
+{
+	bf_read runBits = prevBits;
+	runBits.Seek( iStartBit );
+	pInfo->m_DeltaBitsWriter.GetBitBuf()->WriteBitsFromBuffer( &runBits, iEndBit - iStartBit );
+	pInfo->m_DeltaBitsWriter.SetLastPropIndex( iLastProp );
+}
+
+
+bool SendTable_EncodeDirty(
+	const SendTable *pTable,
+	const void *pStruct, 
+	const CSendPropBits *pDirtyProps,
+	const void *pPrevState,
+	const int nPrevBits,
+	bf_write *pOut, 
+	int *pDeltaProps,
+	int nMaxDeltaProps,
+	int *pnDeltaProps,
+	int objectID,
+	CUtlMemory<CSendProxyRecipients> *pRecipients
+	)
+{
+	CSendTablePrecalc *pPrecalc = pTable->m_pPrecalc;
+	ErrorIfNot( pPrecalc, ("SendTable_EncodeDirty: Missing m_pPrecalc for SendTable %s.", pTable->m_pNetTableName) );
+	if ( pRecipients )
+	{
+		ErrorIfNot(	pRecipients->NumAllocated() >= pPrecalc->GetNumDataTableProxies(), ("SendTable_EncodeDirty: pRecipients array too small.") );
+	}
+
+	VPROF( "SendTable_EncodeDirty" );
+
+	CServerDTITimer timer( pTable, SERVERDTI_ENCODE );
+
+	// The datatable proxies are still called, as they decide which props are sent and to whom.
+	CEncodeInfo info( pPrecalc, (unsigned char*)pStruct, objectID, pOut );
+	info.m_pRecipients = pRecipients;
+
+	info.Init();
+
+	bf_read prevBits( "SendTable_EncodeDirty/prevBits", pPrevState, BitByte( nPrevBits ), nPrevBits );
+	CDeltaBitsReader prevReader( &prevBits );
+	int iPrevIndexBit = 0;				// Where the index of iPrevProp starts.
+	int iLastPrevProp = -1;				// The prop before iPrevProp in pPrevState.
+	unsigned int iPrevProp = prevReader.ReadNextPropIndex();
+
+	// Runs of unchanged props are copied from pPrevState in one go, indices included
+	// when they follow the same prop in both states.
+	int iRunStartBit = -1;
+	int iLastProp = -1;
+
+	int *pDeltaPropsBase = pDeltaProps;
+	int *pDeltaPropsEnd = pDeltaProps + nMaxDeltaProps;
+
+	int iNumProps = pPrecalc->GetNumProps();
+
+	for ( int iProp=0; iProp < iNumProps; iProp++ )
+	{
+		if ( !info.IsPropProxyValid( iProp ) )
+			continue;
+
+		// Skip the props this entity doesn't send anymore.
+		if ( iPrevProp < (unsigned int)iProp && iRunStartBit >= 0 )
+		{
+			SendTable_CopyPropRun( &info, prevBits, iRunStartBit, iPrevIndexBit, iLastProp );
+			iRunStartBit = -1;
+		}
+
+		while ( iPrevProp < (unsigned int)iProp )
+		{
+			prevReader.SkipPropData( pPrecalc->GetProp( iPrevProp ) );
+			iLastPrevProp = (int)iPrevProp;
+			iPrevIndexBit = prevBits.GetNumBitsRead();
+			iPrevProp = prevReader.ReadNextPropIndex();
+		}
+
+		const SendProp *pProp = pPrecalc->GetProp( iProp );
+		const bool bInPrev = ( iPrevProp == (unsigned int)iProp );
+
+		if ( bInPrev && !pDirtyProps->IsBitSet( iProp ) && !pPrecalc->m_AlwaysDirtyProps.IsBitSet( iProp ) )
+		{
+			if ( iRunStartBit < 0 )
+			{
+				if ( iLastPrevProp == iLastProp )
+				{
+					iRunStartBit = iPrevIndexBit;
+				}
+				else
+				{
+					info.m_DeltaBitsWriter.WritePropIndex( iProp );
+					iRunStartBit = prevBits.GetNumBitsRead();
+				}
+			}
+
+			prevReader.SkipPropData( pProp );
+		}
+		else
+		{
+			if ( iRunStartBit >= 0 )
+			{
+				SendTable_CopyPropRun( &info, prevBits, iRunStartBit, iPrevIndexBit, iLastProp );
+				iRunStartBit = -1;
+			}
+
+			info.SeekToProp( iProp );
+
+			int iStartBit = pOut->GetNumBitsWritten();
+			SendTable_EncodeProp( &info, iProp );
+
+			bool bChanged = true;
+			if ( bInPrev )
+			{
+				bf_read newBits( "SendTable_EncodeDirty/newBits", pOut->GetBasePointer(), pOut->GetNumBytesWritten(), pOut->GetNumBitsWritten() );
+				newBits.Seek( iStartBit );
+				CDeltaBitsReader newReader( &newBits );
+				newReader.ReadNextPropIndex();
+
+				bChanged = prevReader.ComparePropData( &newReader, pProp ) != 0;
+				newReader.ForceFinished();
+			}
+
+			if ( bChanged && pDeltaProps < pDeltaPropsEnd )
+			{
+				*pDeltaProps++ = iProp;
+			}
+		}
+
+		iLastProp = iProp;
+		if ( bInPrev )
+		{
+			iLastPrevProp = (int)iPrevProp;
+			iPrevIndexBit = prevBits.GetNumBitsRead();
+			iPrevProp = prevReader.ReadNextPropIndex();
+		}
+	}
+
+	if ( iRunStartBit >= 0 )
+	{
+		SendTable_CopyPropRun( &info, prevBits, iRunStartBit, iPrevIndexBit, iLastProp );
+	}
+
+	if ( iPrevProp != ~0u )
+	{
+		prevReader.ForceFinished();
+	}
+
+	*pnDeltaProps = pDeltaProps - pDeltaPropsBase;
+	return !pOut->IsOverflowed() && !prevBits.IsOverflowed();
+}
+
+
 void SendTable_WritePropList(
 	const SendTable *pTable,
 	const void *pState,
@@ -743,7 +958,73 @@ static void SendTable_CalcNextVectorElems( SendTable *pTable )
 }
 
 
-static bool SendTable_InitTable( SendTable *pTable )
+static void SendTable_CompileEncoders( CSendTablePrecalc *pPrecalc, const CStandardSendProxiesV1 *pSendProxies )
+{
+	pPrecalc->m_Encoders.SetCount( pPrecalc->GetNumProps() );
+	for ( int i = 0; i < pPrecalc->GetNumProps(); ++i )
+	{
+		SendProp_CompileEncoder( pPrecalc->GetProp( i ), pSendProxies, &pPrecalc->m_Encoders[i] );
+	}
+}
+
+
+static bool SendTable_IsStandardVarProxy( SendVarProxyFn fn, const CStandardSendProxiesV1 *pSendProxies )
+{
+	return fn == pSendProxies->m_Int8ToInt32 ||
+		fn == pSendProxies->m_Int16ToInt32 ||
+		fn == pSendProxies->m_Int32ToInt32 ||
+		fn == pSendProxies->m_UInt8ToInt32 ||
+		fn == pSendProxies->m_UInt16ToInt32 ||
+		fn == pSendProxies->m_UInt32ToInt32 ||
+		fn == pSendProxies->m_FloatToFloat ||
+		fn == pSendProxies->m_VectorToVector
+#ifdef SUPPORTS_INT64
+		|| fn == pSendProxies->m_Int64ToInt64
+		|| fn == pSendProxies->m_UInt64ToInt64
+#endif
+		;
+}
+
+
+// Sets up m_PropOffsetToIndexMap and m_AlwaysDirtyProps so SV_PackEntity can re-encode
+// only the props an entity reported changes to.
+static void SendTable_MapPropOffsets( CSendTablePrecalc *pPrecalc, const CStandardSendProxies *pSendProxies )
+{
+	pPrecalc->m_PropOffsetToIndexMap.RemoveAll();
+	pPrecalc->m_AlwaysDirtyProps.Resize( pPrecalc->GetNumProps() );
+	pPrecalc->m_AlwaysDirtyProps.SetAll();
+
+	if ( !pSendProxies || !pPrecalc->GetNumProps() )
+		return;
+
+	BuildPropOffsetToIndexMap( pPrecalc, pSendProxies );
+
+	// A mapped prop that is copied straight from the entity can only change along with its offset.
+	// Other proxies may read more than the prop's own network var (EHANDLEs, tickcounts, ...).
+	FOR_EACH_MAP_FAST( pPrecalc->m_PropOffsetToIndexMap, i )
+	{
+		int iProp = pPrecalc->m_PropOffsetToIndexMap[i] & ~PROP_INDEX_VECTOR_ELEM_MARKER;
+		const SendProp *pProp = pPrecalc->GetProp( iProp );
+
+		if ( pProp->GetFlags() & SPROP_ENCODED_AGAINST_TICKCOUNT )
+			continue;
+
+		if ( pProp->GetType() == DPT_Array )
+		{
+			if ( pProp->GetArrayLengthProxy() || !SendTable_IsStandardVarProxy( pProp->GetArrayProp()->GetProxyFn(), pSendProxies ) )
+				continue;
+		}
+		else if ( !SendTable_IsStandardVarProxy( pProp->GetProxyFn(), pSendProxies ) )
+		{
+			continue;
+		}
+
+		pPrecalc->m_AlwaysDirtyProps.Clear( iProp );
+	}
+}
+
+
+static bool SendTable_InitTable( SendTable *pTable, const CStandardSendProxies *pSendProxies )
 {
 	if( pTable->m_pPrecalc )
 		return true;
@@ -765,6 +1046,8 @@ static bool SendTable_InitTable( SendTable *pTable )
 		return false;
 
 	SendTable_Validate( pPrecalc );
+	SendTable_CompileEncoders( pPrecalc, pSendProxies );
+	SendTable_MapPropOffsets( pPrecalc, pSendProxies );
 	return true;
 }
 
@@ -779,6 +1062,55 @@ static void SendTable_TermTable( SendTable *pTable )
 }
 
 
+void SendTable_MarkPropOffsetDirty( const SendTable *pSendTable, unsigned short offset, CSendPropBits *pDirtyProps )
+{
+	const CSendTablePrecalc *pPrecalc = pSendTable->m_pPrecalc;
+	const CUtlMap<unsigned short, unsigned short> &offsetMap = pPrecalc->m_PropOffsetToIndexMap;
+
+	unsigned short index = offsetMap.Find( offset );
+	if ( index == offsetMap.InvalidIndex() )
+	{
+		// No SendProp for this network var, see MapPropOffsetsToIndices.
+		return;
+	}
+
+	unsigned short propIndex = offsetMap[index];
+	if ( !( propIndex & PROP_INDEX_VECTOR_ELEM_MARKER ) )
+	{
+		pDirtyProps->Set( propIndex );
+		return;
+	}
+
+	// The whole vector changed, look for all 3 vector elems.
+	for ( int iVectorElem=0; iVectorElem < 3; iVectorElem++ )
+	{
+		index = offsetMap.Find( (unsigned short)( offset + iVectorElem * sizeof( float ) ) );
+		if ( index == offsetMap.InvalidIndex() )
+			break;
+
+		propIndex = offsetMap[index];
+		if ( propIndex & PROP_INDEX_VECTOR_ELEM_MARKER )
+			pDirtyProps->Set( propIndex & ~PROP_INDEX_VECTOR_ELEM_MARKER );
+	}
+}
+
+
+int SendTable_GetNumCompiledProps( const SendTable *pSendTable )
+{
+	CSendTablePrecalc *pPrecalc = pSendTable->m_pPrecalc;
+	ErrorIfNot( pPrecalc,
+		("SendTable_GetNumCompiledProps: missing pPrecalc.")
+	);
+
+	int nCompiled = 0;
+	for ( const CSendPropEncoder &encoder : pPrecalc->m_Encoders )
+	{
+		if ( encoder.m_Op != SENDPROP_ENCODE_PROXY )
+			++nCompiled;
+	}
+	return nCompiled;
+}
+
 int SendTable_GetNumFlatProps( SendTable *pSendTable )
 {
 	CSendTablePrecalc *pPrecalc = pSendTable->m_pPrecalc;
@@ -853,6 +1185,7 @@ void SendTable_PrintStats( void )
 	int numSubTables = 0;
 	int numSendProps = 0;
 	int numFlatProps = 0;
+	int numCompiledProps = 0;
 	int numExcludeProps = 0;
 
 	for ( int i=0; i < g_SendTables.Count(); i++ )
@@ -862,6 +1195,7 @@ void SendTable_PrintStats( void )
 		numTables++;
 		numSendProps += st->GetNumProps();
 		numFlatProps += st->m_pPrecalc->GetNumProps();
+		numCompiledProps += SendTable_GetNumCompiledProps( st );
 
 		for ( int j=0; j < st->GetNumProps(); j++ )
 		{
@@ -893,6 +1227,7 @@ void SendTable_PrintStats( void )
 	Msg("Send Tables   : %i\n", numTables );
 	Msg("Send Props    : %i\n", numSendProps );
 	Msg("Flat Props    : %i\n", numFlatProps );
+	Msg("Compiled Props: %i\n", numCompiledProps );
 	Msg("Int Props     : %i\n", numInts );
 	Msg("Float Props   : %i\n", numFloats );
 	Msg("Vector Props  : %i\n", numVecs );
@@ -905,7 +1240,7 @@ void SendTable_PrintStats( void )
 
 
 
-bool SendTable_Init( SendTable **pTables, int nTables )
+bool SendTable_Init( SendTable **pTables, int nTables, const CStandardSendProxies *pSendProxies )
 {
 	ErrorIfNot( g_SendTables.Count() == 0,
 		("SendTable_Init: called twice.")
@@ -914,7 +1249,7 @@ bool SendTable_Init( SendTable **pTables, int nTables )
 	// Initialize them all.
 	for ( int i=0; i < nTables; i++ )
 	{
-		if ( !SendTable_InitTable( pTables[i] ) )
+		if ( !SendTable_InitTable( pTables[i], pSendProxies ) )
 			return false;
 	}
 
@@ -19,16 +19,25 @@
 typedef unsigned int CRC32_t;
 
 class CStandardSendProxies;
+class CStandardSendProxiesV1;
 
 
 #define MAX_DELTABITS_SIZE 2048
 
+
+// One bit per flat prop of a SendTable.
+class CSendPropBits : public CBitVec<MAX_DATATABLE_PROPS>
+{
+};
+
 // ------------------------------------------------------------------------ //
 // SendTable functions.
 // ------------------------------------------------------------------------ //
 
 // Precalculate data that enables the SendTable to be used to encode data.
-bool		SendTable_Init( SendTable **pTables, int nTables );
+// Props using one of pSendProxies are encoded without calling the proxy, and only
+// need encoding again when their offset is reported changed.
+bool		SendTable_Init( SendTable **pTables, int nTables, const CStandardSendProxies *pSendProxies = NULL );
 void		SendTable_Term();
 CRC32_t		SendTable_GetCRC();
 int			SendTable_GetNum();
@@ -38,6 +47,13 @@ SendTable	*SendTabe_GetTable(int index);
 // Return the number of unique properties in the table.
 int	SendTable_GetNumFlatProps( SendTable *pTable );
 
+// Return how many of those are encoded without calling their proxy.
+int	SendTable_GetNumCompiledProps( const SendTable *pTable );
+
+// Mark the props stored at offset in an object of the table's class (as passed to
+// CBaseEdict::StateChanged). Offsets without a prop are ignored.
+void SendTable_MarkPropOffsetDirty( const SendTable *pTable, unsigned short offset, CSendPropBits *pDirtyProps );
+
 // compares properties and writes delta properties
 int SendTable_WriteAllDeltaProps(
 	const SendTable *pTable,					
@@ -117,6 +133,37 @@ bool SendTable_Encode(
 	);
 
 
+// Same as SendTable_Encode, but calls the proxy of every property. Writes the same bits,
+// for checking and timing the compiled encoders.
+bool SendTable_EncodeWithProxies(
+	const SendTable *pTable,
+	const void *pStruct, 
+	bf_write *pOut, 
+	int objectID = -1,
+	CUtlMemory<CSendProxyRecipients> *pRecipients = NULL,
+	bool bNonZeroOnly = false
+	);
+
+
+// Same as SendTable_Encode, but only encodes the props in pDirtyProps, the table's always dirty props
+// and props missing from pPrevState. The others are copied from pPrevState, which must be the last
+// encoding of the same object. The props that differ from pPrevState are returned in pDeltaProps,
+// as SendTable_CalcDelta would.
+bool SendTable_EncodeDirty(
+	const SendTable *pTable,
+	const void *pStruct, 
+	const CSendPropBits *pDirtyProps,
+	const void *pPrevState,
+	const int nPrevBits,
+	bf_write *pOut, 
+	int *pDeltaProps,
+	int nMaxDeltaProps,
+	int *pnDeltaProps,
+	int objectID,
+	CUtlMemory<CSendProxyRecipients> *pRecipients
+	);
+
+
 // In order to receive a table, you must send it from the server and receive its info
 // on the client so the client knows how to unpack it.
 bool SendTable_WriteInfos( SendTable *pTable, bf_write *pBuf );
@@ -851,7 +851,7 @@ void RunDataTableTest()
 
 
 	// Initialize the send and receive modules.
-	SendTable_Init( &pSendTable, 1 );
+	SendTable_Init( &pSendTable, 1, &g_StandardSendProxies );
 	RecvTable_Init( &pRecvTable, 1 );
 
 	pSendTable->SetWriteFlag( false );
@@ -0,0 +1,407 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Dynamic AABB tree (BVH) of moving boxes.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "dynamicaabbtree.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+// Leaf boxes are fattened by this so small moves don't touch the tree.
+#define AABBTREE_FAT_MARGIN		4.0f
+
+// Fat boxes larger than this compared to the moved box are shrunk.
+#define AABBTREE_LOOSE_MARGIN	( 4.0f * AABBTREE_FAT_MARGIN )
+
+
+//-----------------------------------------------------------------------------
+// Box helpers
+//-----------------------------------------------------------------------------
+static inline float BoxSurfaceArea( const Vector &vecMin, const Vector &vecMax )
+{
+	Vector vecSize;
+	VectorSubtract( vecMax, vecMin, vecSize );
+	return 2.0f * ( vecSize.x * vecSize.y + vecSize.y * vecSize.z + vecSize.z * vecSize.x );
+}
+
+static inline float UnionSurfaceArea( const Vector &vecMin1, const Vector &vecMax1, const Vector &vecMin2, const Vector &vecMax2 )
+{
+	Vector vecMin, vecMax;
+	VectorMin( vecMin1, vecMin2, vecMin );
+	VectorMax( vecMax1, vecMax2, vecMax );
+	return BoxSurfaceArea( vecMin, vecMax );
+}
+
+static inline bool BoxContains( const Vector &vecOuterMin, const Vector &vecOuterMax, const Vector &vecMin, const Vector &vecMax )
+{
+	return ( vecOuterMin.x <= vecMin.x ) && ( vecOuterMin.y <= vecMin.y ) && ( vecOuterMin.z <= vecMin.z ) &&
+		( vecOuterMax.x >= vecMax.x ) && ( vecOuterMax.y >= vecMax.y ) && ( vecOuterMax.z >= vecMax.z );
+}
+
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+CDynamicAABBTree::CDynamicAABBTree()
+{
+	m_nRoot = NULL_NODE;
+	m_nFreeList = NULL_NODE;
+	m_nFreeCount = 0;
+	m_nProxyCount = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Frees all nodes
+//-----------------------------------------------------------------------------
+void CDynamicAABBTree::Purge()
+{
+	m_Nodes.Purge();
+	m_nRoot = NULL_NODE;
+	m_nFreeList = NULL_NODE;
+	m_nFreeCount = 0;
+	m_nProxyCount = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Node pool
+//-----------------------------------------------------------------------------
+int CDynamicAABBTree::AllocNode()
+{
+	int nNode;
+	if ( m_nFreeList != NULL_NODE )
+	{
+		nNode = m_nFreeList;
+		m_nFreeList = m_Nodes[nNode].m_nParent;
+		--m_nFreeCount;
+	}
+	else
+	{
+		MEM_ALLOC_CREDIT();
+		nNode = static_cast<int>( m_Nodes.AddToTail() );
+	}
+
+	Node_t &node = m_Nodes[nNode];
+	node.m_nParent = NULL_NODE;
+	node.m_nChild[0] = NULL_NODE;
+	node.m_nChild[1] = NULL_NODE;
+	node.m_nHeight = 0;
+	node.m_nUserData = -1;
+	return nNode;
+}
+
+void CDynamicAABBTree::FreeNode( int nNode )
+{
+	Node_t &node = m_Nodes[nNode];
+	node.m_nParent = m_nFreeList;
+	node.m_nHeight = -1;
+	m_nFreeList = nNode;
+	++m_nFreeCount;
+}
+
+
+//-----------------------------------------------------------------------------
+// Proxies
+//-----------------------------------------------------------------------------
+int CDynamicAABBTree::CreateProxy( const Vector &vecMin, const Vector &vecMax, int nUserData )
+{
+	int nProxy = AllocNode();
+
+	Node_t &node = m_Nodes[nProxy];
+	node.m_vecMin.Init( vecMin.x - AABBTREE_FAT_MARGIN, vecMin.y - AABBTREE_FAT_MARGIN, vecMin.z - AABBTREE_FAT_MARGIN );
+	node.m_vecMax.Init( vecMax.x + AABBTREE_FAT_MARGIN, vecMax.y + AABBTREE_FAT_MARGIN, vecMax.z + AABBTREE_FAT_MARGIN );
+	node.m_nUserData = nUserData;
+
+	InsertLeaf( nProxy );
+	++m_nProxyCount;
+
+	return nProxy;
+}
+
+void CDynamicAABBTree::DestroyProxy( int nProxy )
+{
+	Assert( m_Nodes.IsValidIndex( nProxy ) && m_Nodes[nProxy].IsLeaf() && m_Nodes[nProxy].m_nHeight == 0 );
+
+	RemoveLeaf( nProxy );
+	FreeNode( nProxy );
+	--m_nProxyCount;
+}
+
+bool CDynamicAABBTree::MoveProxy( int nProxy, const Vector &vecMin, const Vector &vecMax )
+{
+	Assert( m_Nodes.IsValidIndex( nProxy ) && m_Nodes[nProxy].IsLeaf() );
+
+	Node_t &leaf = m_Nodes[nProxy];
+	if ( BoxContains( leaf.m_vecMin, leaf.m_vecMax, vecMin, vecMax ) )
+	{
+		// Still fits, unless the element shrank a lot.
+		Vector vecLooseMin( vecMin.x - AABBTREE_LOOSE_MARGIN, vecMin.y - AABBTREE_LOOSE_MARGIN, vecMin.z - AABBTREE_LOOSE_MARGIN );
+		Vector vecLooseMax( vecMax.x + AABBTREE_LOOSE_MARGIN, vecMax.y + AABBTREE_LOOSE_MARGIN, vecMax.z + AABBTREE_LOOSE_MARGIN );
+		if ( BoxContains( vecLooseMin, vecLooseMax, leaf.m_vecMin, leaf.m_vecMax ) )
+			return false;
+	}
+
+	Vector vecFatMin( vecMin.x - AABBTREE_FAT_MARGIN, vecMin.y - AABBTREE_FAT_MARGIN, vecMin.z - AABBTREE_FAT_MARGIN );
+	Vector vecFatMax( vecMax.x + AABBTREE_FAT_MARGIN, vecMax.y + AABBTREE_FAT_MARGIN, vecMax.z + AABBTREE_FAT_MARGIN );
+
+	int nParent = leaf.m_nParent;
+	if ( nParent != NULL_NODE && BoxContains( m_Nodes[nParent].m_vecMin, m_Nodes[nParent].m_vecMax, vecFatMin, vecFatMax ) )
+	{
+		// Moved within its parent, tree stays good enough, so only refit boxes up.
+		leaf.m_vecMin = vecFatMin;
+		leaf.m_vecMax = vecFatMax;
+		Refit( nParent, false );
+		return true;
+	}
+
+	RemoveLeaf( nProxy );
+
+	m_Nodes[nProxy].m_vecMin = vecFatMin;
+	m_Nodes[nProxy].m_vecMax = vecFatMax;
+
+	InsertLeaf( nProxy );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Inserts leaf next to the sibling with the lowest SAH cost
+//-----------------------------------------------------------------------------
+void CDynamicAABBTree::InsertLeaf( int nLeaf )
+{
+	if ( m_nRoot == NULL_NODE )
+	{
+		m_nRoot = nLeaf;
+		m_Nodes[m_nRoot].m_nParent = NULL_NODE;
+		return;
+	}
+
+	const Vector vecLeafMin = m_Nodes[nLeaf].m_vecMin;
+	const Vector vecLeafMax = m_Nodes[nLeaf].m_vecMax;
+
+	// Find the best sibling.
+	int nIndex = m_nRoot;
+	while ( !m_Nodes[nIndex].IsLeaf() )
+	{
+		const Node_t &node = m_Nodes[nIndex];
+
+		float flArea = BoxSurfaceArea( node.m_vecMin, node.m_vecMax );
+		float flCombinedArea = UnionSurfaceArea( node.m_vecMin, node.m_vecMax, vecLeafMin, vecLeafMax );
+
+		// Cost of creating a new parent for this node and the new leaf.
+		float flCost = 2.0f * flCombinedArea;
+
+		// Minimum cost of pushing the leaf further down the tree.
+		float flInheritanceCost = 2.0f * ( flCombinedArea - flArea );
+
+		float flChildCost[2];
+		for ( int i = 0; i < 2; ++i )
+		{
+			const Node_t &child = m_Nodes[ node.m_nChild[i] ];
+			flChildCost[i] = UnionSurfaceArea( child.m_vecMin, child.m_vecMax, vecLeafMin, vecLeafMax ) + flInheritanceCost;
+			if ( !child.IsLeaf() )
+			{
+				flChildCost[i] -= BoxSurfaceArea( child.m_vecMin, child.m_vecMax );
+			}
+		}
+
+		if ( flCost < flChildCost[0] && flCost < flChildCost[1] )
+			break;
+
+		nIndex = ( flChildCost[0] < flChildCost[1] ) ? node.m_nChild[0] : node.m_nChild[1];
+	}
+
+	int nSibling = nIndex;
+
+	// Create a new parent.
+	int nOldParent = m_Nodes[nSibling].m_nParent;
+	int nNewParent = AllocNode();
+
+	Node_t &newParent = m_Nodes[nNewParent];
+	newParent.m_nParent = nOldParent;
+	VectorMin( m_Nodes[nSibling].m_vecMin, vecLeafMin, newParent.m_vecMin );
+	VectorMax( m_Nodes[nSibling].m_vecMax, vecLeafMax, newParent.m_vecMax );
+	newParent.m_nHeight = m_Nodes[nSibling].m_nHeight + 1;
+	newParent.m_nChild[0] = nSibling;
+	newParent.m_nChild[1] = nLeaf;
+
+	if ( nOldParent != NULL_NODE )
+	{
+		Node_t &oldParent = m_Nodes[nOldParent];
+		oldParent.m_nChild[ oldParent.m_nChild[0] == nSibling ? 0 : 1 ] = nNewParent;
+	}
+	else
+	{
+		m_nRoot = nNewParent;
+	}
+
+	m_Nodes[nSibling].m_nParent = nNewParent;
+	m_Nodes[nLeaf].m_nParent = nNewParent;
+
+	// Walk back up fixing heights and boxes.
+	Refit( nOldParent, true );
+}
+
+
+//-----------------------------------------------------------------------------
+// Removes leaf, its sibling takes the place of their parent
+//-----------------------------------------------------------------------------
+void CDynamicAABBTree::RemoveLeaf( int nLeaf )
+{
+	if ( nLeaf == m_nRoot )
+	{
+		m_nRoot = NULL_NODE;
+		return;
+	}
+
+	int nParent = m_Nodes[nLeaf].m_nParent;
+	int nGrandParent = m_Nodes[nParent].m_nParent;
+	int nSibling = m_Nodes[nParent].m_nChild[0] == nLeaf ? m_Nodes[nParent].m_nChild[1] : m_Nodes[nParent].m_nChild[0];
+
+	if ( nGrandParent != NULL_NODE )
+	{
+		Node_t &grandParent = m_Nodes[nGrandParent];
+		grandParent.m_nChild[ grandParent.m_nChild[0] == nParent ? 0 : 1 ] = nSibling;
+		m_Nodes[nSibling].m_nParent = nGrandParent;
+		FreeNode( nParent );
+
+		Refit( nGrandParent, true );
+	}
+	else
+	{
+		m_nRoot = nSibling;
+		m_Nodes[nSibling].m_nParent = NULL_NODE;
+		FreeNode( nParent );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Recomputes heights and boxes up to the root
+//-----------------------------------------------------------------------------
+void CDynamicAABBTree::Refit( int nNode, bool bBalance )
+{
+	while ( nNode != NULL_NODE )
+	{
+		if ( bBalance )
+		{
+			nNode = Balance( nNode );
+		}
+
+		Node_t &node = m_Nodes[nNode];
+		const Node_t &child0 = m_Nodes[ node.m_nChild[0] ];
+		const Node_t &child1 = m_Nodes[ node.m_nChild[1] ];
+
+		Vector vecMin, vecMax;
+		VectorMin( child0.m_vecMin, child1.m_vecMin, vecMin );
+		VectorMax( child0.m_vecMax, child1.m_vecMax, vecMax );
+
+		// Refit only, nothing changes above if this box didn't.
+		if ( !bBalance && vecMin == node.m_vecMin && vecMax == node.m_vecMax )
+			return;
+
+		node.m_vecMin = vecMin;
+		node.m_vecMax = vecMax;
+		node.m_nHeight = 1 + max( child0.m_nHeight, child1.m_nHeight );
+
+		nNode = node.m_nParent;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Rotates the higher child of A up if children heights differ by more than 1.
+// Returns the new root of the subtree.
+//-----------------------------------------------------------------------------
+int CDynamicAABBTree::Balance( int iA )
+{
+	Node_t *pA = &m_Nodes[iA];
+	if ( pA->IsLeaf() || pA->m_nHeight < 2 )
+		return iA;
+
+	int iB = pA->m_nChild[0];
+	int iC = pA->m_nChild[1];
+	Node_t *pB = &m_Nodes[iB];
+	Node_t *pC = &m_Nodes[iC];
+
+	int nBalance = pC->m_nHeight - pB->m_nHeight;
+	if ( nBalance >= -1 && nBalance <= 1 )
+		return iA;
+
+	// Rotate the higher child (up) with A (down).
+	int iUp = nBalance > 1 ? iC : iB;
+	int iOther = nBalance > 1 ? iB : iC;
+	int nUpSlot = nBalance > 1 ? 1 : 0;
+
+	Node_t *pUp = &m_Nodes[iUp];
+	Node_t *pOther = &m_Nodes[iOther];
+
+	int iF = pUp->m_nChild[0];
+	int iG = pUp->m_nChild[1];
+	Node_t *pF = &m_Nodes[iF];
+	Node_t *pG = &m_Nodes[iG];
+
+	// Up takes the place of A.
+	pUp->m_nChild[0] = iA;
+	pUp->m_nParent = pA->m_nParent;
+	pA->m_nParent = iUp;
+
+	if ( pUp->m_nParent != NULL_NODE )
+	{
+		Node_t &parent = m_Nodes[pUp->m_nParent];
+		parent.m_nChild[ parent.m_nChild[0] == iA ? 0 : 1 ] = iUp;
+	}
+	else
+	{
+		m_nRoot = iUp;
+	}
+
+	// The higher grandchild stays with Up, the other one goes to A.
+	int iKeep = pF->m_nHeight > pG->m_nHeight ? iF : iG;
+	int iMove = pF->m_nHeight > pG->m_nHeight ? iG : iF;
+	Node_t *pKeep = &m_Nodes[iKeep];
+	Node_t *pMove = &m_Nodes[iMove];
+
+	pUp->m_nChild[1] = iKeep;
+	pA->m_nChild[nUpSlot] = iMove;
+	pMove->m_nParent = iA;
+
+	VectorMin( pOther->m_vecMin, pMove->m_vecMin, pA->m_vecMin );
+	VectorMax( pOther->m_vecMax, pMove->m_vecMax, pA->m_vecMax );
+	VectorMin( pA->m_vecMin, pKeep->m_vecMin, pUp->m_vecMin );
+	VectorMax( pA->m_vecMax, pKeep->m_vecMax, pUp->m_vecMax );
+
+	pA->m_nHeight = 1 + max( pOther->m_nHeight, pMove->m_nHeight );
+	pUp->m_nHeight = 1 + max( pA->m_nHeight, pKeep->m_nHeight );
+
+	return iUp;
+}
+
+
+//-----------------------------------------------------------------------------
+// Tree quality, lower is better
+//-----------------------------------------------------------------------------
+float CDynamicAABBTree::ComputeAreaRatio() const
+{
+	if ( m_nRoot == NULL_NODE )
+		return 0.0f;
+
+	float flRootArea = BoxSurfaceArea( m_Nodes[m_nRoot].m_vecMin, m_Nodes[m_nRoot].m_vecMax );
+	if ( flRootArea <= 0.0f )
+		return 0.0f;
+
+	float flTotalArea = 0.0f;
+	for ( const auto &node : m_Nodes )
+	{
+		if ( node.m_nHeight <= 0 )
+			continue;
+
+		flTotalArea += BoxSurfaceArea( node.m_vecMin, node.m_vecMax );
+	}
+
+	return flTotalArea / flRootArea;
+}
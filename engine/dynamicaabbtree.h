@@ -0,0 +1,155 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Dynamic AABB tree (BVH) of moving boxes.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef DYNAMICAABBTREE_H
+#define DYNAMICAABBTREE_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "mathlib/vector.h"
+#include "tier1/utlvector.h"
+
+
+//-----------------------------------------------------------------------------
+// Binary tree of fattened leaf boxes. Leaves are inserted next to the sibling
+// which gives the lowest surface area heuristic cost and the tree is kept
+// balanced with AVL style rotations.
+//
+// Moved leaves which stay within their fattened box don't touch the tree, ones
+// which stay within their parent box only refit ancestors, the rest are
+// reinserted.
+//
+// Not thread safe, but const queries may run in parallel.
+//-----------------------------------------------------------------------------
+class CDynamicAABBTree
+{
+public:
+	enum
+	{
+		NULL_NODE = -1
+	};
+
+	CDynamicAABBTree();
+
+	// Frees all nodes.
+	void Purge();
+
+	// Creates a leaf of box with user data, returns its proxy id.
+	int CreateProxy( const Vector &vecMin, const Vector &vecMax, int nUserData );
+	void DestroyProxy( int nProxy );
+
+	// Updates proxy box, returns false if tree was not touched.
+	bool MoveProxy( int nProxy, const Vector &vecMin, const Vector &vecMax );
+
+	int GetUserData( int nProxy ) const;
+	const Vector &GetFatMin( int nProxy ) const;
+	const Vector &GetFatMax( int nProxy ) const;
+
+	// Calls visitor( nUserData ) for each leaf with fat box passing test.Intersects( mins, maxs ).
+	// Visitor returns false to stop, then Query returns false as well.
+	template <class T, class V> bool Query( const T &test, V &visitor ) const;
+
+	int ProxyCount() const { return m_nProxyCount; }
+	intp NodeCount() const { return m_Nodes.Count() - m_nFreeCount; }
+	int Height() const;
+
+	// Sum of internal node surface areas relative to root surface area.
+	float ComputeAreaRatio() const;
+
+private:
+	struct Node_t
+	{
+		Vector	m_vecMin;
+		Vector	m_vecMax;
+		int		m_nParent;		// next free node, when node is free
+		int		m_nChild[2];	// NULL_NODE for leaves
+		int		m_nHeight;		// 0 for leaves, -1 for free nodes
+		int		m_nUserData;
+
+		bool IsLeaf() const { return m_nChild[0] == NULL_NODE; }
+	};
+
+	int AllocNode();
+	void FreeNode( int nNode );
+
+	void InsertLeaf( int nLeaf );
+	void RemoveLeaf( int nLeaf );
+
+	// Rotates subtree if it is imbalanced, returns new subtree root.
+	int Balance( int nNode );
+
+	// Recomputes height and box of nodes from node to root.
+	void Refit( int nNode, bool bBalance );
+
+	CUtlVector<Node_t>	m_Nodes;
+	int					m_nRoot;
+	int					m_nFreeList;
+	int					m_nFreeCount;
+	int					m_nProxyCount;
+};
+
+
+//-----------------------------------------------------------------------------
+// Inline methods
+//-----------------------------------------------------------------------------
+inline int CDynamicAABBTree::GetUserData( int nProxy ) const
+{
+	Assert( m_Nodes[nProxy].IsLeaf() );
+	return m_Nodes[nProxy].m_nUserData;
+}
+
+inline const Vector &CDynamicAABBTree::GetFatMin( int nProxy ) const
+{
+	return m_Nodes[nProxy].m_vecMin;
+}
+
+inline const Vector &CDynamicAABBTree::GetFatMax( int nProxy ) const
+{
+	return m_Nodes[nProxy].m_vecMax;
+}
+
+inline int CDynamicAABBTree::Height() const
+{
+	return m_nRoot != NULL_NODE ? m_Nodes[m_nRoot].m_nHeight : 0;
+}
+
+template <class T, class V>
+bool CDynamicAABBTree::Query( const T &test, V &visitor ) const
+{
+	if ( m_nRoot == NULL_NODE )
+		return true;
+
+	// Balanced, so even 64k leaves fit into the fixed part.
+	CUtlVectorFixedGrowable<int, 128> stack;
+	stack.AddToTail( m_nRoot );
+
+	while ( stack.Count() )
+	{
+		const Node_t &node = m_Nodes[ stack.Tail() ];
+		stack.RemoveMultipleFromTail( 1 );
+
+		if ( !test.Intersects( node.m_vecMin, node.m_vecMax ) )
+			continue;
+
+		if ( node.IsLeaf() )
+		{
+			if ( !visitor( node.m_nUserData ) )
+				return false;
+		}
+		else
+		{
+			stack.AddToTail( node.m_nChild[1] );
+			stack.AddToTail( node.m_nChild[0] );
+		}
+	}
+
+	return true;
+}
+
+
+#endif // DYNAMICAABBTREE_H
@@ -70,7 +70,7 @@ static CUtlVector<Ray_t> s_BenchmarkRays;
 abstract_class CEngineTrace : public IEngineTrace
 {
 public:
-	CEngineTrace() { m_pRootMoveParent = NULL; }
+	CEngineTrace() = default;
 	// Returns the contents mask at a particular world-space position
 	virtual int		GetPointContents( const Vector &vecAbsPosition, IHandleEntity** ppEntity );
 
@@ -125,6 +125,14 @@ public:
 	// Walks bsp to find the leaf containing the specified point
 	virtual int GetLeafContainingPoint( const Vector &ptTest );
 
+	// Traces a batch of rays, world is traced in SIMD packets
+	virtual void	TraceRays( const Ray_t *pRays, int nRays, unsigned int fMask, ITraceFilter *pTraceFilter, trace_t *pTraces );
+
+	// Read-only tracing from any thread
+	virtual void	BeginReadOnlyTraces();
+	virtual void	EndReadOnlyTraces();
+	virtual bool	IsInReadOnlyTraces() const;
+
 private:
 	// FIXME: Different versions for client + server. Eventually we need to make these go away
 	virtual void SetTraceEntity( ICollideable *pCollideable, trace_t *pTrace ) = 0;
@@ -158,9 +166,14 @@ private:
 
 	// Clips a trace to another trace
 	bool ClipTraceToTrace( trace_t &clipTrace, trace_t *pFinalTrace );
+
+	// Second half of TraceRay, clips the world trace against entities along the ray
+	void TraceRayAgainstEntities( const Ray_t &ray, unsigned int fMask, ITraceFilter *pTraceFilter, trace_t *pTrace );
 private:
-	int m_traceStatCounters[NUM_TRACE_STAT_COUNTER];
-	const matrix3x4_t *m_pRootMoveParent;
+	CInterlockedInt m_traceStatCounters[NUM_TRACE_STAT_COUNTER];
+	CInterlockedInt m_nReadOnlyTraces;
+	// Set while tracing against a root parent aligned collideable, traces of other threads are unrelated.
+	static thread_local const matrix3x4_t *s_pRootMoveParent;
 	friend void RayBench( const CCommand &args );
 
 };
@@ -194,14 +207,19 @@ public:
 };
 #endif
 
+thread_local const matrix3x4_t *CEngineTrace::s_pRootMoveParent = NULL;
+
 //-----------------------------------------------------------------------------
 // Expose CVEngineServer to the game + client DLLs
 //-----------------------------------------------------------------------------
+// Version 4 only added TraceRays and the read-only trace methods to the end, so keep exposing 3 as well.
 static CEngineTraceServer	s_EngineTraceServer;
+EXPOSE_SINGLE_INTERFACE_GLOBALVAR(CEngineTraceServer, IEngineTrace003, INTERFACEVERSION_ENGINETRACE_SERVER_VERSION_3, s_EngineTraceServer);
 EXPOSE_SINGLE_INTERFACE_GLOBALVAR(CEngineTraceServer, IEngineTrace, INTERFACEVERSION_ENGINETRACE_SERVER, s_EngineTraceServer);
 
 #ifndef SWDS
 static CEngineTraceClient	s_EngineTraceClient;
+EXPOSE_SINGLE_INTERFACE_GLOBALVAR(CEngineTraceClient, IEngineTrace003, INTERFACEVERSION_ENGINETRACE_CLIENT_VERSION_3, s_EngineTraceClient);
 EXPOSE_SINGLE_INTERFACE_GLOBALVAR(CEngineTraceClient, IEngineTrace, INTERFACEVERSION_ENGINETRACE_CLIENT, s_EngineTraceClient);
 #endif
 
@@ -931,20 +949,20 @@ bool CEngineTrace::ClipRayToBBox( const Ray_t &ray, unsigned int fMask, ICollide
 
 	VectorAligned vecAbsMins, vecAbsMaxs;
 	VectorAligned vecInvDelta;
-	// NOTE: If m_pRootMoveParent is set, then the boxes should be rotated into the root parent's space
-	if ( !ray.m_IsRay && m_pRootMoveParent )
+	// NOTE: If s_pRootMoveParent is set, then the boxes should be rotated into the root parent's space
+	if ( !ray.m_IsRay && s_pRootMoveParent )
 	{
 		Ray_t ray_l;
 
 		ray_l.m_Extents = ray.m_Extents;
 
-		VectorIRotate( ray.m_Delta, *m_pRootMoveParent, ray_l.m_Delta );
+		VectorIRotate( ray.m_Delta, *s_pRootMoveParent, ray_l.m_Delta );
 		ray_l.m_StartOffset.Init();
-		VectorITransform( ray.m_Start, *m_pRootMoveParent, ray_l.m_Start );
+		VectorITransform( ray.m_Start, *s_pRootMoveParent, ray_l.m_Start );
 
 		vecInvDelta = ray_l.InvDelta();
 		Vector localEntityOrigin;
-		VectorITransform( pEntity->GetCollisionOrigin(), *m_pRootMoveParent, localEntityOrigin );
+		VectorITransform( pEntity->GetCollisionOrigin(), *s_pRootMoveParent, localEntityOrigin );
 		ray_l.m_IsRay = ray.m_IsRay;
 		ray_l.m_IsSwept = ray.m_IsSwept;
 
@@ -956,7 +974,7 @@ bool CEngineTrace::ClipRayToBBox( const Ray_t &ray, unsigned int fMask, ICollide
 		{
 			Vector temp;
 			VectorCopy (pTrace->plane.normal, temp);
-			VectorRotate( temp, *m_pRootMoveParent, pTrace->plane.normal );
+			VectorRotate( temp, *s_pRootMoveParent, pTrace->plane.normal );
 			VectorAdd( ray.m_Start, ray.m_StartOffset, pTrace->startpos );
 
 			if (pTrace->fraction == 1)
@@ -1075,10 +1093,10 @@ void CEngineTrace::ClipRayToCollideable( const Ray_t &ray, unsigned int fMask, I
 		}
 	}
 
-	const matrix3x4_t *pOldRoot = m_pRootMoveParent;
+	const matrix3x4_t *pOldRoot = s_pRootMoveParent;
 	if ( pEntity->GetSolidFlags() & FSOLID_ROOT_PARENT_ALIGNED )
 	{
-		m_pRootMoveParent = pEntity->GetRootParentToWorldTransform();
+		s_pRootMoveParent = pEntity->GetRootParentToWorldTransform();
 	}
 	bool bTraced = false;
 	bool bCustomPerformed = false;
@@ -1148,7 +1166,7 @@ void CEngineTrace::ClipRayToCollideable( const Ray_t &ray, unsigned int fMask, I
 	VectorMA( vecOffset, pTrace->fraction, ray.m_Delta, vecEndTest );
 	Assert( VectorsAreEqual( vecEndTest, pTrace->endpos, 0.1f ) );
 #endif
-	m_pRootMoveParent = pOldRoot;
+	s_pRootMoveParent = pOldRoot;
 }
 
 
@@ -1659,7 +1677,7 @@ CON_COMMAND_EXTERN( ray_bench, RayBench, "Time the rays" )
 void CEngineTrace::TraceRay( const Ray_t &ray, unsigned int fMask, ITraceFilter *pTraceFilter, trace_t *pTrace )
 {	
 #if defined _DEBUG && !defined SWDS
-	if( debugrayenable.GetBool() )
+	if( debugrayenable.GetBool() && ThreadInMainThread() )
 	{
 		s_FrameRays.AddToTail( ray );
 	}
@@ -1701,7 +1719,103 @@ void CEngineTrace::TraceRay( const Ray_t &ray, unsigned int fMask, ITraceFilter
 
 		CM_BoxTrace( ray, 0, fMask, true, *pTrace );
 		SetTraceEntity( pCollide, pTrace );
+	}
+
+	TraceRayAgainstEntities( ray, fMask, pTraceFilter, pTrace );
+}
+
+//-----------------------------------------------------------------------------
+// Traces a batch of rays, same as calling TraceRay for each one
+//-----------------------------------------------------------------------------
+void CEngineTrace::TraceRays( const Ray_t *pRays, int nRays, unsigned int fMask, ITraceFilter *pTraceFilter, trace_t *pTraces )
+{
+	tmZone( TELEMETRY_LEVEL1, TMZF_NONE, "%s:%d", __FUNCTION__, __LINE__ );
+	VPROF_INCREMENT_COUNTER( "TraceRay", nRays );
+	m_traceStatCounters[TRACE_STAT_COUNTER_TRACERAY] += nRays;
+
+	CTraceFilterHitAll traceFilter;
+	if ( !pTraceFilter )
+	{
+		pTraceFilter = &traceFilter;
+	}
+
+	// Collide with the world, shared by rays in packets.
+	if ( pTraceFilter->GetTraceType() != TRACE_ENTITIES_ONLY )
+	{
+		ICollideable *pCollide = GetWorldCollideable();
+		Assert( pCollide );
+
+		// Make sure the world entity is unrotated
+		Assert(!pCollide || pCollide->GetCollisionOrigin() == vec3_origin );
+		Assert(!pCollide || pCollide->GetCollisionAngles() == vec3_angle );
+
+		CM_BoxTraceRays( pRays, nRays, 0, fMask, true, pTraces );
+
+		for ( int i = 0; i < nRays; ++i )
+		{
+			SetTraceEntity( pCollide, &pTraces[i] );
+		}
+	}
+	else
+	{
+		for ( int i = 0; i < nRays; ++i )
+		{
+			CM_ClearTrace( &pTraces[i] );
+		}
+	}
+
+	// Entities along each ray.
+	for ( int i = 0; i < nRays; ++i )
+	{
+		TraceRayAgainstEntities( pRays[i], fMask, pTraceFilter, &pTraces[i] );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Read-only tracing from any thread
+//-----------------------------------------------------------------------------
+void CEngineTrace::BeginReadOnlyTraces()
+{
+	Assert( ThreadInMainThread() );
+
+	if ( m_nReadOnlyTraces == 0 )
+	{
+		// Partition queries move lazily updated entities first, do it now so concurrent traces only read
+		SpatialPartition()->UpdateLazyElements( SpatialPartitionMask() | SpatialPartitionTriggerMask() );
+	}
+
+	++m_nReadOnlyTraces;
+}
+
+void CEngineTrace::EndReadOnlyTraces()
+{
+	Assert( ThreadInMainThread() );
+	Assert( m_nReadOnlyTraces > 0 );
+
+	--m_nReadOnlyTraces;
+}
 
+bool CEngineTrace::IsInReadOnlyTraces() const
+{
+	return m_nReadOnlyTraces != 0;
+}
+
+bool EngineTrace_IsInReadOnlyTraces()
+{
+#ifndef SWDS
+	if ( s_EngineTraceClient.IsInReadOnlyTraces() )
+		return true;
+#endif
+	return s_EngineTraceServer.IsInReadOnlyTraces();
+}
+
+//-----------------------------------------------------------------------------
+// Clips the world trace of a ray against entities along it
+//-----------------------------------------------------------------------------
+void CEngineTrace::TraceRayAgainstEntities( const Ray_t &ray, unsigned int fMask, ITraceFilter *pTraceFilter, trace_t *pTrace )
+{
+	if ( pTraceFilter->GetTraceType() != TRACE_ENTITIES_ONLY )
+	{
 		// inside world, no need to check being inside anything else
 		if ( pTrace->startsolid )
 			return;
@@ -1844,16 +1958,16 @@ void CEngineTrace::SweepCollideable( ICollideable *pCollide,
 		const Vector &vecAbsStart, const Vector &vecAbsEnd, const QAngle &vecAngles,
 		unsigned int fMask, ITraceFilter *pTraceFilter, trace_t *pTrace )
 {
-	const matrix3x4_t *pOldRoot = m_pRootMoveParent;
+	const matrix3x4_t *pOldRoot = s_pRootMoveParent;
 	Ray_t ray;
 	Assert( vecAngles == vec3_angle );
 	if ( pCollide->GetSolidFlags() & FSOLID_ROOT_PARENT_ALIGNED )
 	{
-		m_pRootMoveParent = pCollide->GetRootParentToWorldTransform();
+		s_pRootMoveParent = pCollide->GetRootParentToWorldTransform();
 	}
 	ray.Init( vecAbsStart, vecAbsEnd, pCollide->OBBMins(), pCollide->OBBMaxs() );
 	TraceRay( ray, fMask, pTraceFilter, pTrace );
-	m_pRootMoveParent = pOldRoot;
+	s_pRootMoveParent = pOldRoot;
 }
 
 
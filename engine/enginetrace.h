@@ -26,5 +26,11 @@ extern IEngineTrace *g_pEngineTraceClient;
 //-----------------------------------------------------------------------------
 void EngineTraceRenderRayCasts();
 
+//-----------------------------------------------------------------------------
+// True while client or server traces run in read-only mode, world and entity
+// collision must not change then.
+//-----------------------------------------------------------------------------
+bool EngineTrace_IsInReadOnlyTraces();
+
 
 #endif // ENGINETRACE_H
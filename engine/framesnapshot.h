@@ -163,10 +163,21 @@ public:
 	// List of entities to explicitly delete
 	void			AddExplicitDelete( int iSlot );
 
+	// Snapshots released while clients are sent in parallel are not deleted
+	// right away, other send jobs may still walk over them in WriteTempEntities.
+	// They are deleted on the calling (main) thread in EndParallelSend.
+	void			BeginParallelSend();
+	void			EndParallelSend();
+
 private:
 	void	DeleteFrameSnapshot( CFrameSnapshot* pSnapshot );
+	void	FreeFrameSnapshot( CFrameSnapshot* pSnapshot );
 
 	CUtlLinkedList<CFrameSnapshot*, int>		m_FrameSnapshots;
+	// Guards m_FrameSnapshots and deferred snapshot deletes.
+	CThreadFastMutex							m_SnapshotsMutex;
+	CUtlVector<CFrameSnapshot*>					m_DeferredDeletes;
+	bool										m_bDeferDeletes;
 	CClassMemoryPool< PackedEntity >			m_PackedEntitiesPool;
 
 	int								m_nPackedEntityCacheCounter;  // increase with every cache access
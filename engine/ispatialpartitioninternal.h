@@ -23,6 +23,10 @@ public:
 	virtual void Init( const Vector& worldmin, const Vector& worldmax ) = 0;
 
 	virtual void DrawDebugOverlays() = 0;
+
+	// Runs query callbacks once so lazily moved elements are up to date, queries
+	// made in read-only traces then don't move elements.
+	virtual void UpdateLazyElements( SpatialPartitionListMask_t listMask ) = 0;
 };
 
 
@@ -31,10 +35,22 @@ public:
 //-----------------------------------------------------------------------------
 ISpatialPartitionInternal* SpatialPartition();
 
+//-----------------------------------------------------------------------------
+// Partition trees which use a dynamic AABB tree instead of the voxel hash
+//-----------------------------------------------------------------------------
+enum SpatialPartitionBVHTrees_t
+{
+	SPATIAL_PARTITION_BVH_NONE		= 0,
+	SPATIAL_PARTITION_BVH_SERVER	= ( 1 << 0 ),	// lists other than PARTITION_ALL_CLIENT_EDICTS
+	SPATIAL_PARTITION_BVH_CLIENT	= ( 1 << 1 ),	// PARTITION_ALL_CLIENT_EDICTS lists
+	SPATIAL_PARTITION_BVH_ALL		= SPATIAL_PARTITION_BVH_SERVER | SPATIAL_PARTITION_BVH_CLIENT,
+};
+
 //-----------------------------------------------------------------------------
 // Create/destroy a custom spatial partition
 //-----------------------------------------------------------------------------
 ISpatialPartition *CreateSpatialPartition( const Vector& worldmin, const Vector& worldmax );
+ISpatialPartition *CreateSpatialPartition( const Vector& worldmin, const Vector& worldmax, int nBVHTrees );
 void DestroySpatialPartition( ISpatialPartition * );
 
 
@@ -129,6 +129,9 @@ void		NET_OutOfBandPrintf( intp sock, const netadr_t &adr, PRINTF_FORMAT_STRING
 int			NET_SendPacket( INetChannel *chan, intp sock,  const netadr_t &to, const  unsigned char *data, int length, bf_write *pVoicePayload = NULL, bool bUseCompression = false );
 // Called periodically to maybe send any queued packets (up to 4 per frame)
 void		NET_SendQueuedPackets();
+// Queue datagrams sent on a socket and send them with as few syscalls as possible on flush (Linux only)
+void		NET_BeginBatchedSend( intp sock );
+void		NET_FlushBatchedSend();
 // Start set current network configuration
 void		NET_SetMutiplayer( bool multiplayer );
 // Set net_time
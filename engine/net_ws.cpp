@@ -2,6 +2,7 @@
 //
 // IP Support layer.
 
+#include <atomic>
 #include <system_error>
 
 #include "tier0/etwprof.h"
@@ -1334,6 +1335,122 @@ bool NET_GetLoopPacket ( netpacket_t * packet )
 	return ( NET_LagPacket( true, packet ) );	
 }
 
+#ifdef LINUX
+// Batched UDP I/O. Datagrams are drained from the socket with a single recvmmsg
+// into a per socket ring, and datagrams sent between NET_BeginBatchedSend and
+// NET_FlushBatchedSend go out with sendmmsg. Saves thousands of syscalls per
+// tick on full servers.
+static ConVar net_udp_batchio( "net_udp_batchio", "1", 0, "Receive and send UDP datagrams in batches via recvmmsg/sendmmsg." );
+
+#define NET_BATCH_DATAGRAMS		32
+// Slots hold the largest UDP payload, so every datagram recvfrom into a NET_MAX_MESSAGE
+// buffer accepted still fits. A truncated datagram is already consumed and can't be re-read.
+#define NET_BATCH_DATAGRAM_SIZE	( NET_MAX_MESSAGE < 65536 ? NET_MAX_MESSAGE : 65536 )
+
+struct NetRecvBatch_t
+{
+	mmsghdr			msgs[ NET_BATCH_DATAGRAMS ];
+	iovec			iovecs[ NET_BATCH_DATAGRAMS ];
+	sockaddr		addrs[ NET_BATCH_DATAGRAMS ];
+	int				nReceived;	// datagrams in ring
+	int				nNext;		// next datagram to hand out
+	byte			data[ NET_BATCH_DATAGRAMS ][ NET_BATCH_DATAGRAM_SIZE ];
+};
+
+// Each socket is processed by one thread at a time, so are rings. Extra
+// sockets use plain recvfrom.
+static NetRecvBatch_t *s_pRecvBatches[MAX_SOCKETS];
+
+static bool NET_UseBatchedIO()
+{
+	// VCR records every recvfrom, keep old path for it.
+	return net_udp_batchio.GetBool() && VCRGetMode() == VCR_Disabled;
+}
+
+static void NET_ClearRecvBatch( intp sock )
+{
+	if ( sock >= 0 && sock < MAX_SOCKETS && s_pRecvBatches[sock] )
+	{
+		s_pRecvBatches[sock]->nReceived = 0;
+		s_pRecvBatches[sock]->nNext = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: recvfrom replacement which refills ring with recvmmsg when empty.
+// Output : datagram size or -1 and errno when no datagrams available
+//-----------------------------------------------------------------------------
+static int NET_ReceiveFromBatch( intp sock, socket_handle hSocket, char *buf, int len, struct sockaddr *from, int *fromlen )
+{
+	NetRecvBatch_t *&pBatch = s_pRecvBatches[sock];
+	if ( !pBatch )
+	{
+		pBatch = new NetRecvBatch_t;
+		pBatch->nReceived = 0;
+		pBatch->nNext = 0;
+	}
+
+	for ( ;; )
+	{
+		if ( pBatch->nNext >= pBatch->nReceived )
+		{
+			for ( int i = 0; i < NET_BATCH_DATAGRAMS; ++i )
+			{
+				pBatch->iovecs[i].iov_base = pBatch->data[i];
+				pBatch->iovecs[i].iov_len = sizeof( pBatch->data[i] );
+
+				msghdr &hdr = pBatch->msgs[i].msg_hdr;
+				V_memset( &hdr, 0, sizeof( hdr ) );
+				hdr.msg_name = &pBatch->addrs[i];
+				hdr.msg_namelen = sizeof( pBatch->addrs[i] );
+				hdr.msg_iov = &pBatch->iovecs[i];
+				hdr.msg_iovlen = 1;
+				pBatch->msgs[i].msg_len = 0;
+			}
+
+			pBatch->nNext = 0;
+			pBatch->nReceived = 0;
+
+			int ret;
+			{
+				VPROF_BUDGET( "recvmmsg", VPROF_BUDGETGROUP_OTHER_NETWORKING );
+				ret = recvmmsg( hSocket, pBatch->msgs, NET_BATCH_DATAGRAMS, MSG_DONTWAIT, nullptr );
+			}
+
+			if ( ret <= 0 )
+			{
+				if ( ret == 0 )
+				{
+					errno = EWOULDBLOCK;
+				}
+				return -1;
+			}
+
+			pBatch->nReceived = ret;
+
+			// recvfrom would need a syscall per datagram.
+			VPROF_INCREMENT_GROUP_COUNTER( "UDP recv syscalls saved", COUNTER_GROUP_DEFAULT, ret - 1 );
+		}
+
+		const mmsghdr &msg = pBatch->msgs[ pBatch->nNext++ ];
+		if ( msg.msg_hdr.msg_flags & MSG_TRUNC )
+		{
+			ConDMsg( "NET_ReceiveDatagram:  Oversize packet on %s socket, dropped\n", DescribeSocket( sock ) );
+			continue;
+		}
+
+		const int nBytes = min( static_cast<int>( msg.msg_len ), len );
+		V_memcpy( buf, pBatch->data[ &msg - pBatch->msgs ], nBytes );
+
+		const int nAddrBytes = min( static_cast<int>( msg.msg_hdr.msg_namelen ), *fromlen );
+		V_memcpy( from, msg.msg_hdr.msg_name, nAddrBytes );
+		*fromlen = nAddrBytes;
+
+		return nBytes;
+	}
+}
+#endif // LINUX
+
 bool NET_ReceiveDatagram ( const intp sock, netpacket_t * packet )
 {
 	VPROF_BUDGET( "NET_ReceiveDatagram", VPROF_BUDGETGROUP_OTHER_NETWORKING );
@@ -1346,6 +1463,13 @@ bool NET_ReceiveDatagram ( const intp sock, netpacket_t * packet )
 	socket_handle	net_socket = net_sockets[packet->source].hUDP;
 
 	int ret = 0;
+#ifdef LINUX
+	if ( NET_UseBatchedIO() && packet->source < MAX_SOCKETS )
+	{
+		ret = NET_ReceiveFromBatch( packet->source, net_socket, (char *)packet->data, NET_MAX_MESSAGE, &from, &fromlen );
+	}
+	else
+#endif
 	{
 		VPROF_BUDGET( "recvfrom", VPROF_BUDGETGROUP_OTHER_NETWORKING );
 		ret = VCRHook_recvfrom(net_socket, (char *)packet->data, NET_MAX_MESSAGE, 0, &from, &fromlen );
@@ -1787,8 +1911,155 @@ void NET_LogBadPacket(netpacket_t * packet)
 	}
 }
 
+#ifdef LINUX
+struct NetBatchedDatagram_t
+{
+	intp			nOffset;	// in NetSendBatch_t::data
+	int				nLength;
+	sockaddr		to;
+	socklen_t		tolen;
+};
+
+struct NetSendBatch_t
+{
+	CThreadFastMutex					mutex;
+	// Set between NET_BeginBatchedSend and NET_FlushBatchedSend, checked without the lock.
+	std::atomic<bool>					bActive;
+	// Socket which sends are batched, valid while bActive.
+	socket_handle						hSocket;
+	CUtlVector<byte>					data;
+	CUtlVector<NetBatchedDatagram_t>	datagrams;
+};
+
+// Snapshots may be sent from parallel jobs, so batch is shared and locked.
+static NetSendBatch_t s_SendBatch;
+
+static bool NET_QueueBatchedSend( SOCKET s, const char *buf, int len, const struct sockaddr *to, int tolen )
+{
+	if ( tolen > static_cast<int>( sizeof( sockaddr ) ) )
+		return false;
+
+	AUTO_LOCK( s_SendBatch.mutex );
+
+	if ( !s_SendBatch.bActive.load( std::memory_order_relaxed ) || s_SendBatch.hSocket != s )
+		return false;
+
+	NetBatchedDatagram_t &datagram = s_SendBatch.datagrams[ s_SendBatch.datagrams.AddToTail() ];
+	datagram.nOffset = s_SendBatch.data.Count();
+	datagram.nLength = len;
+	V_memcpy( &datagram.to, to, tolen );
+	datagram.tolen = tolen;
+
+	s_SendBatch.data.AddMultipleToTail( len, reinterpret_cast<const byte *>( buf ) );
+	return true;
+}
+#endif // LINUX
+
+void NET_BeginBatchedSend( intp sock )
+{
+#ifdef LINUX
+	if ( !NET_UseBatchedIO() || sock < 0 || sock >= net_sockets.Count() || !net_sockets[sock].hUDP )
+		return;
+
+	AUTO_LOCK( s_SendBatch.mutex );
+
+	Assert( !s_SendBatch.bActive.load( std::memory_order_relaxed ) );
+	s_SendBatch.hSocket = net_sockets[sock].hUDP;
+	s_SendBatch.bActive.store( true, std::memory_order_release );
+#endif
+}
+
+void NET_FlushBatchedSend()
+{
+#ifdef LINUX
+	VPROF_BUDGET( "NET_FlushBatchedSend", VPROF_BUDGETGROUP_OTHER_NETWORKING );
+
+	AUTO_LOCK( s_SendBatch.mutex );
+
+	if ( !s_SendBatch.bActive.load( std::memory_order_relaxed ) )
+		return;
+
+	const socket_handle hSocket = s_SendBatch.hSocket;
+	s_SendBatch.bActive.store( false, std::memory_order_release );
+
+	const intp nDatagrams = s_SendBatch.datagrams.Count();
+	if ( !nDatagrams )
+		return;
+
+	CUtlVector<mmsghdr> msgs;
+	CUtlVector<iovec> iovecs;
+	msgs.SetCount( nDatagrams );
+	iovecs.SetCount( nDatagrams );
+
+	for ( intp i = 0; i < nDatagrams; ++i )
+	{
+		NetBatchedDatagram_t &datagram = s_SendBatch.datagrams[i];
+
+		iovecs[i].iov_base = s_SendBatch.data.Base() + datagram.nOffset;
+		iovecs[i].iov_len = datagram.nLength;
+
+		msghdr &hdr = msgs[i].msg_hdr;
+		V_memset( &hdr, 0, sizeof( hdr ) );
+		hdr.msg_name = &datagram.to;
+		hdr.msg_namelen = datagram.tolen;
+		hdr.msg_iov = &iovecs[i];
+		hdr.msg_iovlen = 1;
+		msgs[i].msg_len = 0;
+	}
+
+	int nSyscalls = 0;
+	intp nSent = 0;
+	while ( nSent < nDatagrams )
+	{
+		++nSyscalls;
+
+		// Kernel sends at most UIO_MAXIOV datagrams per call.
+		const int ret = sendmmsg( hSocket, msgs.Base() + nSent, static_cast<unsigned>( nDatagrams - nSent ), 0 );
+		if ( ret < 0 )
+		{
+			const int net_error = NET_GetLastError();
+			if ( net_error == EINTR )
+				continue;
+
+			if ( net_error == WSAEWOULDBLOCK )
+			{
+				// Send buffer is full. Send the rest one by one like the unbatched path, which
+				// drops only the datagrams that still don't fit.
+				for ( ; nSent < nDatagrams; ++nSent )
+				{
+					const NetBatchedDatagram_t &datagram = s_SendBatch.datagrams[nSent];
+					++nSyscalls;
+					sendto( hSocket, s_SendBatch.data.Base() + datagram.nOffset, datagram.nLength, 0, &datagram.to, datagram.tolen );
+				}
+				break;
+			}
+
+			// sendmmsg only fails when the first datagram does, drop it and go on with the rest.
+			if ( net_error != WSAECONNRESET )
+			{
+				ConDMsg( "NET_FlushBatchedSend Warning: %s, datagram dropped\n", NET_ErrorString( net_error ) );
+			}
+			++nSent;
+			continue;
+		}
+
+		nSent += ret;
+	}
+
+	VPROF_INCREMENT_GROUP_COUNTER( "UDP send syscalls saved", COUNTER_GROUP_DEFAULT, static_cast<int>( nDatagrams ) - nSyscalls );
+
+	s_SendBatch.datagrams.RemoveAll();
+	s_SendBatch.data.RemoveAll();
+#endif
+}
+
 int NET_SendToImpl( SOCKET s, const char FAR * buf, int len, const struct sockaddr FAR * to, int tolen, int iGameDataLength )
 {
+#ifdef LINUX
+	if ( s_SendBatch.bActive.load( std::memory_order_acquire ) && NET_QueueBatchedSend( s, buf, len, to, tolen ) )
+		return len;
+#endif
+
 	int nSend = sendto( s, buf, len, 0, to, tolen );
 	return nSend;
 }
@@ -2370,6 +2641,9 @@ void NET_CloseAllSockets (void)
 		{
 			NET_CloseSocket( net_sockets[i].hUDP );
 			NET_CloseSocket( net_sockets[i].hTCP );
+#ifdef LINUX
+			NET_ClearRecvBatch( i );
+#endif
 
 			net_sockets[i].nPort = 0;
 			net_sockets[i].bListening = false;
@@ -2411,6 +2685,10 @@ void NET_FlushAllSockets( void )
 			{
 				bytes = VCRHook_recvfrom( net_sockets[i].hUDP, data, sizeof(data), 0, (struct sockaddr *)&from, (int *)&fromlen );
 			}
+
+#ifdef LINUX
+			NET_ClearRecvBatch( i );
+#endif
 		}
 	}
 }
@@ -2987,6 +3265,14 @@ void NET_Shutdown ()
 	NET_CloseAllSockets();
 	NET_ConfigLoopbackBuffers( false );
 
+#ifdef LINUX
+	for ( auto *&batch : s_pRecvBatches )
+	{
+		delete batch;
+		batch = nullptr;
+	}
+#endif
+
 	Assert( s_NetChannels.Count() == 0 );
 	Assert( s_PendingSockets.Count() == 0);
 }
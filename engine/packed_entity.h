@@ -17,6 +17,7 @@
 #include <mempool.h>
 #include <utlvector.h>
 #include <tier0/dbg.h>
+#include <tier0/threadtools.h>
 
 #include "common.h"
 
@@ -110,7 +111,7 @@ public:
 	ClientClass	*m_pClientClass;	// Valid on the client
 		
 	int			m_nEntityIndex;		// Entity index.
-	int			m_ReferenceCount;	// reference count;
+	CInterlockedInt	m_ReferenceCount;	// reference count, interlocked as snapshots are released from send jobs;
 
 private:
 
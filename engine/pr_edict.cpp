@@ -19,6 +19,8 @@
 #include "ispatialpartition.h"
 #include "utllinkedlist.h"
 #include "framesnapshot.h"
+#include "sv_packedentities.h"
+#include "dt_send_eng.h"
 #include "sv_log.h"
 #include "tier1/utlmap.h"
 #include "tier1/utlvector.h"
@@ -54,6 +56,7 @@ static void ED_ClearEdict( edict_t *e )
 	e->ClearFree();
 	e->ClearStateChanged();
 	e->SetChangeInfoSerialNumber( 0 );
+	sv.edictdirtyprops[ e->m_EdictIndex ].ClearAll();
 	
 	serverGameEnts->FreeContainingEntity(e);
 	InitializeEntityDLLFields(e);
@@ -366,3 +369,9 @@ const IChangeInfoAccessor *CBaseEdict::GetChangeAccessor() const
 {
 	return &sv.edictchangeinfo[ NUM_FOR_EDICTINFO( (const edict_t*)this ) ];
 }
+
+bool CBaseEdict::StateChangedOverflow( unsigned short offset )
+{
+	SV_EdictStateChangedOverflow( (edict_t*)this, offset );
+	return true;
+}
@@ -32,6 +32,7 @@ class CEventInfo;
 typedef CGameTrace trace_t;
 typedef int TABLEID;
 class IChangeInfoAccessor;
+class CSendPropBits;
 class CPureServerWhitelist;
 
 
@@ -102,6 +103,7 @@ public:
 	int			free_edicts; // how many edicts in num_edicts are free, in use is num_edicts - free_edicts
 	edict_t		*edicts;			// Can array index now, edict_t is fixed
 	IChangeInfoAccessor *edictchangeinfo; // HACK to allow backward compat since we can't change edict_t layout
+	CSendPropBits *edictdirtyprops;	// Props changed since each edict was last packed, that didn't fit in its change info.
 
 	int			m_nMaxClientsLimit;    // Max allowed on server.
 	
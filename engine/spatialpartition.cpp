@@ -27,10 +27,13 @@
 #include "tier1/convar.h"
 #include "tier1/memstack.h"
 #include "enginethreads.h"
+#include "enginetrace.h"
 #include "datacache/imdlcache.h"
 #include "tier2/renderutils.h"
 #include "bitvec.h"
 #include "tier1/mempool.h"
+#include "dynamicaabbtree.h"
+#include "spatialpartitionrecord.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -96,6 +99,7 @@ struct EntityInfo_t
 	char						m_nLevel[NUM_TREES];	// Which level voxel tree is it in?
 	unsigned short				m_nVisitBit[NUM_TREES];
 	intp						m_iLeafList[NUM_TREES];	// Index into the leaf pool - leaf list for entity (m_aLeafList).
+	int							m_nProxy[NUM_TREES];	// Leaf in the dynamic AABB tree, when tree uses it.
 };
 
 
@@ -230,7 +234,7 @@ public:
 	virtual ~CVoxelTree();
 
 	// Inherited from ISpatialPartition
-	virtual void Init(  CSpatialPartition *pOwner, int iTree, const Vector& worldmin, const Vector& worldmax );
+	virtual void Init(  CSpatialPartition *pOwner, int iTree, const Vector& worldmin, const Vector& worldmax, bool bUseBVH );
 
 	virtual void ElementMoved( SpatialPartitionHandle_t handle, const Vector& mins, const Vector& maxs );
 	virtual void EnumerateElementsInBox( SpatialPartitionListMask_t listMask, const Vector& mins, const Vector& maxs, bool coarseTest, IPartitionEnumerator* pIterator );
@@ -277,6 +281,10 @@ public:
 	void ComputeSweptRayBounds( const Ray_t &ray, const Vector &vecStartMin, const Vector &vecStartMax, Vector *pVecMin, Vector *pVecMax );
 
 private:
+	// Dynamic AABB tree enumeration
+	template <class T> bool EnumerateElementsInBVH( const T &intersectTest, SpatialPartitionListMask_t listMask, IPartitionEnumerator* pIterator );
+	void MoveElementInBVH( SpatialPartitionHandle_t hPartition, const Vector& mins, const Vector& maxs );
+	void RenderObjectsInBVH( const Vector &vecMin, const Vector &vecMax, float flTime );
 
 	int									m_nLevelCount;
 	CVoxelHash*							m_pVoxelHash;
@@ -292,6 +300,8 @@ private:
 	CObjectPool<CPartitionVisits, 2>	m_FreeVisits;
 #endif
 	CThreadSpinRWLock					m_lock;
+	bool								m_bUseBVH;
+	CDynamicAABBTree					m_BVH;								// Used instead of voxel hash when m_bUseBVH.
 };
 
 //-----------------------------------------------------------------------------
@@ -311,6 +321,7 @@ public:
 
 	// Inherited from ISpatialPartition
 	virtual void Init( const Vector& worldmin, const Vector& worldmax );
+	void Init( const Vector& worldmin, const Vector& worldmax, int nBVHTrees );
 	void Shutdown( void );
 
 	virtual SpatialPartitionHandle_t CreateHandle( IHandleEntity *pHandleEntity );
@@ -355,6 +366,7 @@ public:
 	virtual void RenderObjectsInPlayerLeafs( const Vector &vecPlayerMin, const Vector &vecPlayerMax, float flTime );
 	virtual void ReportStats( const char *pFileName );
 	virtual void DrawDebugOverlays();
+	virtual void UpdateLazyElements( SpatialPartitionListMask_t listMask );
 
 	// Gets entity info (for enumerations).
 	EntityInfo_t &EntityInfo( SpatialPartitionHandle_t hPartition );
@@ -365,10 +377,18 @@ public:
 	CVoxelTree * VoxelTree( SpatialPartitionListMask_t listMask );
 	CVoxelTree * VoxelTreeForHandle( SpatialPartitionHandle_t handle );
 
+	// Records all operations until stopped, for the spatial partition benchmark.
+	void StartRecording();
+	bool StopRecording( const char *pFileName );
+	bool IsRecording() const	{ return m_bRecording; }
+
 protected:
 	// Invokes the pre-query callbacks.
 	void InvokeQueryCallbacks( SpatialPartitionListMask_t listMask, bool = false );
 
+	void Record( SpatialPartitionRecordOp_t nOp, SpatialPartitionHandle_t hPartition, SpatialPartitionListMask_t listMask, 
+		const Vector &vec0 = vec3_origin, const Vector &vec1 = vec3_origin, const Vector &vec2 = vec3_origin );
+
 	typedef CUtlLinkedList<EntityInfo_t, SpatialPartitionHandle_t, false, SpatialPartitionHandle_t, CUtlMemoryStack<UtlLinkedListElem_t< EntityInfo_t, SpatialPartitionHandle_t >, SpatialPartitionHandle_t, 0xffff, 1024> > CHandleList;
 
 private:
@@ -383,6 +403,11 @@ private:
 
 	// Debug!
 	SpatialPartitionListMask_t								m_nSuppressedListMask;
+
+	// Recorded operations.
+	bool													m_bRecording;
+	CThreadFastMutex										m_RecordMutex;
+	CUtlVector<SpatialPartitionRecord_t>					m_Records;
 };
 
 //-----------------------------------------------------------------------------
@@ -1696,7 +1721,7 @@ void CVoxelHash::RenderObjectsInPlayerLeafs( const Vector &vecPlayerMin, const V
 // Purpose: Constructor
 //-----------------------------------------------------------------------------
 
-CVoxelTree::CVoxelTree() : m_pVoxelHash( NULL ), m_pOwner( NULL ), m_nNextVisitBit( 0 )
+CVoxelTree::CVoxelTree() : m_pVoxelHash( NULL ), m_pOwner( NULL ), m_nNextVisitBit( 0 ), m_bUseBVH( false )
 {
 	// Compute max number of levels
 	m_nLevelCount = 0;
@@ -1733,15 +1758,29 @@ void ClampVector( Vector &out, const Vector &mins, const Vector &maxs )
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Bloat by an eps and clamp to the partition bounds, as stored in the tree.
+//-----------------------------------------------------------------------------
+static inline void ComputeTreeBounds( const Vector& mins, const Vector& maxs, Vector &vecMin, Vector &vecMax )
+{
+	vecMin.Init( mins.x - SPHASH_EPS, mins.y - SPHASH_EPS, mins.z - SPHASH_EPS );
+	vecMax.Init( maxs.x + SPHASH_EPS, maxs.y + SPHASH_EPS, maxs.z + SPHASH_EPS );
+
+	ClampVector(vecMin, s_PartitionMin, s_PartitionMax);
+	ClampVector(vecMax, s_PartitionMin, s_PartitionMax);
+}
+
 //-----------------------------------------------------------------------------
 // Purpose:
 //   Input: worldmin - 
 //          worldmax - 
 //-----------------------------------------------------------------------------
-void CVoxelTree::Init( CSpatialPartition *pOwner, int iTree, const Vector &worldmin, const Vector &worldmax )
+void CVoxelTree::Init( CSpatialPartition *pOwner, int iTree, const Vector &worldmin, const Vector &worldmax, bool bUseBVH )
 {
 	m_pOwner = pOwner;
 	m_TreeId = iTree;
+	m_bUseBVH = bUseBVH;
+	m_BVH.Purge();
 
 	// Reset the enumeration id.
 	m_pVisits = NULL;
@@ -1762,6 +1801,7 @@ void CVoxelTree::Init( CSpatialPartition *pOwner, int iTree, const Vector &world
 //-----------------------------------------------------------------------------
 void CVoxelTree::Shutdown( void )
 {
+	m_BVH.Purge();
 	m_aLeafList.Purge();
 	for ( int i = 0; i < m_nLevelCount; ++i )
 	{
@@ -1797,22 +1837,30 @@ void CVoxelTree::InsertIntoTree( SpatialPartitionHandle_t hPartition, const Vect
 	}
 
 	// Bloat by an eps before inserting the object into the tree.
-	Vector vecMin( mins.x - SPHASH_EPS, mins.y - SPHASH_EPS, mins.z - SPHASH_EPS );
-	Vector vecMax( maxs.x + SPHASH_EPS, maxs.y + SPHASH_EPS, maxs.z + SPHASH_EPS );
-
-	ClampVector(vecMin, s_PartitionMin, s_PartitionMax);
-	ClampVector(vecMax, s_PartitionMin, s_PartitionMax);
-	Vector vecSize;
-	VectorSubtract( vecMax, vecMin, vecSize );
+	Vector vecMin, vecMax;
+	ComputeTreeBounds( mins, maxs, vecMin, vecMax );
 
-	int nLevel;
-	for ( nLevel = 0; nLevel < m_nLevelCount - 1; ++nLevel )
+	if ( m_bUseBVH )
 	{
-		int nVoxelSize = m_pVoxelHash[nLevel].VoxelSize();
-		if ( (nVoxelSize > vecSize.x) && (nVoxelSize > vecSize.y) && (nVoxelSize > vecSize.z) )
-			break;
+		info.m_vecMin = vecMin;
+		info.m_vecMax = vecMax;
+		info.m_nLevel[m_TreeId] = 0;
+		info.m_nProxy[m_TreeId] = m_BVH.CreateProxy( vecMin, vecMax, hPartition );
+	}
+	else
+	{
+		Vector vecSize;
+		VectorSubtract( vecMax, vecMin, vecSize );
+
+		int nLevel;
+		for ( nLevel = 0; nLevel < m_nLevelCount - 1; ++nLevel )
+		{
+			int nVoxelSize = m_pVoxelHash[nLevel].VoxelSize();
+			if ( (nVoxelSize > vecSize.x) && (nVoxelSize > vecSize.y) && (nVoxelSize > vecSize.z) )
+				break;
+		}
+		m_pVoxelHash[nLevel].InsertIntoTree( hPartition, vecMin, vecMax );
 	}
-	m_pVoxelHash[nLevel].InsertIntoTree( hPartition, vecMin, vecMax );
 	m_lock.UnlockWrite();
 
 	if ( bWasReading )
@@ -1840,7 +1888,18 @@ void CVoxelTree::RemoveFromTree( SpatialPartitionHandle_t hPartition )
 		}
 
 		m_lock.LockForWrite();
-		m_pVoxelHash[nLevel].RemoveFromTree( hPartition );
+		if ( m_bUseBVH )
+		{
+			if ( info.m_nProxy[m_TreeId] != CDynamicAABBTree::NULL_NODE )
+			{
+				m_BVH.DestroyProxy( info.m_nProxy[m_TreeId] );
+				info.m_nProxy[m_TreeId] = CDynamicAABBTree::NULL_NODE;
+			}
+		}
+		else
+		{
+			m_pVoxelHash[nLevel].RemoveFromTree( hPartition );
+		}
 		m_AvailableVisitBits.AddToTail( info.m_nVisitBit[m_TreeId] );
 		info.m_nVisitBit[m_TreeId] = (unsigned short)-1;
 		m_lock.UnlockWrite();
@@ -1862,7 +1921,8 @@ void CVoxelTree::ElementMoved( SpatialPartitionHandle_t hPartition, const Vector
 	{
 		// If it doesn't already exist in the tree - add it.
 		EntityInfo_t &info = EntityInfo( hPartition );
-		if ( info.m_iLeafList[GetTreeId()] == CLeafList::InvalidIndex() )
+		bool bInTree = m_bUseBVH ? ( info.m_nProxy[GetTreeId()] != CDynamicAABBTree::NULL_NODE ) : ( info.m_iLeafList[GetTreeId()] != CLeafList::InvalidIndex() );
+		if ( !bInTree )
 		{
 			InsertIntoTree( hPartition, mins, maxs );
 			return;
@@ -1878,6 +1938,13 @@ void CVoxelTree::ElementMoved( SpatialPartitionHandle_t hPartition, const Vector
 			return;
 		}
 
+		// Refit the leaf in place, it keeps its visit bit.
+		if ( m_bUseBVH )
+		{
+			MoveElementInBVH( hPartition, mins, maxs );
+			return;
+		}
+
 		// Remove entity from voxel hash.
 		RemoveFromTree( hPartition );
 
@@ -1887,6 +1954,75 @@ void CVoxelTree::ElementMoved( SpatialPartitionHandle_t hPartition, const Vector
 }
 
 
+//-----------------------------------------------------------------------------
+// Updates element bounds in the dynamic AABB tree
+//-----------------------------------------------------------------------------
+void CVoxelTree::MoveElementInBVH( SpatialPartitionHandle_t hPartition, const Vector& mins, const Vector& maxs )
+{
+	bool bWasReading = ( m_pVisits != NULL );
+	if ( bWasReading )
+	{
+		// If we're recursing in this thread, need to release our read lock to allow ourselves to write
+		UnlockRead();
+	}
+
+	m_lock.LockForWrite();
+
+	EntityInfo_t &info = EntityInfo( hPartition );
+	ComputeTreeBounds( mins, maxs, info.m_vecMin, info.m_vecMax );
+	m_BVH.MoveProxy( info.m_nProxy[m_TreeId], info.m_vecMin, info.m_vecMax );
+
+	m_lock.UnlockWrite();
+
+	if ( bWasReading )
+	{
+		LockForRead();
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Main dynamic AABB tree enumeration method
+//-----------------------------------------------------------------------------
+template <class T> 
+bool CVoxelTree::EnumerateElementsInBVH( const T &intersectTest, SpatialPartitionListMask_t listMask, IPartitionEnumerator* pIterator )
+{
+	// Gather first, enumerators may insert or move elements and so rebuild the tree
+	// under us. Every element has a single leaf, so no need to check visits.
+	CUtlVectorFixedGrowable<SpatialPartitionHandle_t, 256> elements;
+	auto gather = [&]( int nUserData )
+	{
+		SpatialPartitionHandle_t hPartition = static_cast<SpatialPartitionHandle_t>( nUserData );
+		EntityInfo_t &hInfo = EntityInfo( hPartition );
+
+		if ( ( listMask & hInfo.m_fList ) && intersectTest.Intersects( hInfo.m_vecMin, hInfo.m_vecMax ) )
+		{
+			elements.AddToTail( hPartition );
+		}
+		return true;
+	};
+	m_BVH.Query( intersectTest, gather );
+
+	for ( auto hPartition : elements )
+	{
+		EntityInfo_t &hInfo = EntityInfo( hPartition );
+
+		// Keep going if this dude isn't in the list
+		if ( !( listMask & hInfo.m_fList ) )
+			continue;
+
+		if ( hInfo.m_flags & ENTITY_HIDDEN )
+			continue;
+
+		// Okay, this one is good...
+		if ( pIterator->EnumElement( hInfo.m_pHandleEntity ) == ITERATION_STOP )
+			return false;
+	}
+
+	return true;
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose:
 //-----------------------------------------------------------------------------
@@ -1915,6 +2051,16 @@ void CVoxelTree::EnumerateElementsInBox( SpatialPartitionListMask_t listMask,
 	CPartitionVisits *pPrevVisits = BeginVisit();
 
 	m_lock.LockForRead();
+	if ( m_bUseBVH )
+	{
+		CIntersectBox intersectBox( this, mins, maxs );
+		EnumerateElementsInBVH( intersectBox, listMask, pIterator );
+
+		m_lock.UnlockRead();
+		EndVisit( pPrevVisits );
+		return;
+	}
+
 	Voxel_t vs = m_pVoxelHash[0].VoxelIndexFromPoint( mins );
 	Voxel_t ve = m_pVoxelHash[0].VoxelIndexFromPoint( maxs );
 	if ( !m_pVoxelHash[0].EnumerateElementsInBox( listMask, vs, ve, mins, maxs, pIterator ) )
@@ -2300,7 +2446,20 @@ void CVoxelTree::EnumerateElementsAlongRay( SpatialPartitionListMask_t listMask,
 	CPartitionVisits *pPrevVisits = BeginVisit();
 
 	m_lock.LockForRead();
-	if ( ray.m_IsRay )
+	if ( m_bUseBVH )
+	{
+		if ( ray.m_IsRay )
+		{
+			CIntersectRay intersectRay( this, clippedRay, vecInvDelta );
+			EnumerateElementsInBVH( intersectRay, listMask, pIterator );
+		}
+		else
+		{
+			CIntersectSweptBox intersectSweptBox( this, clippedRay, vecInvDelta );
+			EnumerateElementsInBVH( intersectSweptBox, listMask, pIterator );
+		}
+	}
+	else if ( ray.m_IsRay )
 	{
 		EnumerateElementsAlongRay_Ray( listMask, clippedRay, vecInvDelta, vecEnd, pIterator );
 	}
@@ -2328,6 +2487,15 @@ void CVoxelTree::EnumerateElementsAtPoint( SpatialPartitionListMask_t listMask,
 		return;
 
 	m_lock.LockForRead();
+	if ( m_bUseBVH )
+	{
+		CIntersectPoint intersectPoint( this, pt );
+		EnumerateElementsInBVH( intersectPoint, listMask, pIterator );
+
+		m_lock.UnlockRead();
+		return;
+	}
+
 	// Callbacks.
 	Voxel_t v = m_pVoxelHash[0].VoxelIndexFromPoint( pt );
 	if ( !m_pVoxelHash[0].EnumerateElementsAtPoint( listMask, v, pt, pIterator ) )
@@ -2363,6 +2531,13 @@ void CVoxelTree::RenderAllObjectsInTree( float flTime )
 {
 	MDLCACHE_CRITICAL_SECTION_(g_pMDLCache);
 	m_lock.LockForRead();
+	if ( m_bUseBVH )
+	{
+		RenderObjectsInBVH( s_PartitionMin, s_PartitionMax, flTime );
+		m_lock.UnlockRead();
+		return;
+	}
+
 	for ( int i = 0; i < m_nLevelCount; ++i )
 	{
 		m_pVoxelHash[i].RenderAllObjectsInTree( flTime );
@@ -2379,6 +2554,13 @@ void CVoxelTree::RenderObjectsInPlayerLeafs( const Vector &vecPlayerMin, const V
 {
 	MDLCACHE_CRITICAL_SECTION_(g_pMDLCache);
 	m_lock.LockForRead();
+	if ( m_bUseBVH )
+	{
+		RenderObjectsInBVH( vecPlayerMin, vecPlayerMax, flTime );
+		m_lock.UnlockRead();
+		return;
+	}
+
 	for ( int i = 0; i < m_nLevelCount; ++i )
 	{
 		m_pVoxelHash[i].RenderObjectsInPlayerLeafs( vecPlayerMin, vecPlayerMax, flTime );
@@ -2387,6 +2569,29 @@ void CVoxelTree::RenderObjectsInPlayerLeafs( const Vector &vecPlayerMin, const V
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: Debug! Render boxes around objects in the dynamic AABB tree leafs
+//          intersecting the box.
+//-----------------------------------------------------------------------------
+void CVoxelTree::RenderObjectsInBVH( const Vector &vecMin, const Vector &vecMax, float flTime )
+{
+#ifndef SWDS
+	CIntersectBox intersectBox( this, vecMin, vecMax );
+	auto render = [&]( int nUserData )
+	{
+		EntityInfo_t &info = EntityInfo( static_cast<SpatialPartitionHandle_t>( nUserData ) );
+		const Vector &vecFatMin = m_BVH.GetFatMin( info.m_nProxy[m_TreeId] );
+		const Vector &vecFatMax = m_BVH.GetFatMax( info.m_nProxy[m_TreeId] );
+
+		CDebugOverlay::AddBoxOverlay( vec3_origin, info.m_vecMin, info.m_vecMax, vec3_angle, s_pVoxelColor[0][0], s_pVoxelColor[0][1], s_pVoxelColor[0][2], 75, flTime );
+		CDebugOverlay::AddBoxOverlay( vec3_origin, vecFatMin, vecFatMax, vec3_angle, s_pVoxelColor[1][0], s_pVoxelColor[1][1], s_pVoxelColor[1][2], 0, flTime );
+		return true;
+	};
+	m_BVH.Query( intersectBox, render );
+#endif
+}
+
+
 //-----------------------------------------------------------------------------
 // Expose CSpatialPartition to the game + client DLL.
 //-----------------------------------------------------------------------------
@@ -2411,6 +2616,7 @@ CSpatialPartition::CSpatialPartition()
 	memset(m_bUseOldQueryCallback, 0, sizeof(m_bUseOldQueryCallback));
 	m_nQueryCallbackCount = 0;
 	m_nSuppressedListMask = 0;
+	m_bRecording = false;
 }
 
 
@@ -2424,16 +2630,21 @@ CSpatialPartition::~CSpatialPartition()
 //   Input: worldmin - 
 //          worldmax - 
 //-----------------------------------------------------------------------------
+static ConVar spatialpartition_bvh( "spatialpartition_bvh", "0", 0, "Partition trees which use dynamic AABB tree instead of voxel hash: 0 - none, 1 - server lists, 2 - client lists, 3 - both. Applied on map load.", true, SPATIAL_PARTITION_BVH_NONE, true, SPATIAL_PARTITION_BVH_ALL );
+
 void CSpatialPartition::Init( const Vector &worldmin, const Vector &worldmax )
+{
+	Init( worldmin, worldmax, spatialpartition_bvh.GetInt() );
+}
+
+void CSpatialPartition::Init( const Vector &worldmin, const Vector &worldmax, int nBVHTrees )
 {
 	// Clear the handle list and ensure some new memory.
 	m_aHandles.Purge();
 	m_aHandles.EnsureCapacity( SPHASH_HANDLELIST_BLOCK );
 
-	for ( int i = 0; i < NUM_TREES; i++ )
-	{
-		m_VoxelTrees[i].Init( this, i, worldmin, worldmax );
-	}
+	m_VoxelTrees[CLIENT_TREE].Init( this, CLIENT_TREE, worldmin, worldmax, ( nBVHTrees & SPATIAL_PARTITION_BVH_CLIENT ) != 0 );
+	m_VoxelTrees[SERVER_TREE].Init( this, SERVER_TREE, worldmin, worldmax, ( nBVHTrees & SPATIAL_PARTITION_BVH_SERVER ) != 0 );
 }
 
 //-----------------------------------------------------------------------------
@@ -2536,6 +2747,15 @@ void CSpatialPartition::InvokeQueryCallbacks( SpatialPartitionListMask_t listMas
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Brings lazily moved elements up to date.
+//-----------------------------------------------------------------------------
+void CSpatialPartition::UpdateLazyElements( SpatialPartitionListMask_t listMask )
+{
+	InvokeQueryCallbacks( listMask );
+	InvokeQueryCallbacks( listMask, true );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Create spatial partition object handle.
 //   Input: pHandleEntity - entity handle of the object to create a spatial partition handle for
@@ -2556,6 +2776,12 @@ SpatialPartitionHandle_t CSpatialPartition::CreateHandle( IHandleEntity *pHandle
 		m_aHandles[hPartition].m_nVisitBit[i] = 0xffff;
 		m_aHandles[hPartition].m_nLevel[i] = (uint8)-1;
 		m_aHandles[hPartition].m_iLeafList[i] = CLeafList::InvalidIndex();
+		m_aHandles[hPartition].m_nProxy[i] = CDynamicAABBTree::NULL_NODE;
+	}
+
+	if ( m_bRecording )
+	{
+		Record( SPR_CREATE_HANDLE, hPartition, 0 );
 	}
 	
 	return hPartition;
@@ -2568,8 +2794,15 @@ SpatialPartitionHandle_t CSpatialPartition::CreateHandle( IHandleEntity *pHandle
 //-----------------------------------------------------------------------------
 void CSpatialPartition::DestroyHandle( SpatialPartitionHandle_t hPartition )
 {
+	Assert( !EngineTrace_IsInReadOnlyTraces() );
+
 	if ( hPartition != PARTITION_INVALID_HANDLE )
 	{
+		if ( m_bRecording )
+		{
+			Record( SPR_DESTROY_HANDLE, hPartition, 0 );
+		}
+
 		RemoveFromTree( hPartition );
 		m_HandlesMutex.Lock();
 //		memset( &m_aHandles[hPartition], 0xcd, sizeof(EntityInfo_t) );
@@ -2595,6 +2828,11 @@ SpatialPartitionHandle_t CSpatialPartition::CreateHandle( IHandleEntity *pHandle
 	Insert( listMask, hPartition );
 	InsertIntoTree( hPartition, mins, maxs );
 
+	if ( m_bRecording )
+	{
+		Record( SPR_MOVE, hPartition, 0, mins, maxs );
+	}
+
 	return hPartition;
 }
 
@@ -2605,9 +2843,15 @@ SpatialPartitionHandle_t CSpatialPartition::CreateHandle( IHandleEntity *pHandle
 //-----------------------------------------------------------------------------
 void CSpatialPartition::Insert( SpatialPartitionListMask_t listId, SpatialPartitionHandle_t handle )
 {
+	Assert( !EngineTrace_IsInReadOnlyTraces() );
 	Assert( m_aHandles.IsValidIndex( handle ) );
 	Assert( listId <= USHRT_MAX );
 	m_aHandles[handle].m_fList |= listId;
+
+	if ( m_bRecording )
+	{
+		Record( SPR_SET_LISTS, handle, m_aHandles[handle].m_fList );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -2617,9 +2861,15 @@ void CSpatialPartition::Insert( SpatialPartitionListMask_t listId, SpatialPartit
 //-----------------------------------------------------------------------------
 void CSpatialPartition::Remove( SpatialPartitionListMask_t listId, SpatialPartitionHandle_t handle )
 {
+	Assert( !EngineTrace_IsInReadOnlyTraces() );
 	Assert( m_aHandles.IsValidIndex( handle ) );
 	Assert( listId <= USHRT_MAX );
 	m_aHandles[handle].m_fList &= ~listId;
+
+	if ( m_bRecording )
+	{
+		Record( SPR_SET_LISTS, handle, m_aHandles[handle].m_fList );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -2628,11 +2878,17 @@ void CSpatialPartition::Remove( SpatialPartitionListMask_t listId, SpatialPartit
 void CSpatialPartition::RemoveAndInsert( SpatialPartitionListMask_t removeMask, SpatialPartitionListMask_t insertMask, 
 											 SpatialPartitionHandle_t handle )
 {
+	Assert( !EngineTrace_IsInReadOnlyTraces() );
 	Assert( m_aHandles.IsValidIndex( handle ) );
 	Assert( removeMask <= USHRT_MAX );
 	Assert( insertMask <= USHRT_MAX );
 	m_aHandles[handle].m_fList &= ~removeMask;
 	m_aHandles[handle].m_fList |= insertMask;
+
+	if ( m_bRecording )
+	{
+		Record( SPR_SET_LISTS, handle, m_aHandles[handle].m_fList );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -2641,8 +2897,14 @@ void CSpatialPartition::RemoveAndInsert( SpatialPartitionListMask_t removeMask,
 //-----------------------------------------------------------------------------
 void CSpatialPartition::Remove( SpatialPartitionHandle_t handle )
 {
+	Assert( !EngineTrace_IsInReadOnlyTraces() );
 	Assert( m_aHandles.IsValidIndex( handle ) );
 	m_aHandles[handle].m_fList = 0;
+
+	if ( m_bRecording )
+	{
+		Record( SPR_SET_LISTS, handle, 0 );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -2651,11 +2913,17 @@ void CSpatialPartition::Remove( SpatialPartitionHandle_t handle )
 //-----------------------------------------------------------------------------
 void CSpatialPartition::UnhideElement( SpatialPartitionHandle_t handle, SpatialTempHandle_t tempHandle )
 {
+	Assert( !EngineTrace_IsInReadOnlyTraces() );
 	Assert( m_aHandles.IsValidIndex( handle ) );
 
 	m_HandlesMutex.Lock();
 	m_aHandles[handle].m_flags &= ~ENTITY_HIDDEN;
 	m_HandlesMutex.Unlock();
+
+	if ( m_bRecording )
+	{
+		Record( SPR_UNHIDE, handle, 0 );
+	}
 }
 
 
@@ -2665,11 +2933,17 @@ void CSpatialPartition::UnhideElement( SpatialPartitionHandle_t handle, SpatialT
 //-----------------------------------------------------------------------------
 SpatialTempHandle_t CSpatialPartition::HideElement( SpatialPartitionHandle_t handle )
 {
+	Assert( !EngineTrace_IsInReadOnlyTraces() );
 	Assert( m_aHandles.IsValidIndex( handle ) );
 	m_HandlesMutex.Lock();
 	m_aHandles[handle].m_flags |= ENTITY_HIDDEN;
 	m_HandlesMutex.Unlock();
 
+	if ( m_bRecording )
+	{
+		Record( SPR_HIDE, handle, 0 );
+	}
+
 	return 1;
 }
 
@@ -2704,9 +2978,15 @@ SpatialPartitionListMask_t CSpatialPartition::GetSuppressedLists( void )
 //-----------------------------------------------------------------------------
 void CSpatialPartition::ElementMoved( SpatialPartitionHandle_t handle, const Vector& mins, const Vector& maxs )
 {
+	Assert( !EngineTrace_IsInReadOnlyTraces() );
+
 	EntityInfo_t &entityInfo = EntityInfo( handle );
 	SpatialPartitionListMask_t listMask = entityInfo.m_fList;
 
+	if ( m_bRecording )
+	{
+		Record( SPR_MOVE, handle, 0, mins, maxs );
+	}
 
 	if ( CLIENT_TREE != SERVER_TREE )
 	{
@@ -2737,6 +3017,12 @@ void CSpatialPartition::EnumerateElementsInBox( SpatialPartitionListMask_t listM
 	MDLCACHE_CRITICAL_SECTION_(g_pMDLCache);
 	CVoxelTree *pTree = VoxelTree( listMask );
 	InvokeQueryCallbacks( listMask );
+
+	if ( m_bRecording )
+	{
+		Record( SPR_QUERY_BOX, PARTITION_INVALID_HANDLE, listMask, mins, maxs );
+	}
+
 	pTree->EnumerateElementsInBox( listMask, mins, maxs, coarseTest, pIterator );
 	InvokeQueryCallbacks( listMask, true );
 }
@@ -2749,6 +3035,12 @@ void CSpatialPartition::EnumerateElementsInSphere( SpatialPartitionListMask_t li
 	MDLCACHE_CRITICAL_SECTION_(g_pMDLCache);
 	CVoxelTree *pTree = VoxelTree( listMask );
 	InvokeQueryCallbacks( listMask );
+
+	if ( m_bRecording )
+	{
+		Record( SPR_QUERY_SPHERE, PARTITION_INVALID_HANDLE, listMask, origin, Vector( radius, 0, 0 ) );
+	}
+
 	pTree->EnumerateElementsInSphere( listMask, origin, radius, coarseTest, pIterator );
 	InvokeQueryCallbacks( listMask, true );
 }
@@ -2761,6 +3053,12 @@ void CSpatialPartition::EnumerateElementsAlongRay( SpatialPartitionListMask_t li
 	MDLCACHE_CRITICAL_SECTION_(g_pMDLCache);
 	CVoxelTree *pTree = VoxelTree( listMask );
 	InvokeQueryCallbacks( listMask );
+
+	if ( m_bRecording )
+	{
+		Record( SPR_QUERY_RAY, PARTITION_INVALID_HANDLE, listMask, ray.m_Start, ray.m_Delta, ray.m_Extents );
+	}
+
 	pTree->EnumerateElementsAlongRay( listMask, ray, coarseTest, pIterator );
 	InvokeQueryCallbacks( listMask, true );
 }
@@ -2773,6 +3071,12 @@ void CSpatialPartition::EnumerateElementsAtPoint( SpatialPartitionListMask_t lis
 	MDLCACHE_CRITICAL_SECTION_(g_pMDLCache);
 	CVoxelTree *pTree = VoxelTree( listMask );
 	InvokeQueryCallbacks( listMask );
+
+	if ( m_bRecording )
+	{
+		Record( SPR_QUERY_POINT, PARTITION_INVALID_HANDLE, listMask, pt );
+	}
+
 	pTree->EnumerateElementsAtPoint( listMask, pt, coarseTest, pIterator );
 	InvokeQueryCallbacks( listMask, true );
 }
@@ -2872,6 +3176,13 @@ void CSpatialPartition::RenderObjectsInPlayerLeafs( const Vector &vecPlayerMin,
 //-----------------------------------------------------------------------------
 void CVoxelTree::ReportStats( const char *pFileName )
 {
+	if ( m_bUseBVH )
+	{
+		Msg( "Dynamic AABB tree : %d entities, %zd nodes, height %d, area ratio %.2f\n",
+			m_BVH.ProxyCount(), m_BVH.NodeCount(), m_BVH.Height(), m_BVH.ComputeAreaRatio() );
+		return;
+	}
+
 	Msg( "Histogram : Entities per level\n" );
 	for ( int i = 0; i < m_nLevelCount; ++i )
 	{
@@ -2896,6 +3207,12 @@ void CVoxelTree::DrawDebugOverlays()
 	if ( nLevel < 0 )
 		return;
 
+	if ( m_bUseBVH )
+	{
+		RenderAllObjectsInTree( 0.01f );
+		return;
+	}
+
 	m_lock.LockForRead();
 	for ( int i = 0; i < m_nLevelCount; ++i )
 	{
@@ -2916,6 +3233,119 @@ void CSpatialPartition::DrawDebugOverlays()
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Recording
+//-----------------------------------------------------------------------------
+void CSpatialPartition::Record( SpatialPartitionRecordOp_t nOp, SpatialPartitionHandle_t hPartition, SpatialPartitionListMask_t listMask, 
+							   const Vector &vec0, const Vector &vec1, const Vector &vec2 )
+{
+	SpatialPartitionRecord_t record;
+	record.m_nOp = static_cast<uint8>( nOp );
+	record.m_nPad = 0;
+	record.m_hPartition = hPartition;
+	record.m_nListMask = listMask;
+	record.m_vec[0] = vec0;
+	record.m_vec[1] = vec1;
+	record.m_vec[2] = vec2;
+
+	AUTO_LOCK( m_RecordMutex );
+	if ( m_bRecording )
+	{
+		m_Records.AddToTail( record );
+	}
+}
+
+void CSpatialPartition::StartRecording()
+{
+	AUTO_LOCK( m_RecordMutex );
+	m_Records.RemoveAll();
+
+	// Handles which already exist are created at the start of the record.
+	for ( auto h = m_aHandles.Head(); h != m_aHandles.InvalidIndex(); h = m_aHandles.Next( h ) )
+	{
+		const EntityInfo_t &info = m_aHandles[h];
+
+		SpatialPartitionRecord_t record;
+		memset( &record, 0, sizeof( record ) );
+		record.m_hPartition = h;
+
+		record.m_nOp = SPR_CREATE_HANDLE;
+		m_Records.AddToTail( record );
+
+		record.m_nOp = SPR_SET_LISTS;
+		record.m_nListMask = info.m_fList;
+		m_Records.AddToTail( record );
+
+		if ( info.m_flags & ( IN_CLIENT_TREE | IN_SERVER_TREE ) )
+		{
+			// Tree bounds were bloated by an eps.
+			record.m_nOp = SPR_MOVE;
+			record.m_nListMask = 0;
+			record.m_vec[0].Init( info.m_vecMin.x + SPHASH_EPS, info.m_vecMin.y + SPHASH_EPS, info.m_vecMin.z + SPHASH_EPS );
+			record.m_vec[1].Init( info.m_vecMax.x - SPHASH_EPS, info.m_vecMax.y - SPHASH_EPS, info.m_vecMax.z - SPHASH_EPS );
+			m_Records.AddToTail( record );
+		}
+
+		if ( info.m_flags & ENTITY_HIDDEN )
+		{
+			record.m_nOp = SPR_HIDE;
+			m_Records.AddToTail( record );
+		}
+	}
+
+	m_bRecording = true;
+}
+
+bool CSpatialPartition::StopRecording( const char *pFileName )
+{
+	AUTO_LOCK( m_RecordMutex );
+	m_bRecording = false;
+
+	SpatialPartitionRecordHeader_t header;
+	header.m_nId = SPATIALPARTITION_RECORD_ID;
+	header.m_nVersion = SPATIALPARTITION_RECORD_VERSION;
+	header.m_nRecordCount = static_cast<int>( m_Records.Count() );
+
+	CUtlBuffer buf;
+	buf.Put( &header, sizeof( header ) );
+	buf.Put( m_Records.Base(), m_Records.Count() * sizeof( SpatialPartitionRecord_t ) );
+
+	bool bOk = g_pFileSystem->WriteFile( pFileName, "MOD", buf );
+	if ( bOk )
+	{
+		Msg( "Wrote %d spatial partition operations to %s.\n", header.m_nRecordCount, pFileName );
+	}
+	else
+	{
+		Warning( "Unable to write spatial partition record %s.\n", pFileName );
+	}
+
+	m_Records.Purge();
+	return bOk;
+}
+
+CON_COMMAND( spatialpartition_record, "Records spatial partition operations for spatialpartition_benchmark until spatialpartition_record_stop." )
+{
+	if ( g_SpatialPartition.IsRecording() )
+	{
+		Warning( "Already recording spatial partition operations.\n" );
+		return;
+	}
+
+	g_SpatialPartition.StartRecording();
+}
+
+CON_COMMAND( spatialpartition_record_stop, "Stops recording spatial partition operations and writes them into the file. Usage: spatialpartition_record_stop <file>" )
+{
+	if ( !g_SpatialPartition.IsRecording() )
+	{
+		Warning( "Not recording spatial partition operations.\n" );
+		return;
+	}
+
+	g_SpatialPartition.StopRecording( args.ArgC() < 2 ? "spatialpartition.rec" : args.Arg( 1 ) );
+}
+
 //=============================================================================
 ISpatialPartition *CreateSpatialPartition( const Vector& worldmin, const Vector& worldmax )
 {
@@ -2924,6 +3354,13 @@ ISpatialPartition *CreateSpatialPartition( const Vector& worldmin, const Vector&
 	return pResult;
 }
 
+ISpatialPartition *CreateSpatialPartition( const Vector& worldmin, const Vector& worldmax, int nBVHTrees )
+{
+	CSpatialPartition *pResult = new CSpatialPartition;
+	pResult->Init( worldmin, worldmax, nBVHTrees );
+	return pResult;
+}
+
 void DestroySpatialPartition( ISpatialPartition *pPartition )
 {
 	Assert( pPartition != (ISpatialPartition*)&g_SpatialPartition );
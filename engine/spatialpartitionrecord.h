@@ -0,0 +1,54 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: File format of recorded spatial partition operations, replayed by
+// the spatial partition benchmark.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef SPATIALPARTITIONRECORD_H
+#define SPATIALPARTITIONRECORD_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier0/commonmacros.h"
+#include "mathlib/vector.h"
+
+#define SPATIALPARTITION_RECORD_ID		MAKEID( 'S', 'P', 'R', 'C' )
+#define SPATIALPARTITION_RECORD_VERSION	1
+
+enum SpatialPartitionRecordOp_t
+{
+	SPR_CREATE_HANDLE = 0,
+	SPR_DESTROY_HANDLE,
+	SPR_SET_LISTS,			// m_nListMask is the new list mask of the handle
+	SPR_HIDE,
+	SPR_UNHIDE,
+	SPR_MOVE,				// m_vec[0], m_vec[1] - mins, maxs
+	SPR_QUERY_BOX,			// m_vec[0], m_vec[1] - mins, maxs
+	SPR_QUERY_SPHERE,		// m_vec[0] - origin, m_vec[1].x - radius
+	SPR_QUERY_RAY,			// m_vec[0], m_vec[1], m_vec[2] - start, delta, extents
+	SPR_QUERY_POINT,		// m_vec[0] - point
+
+	SPR_OP_COUNT
+};
+
+struct SpatialPartitionRecordHeader_t
+{
+	int		m_nId;
+	int		m_nVersion;
+	int		m_nRecordCount;
+};
+
+struct SpatialPartitionRecord_t
+{
+	uint8	m_nOp;
+	uint8	m_nPad;
+	uint16	m_hPartition;	// handle at record time, queries don't use it
+	uint32	m_nListMask;
+	Vector	m_vec[3];
+};
+
+
+#endif // SPATIALPARTITIONRECORD_H
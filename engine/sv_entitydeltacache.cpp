@@ -0,0 +1,164 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Per tick cache of encoded entity deltas shared by all clients.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "server_pch.h"
+#include "sv_entitydeltacache.h"
+#include "packed_entity.h"
+#include "dt_send.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+static ConVar sv_deltacache( "sv_deltacache", "256", 0, "Size in KB of the per tick cache of entity deltas shared by clients, 0 disables it.", true, 0, true, 65536 );
+
+CEntityDeltaCache g_EntityDeltaCache;
+
+
+CEntityDeltaCache::CEntityDeltaCache()
+{
+	m_nTickCount = -1;
+	m_nShardCapacity = 0;
+
+	for ( auto &head : m_nHeads )
+	{
+		head = -1;
+	}
+}
+
+CEntityDeltaCache::~CEntityDeltaCache()
+{
+	for ( auto &shard : m_Shards )
+	{
+		shard.m_Entries.Purge();
+		shard.m_Data.Purge();
+	}
+}
+
+void CEntityDeltaCache::Flush()
+{
+	for ( auto &shard : m_Shards )
+	{
+		AUTO_LOCK( shard.m_Mutex );
+
+		// keep memory, cache is refilled next tick
+		shard.m_Entries.RemoveAll();
+		shard.m_Data.RemoveAll();
+	}
+
+	for ( auto &head : m_nHeads )
+	{
+		head = -1;
+	}
+}
+
+void CEntityDeltaCache::BeginSnapshot( int nTickCount )
+{
+	Flush();
+
+	m_nTickCount = nTickCount;
+	m_nShardCapacity = ( sv_deltacache.GetInt() * 1024 ) / NUM_SHARDS;
+
+	if ( m_nShardCapacity > 0 )
+	{
+		for ( auto &shard : m_Shards )
+		{
+			shard.m_Data.EnsureCapacity( m_nShardCapacity );
+		}
+	}
+}
+
+bool CEntityDeltaCache::BuildCullMask( const PackedEntity *pFrom, const PackedEntity *pTo, int iClient, uint64 &nMask )
+{
+	const int nFromProxies = pFrom->GetNumRecipients();
+	const int nToProxies = pTo->GetNumRecipients();
+
+	if ( nFromProxies > MAX_CULL_PROXIES || nToProxies > MAX_CULL_PROXIES )
+		return false;
+
+	const CSendProxyRecipients *pFromRecipients = pFrom->GetRecipients();
+	const CSendProxyRecipients *pToRecipients = pTo->GetRecipients();
+
+	nMask = 0;
+
+	for ( int i = 0; i < nToProxies; i++ )
+	{
+		if ( pToRecipients[i].m_Bits.IsBitSet( iClient ) )
+			nMask |= 1ULL << i;
+	}
+
+	for ( int i = 0; i < nFromProxies; i++ )
+	{
+		if ( pFromRecipients[i].m_Bits.IsBitSet( iClient ) )
+			nMask |= 1ULL << ( i + MAX_CULL_PROXIES );
+	}
+
+	return true;
+}
+
+const byte* CEntityDeltaCache::FindDeltaBits( int nEntityIndex, const EntityDeltaKey_t &key, int &nBits )
+{
+	nBits = -1;
+
+	if ( nEntityIndex < 0 || nEntityIndex >= MAX_EDICTS || m_nShardCapacity <= 0 )
+		return NULL;
+
+	Shard_t &shard = GetShard( nEntityIndex );
+
+	AUTO_LOCK( shard.m_Mutex );
+
+	for ( int i = m_nHeads[nEntityIndex]; i != -1; i = shard.m_Entries[i].m_nNext )
+	{
+		const DeltaEntry_t &entry = shard.m_Entries[i];
+
+		if ( entry.m_Key.m_pToPack != key.m_pToPack ||
+			 entry.m_Key.m_pFromPack != key.m_pFromPack ||
+			 entry.m_Key.m_nDeltaTick != key.m_nDeltaTick ||
+			 entry.m_Key.m_nCullMask != key.m_nCullMask )
+			continue;
+
+		nBits = entry.m_nBits;
+
+		// shard data never grows past capacity reserved in BeginSnapshot, so pointer stays valid this tick
+		return shard.m_Data.Base() + entry.m_nDataOffset;
+	}
+
+	return NULL;
+}
+
+void CEntityDeltaCache::AddDeltaBits( int nEntityIndex, const EntityDeltaKey_t &key, int nBits, const bf_write *pBufStart )
+{
+	if ( nEntityIndex < 0 || nEntityIndex >= MAX_EDICTS || m_nShardCapacity <= 0 )
+		return;
+
+	const int nBufferSize = PAD_NUMBER( Bits2Bytes( nBits ), 4 );
+
+	Shard_t &shard = GetShard( nEntityIndex );
+
+	AUTO_LOCK( shard.m_Mutex );
+
+	if ( shard.m_Data.Count() + nBufferSize > m_nShardCapacity )
+		return;	// data wouldn't fit into cache anymore, don't add new entries
+
+	DeltaEntry_t &entry = shard.m_Entries[ shard.m_Entries.AddToTail() ];
+	entry.m_Key = key;
+	entry.m_nBits = nBits;
+	entry.m_nDataOffset = static_cast<int>( shard.m_Data.Count() );
+	entry.m_nNext = m_nHeads[nEntityIndex];
+
+	m_nHeads[nEntityIndex] = static_cast<int>( shard.m_Entries.Count() - 1 );
+
+	if ( nBits > 0 )
+	{
+		shard.m_Data.AddMultipleToTail( nBufferSize );
+
+		bf_read inBuffer;
+		inBuffer.StartReading( pBufStart->GetData(), pBufStart->m_nDataBytes, pBufStart->GetNumBitsWritten() );
+
+		bf_write outBuffer( shard.m_Data.Base() + entry.m_nDataOffset, nBufferSize );
+		outBuffer.WriteBitsFromBuffer( &inBuffer, nBits );
+	}
+}
@@ -0,0 +1,98 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Per tick cache of encoded entity deltas shared by all clients.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef SV_ENTITYDELTACACHE_H
+#define SV_ENTITYDELTACACHE_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier0/threadtools.h"
+#include "tier1/utlvector.h"
+#include "const.h"
+
+class bf_write;
+class PackedEntity;
+
+
+// Identifies an encoded delta. Same packs delta'd from the same tick produce the same
+// bits unless send proxies culled different props, so culling result is a part of key.
+struct EntityDeltaKey_t
+{
+	const PackedEntity	*m_pFromPack;
+	const PackedEntity	*m_pToPack;
+	int					m_nDeltaTick;
+	uint64				m_nCullMask;	// client bit of each old (high) / new (low) state proxy
+};
+
+
+//-----------------------------------------------------------------------------
+// Game server counterpart of the HLTV CDeltaEntityCache. Clients which receive
+// the same entity delta from the same tick share its encoded bit stream, so
+// SendTable_WritePropList runs once per tick instead of once per client.
+//
+// Safe to use from parallel snapshot send jobs, entries are sharded by entity
+// index. BeginSnapshot must be called from the main thread before sending a new
+// snapshot, packs may be reallocated at same addresses once snapshot is gone.
+//-----------------------------------------------------------------------------
+class CEntityDeltaCache
+{
+public:
+	CEntityDeltaCache();
+	~CEntityDeltaCache();
+
+	// Drops all entries of the previous snapshot.
+	void BeginSnapshot( int nTickCount );
+	void Flush();
+
+	// Deltas are shared only while writing the snapshot of this tick.
+	bool IsEnabled( int nTickCount ) const { return m_nShardCapacity > 0 && m_nTickCount == nTickCount; }
+
+	// Builds the culling mask of key, false if entity has too many proxies to cache.
+	static bool BuildCullMask( const PackedEntity *pFrom, const PackedEntity *pTo, int iClient, uint64 &nMask );
+
+	// Returns cached delta bits valid until next BeginSnapshot, NULL if not cached.
+	// nBits is 0 if entity did not change.
+	const byte* FindDeltaBits( int nEntityIndex, const EntityDeltaKey_t &key, int &nBits );
+
+	// Caches nBits written after pBufStart state, 0 if entity did not change.
+	void AddDeltaBits( int nEntityIndex, const EntityDeltaKey_t &key, int nBits, const bf_write *pBufStart );
+
+private:
+	enum
+	{
+		NUM_SHARDS = 64,	// must be power of 2
+		MAX_CULL_PROXIES = 32
+	};
+
+	struct DeltaEntry_t
+	{
+		EntityDeltaKey_t	m_Key;
+		int					m_nBits;
+		int					m_nDataOffset;	// into shard data
+		int					m_nNext;		// next entry of same entity, -1 if last
+	};
+
+	struct alignas(64) Shard_t
+	{
+		CThreadFastMutex			m_Mutex;
+		CUtlVector<DeltaEntry_t>	m_Entries;
+		CUtlVector<byte>			m_Data;
+	};
+
+	Shard_t &GetShard( int nEntityIndex ) { return m_Shards[nEntityIndex & (NUM_SHARDS - 1)]; }
+
+	int		m_nTickCount;	// tick of snapshot being sent
+	int		m_nShardCapacity;	// max data bytes per shard
+	int		m_nHeads[MAX_EDICTS];	// first entry of entity, guarded by entity shard
+	Shard_t	m_Shards[NUM_SHARDS];
+};
+
+extern CEntityDeltaCache g_EntityDeltaCache;
+
+
+#endif // SV_ENTITYDELTACACHE_H
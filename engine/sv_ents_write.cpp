@@ -21,6 +21,7 @@
 #include "replayserver.h"
 #include "tier0/vcrmode.h"
 #include "framesnapshot.h"
+#include "sv_entitydeltacache.h"
 
 
 // memdbgon must be the last include file in a .cpp file!!!
@@ -77,6 +78,9 @@ public:
 
 	int				m_nFullProps;	// number of properties send as full update (Enter PVS)
 	bool			m_bCullProps;	// filter props by clients in recipient lists
+	bool			m_bUseDeltaCache;	// share encoded deltas with other clients via g_EntityDeltaCache
+	bool			m_bHasDeltaKey;	// m_DeltaKey is valid for current entity
+	EntityDeltaKey_t	m_DeltaKey;
 	
 	/* Some profiling data
 	int				m_nTotalGap;
@@ -303,6 +307,11 @@ static inline void SV_WritePropsFromPackedEntity(
 		pSendProps, 
 		ARRAYSIZE( pSendProps )
 		);
+
+		if ( u.m_bHasDeltaKey )
+		{
+			bufStart = *u.m_pBuf;
+		}
 	}
 	else
 	{
@@ -327,6 +336,12 @@ static inline void SV_WritePropsFromPackedEntity(
 		int nBits = u.m_pBuf->GetNumBitsWritten() - bufStart.GetNumBitsWritten();
 		hltv->m_DeltaCache.AddDeltaBits( pTo->m_nEntityIndex, u.m_pFromSnapshot->m_nTickCount, nBits, &bufStart );
 	}
+	else if ( u.m_bHasDeltaKey && !u.m_pBuf->IsOverflowed() )
+	{
+		// share delta bits with other clients getting the same props
+		int nBits = u.m_pBuf->GetNumBitsWritten() - bufStart.GetNumBitsWritten();
+		g_EntityDeltaCache.AddDeltaBits( pTo->m_nEntityIndex, u.m_DeltaKey, nBits, &bufStart );
+	}
 }
 
 
@@ -364,7 +379,7 @@ static bool SV_NeedsExplicitCreate( CEntityWriteInfo &u )
 	{
 		// If it doesn't need explicit create, then the classnames should match.
 		// This assert is analagous to the "Server / Client mismatch" one on the client.
-		static int nWhines = 0;
+		static thread_local int nWhines = 0;
 		if ( pFromEnt->m_pClass->GetName() != pToEnt->m_pClass->GetName() )
 		{
 			if ( ++nWhines < 4 )
@@ -454,6 +469,40 @@ static inline void SV_DetermineUpdateType( CEntityWriteInfo &u )
 	}
 #endif
 
+	u.m_bHasDeltaKey = u.m_bUseDeltaCache &&
+		CEntityDeltaCache::BuildCullMask( u.m_pOldPack, u.m_pNewPack, u.m_nClientEntity-1, u.m_DeltaKey.m_nCullMask );
+
+	if ( u.m_bHasDeltaKey )
+	{
+		u.m_DeltaKey.m_pFromPack = u.m_pOldPack;
+		u.m_DeltaKey.m_pToPack = u.m_pNewPack;
+		u.m_DeltaKey.m_nDeltaTick = u.m_pFromSnapshot->m_nTickCount;
+
+		int nCachedBits;
+		const byte *pBuffer = g_EntityDeltaCache.FindDeltaBits( u.m_nNewEntity, u.m_DeltaKey, nCachedBits );
+
+		ServerDTI_AddDeltaCacheEvent( u.m_pNewPack->m_pServerClass->m_pTable, pBuffer != NULL );
+
+		if ( pBuffer )
+		{
+			if ( nCachedBits > 0 )
+			{
+				SV_WriteDeltaHeader( u, u.m_nNewEntity, FHDR_ZERO );
+
+				// other client got the same delta this tick
+				u.m_pBuf->WriteBits( pBuffer, nCachedBits );
+
+				u.m_UpdateType = DeltaEnt;
+			}
+			else
+			{
+				u.m_UpdateType = PreserveEnt;
+			}
+
+			return;
+		}
+	}
+
 	int checkProps[MAX_DATATABLE_PROPS];
 	int nCheckProps = u.m_pNewPack->GetPropsChangedAfterTick( u.m_pFromSnapshot->m_nTickCount, checkProps, ARRAYSIZE( checkProps ) );
 	
@@ -540,6 +589,11 @@ static inline void SV_DetermineUpdateType( CEntityWriteInfo &u )
 #endif
 		}
 #endif
+		if ( u.m_bHasDeltaKey )
+		{
+			// no bits changed, PreserveEnt
+			g_EntityDeltaCache.AddDeltaBits( u.m_nNewEntity, u.m_DeltaKey, 0, NULL );
+		}
 		u.m_UpdateType = PreserveEnt;
 	}
 }
@@ -803,6 +857,10 @@ void CBaseServer::WriteDeltaEntities( CBaseClient *client, CClientFrame *to, CCl
 	{
 		u.m_bCullProps = true;	// always cull props for players
 	}
+
+	// game server clients share encoded deltas, HLTV and replay have own caches
+	u.m_bUseDeltaCache = u.m_bCullProps && !IsHLTV() && !IsReplay() && g_EntityDeltaCache.IsEnabled( u.m_pToSnapshot->m_nTickCount );
+	u.m_bHasDeltaKey = false;
 	
 	if ( from != NULL )
 	{
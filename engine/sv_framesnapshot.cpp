@@ -35,6 +35,7 @@ CFrameSnapshotManager::CFrameSnapshotManager( void )
 {
 	COMPILE_TIME_ASSERT( INVALID_PACKED_ENTITY_HANDLE == 0 );
 	m_nPackedEntityCacheCounter = 0;
+	m_bDeferDeletes = false;
 	V_memset( m_pPackedData, 0x00, sizeof(m_pPackedData) );
 	V_memset( m_pSerialNumber, 0x00, sizeof(m_pSerialNumber) );
 }
@@ -70,6 +71,8 @@ CFrameSnapshot*	CFrameSnapshotManager::NextSnapshot( const CFrameSnapshot *pSnap
 	if ( !pSnapshot || (pSnapshot->m_ListIndex == m_FrameSnapshots.InvalidIndex()) )
 		return NULL;
 
+	AUTO_LOCK( m_SnapshotsMutex );
+
 	auto next = m_FrameSnapshots.Next(pSnapshot->m_ListIndex);
 
 	if ( next == m_FrameSnapshots.InvalidIndex() )
@@ -102,7 +105,10 @@ CFrameSnapshot*	CFrameSnapshotManager::CreateEmptySnapshot( int tickcount, int m
 		entry++;
 	}
 
-	snap->m_ListIndex = m_FrameSnapshots.AddToTail( snap );
+	{
+		AUTO_LOCK( m_SnapshotsMutex );
+		snap->m_ListIndex = m_FrameSnapshots.AddToTail( snap );
+	}
 	return snap;
 }
 
@@ -182,6 +188,22 @@ CFrameSnapshot* CFrameSnapshotManager::TakeTickSnapshot( int tickcount )
 //-----------------------------------------------------------------------------
 
 void CFrameSnapshotManager::DeleteFrameSnapshot( CFrameSnapshot* pSnapshot )
+{
+	{
+		AUTO_LOCK( m_SnapshotsMutex );
+
+		if ( m_bDeferDeletes )
+		{
+			// Some send job may still iterate over this snapshot, free it later
+			m_DeferredDeletes.AddToTail( pSnapshot );
+			return;
+		}
+	}
+
+	FreeFrameSnapshot( pSnapshot );
+}
+
+void CFrameSnapshotManager::FreeFrameSnapshot( CFrameSnapshot* pSnapshot )
 {
 	// Decrement reference counts of all packed entities
 	for (int i = 0; i < pSnapshot->m_nNumEntities; ++i)
@@ -192,10 +214,40 @@ void CFrameSnapshotManager::DeleteFrameSnapshot( CFrameSnapshot* pSnapshot )
 		}
 	}
 
-	m_FrameSnapshots.Remove( pSnapshot->m_ListIndex );
+	{
+		AUTO_LOCK( m_SnapshotsMutex );
+		m_FrameSnapshots.Remove( pSnapshot->m_ListIndex );
+	}
+
 	delete pSnapshot;
 }
 
+void CFrameSnapshotManager::BeginParallelSend()
+{
+	AUTO_LOCK( m_SnapshotsMutex );
+
+	Assert( !m_bDeferDeletes );
+	m_bDeferDeletes = true;
+}
+
+void CFrameSnapshotManager::EndParallelSend()
+{
+	CUtlVector<CFrameSnapshot*> deferredDeletes;
+
+	{
+		AUTO_LOCK( m_SnapshotsMutex );
+
+		Assert( m_bDeferDeletes );
+		m_bDeferDeletes = false;
+		deferredDeletes.Swap( m_DeferredDeletes );
+	}
+
+	FOR_EACH_VEC( deferredDeletes, i )
+	{
+		FreeFrameSnapshot( deferredDeletes[i] );
+	}
+}
+
 void CFrameSnapshotManager::RemoveEntityReference( PackedEntityHandle_t handle )
 {
 	Assert( handle != INVALID_PACKED_ENTITY_HANDLE );
@@ -489,8 +541,9 @@ void CFrameSnapshot::ReleaseReference()
 {
 	Assert( m_nReferences > 0 );
 
-	--m_nReferences;
-	if ( m_nReferences == 0 )
+	// Decrement and test must be a single interlocked op, otherwise two
+	// threads releasing concurrently can both observe zero.
+	if ( --m_nReferences == 0 )
 	{
 		g_FrameSnapshotManager.DeleteFrameSnapshot( this );
 	}
@@ -33,6 +33,7 @@
 #include "networkstringtable.h"
 #include "dt_send_eng.h"
 #include "sv_packedentities.h"
+#include "sv_entitydeltacache.h"
 #include "testscriptmgr.h"
 #include "PlayerState.h"
 #include "saverestoretypes.h"
@@ -768,13 +769,32 @@ int SV_BuildSendTablesArray( ServerClass *pClasses, SendTable **pTables, int nMa
 }
 
 
+// Send proxies the game DLL's tables are encoded with, patched up for older game DLLs.
+const CStandardSendProxies *SV_GetStandardSendProxies()
+{
+	// If the game server is greater than v4, then it is using the new proxy format.
+	if ( g_iServerGameDLLVersion >= 5 ) // check server version
+		return serverGameDLL->GetStandardSendProxies();
+
+	// If the game server is older than v4, it is using the old proxy; we set the new proxy members to the 
+	// engine's copy.
+	static CStandardSendProxies compatSendProxy = *serverGameDLL->GetStandardSendProxies();
+
+	compatSendProxy.m_DataTableToDataTable = g_StandardSendProxies.m_DataTableToDataTable;
+	compatSendProxy.m_SendLocalDataTable = g_StandardSendProxies.m_SendLocalDataTable;
+	compatSendProxy.m_ppNonModifiedPointerProxies = g_StandardSendProxies.m_ppNonModifiedPointerProxies;
+
+	return &compatSendProxy;
+}
+
+
 // Builds an alternate copy of the datatable for any classes that have datatables with props excluded.
 void SV_InitSendTables( ServerClass *pClasses )
 {
 	SendTable *pTables[MAX_DATATABLES];
 	int nTables = SV_BuildSendTablesArray( pClasses, pTables, ARRAYSIZE( pTables ) );
 
-	SendTable_Init( pTables, nTables );
+	SendTable_Init( pTables, nTables, SV_GetStandardSendProxies() );
 }
 
 
@@ -1779,16 +1799,16 @@ void CGameServer::CopyTempEntities( CFrameSnapshot* pSnapshot )
 	}
 }
 
-// If enabled, random crashes start to appear in WriteTempEntities, etc. It looks like
-// one thread can be in WriteDeltaEntities while another is in WriteTempEntities, and both are
-// partying on g_FrameSnapshotManager.m_FrameSnapshots. Bruce sent e-mail from a customer
-// that stated these crashes don't occur when parallel_sendsnapshot is disabled. Zoid said:
-//
-//   Easiest is just turn off parallel snapshots, it's not much of a win on servers where we
-//   are running many instances anyway. It's off in Dota and CSGO dedicated servers.
+// Historically random crashes appeared in WriteTempEntities when this was on: one send job
+// walked g_FrameSnapshotManager.m_FrameSnapshots while another released the last reference
+// to a snapshot and deleted it. Snapshots released during the parallel send are now deleted
+// after all jobs finish, see CFrameSnapshotManager::BeginParallelSend, and packed entity
+// reference counts are interlocked. Each client writes into its own scratch buffer.
 //
-// Bruce also had a patch to disable this in //ValveGames/staging/game/tf/cfg/unencrypted/print_instance_config.py
-static ConVar sv_parallel_sendsnapshot( "sv_parallel_sendsnapshot", "0" );
+// sv_parallel_sendsnapshot_stress only exercises snapshot reference handling, not the real
+// SendSnapshot / WriteDeltaEntities / CNetChan::Transmit path, so this stays an opt-in
+// experiment until that path has been run with several clients.
+static ConVar sv_parallel_sendsnapshot( "sv_parallel_sendsnapshot", "0", 0, "Experimental: send client snapshots in parallel using the thread pool." );
 
 static void SV_ParallelSendSnapshot( CGameClient *& pClient )
 {
@@ -1866,12 +1886,20 @@ void CGameServer::SendClientMessages ( bool bSendSnapshots )
 		// Compute the client packs
 		SV_ComputeClientPacks( receivingClientCount, pReceivingClients, pSnapshot );
 
+		// Entity deltas encoded for one client are reused for others this snapshot
+		g_EntityDeltaCache.BeginSnapshot( pSnapshot->m_nTickCount );
+
+		// Snapshot datagrams of all clients are flushed with one batched send
+		NET_BeginBatchedSend( m_Socket );
+
 		if ( receivingClientCount > 1 && sv_parallel_sendsnapshot.GetBool() )
 		{
 			// SV_ParallelSendSnapshot will not process HLTV or Replay clients as they
 			// must be run on the main thread due to un-threadsafe global state access.
 			// It will replace anything that it does process with a NULL pointer.
+			framesnapshotmanager->BeginParallelSend();
 			ParallelProcess( "SV_ParallelSendSnapshot", pReceivingClients, receivingClientCount, &SV_ParallelSendSnapshot );
+			framesnapshotmanager->EndParallelSend();
 		}
 		
 		for (int i = 0; i < receivingClientCount; ++i)
@@ -1885,6 +1913,8 @@ void CGameServer::SendClientMessages ( bool bSendSnapshots )
 			pClient->SendSnapshot( pFrame );
 			pClient->UpdateSendState();
 		}
+
+		NET_FlushBatchedSend();
 	
 		pSnapshot->ReleaseReference();
 	}
@@ -2288,6 +2318,7 @@ static void SV_AllocateEdicts()
 	ED_ClearFreeEdictList();
 
 	sv.edictchangeinfo = Hunk_AllocName<IChangeInfoAccessor>( sv.max_edicts, "edictchangeinfo" );
+	sv.edictdirtyprops = Hunk_AllocName<CSendPropBits>( sv.max_edicts, "edictdirtyprops" );
 }
 
 #include "tier0/memdbgon.h"
@@ -88,12 +88,16 @@ void SV_RedirectEnd( void );
 class ServerClass;
 class IClient;
 class CClientFrame;
+class CStandardSendProxies;
 
 
 // Builds an alternate copy of the datatable for any classes that have datatables with props excluded.
 void SV_InitSendTables( ServerClass *pClasses );
 void SV_TermSendTables( ServerClass *pClasses );
 
+// The game DLL's standard send proxies, with the engine's datatable proxies filled in for old DLLs.
+const CStandardSendProxies *SV_GetStandardSendProxies();
+
 // send voice data from cl to other clients
 void SV_BroadcastVoiceData(IClient * cl, int nBytes, char * data, int64 xuid);
 void SV_SendRestoreMsg( bf_write &dest );
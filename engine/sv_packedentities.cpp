@@ -42,6 +42,8 @@ IClientEntityList *entitylist = NULL;
 #include "tier0/memdbgon.h"
 
 ConVar sv_debugmanualmode( "sv_debugmanualmode", "0", 0, "Make sure entities correctly report whether or not their network data has changed." );
+static ConVar sv_partialrepack( "sv_partialrepack", "0", 0, "Re-encode only the props entities report changes to, and copy the rest from their previous packet." );
+static ConVar sv_partialrepack_verify( "sv_partialrepack_verify", "0", 0, "Also fully encode entities packed with sv_partialrepack and report props that changed without their offset being reported." );
 
 // This function makes sure that this entity class has an instance baseline.
 // If it doesn't have one yet, it makes a new one.
@@ -88,6 +90,105 @@ void SV_EnsureInstanceBaseline( ServerClass *pServerClass, int iEdict, const voi
 	ThreadMemoryBarrier();
 }
 
+//-----------------------------------------------------------------------------
+// Dirty props. Edicts remember the offsets they change in the shared change infos,
+// which only hold a few per frame. The rest, and the changes of edicts that weren't
+// packed this frame, are kept as the edict's dirty props until it's packed again.
+//-----------------------------------------------------------------------------
+
+SendTable* GetEntSendTable( edict_t *pEdict );
+
+void SV_EdictStateChangedOverflow( edict_t *pEdict, unsigned short offset )
+{
+	if ( pEdict->m_fStateFlags & FL_FULL_EDICT_CHANGED )
+		return;
+
+	SendTable *pSendTable = GetEntSendTable( pEdict );
+	if ( !pSendTable || !pSendTable->m_pPrecalc )
+	{
+		pEdict->StateChanged();
+		return;
+	}
+
+	SendTable_MarkPropOffsetDirty( pSendTable, offset, &sv.edictdirtyprops[ NUM_FOR_EDICT( pEdict ) ] );
+}
+
+static void SV_AccumulateEdictChangeInfo( int iEdict, edict_t *pEdict, const SendTable *pSendTable )
+{
+	if ( pEdict->GetChangeInfoSerialNumber() != g_pSharedChangeInfo->m_iSerialNumber )
+		return;
+
+	const CEdictChangeInfo *pCI = &g_pSharedChangeInfo->m_ChangeInfos[ pEdict->GetChangeInfo() ];
+	for ( unsigned short i=0; i < pCI->m_nChangeOffsets; i++ )
+	{
+		SendTable_MarkPropOffsetDirty( pSendTable, pCI->m_ChangeOffsets[i], &sv.edictdirtyprops[iEdict] );
+	}
+}
+
+// Call before InvalidateSharedEdictChangeInfos, so edicts that weren't packed keep their changes.
+static void SV_AccumulateEdictChangeInfos()
+{
+	for ( int i=0; i < sv.num_edicts; i++ )
+	{
+		edict_t *pEdict = &sv.edicts[i];
+		if ( ( pEdict->m_fStateFlags & ( FL_EDICT_CHANGED | FL_FULL_EDICT_CHANGED ) ) != FL_EDICT_CHANGED )
+			continue;
+
+		SendTable *pSendTable = GetEntSendTable( pEdict );
+		if ( pSendTable && pSendTable->m_pPrecalc )
+		{
+			SV_AccumulateEdictChangeInfo( i, pEdict, pSendTable );
+		}
+	}
+}
+
+static inline void SV_ClearStateChanged( int iEdict, edict_t *pEdict, int nFlatProps )
+{
+	pEdict->ClearStateChanged();
+
+	// Only the table's props can have been marked.
+	memset( sv.edictdirtyprops[iEdict].Base(), 0, ( ( nFlatProps + 31 ) >> 5 ) * sizeof( uint32 ) );
+}
+
+// The dirty props of an edict are complete unless it reported a change it couldn't give an offset for.
+static inline bool SV_CanRepackDirtyProps( const edict_t *pEdict, const PackedEntity *pPrevFrame, const ServerClass *pServerClass )
+{
+	return sv_partialrepack.GetBool() &&
+		!sv_debugmanualmode.GetInt() &&
+		pEdict->HasStateChanged() &&
+		!( pEdict->m_fStateFlags & FL_FULL_EDICT_CHANGED ) &&
+		pPrevFrame->m_pServerClass == pServerClass;
+}
+
+// Encodes the whole entity again and complains about props the partial encoding got wrong.
+static void SV_VerifyDirtyRepack( int edictIdx, edict_t *edict, SendTable *pSendTable, const void *pDirtyData, int nDirtyBits )
+{
+	ALIGN4 char packedData[MAX_PACKEDENTITY_DATA] ALIGN4_POST;
+	bf_write writeBuf( "SV_VerifyDirtyRepack->writeBuf", packedData, sizeof( packedData ) );
+
+	if ( !SendTable_Encode( pSendTable, edict->GetUnknown(), &writeBuf, edictIdx, NULL, false ) )
+		return;
+
+	int deltaProps[MAX_DATATABLE_PROPS];
+	int nChanges = SendTable_CalcDelta(
+		pSendTable,
+		pDirtyData, nDirtyBits,
+		packedData, writeBuf.GetNumBitsWritten(),
+		deltaProps,
+		ARRAYSIZE( deltaProps ),
+		edictIdx
+		);
+
+	for ( int iDeltaProp=0; iDeltaProp < nChanges; iDeltaProp++ )
+	{
+		const SendProp *pProp = pSendTable->m_pPrecalc->GetProp( deltaProps[iDeltaProp] );
+		Warning( "Entity %d (class '%s') changed '%s' without reporting its offset.\n", 
+			edictIdx,
+			edict->GetClassName(),
+			pProp->GetName() );
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Pack the entity....
 //-----------------------------------------------------------------------------
@@ -114,27 +215,66 @@ static inline void SV_PackEntity(
 		bUsedPrev = framesnapshotmanager->UsePreviouslySentPacket( pSnapshot, edictIdx, iSerialNum );
 	}
 		
+	SendTable *pSendTable = pServerClass->m_pTable;
+	int nFlatProps = SendTable_GetNumFlatProps( pSendTable );
+
 	if ( bUsedPrev && !sv_debugmanualmode.GetInt() )
 	{
-		edict->ClearStateChanged();
+		SV_ClearStateChanged( edictIdx, edict, nFlatProps );
 		return;
 	}
 	
+	// If this entity was previously in there, then it should have a valid IChangeFrameList 
+	// which we can delta against to figure out which properties have changed.
+	//
+	// If not, then we want to setup a new IChangeFrameList.
+
+	PackedEntity *pPrevFrame = framesnapshotmanager->GetPreviouslySentPacket( edictIdx, pSnapshot->m_pEntities[ edictIdx ].m_nSerialNumber );
+
 	// First encode the entity's data.
 	ALIGN4 char packedData[MAX_PACKEDENTITY_DATA] ALIGN4_POST;
 	bf_write writeBuf( "SV_PackEntity->writeBuf", packedData, sizeof( packedData ) );
 
-	SendTable *pSendTable = pServerClass->m_pTable;
-	
 	// (avoid constructor overhead).
 	unsigned char tempData[ sizeof( CSendProxyRecipients ) * MAX_DATATABLE_PROXIES ];
 	CUtlMemory< CSendProxyRecipients > recip( (CSendProxyRecipients*)tempData, pSendTable->m_pPrecalc->GetNumDataTableProxies() );
 
-	if( !SendTable_Encode( pSendTable, edict->GetUnknown(), &writeBuf, edictIdx, &recip, false ) )
+	int deltaProps[MAX_DATATABLE_PROPS];
+	int nChanges = 0;
+
+	// If we know what changed since the previous packet, only encode that and copy the rest.
+	bool bPartial = pPrevFrame && SV_CanRepackDirtyProps( edict, pPrevFrame, pServerClass );
+	if ( bPartial )
+	{
+		SV_AccumulateEdictChangeInfo( edictIdx, edict, pSendTable );
+
+		if ( !SendTable_EncodeDirty( 
+			pSendTable, 
+			edict->GetUnknown(), 
+			&sv.edictdirtyprops[edictIdx], 
+			pPrevFrame->GetData(), pPrevFrame->GetNumBits(), 
+			&writeBuf, 
+			deltaProps, 
+			ARRAYSIZE( deltaProps ), 
+			&nChanges, 
+			edictIdx, 
+			&recip ) )
+		{
+			Host_Error( "SV_PackEntity: SendTable_EncodeDirty returned false (ent %d).\n", edictIdx );
+		}
+
+		if ( sv_partialrepack_verify.GetBool() )
+		{
+			SV_VerifyDirtyRepack( edictIdx, edict, pSendTable, packedData, writeBuf.GetNumBitsWritten() );
+		}
+	}
+	else if( !SendTable_Encode( pSendTable, edict->GetUnknown(), &writeBuf, edictIdx, &recip, false ) )
 	{							 
 		Host_Error( "SV_PackEntity: SendTable_Encode returned false (ent %d).\n", edictIdx );
 	}
 
+	ServerDTI_AddEntityRepackEvent( pSendTable, bPartial );
+
 #ifndef NO_VCR
 	// VCR mode stuff..
 	if ( vcr_verbose.GetInt() && writeBuf.GetNumBytesWritten() > 0 )
@@ -143,32 +283,26 @@ static inline void SV_PackEntity(
 
 	SV_EnsureInstanceBaseline( pServerClass, edictIdx, packedData, writeBuf.GetNumBytesWritten() );
 		
-	int nFlatProps = SendTable_GetNumFlatProps( pSendTable );
 	IChangeFrameList *pChangeFrame = NULL;
 
-	// If this entity was previously in there, then it should have a valid IChangeFrameList 
-	// which we can delta against to figure out which properties have changed.
-	//
-	// If not, then we want to setup a new IChangeFrameList.
-
-	PackedEntity *pPrevFrame = framesnapshotmanager->GetPreviouslySentPacket( edictIdx, pSnapshot->m_pEntities[ edictIdx ].m_nSerialNumber );
 	if ( pPrevFrame )
 	{
-		// Calculate a delta.
+		// Calculate a delta, unless SendTable_EncodeDirty already did.
 		Assert( !pPrevFrame->IsCompressed() );
 		
-		int deltaProps[MAX_DATATABLE_PROPS];
-
-		int nChanges = SendTable_CalcDelta(
-			pSendTable, 
-			pPrevFrame->GetData(), pPrevFrame->GetNumBits(),
-			packedData,	writeBuf.GetNumBitsWritten(),
-			
-			deltaProps,
-			ARRAYSIZE( deltaProps ),
+		if ( !bPartial )
+		{
+			nChanges = SendTable_CalcDelta(
+				pSendTable, 
+				pPrevFrame->GetData(), pPrevFrame->GetNumBits(),
+				packedData,	writeBuf.GetNumBitsWritten(),
+				
+				deltaProps,
+				ARRAYSIZE( deltaProps ),
 
-			edictIdx
-			);
+				edictIdx
+				);
+		}
 
 #ifndef NO_VCR
 		if ( vcr_verbose.GetInt() )
@@ -185,7 +319,7 @@ static inline void SV_PackEntity(
 			{
 				if ( framesnapshotmanager->UsePreviouslySentPacket( pSnapshot, edictIdx, iSerialNum ) )
 				{
-					edict->ClearStateChanged();
+					SV_ClearStateChanged( edictIdx, edict, nFlatProps );
 					return;
 				}
 			}
@@ -256,7 +390,7 @@ static inline void SV_PackEntity(
 		pPackedEntity->SetRecipients( recip );
 	}
 
-	edict->ClearStateChanged();
+	SV_ClearStateChanged( edictIdx, edict, nFlatProps );
 }
 
 // in HLTV mode we ALWAYS have to store position and PVS info, even if entity didnt change
@@ -364,11 +498,12 @@ void PackEntities_NetworkBackDoor(
 		ServerClass *pSVClass = snapshot->m_pEntities[ index ].m_pClass;
 		g_pLocalNetworkBackdoor->EntState( index, edict->m_NetworkSerialNumber, 
 			pSVClass->m_ClassID, pSVClass->m_pTable, edict->GetUnknown(), edict->HasStateChanged(), bShouldTransmit );
-		edict->ClearStateChanged();
+		SV_ClearStateChanged( index, edict, SendTable_GetNumFlatProps( pSVClass->m_pTable ) );
 	}
 	
 	// Tell the client about any entities that are now dormant.
 	g_pLocalNetworkBackdoor->ProcessDormantEntities();
+	SV_AccumulateEdictChangeInfos();
 	InvalidateSharedEdictChangeInfos();
 }
 
@@ -449,6 +584,7 @@ void PackEntities_Normal(
 		}
 	}
 
+	SV_AccumulateEdictChangeInfos();
 	InvalidateSharedEdictChangeInfos();
 }
 
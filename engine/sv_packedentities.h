@@ -30,5 +30,8 @@ void SV_EnsureInstanceBaseline( ServerClass *pServerClass, int iEdict, const voi
 
 void SV_EnableChangeFrames( bool state );
 
+// Remembers a change CBaseEdict::StateChanged had no room for in the shared change infos.
+void SV_EdictStateChangedOverflow( edict_t *pEdict, unsigned short offset );
+
 
 #endif // SV_PACKEDENTITIES_H
@@ -0,0 +1,209 @@
+// Copyright Valve Corporation, All rights reserved.
+//
+// Data cache self-tests.
+
+#include "tests_datacache.h"
+
+#include <atomic>
+#include <memory>
+
+#include "tier0/dbg.h"
+#include "tier0/fasttimer.h"
+#include "tier1/convar.h"
+#include "tier1/strtools.h"
+#include "tier3/tier3.h"
+#include "vstdlib/jobthread.h"
+
+#include "datacache/idatacache.h"
+
+#include "tier0/memdbgon.h"
+
+namespace {
+
+constexpr char kSectionName[]{"contention benchmark"};
+constexpr int kItemsNum{4096};
+// Every this item is kept locked, so Lock + Unlock on it are nested ones.
+constexpr int kLockedItemsStride{4};
+
+// Items point into static data, so nothing to free on discard.
+class BenchmarkCacheClient : public IDataCacheClient {
+ public:
+  bool HandleCacheNotification(const DataCacheNotification_t &) override {
+    return true;
+  }
+
+  bool GetItemName(DataCacheClientID_t client_id, const void *, char *dest,
+                   size_t max_length) override {
+    V_snprintf(dest, max_length, "benchmark item %zu", client_id);
+    return true;
+  }
+};
+
+struct ContentionWorkerContext {
+  IDataCacheSection *section;
+  const DataCacheHandle_t *handles;
+  int ops_num;
+  unsigned seed;
+  std::atomic_int *mismatches_num;
+};
+
+void ContentionWorker(ContentionWorkerContext *context) {
+  IDataCacheSection *section{context->section};
+  unsigned random{context->seed};
+  int mismatches_num{0};
+
+  for (int i{0}; i < context->ops_num; ++i) {
+    random = random * 1664525u + 1013904223u;
+
+    const int item{static_cast<int>((random >> 8) % kItemsNum)};
+    const DataCacheHandle_t handle{context->handles[item]};
+
+    // Mostly reads, like model and sound lookups during a frame.
+    const void *data;
+    switch (i & 7) {
+      case 5:
+      case 6:
+        data = section->Get(handle);
+        break;
+      case 7:
+        data = section->Lock(handle);
+        section->Unlock(handle);
+        break;
+      default:
+        data = section->GetNoTouch(handle);
+        break;
+    }
+
+    if (!data || *static_cast<const int *>(data) != item) ++mismatches_num;
+  }
+
+  context->mismatches_num->fetch_add(mismatches_num,
+                                     std::memory_order_relaxed);
+}
+
+// Returns ops per second.
+double RunContention(IDataCacheSection *section,
+                     const DataCacheHandle_t *handles, int threads_num,
+                     int ops_num, std::atomic_int &mismatches_num) {
+  std::unique_ptr<ContentionWorkerContext[]> contexts{
+      std::make_unique<ContentionWorkerContext[]>(threads_num)};
+  std::unique_ptr<CJob *[]> jobs{std::make_unique<CJob *[]>(threads_num)};
+
+  for (int i{0}; i < threads_num; ++i) {
+    contexts[i] = {section, handles, ops_num / threads_num,
+                   static_cast<unsigned>(i + 1), &mismatches_num};
+  }
+
+  IThreadPool *pool{CreateThreadPool()};
+
+  ThreadPoolStartParams_t params;
+  params.nThreads = threads_num;
+  params.fDistribute = TRS_FALSE;
+  pool->Start(params, "DataCacheTstJob");
+
+  CFastTimer timer;
+  timer.Start();
+
+  for (int i{0}; i < threads_num; ++i) {
+    jobs[i] = pool->QueueCall(&ContentionWorker, &contexts[i]);
+  }
+
+  for (int i{0}; i < threads_num; ++i) {
+    jobs[i]->WaitForFinish();
+    jobs[i]->Release();
+  }
+
+  timer.End();
+
+  pool->Stop();
+  DestroyThreadPool(pool);
+
+  const double seconds{timer.GetDuration().GetSeconds()};
+  return seconds > 0 ? (ops_num / threads_num) * threads_num / seconds : 0.0;
+}
+
+}  // namespace
+
+namespace se::engine::tests::datacache {
+
+bool RunDataCacheContentionBenchmark(int ops_num) {
+  constexpr int kThreadsNums[]{1, 2, 4, 8, 16, 32};
+
+  if (!g_pDataCache) {
+    Warning("RunDataCacheContentionBenchmark: No data cache.\n");
+    return false;
+  }
+
+  ConVarRef lockfree("datacache_lockfree");
+  if (!lockfree.IsValid()) {
+    Warning("RunDataCacheContentionBenchmark: No datacache_lockfree.\n");
+    return false;
+  }
+
+  ops_num = max(ops_num, kThreadsNums[ssize(kThreadsNums) - 1]);
+
+  BenchmarkCacheClient client;
+  IDataCacheSection *section{g_pDataCache->AddSection(&client, kSectionName)};
+
+  std::unique_ptr<int[]> values{std::make_unique<int[]>(kItemsNum)};
+  std::unique_ptr<DataCacheHandle_t[]> handles{
+      std::make_unique<DataCacheHandle_t[]>(kItemsNum)};
+
+  for (int i{0}; i < kItemsNum; ++i) {
+    values[i] = i;
+    section->Add(i, &values[i], sizeof(values[i]), &handles[i]);
+
+    if (i % kLockedItemsStride == 0) section->Lock(handles[i]);
+  }
+
+  const bool was_lockfree{lockfree.GetBool()};
+  std::atomic_int mismatches_num{0};
+
+  Msg("RunDataCacheContentionBenchmark: %d items, %d ops, ops per ms (higher "
+      "is better).\n",
+      kItemsNum, ops_num);
+  Msg("RunDataCacheContentionBenchmark: threads | mutex | lock-free\n");
+
+  for (const int threads_num : kThreadsNums) {
+    lockfree.SetValue(0);
+    const double mutex_rate{RunContention(section, handles.get(), threads_num,
+                                          ops_num, mismatches_num)};
+
+    lockfree.SetValue(1);
+    const double lockfree_rate{RunContention(
+        section, handles.get(), threads_num, ops_num, mismatches_num)};
+
+    Msg("RunDataCacheContentionBenchmark: %7d | %10.1f | %10.1f (x%.2f)\n",
+        threads_num, mutex_rate / 1000, lockfree_rate / 1000,
+        mutex_rate > 0 ? lockfree_rate / mutex_rate : 0.0);
+  }
+
+  lockfree.SetValue(was_lockfree ? 1 : 0);
+
+  // Balanced nested locks must leave exactly initial ones behind.
+  int bad_locks_num{0};
+  for (int i{0}; i < kItemsNum; ++i) {
+    const int expected_locks{i % kLockedItemsStride == 0 ? 1 : 0};
+    if (section->GetLockCount(handles[i]) != expected_locks) ++bad_locks_num;
+
+    if (expected_locks) section->Unlock(handles[i]);
+  }
+
+  DataCacheStatus_t status;
+  section->GetStatus(&status);
+
+  const bool ok{mismatches_num.load(std::memory_order_relaxed) == 0 &&
+                bad_locks_num == 0 && status.nItemsLocked == 0 &&
+                status.nBytesLocked == 0};
+
+  Msg("RunDataCacheContentionBenchmark: %d wrong items, %d wrong lock counts, "
+      "%zu items locked after unlock. %s.\n",
+      mismatches_num.load(std::memory_order_relaxed), bad_locks_num,
+      status.nItemsLocked, ok ? "PASSED" : "FAILED");
+
+  g_pDataCache->RemoveSection(kSectionName);
+
+  return ok;
+}
+
+}  // namespace se::engine::tests::datacache
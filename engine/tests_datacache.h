@@ -0,0 +1,18 @@
+// Copyright Valve Corporation, All rights reserved.
+//
+// Data cache self-tests.
+
+#ifndef SE_ENGINE_TESTS_DATACACHE_H_
+#define SE_ENGINE_TESTS_DATACACHE_H_
+
+namespace se::engine::tests::datacache {
+
+// Hammers one data cache section with GetNoTouch / Get / nested Lock + Unlock
+// from 1, 2, 4, 8, 16 and 32 threads, with datacache_lockfree off (cache
+// mutex on every call) and on, and prints ops/sec of both. Fails if any call
+// returns wrong item or lock counts / section status are off afterwards.
+bool RunDataCacheContentionBenchmark(int ops_num = 1000000);
+
+}  // namespace se::engine::tests::datacache
+
+#endif  // !SE_ENGINE_TESTS_DATACACHE_H_
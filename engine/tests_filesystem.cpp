@@ -0,0 +1,177 @@
+// Copyright Valve Corporation, All rights reserved.
+//
+// File system self-tests.
+
+#include "tests_filesystem.h"
+
+#include "tier0/dbg.h"
+#include "tier0/fasttimer.h"
+#include "tier0/icommandline.h"
+#include "tier1/convar.h"
+#include "tier1/strtools.h"
+#include "tier1/utlstring.h"
+#include "tier1/utlvector.h"
+#include "filesystem.h"
+#include "icvar.h"
+
+#include "tier0/memdbgon.h"
+
+namespace {
+
+constexpr char kPathId[]{"GAME"};
+constexpr int kMaxNamesNum{4096};
+constexpr int kMaxDirsDepth{4};
+
+void CollectFileNames(const char *dir, int depth,
+                      CUtlVector<CUtlString> &names) {
+  char wildcard[MAX_PATH];
+  V_sprintf_safe(wildcard, "%s*", dir);
+
+  FileFindHandle_t handle;
+  for (const char *name{
+           g_pFullFileSystem->FindFirstEx(wildcard, kPathId, &handle)};
+       name && names.Count() < kMaxNamesNum;
+       name = g_pFullFileSystem->FindNext(handle)) {
+    // Skips . and .. too.
+    if (name[0] == '.') continue;
+
+    char path[MAX_PATH];
+    V_sprintf_safe(path, "%s%s", dir, name);
+
+    if (g_pFullFileSystem->FindIsDirectory(handle)) {
+      if (depth < kMaxDirsDepth) {
+        V_strcat_safe(path, "/");
+        CollectFileNames(path, depth + 1, names);
+      }
+    } else {
+      names.AddToTail(path);
+    }
+  }
+
+  g_pFullFileSystem->FindClose(handle);
+}
+
+// Returns lookups per second.
+double RunLookups(const CUtlVector<CUtlString> &names, bool expected,
+                  int lookups_num, int &mismatches_num) {
+  CFastTimer timer;
+  timer.Start();
+
+  for (int i{0}; i < lookups_num; ++i) {
+    const char *name{names[i % names.Count()].Get()};
+    if (g_pFullFileSystem->FileExists(name, kPathId) != expected)
+      ++mismatches_num;
+  }
+
+  timer.End();
+
+  const double seconds{timer.GetDuration().GetSeconds()};
+  return seconds > 0 ? lookups_num / seconds : 0.0;
+}
+
+// Returns command run time in ms or -1 if there is no such command.
+double RunCommand(const char *command) {
+  CCommand args;
+  if (!args.Tokenize(command)) return -1;
+
+  ConCommand *concommand{g_pCVar->FindCommand(args[0])};
+  if (!concommand) return -1;
+
+  CFastTimer timer;
+  timer.Start();
+
+  concommand->Dispatch(args);
+
+  timer.End();
+
+  return timer.GetDuration().GetMillisecondsF();
+}
+
+}  // namespace
+
+namespace se::engine::tests::filesystem {
+
+bool RunFileSystemLookupBenchmark(int lookups_num) {
+  if (!g_pFullFileSystem) {
+    Warning("RunFileSystemLookupBenchmark: No file system.\n");
+    return false;
+  }
+
+  ConVarRef lookups("fs_fileindex_lookups");
+  if (!lookups.IsValid()) {
+    Warning("RunFileSystemLookupBenchmark: No fs_fileindex_lookups.\n");
+    return false;
+  }
+
+  const bool has_index{CommandLine()->FindParm("-fs_fileindex") != 0};
+  if (!has_index) {
+    Warning(
+        "RunFileSystemLookupBenchmark: No -fs_fileindex, index side will "
+        "probe every search path too.\n");
+  }
+
+  CUtlVector<CUtlString> hits;
+  CollectFileNames("", 0, hits);
+
+  if (hits.IsEmpty()) {
+    Warning("RunFileSystemLookupBenchmark: No %s files found.\n", kPathId);
+    return false;
+  }
+
+  // Misses next to real files, like probing for optional .vtf / .phy / .ani.
+  CUtlVector<CUtlString> misses;
+  misses.EnsureCapacity(hits.Count());
+  for (const CUtlString &hit : hits) {
+    char miss[MAX_PATH];
+    V_sprintf_safe(miss, "%s.missing", hit.Get());
+    misses.AddToTail(miss);
+  }
+
+  lookups_num = max(lookups_num, 1);
+
+  const bool was_lookups{lookups.GetBool()};
+  int mismatches_num{0};
+
+  Msg("RunFileSystemLookupBenchmark: %zd files, %d lookups, lookups per ms "
+      "(higher is better).\n",
+      hits.Count(), lookups_num);
+  Msg("RunFileSystemLookupBenchmark: kind | search paths | index\n");
+
+  for (const bool expected : {true, false}) {
+    const CUtlVector<CUtlString> &names{expected ? hits : misses};
+
+    lookups.SetValue(0);
+    const double probe_rate{
+        RunLookups(names, expected, lookups_num, mismatches_num)};
+
+    lookups.SetValue(1);
+    const double index_rate{
+        RunLookups(names, expected, lookups_num, mismatches_num)};
+
+    Msg("RunFileSystemLookupBenchmark: %6s | %10.1f | %10.1f (x%.2f)\n",
+        expected ? "hits" : "misses", probe_rate / 1000, index_rate / 1000,
+        probe_rate > 0 ? index_rate / probe_rate : 0.0);
+  }
+
+  lookups.SetValue(was_lookups ? 1 : 0);
+
+  if (has_index) {
+    // Cold start lists every directory, warm start stats them against
+    // saved index.
+    const double cold_ms{RunCommand("fs_fileindex_rebuild")};
+    const double warm_ms{RunCommand("fs_fileindex_rebuild reuse")};
+
+    Msg("RunFileSystemLookupBenchmark: index startup %.2f ms listed, %.2f ms "
+        "reused (x%.2f).\n",
+        cold_ms, warm_ms, warm_ms > 0 ? cold_ms / warm_ms : 0.0);
+  }
+
+  const bool ok{mismatches_num == 0};
+
+  Msg("RunFileSystemLookupBenchmark: %d wrong lookups. %s.\n", mismatches_num,
+      ok ? "PASSED" : "FAILED");
+
+  return ok;
+}
+
+}  // namespace se::engine::tests::filesystem
@@ -0,0 +1,20 @@
+// Copyright Valve Corporation, All rights reserved.
+//
+// File system self-tests.
+
+#ifndef SE_ENGINE_TESTS_FILESYSTEM_H_
+#define SE_ENGINE_TESTS_FILESYSTEM_H_
+
+namespace se::engine::tests::filesystem {
+
+// Looks up up to 4096 GAME files and as many missing names next to them with
+// FileExists, with fs_fileindex_lookups off (probe every search path) and on
+// (skip search paths file location index says have no file), and prints
+// lookups/sec of both. Then times listing all indexed directories from scratch
+// vs revalidating saved index, like on startup. Fails if any lookup returns
+// wrong result. Needs -fs_fileindex for the index side.
+bool RunFileSystemLookupBenchmark(int lookups_num = 200000);
+
+}  // namespace se::engine::tests::filesystem
+
+#endif  // !SE_ENGINE_TESTS_FILESYSTEM_H_
@@ -2,7 +2,13 @@
 //
 // Self-tests commands.
 
+#include "tests_datacache.h"
+#include "tests_filesystem.h"
+#include "tests_send_snapshot.h"
+#include "tests_send_table.h"
+#include "tests_spatial_partition.h"
 #include "tests_thread_pool.h"
+#include "tests_trace.h"
 #include "tests_ts_collections.h"
 
 #include <atomic>
@@ -102,3 +108,88 @@ CON_COMMAND(threadpool_run_tests,
     se::engine::tests::thread_pool::RunThreadPoolTests();
   }
 }
+
+CON_COMMAND(threadpool_run_benchmark,
+            "Run thread pool shared queue vs work-stealing benchmark. 100000 "
+            "jobs by default.") {
+  const int jobs_num{args.ArgC() == 1 ? 100000 : atoi(args.Arg(1))};
+
+  se::engine::tests::thread_pool::RunThreadPoolBenchmark(jobs_num);
+}
+
+CON_COMMAND(threadpool_run_parallel_process_benchmark,
+            "Run ParallelProcess / ParallelLoopProcess chunking benchmark.") {
+  se::engine::tests::thread_pool::RunParallelProcessBenchmark();
+}
+
+CON_COMMAND(sv_parallel_sendsnapshot_stress,
+            "Stress snapshot reference handling of the parallel snapshot "
+            "send. 128 clients and 2000 ticks by default.") {
+  const int clients_num{args.ArgC() < 2 ? 128 : atoi(args.Arg(1))};
+  const int ticks_num{args.ArgC() < 3 ? 2000 : atoi(args.Arg(2))};
+
+  se::engine::tests::send_snapshot::RunParallelSendSnapshotTests(clients_num,
+                                                                 ticks_num);
+}
+
+CON_COMMAND(sendtable_encode_benchmark,
+            "Run SendTable proxies vs compiled encoders benchmark on the "
+            "entities of the loaded map. 100 passes by default.") {
+  const int iterations_num{args.ArgC() == 1 ? 100 : atoi(args.Arg(1))};
+
+  se::engine::tests::send_table::RunSendTableEncodeBenchmark(iterations_num);
+}
+
+CON_COMMAND(sendtable_dirty_repack_benchmark,
+            "Run SendTable dirty prop repack vs full encode and delta "
+            "benchmark on the loaded map. 100 passes by default.") {
+  const int iterations_num{args.ArgC() == 1 ? 100 : atoi(args.Arg(1))};
+
+  se::engine::tests::send_table::RunSendTableDirtyRepackBenchmark(
+      iterations_num);
+}
+
+CON_COMMAND(trace_rays_benchmark,
+            "Run TraceRays packet tracing vs TraceRay benchmark on the loaded "
+            "map. 100000 rays by default.") {
+  const int rays_num{args.ArgC() == 1 ? 100000 : atoi(args.Arg(1))};
+
+  se::engine::tests::trace::RunTraceRaysBenchmark(rays_num);
+}
+
+CON_COMMAND(trace_concurrent_test,
+            "Run read-only concurrent TraceRay tests on the loaded map. 8 "
+            "threads and 30000 rays by default.") {
+  const int threads_num{args.ArgC() < 2 ? 8 : atoi(args.Arg(1))};
+  const int rays_num{args.ArgC() < 3 ? 30000 : atoi(args.Arg(2))};
+
+  se::engine::tests::trace::RunConcurrentTraceTests(threads_num, rays_num);
+}
+
+CON_COMMAND(spatialpartition_benchmark,
+            "Run voxel hash vs dynamic AABB tree spatial partition benchmark. "
+            "Replays spatialpartition_record file if given, otherwise 300 "
+            "frames of a synthetic map. Usage: spatialpartition_benchmark "
+            "[file] [frames]") {
+  const char *record_path{args.ArgC() < 2 ? "" : args.Arg(1)};
+  const int frames_num{args.ArgC() < 3 ? 300 : atoi(args.Arg(2))};
+
+  se::engine::tests::spatial_partition::RunSpatialPartitionBenchmark(
+      record_path, frames_num);
+}
+
+CON_COMMAND(datacache_contention_benchmark,
+            "Run data cache section mutex vs lock-free contention benchmark "
+            "on 1-32 threads. 1000000 ops by default.") {
+  const int ops_num{args.ArgC() == 1 ? 1000000 : atoi(args.Arg(1))};
+
+  se::engine::tests::datacache::RunDataCacheContentionBenchmark(ops_num);
+}
+
+CON_COMMAND(filesystem_lookup_benchmark,
+            "Run search paths vs file location index lookup benchmark and time "
+            "index startup. 200000 lookups by default.") {
+  const int lookups_num{args.ArgC() == 1 ? 200000 : atoi(args.Arg(1))};
+
+  se::engine::tests::filesystem::RunFileSystemLookupBenchmark(lookups_num);
+}
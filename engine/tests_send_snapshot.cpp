@@ -0,0 +1,228 @@
+// Copyright Valve Corporation, All rights reserved.
+//
+// Parallel snapshot send self-tests.
+
+#include "tests_send_snapshot.h"
+
+#include <atomic>
+#include <memory>
+
+#include "tier0/dbg.h"
+#include "tier0/fasttimer.h"
+#include "tier1/bitbuf.h"
+#include "tier1/smartptr.h"
+#include "vstdlib/jobthread.h"
+#include "vstdlib/random.h"
+
+#include "framesnapshot.h"
+#include "packed_entity.h"
+#include "server.h"
+
+#include "tier0/memdbgon.h"
+
+namespace {
+
+// Number of client frames a fake client keeps, like CClientFrameManager.
+constexpr int kMaxClientFrames{32};
+// Number of packed entities shared between all snapshots.
+constexpr int kPackedEntitiesNum{256};
+
+using SnapshotPtr = CSmartPtr<CFrameSnapshot, CRefCountAccessorLongName>;
+
+struct FakeClient {
+  CUniformRandomStream random;
+  // Snapshots referenced by not yet acknowledged client frames.
+  SnapshotPtr frames[kMaxClientFrames];
+  int frames_num;
+  // Last sent snapshot, same as CBaseClient::m_pLastSnapshot.
+  SnapshotPtr last_snapshot;
+  SnapshotPtr send_snapshot;
+  // Per client scratch buffer, same as CBaseClient::m_SnapshotScratchBuffer.
+  alignas(4) byte scratch_buffer[1024];
+  int walked_snapshots_num;
+};
+
+std::atomic_int g_errors_num;
+
+void ReportError(const char *what, int tick) {
+  if (g_errors_num.fetch_add(1, std::memory_order_relaxed) < 16) {
+    Warning("RunParallelSendSnapshotTests: %s (tick %d).\n", what, tick);
+  }
+}
+
+void SendFakeSnapshot(FakeClient *&client_ptr) {
+  FakeClient &client = *client_ptr;
+  CFrameSnapshot *current = client.send_snapshot.GetObject();
+  const int tick{current->m_nTickCount};
+
+  // Walk snapshots since the last sent one, like WriteTempEntities does. Other
+  // jobs release their references meanwhile.
+  CFrameSnapshot *snapshot = client.last_snapshot.IsValid()
+                                 ? client.last_snapshot->NextSnapshot()
+                                 : current;
+  int prev_tick{client.last_snapshot.IsValid()
+                    ? client.last_snapshot->m_nTickCount
+                    : tick - 1};
+  while (snapshot) {
+    if (snapshot->m_nTickCount <= prev_tick) {
+      ReportError("snapshot list is out of order", tick);
+      break;
+    }
+
+    prev_tick = snapshot->m_nTickCount;
+    ++client.walked_snapshots_num;
+
+    if (snapshot == current) break;
+
+    snapshot = framesnapshotmanager->NextSnapshot(snapshot);
+  }
+
+  if (!snapshot) ReportError("current snapshot is not reachable", tick);
+
+  // Touch packed entity references of the snapshot like delta writing does.
+  for (int i{0}; i < 8; ++i) {
+    const int entity{client.random.RandomInt(0, current->m_nNumEntities - 1)};
+    const PackedEntityHandle_t handle{current->m_pEntities[entity].m_pPackedData};
+
+    framesnapshotmanager->AddEntityReference(handle);
+    framesnapshotmanager->RemoveEntityReference(handle);
+  }
+
+  // Write into the client scratch buffer and validate it.
+  bf_write msg("SendFakeSnapshot", client.scratch_buffer,
+               sizeof(client.scratch_buffer));
+  const int payload_num{client.random.RandomInt(1, 200)};
+  msg.WriteLong(tick);
+  for (int i{0}; i < payload_num; ++i) msg.WriteUBitLong(i ^ tick, 17);
+
+  bf_read check("SendFakeSnapshot", client.scratch_buffer,
+                msg.GetNumBytesWritten());
+  bool is_corrupted{check.ReadLong() != tick};
+  for (int i{0}; i < payload_num && !is_corrupted; ++i) {
+    is_corrupted = check.ReadUBitLong(17) != ((i ^ tick) & ((1 << 17) - 1));
+  }
+  if (is_corrupted) ReportError("scratch buffer corrupted", tick);
+
+  // Remember this snapshot, releasing the previous one.
+  client.last_snapshot = current;
+
+  // Client acknowledged some frames, drop them. May release last references.
+  const int acked_num{client.random.RandomInt(0, client.frames_num)};
+  for (int i{0}; i < client.frames_num - acked_num; ++i) {
+    client.frames[i] = client.frames[i + acked_num];
+  }
+  for (int i{client.frames_num - acked_num}; i < client.frames_num; ++i) {
+    client.frames[i] = nullptr;
+  }
+  client.frames_num -= acked_num;
+
+  if (client.frames_num == kMaxClientFrames) {
+    for (int i{0}; i < kMaxClientFrames - 1; ++i) {
+      client.frames[i] = client.frames[i + 1];
+    }
+    --client.frames_num;
+  }
+  client.frames[client.frames_num++] = current;
+}
+
+}  // namespace
+
+namespace se::engine::tests::send_snapshot {
+
+bool RunParallelSendSnapshotTests(int clients_num, int ticks_num) {
+  if (sv.IsActive()) {
+    Warning(
+        "RunParallelSendSnapshotTests: Server is active, stop it before "
+        "running tests.\n");
+    return false;
+  }
+
+  clients_num = clamp(clients_num, 1, 1024);
+  ticks_num = max(ticks_num, 1);
+
+  Msg("RunParallelSendSnapshotTests: Starting %d clients for %d ticks.\n",
+      clients_num, ticks_num);
+
+  g_errors_num.store(0, std::memory_order_relaxed);
+
+  // Packed entities never drop to zero references, so pool is not touched.
+  std::unique_ptr<PackedEntity[]> packed_entities{
+      std::make_unique<PackedEntity[]>(kPackedEntitiesNum)};
+  for (int i{0}; i < kPackedEntitiesNum; ++i) {
+    packed_entities[i].m_nEntityIndex = i;
+    packed_entities[i].m_ReferenceCount = 1;
+  }
+
+  std::unique_ptr<FakeClient[]> clients{
+      std::make_unique<FakeClient[]>(clients_num)};
+  std::unique_ptr<FakeClient *[]> receiving_clients{
+      std::make_unique<FakeClient *[]>(clients_num)};
+
+  for (int i{0}; i < clients_num; ++i) {
+    clients[i].random.SetSeed(i + 1);
+    clients[i].frames_num = 0;
+    clients[i].walked_snapshots_num = 0;
+  }
+
+  CFastTimer timer;
+  timer.Start();
+
+  for (int tick{1}; tick <= ticks_num; ++tick) {
+    CFrameSnapshot *snapshot =
+        framesnapshotmanager->CreateEmptySnapshot(tick, kPackedEntitiesNum);
+
+    for (int i{0}; i < kPackedEntitiesNum; ++i) {
+      const auto handle =
+          reinterpret_cast<PackedEntityHandle_t>(&packed_entities[i]);
+
+      framesnapshotmanager->AddEntityReference(handle);
+      snapshot->m_pEntities[i].m_pPackedData = handle;
+    }
+
+    for (int i{0}; i < clients_num; ++i) {
+      clients[i].send_snapshot = snapshot;
+      receiving_clients[i] = &clients[i];
+    }
+
+    framesnapshotmanager->BeginParallelSend();
+    ParallelProcess("SendFakeSnapshot", receiving_clients.get(), clients_num,
+                    &SendFakeSnapshot);
+    framesnapshotmanager->EndParallelSend();
+
+    for (int i{0}; i < clients_num; ++i) {
+      clients[i].send_snapshot = nullptr;
+    }
+
+    snapshot->ReleaseReference();
+  }
+
+  timer.End();
+
+  int64 walked_snapshots_num{0};
+  for (int i{0}; i < clients_num; ++i) {
+    walked_snapshots_num += clients[i].walked_snapshots_num;
+  }
+
+  // Release all client references, deletes the rest of snapshots.
+  clients.reset();
+
+  for (int i{0}; i < kPackedEntitiesNum; ++i) {
+    if (packed_entities[i].m_ReferenceCount != 1) {
+      ReportError("packed entity reference count mismatch", ticks_num);
+      break;
+    }
+  }
+
+  const int errors_num{g_errors_num.load(std::memory_order_relaxed)};
+
+  Msg("RunParallelSendSnapshotTests: %d clients, %d ticks, %lld snapshots "
+      "walked in %.2fms (%.4fms/tick). %s.\n",
+      clients_num, ticks_num, walked_snapshots_num,
+      timer.GetDuration().GetMillisecondsF(),
+      timer.GetDuration().GetMillisecondsF() / ticks_num,
+      errors_num ? "FAILED" : "PASSED");
+
+  return errors_num == 0;
+}
+
+}  // namespace se::engine::tests::send_snapshot
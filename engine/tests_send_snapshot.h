@@ -0,0 +1,17 @@
+// Copyright Valve Corporation, All rights reserved.
+//
+// Parallel snapshot send self-tests.
+
+#ifndef SE_ENGINE_TESTS_SEND_SNAPSHOT_H_
+#define SE_ENGINE_TESTS_SEND_SNAPSHOT_H_
+
+namespace se::engine::tests::send_snapshot {
+
+// Simulates |clients_num| clients acknowledging, walking and releasing frame
+// snapshots in parallel for |ticks_num| ticks, the way
+// CGameServer::SendClientMessages does with sv_parallel_sendsnapshot 1.
+bool RunParallelSendSnapshotTests(int clients_num = 128, int ticks_num = 2000);
+
+}  // namespace se::engine::tests::send_snapshot
+
+#endif  // !SE_ENGINE_TESTS_SEND_SNAPSHOT_H_
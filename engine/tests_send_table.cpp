@@ -0,0 +1,334 @@
+// Copyright Valve Corporation, All rights reserved.
+//
+// SendTable encoding self-tests.
+
+#include "tests_send_table.h"
+
+#include <cstring>
+#include <memory>
+
+#include "tier0/dbg.h"
+#include "tier0/fasttimer.h"
+#include "tier1/bitbuf.h"
+#include "tier1/utlvector.h"
+
+#include "dt.h"
+#include "dt_send_eng.h"
+#include "eiface.h"
+#include "server.h"
+#include "server_class.h"
+
+#include "tier0/memdbgon.h"
+
+namespace {
+
+struct EncodedEntity {
+  int edict_index;
+  ServerClass *server_class;
+  IServerUnknown *unknown;
+};
+
+// Same as SV_PackEntity does, without the constructor calls.
+struct EncodeBuffers {
+  alignas(4) unsigned char data[MAX_PACKEDENTITY_DATA];
+  alignas(CSendProxyRecipients) unsigned char
+      recipients[sizeof(CSendProxyRecipients) * MAX_DATATABLE_PROXIES];
+};
+
+// Encodes |entity| into |buffers| and returns the number of bits written, or
+// -1 on overflow.
+int EncodeEntity(const EncodedEntity &entity, bool use_proxies,
+                 bool non_zero_only, EncodeBuffers &buffers) {
+  SendTable *send_table{entity.server_class->m_pTable};
+
+  bf_write out{"RunSendTableEncodeBenchmark", buffers.data,
+               sizeof(buffers.data)};
+  CUtlMemory<CSendProxyRecipients> recipients{
+      reinterpret_cast<CSendProxyRecipients *>(buffers.recipients),
+      send_table->m_pPrecalc->GetNumDataTableProxies()};
+
+  const bool ok{use_proxies
+                    ? SendTable_EncodeWithProxies(send_table, entity.unknown,
+                                                  &out, entity.edict_index,
+                                                  &recipients, non_zero_only)
+                    : SendTable_Encode(send_table, entity.unknown, &out,
+                                       entity.edict_index, &recipients,
+                                       non_zero_only)};
+  return ok ? out.GetNumBitsWritten() : -1;
+}
+
+// Both encodings of every entity must be the same bits.
+int CompareEncodings(const CUtlVector<EncodedEntity> &entities,
+                     bool non_zero_only) {
+  std::unique_ptr<EncodeBuffers> proxies{std::make_unique<EncodeBuffers>()};
+  std::unique_ptr<EncodeBuffers> compiled{std::make_unique<EncodeBuffers>()};
+
+  int mismatches_num{0};
+  for (const EncodedEntity &entity : entities) {
+    // Bits after the written ones must match too.
+    memset(proxies->data, 0, sizeof(proxies->data));
+    memset(compiled->data, 0, sizeof(compiled->data));
+
+    const int proxies_bits{
+        EncodeEntity(entity, true, non_zero_only, *proxies)};
+    const int compiled_bits{
+        EncodeEntity(entity, false, non_zero_only, *compiled)};
+
+    if (proxies_bits != compiled_bits ||
+        (proxies_bits > 0 &&
+         memcmp(proxies->data, compiled->data, Bits2Bytes(proxies_bits)))) {
+      if (mismatches_num++ < 8) {
+        Warning(
+            "RunSendTableEncodeBenchmark: %s (ent %d%s) encodes to %d bits, "
+            "through proxies to %d bits%s.\n",
+            entity.server_class->GetName(), entity.edict_index,
+            non_zero_only ? ", non-zero only" : "", compiled_bits,
+            proxies_bits,
+            proxies_bits == compiled_bits ? ", bits differ" : "");
+      }
+    }
+  }
+
+  return mismatches_num;
+}
+
+// Repacks |entity| against |previous| with |dirty_props| into |buffers| and
+// returns the number of bits written, or -1 on failure.
+int RepackEntity(const EncodedEntity &entity, const EncodeBuffers &previous,
+                 int previous_bits, const CSendPropBits &dirty_props,
+                 EncodeBuffers &buffers, int *delta_props,
+                 int *delta_props_num) {
+  SendTable *send_table{entity.server_class->m_pTable};
+
+  bf_write out{"RunSendTableDirtyRepackBenchmark", buffers.data,
+               sizeof(buffers.data)};
+  CUtlMemory<CSendProxyRecipients> recipients{
+      reinterpret_cast<CSendProxyRecipients *>(buffers.recipients),
+      send_table->m_pPrecalc->GetNumDataTableProxies()};
+
+  const bool ok{SendTable_EncodeDirty(
+      send_table, entity.unknown, &dirty_props, previous.data, previous_bits,
+      &out, delta_props, MAX_DATATABLE_PROPS, delta_props_num,
+      entity.edict_index, &recipients)};
+  return ok ? out.GetNumBitsWritten() : -1;
+}
+
+// An unchanged entity must repack to its full encoding, with no changed props.
+int CompareRepacks(const CUtlVector<EncodedEntity> &entities,
+                   bool all_dirty) {
+  std::unique_ptr<EncodeBuffers> full{std::make_unique<EncodeBuffers>()};
+  std::unique_ptr<EncodeBuffers> repacked{std::make_unique<EncodeBuffers>()};
+  std::unique_ptr<CSendPropBits> dirty_props{
+      std::make_unique<CSendPropBits>()};
+  std::unique_ptr<int[]> delta_props{
+      std::make_unique<int[]>(MAX_DATATABLE_PROPS)};
+
+  if (all_dirty) dirty_props->SetAll();
+
+  int mismatches_num{0};
+  for (const EncodedEntity &entity : entities) {
+    memset(full->data, 0, sizeof(full->data));
+    memset(repacked->data, 0, sizeof(repacked->data));
+
+    const int full_bits{EncodeEntity(entity, false, false, *full)};
+    if (full_bits < 0) continue;
+
+    int delta_props_num{0};
+    const int repacked_bits{RepackEntity(entity, *full, full_bits,
+                                         *dirty_props, *repacked,
+                                         delta_props.get(), &delta_props_num)};
+
+    if (repacked_bits != full_bits || delta_props_num != 0 ||
+        memcmp(full->data, repacked->data, Bits2Bytes(full_bits))) {
+      if (mismatches_num++ < 8) {
+        Warning(
+            "RunSendTableDirtyRepackBenchmark: %s (ent %d%s) encodes to %d "
+            "bits, repacks to %d bits with %d changed props%s.\n",
+            entity.server_class->GetName(), entity.edict_index,
+            all_dirty ? ", all dirty" : "", full_bits, repacked_bits,
+            delta_props_num,
+            repacked_bits == full_bits ? ", bits differ" : "");
+      }
+    }
+  }
+
+  return mismatches_num;
+}
+
+double TimeEncodings(const CUtlVector<EncodedEntity> &entities,
+                     bool use_proxies, int iterations_num) {
+  std::unique_ptr<EncodeBuffers> buffers{std::make_unique<EncodeBuffers>()};
+
+  CFastTimer timer;
+  timer.Start();
+  for (int i{0}; i < iterations_num; ++i) {
+    for (const EncodedEntity &entity : entities) {
+      EncodeEntity(entity, use_proxies, false, *buffers);
+    }
+  }
+  timer.End();
+
+  return timer.GetDuration().GetMillisecondsF();
+}
+
+// Times a full encode and delta against |previous| of every entity, as
+// SV_PackEntity does for entities that didn't report which props changed,
+// or the repack of its always dirty props.
+double TimeRepacks(const CUtlVector<EncodedEntity> &entities,
+                   const CUtlVector<int> &previous_bits,
+                   const EncodeBuffers *previous, bool repack,
+                   int iterations_num) {
+  std::unique_ptr<EncodeBuffers> buffers{std::make_unique<EncodeBuffers>()};
+  std::unique_ptr<CSendPropBits> dirty_props{
+      std::make_unique<CSendPropBits>()};
+  std::unique_ptr<int[]> delta_props{
+      std::make_unique<int[]>(MAX_DATATABLE_PROPS)};
+
+  CFastTimer timer;
+  timer.Start();
+  for (int i{0}; i < iterations_num; ++i) {
+    for (intp j{0}; j < entities.Count(); ++j) {
+      const EncodedEntity &entity{entities[j]};
+      if (previous_bits[j] < 0) continue;
+
+      if (repack) {
+        int delta_props_num{0};
+        RepackEntity(entity, previous[j], previous_bits[j], *dirty_props,
+                     *buffers, delta_props.get(), &delta_props_num);
+      } else {
+        const int bits{EncodeEntity(entity, false, false, *buffers)};
+        SendTable_CalcDelta(entity.server_class->m_pTable, previous[j].data,
+                            previous_bits[j], buffers->data, bits,
+                            delta_props.get(), MAX_DATATABLE_PROPS,
+                            entity.edict_index);
+      }
+    }
+  }
+  timer.End();
+
+  return timer.GetDuration().GetMillisecondsF();
+}
+
+// Networked entities of the loaded map.
+void CollectEntities(CUtlVector<EncodedEntity> &entities) {
+  for (int i{0}; i < sv.num_edicts; ++i) {
+    edict_t *edict{sv.edicts + i};
+    if (edict->IsFree() || !edict->GetUnknown() || !edict->GetNetworkable())
+      continue;
+
+    ServerClass *server_class{edict->GetNetworkable()->GetServerClass()};
+    if (!server_class) continue;
+
+    entities.AddToTail({i, server_class, edict->GetUnknown()});
+  }
+}
+
+}  // namespace
+
+namespace se::engine::tests::send_table {
+
+bool RunSendTableEncodeBenchmark(int iterations_num) {
+  if (!sv.IsActive()) {
+    Warning(
+        "RunSendTableEncodeBenchmark: Load a map before running "
+        "benchmark.\n");
+    return false;
+  }
+
+  iterations_num = max(iterations_num, 1);
+
+  int classes_num{0}, flat_props_num{0}, compiled_props_num{0};
+  for (ServerClass *server_class{serverGameDLL->GetAllServerClasses()};
+       server_class; server_class = server_class->m_pNext) {
+    ++classes_num;
+    flat_props_num += SendTable_GetNumFlatProps(server_class->m_pTable);
+    compiled_props_num +=
+        SendTable_GetNumCompiledProps(server_class->m_pTable);
+  }
+
+  std::unique_ptr<bool[]> encoded_classes{
+      std::make_unique<bool[]>(classes_num)};
+  int encoded_classes_num{0};
+
+  CUtlVector<EncodedEntity> entities;
+  CollectEntities(entities);
+
+  for (const EncodedEntity &entity : entities) {
+    const int class_id{entity.server_class->m_ClassID};
+    if (class_id >= 0 && class_id < classes_num && !encoded_classes[class_id]) {
+      encoded_classes[class_id] = true;
+      ++encoded_classes_num;
+    }
+  }
+
+  const int mismatches_num{CompareEncodings(entities, false) +
+                           CompareEncodings(entities, true)};
+
+  const double proxies_ms{TimeEncodings(entities, true, iterations_num)};
+  const double compiled_ms{TimeEncodings(entities, false, iterations_num)};
+
+  Msg("RunSendTableEncodeBenchmark: %d entities of %d / %d server classes, "
+      "%d / %d flat props compiled.\n",
+      entities.Count(), encoded_classes_num, classes_num, compiled_props_num,
+      flat_props_num);
+  Msg("RunSendTableEncodeBenchmark: %d passes: proxies %.2fms, compiled "
+      "%.2fms (%.2fx). %s.\n",
+      iterations_num, proxies_ms, compiled_ms,
+      compiled_ms > 0 ? proxies_ms / compiled_ms : 0.0,
+      mismatches_num ? "FAILED" : "PASSED");
+
+  return mismatches_num == 0;
+}
+
+bool RunSendTableDirtyRepackBenchmark(int iterations_num) {
+  if (!sv.IsActive()) {
+    Warning(
+        "RunSendTableDirtyRepackBenchmark: Load a map before running "
+        "benchmark.\n");
+    return false;
+  }
+
+  iterations_num = max(iterations_num, 1);
+
+  CUtlVector<EncodedEntity> entities;
+  CollectEntities(entities);
+
+  int flat_props_num{0}, always_dirty_props_num{0};
+  for (const EncodedEntity &entity : entities) {
+    const CSendTablePrecalc *precalc{entity.server_class->m_pTable->m_pPrecalc};
+    flat_props_num += precalc->GetNumProps();
+    for (int i{0}; i < precalc->GetNumProps(); ++i) {
+      if (precalc->m_AlwaysDirtyProps.IsBitSet(i)) ++always_dirty_props_num;
+    }
+  }
+
+  const int mismatches_num{CompareRepacks(entities, false) +
+                           CompareRepacks(entities, true)};
+
+  // Each entity's full encoding is the previous packet of the timed passes.
+  std::unique_ptr<EncodeBuffers[]> previous{
+      std::make_unique<EncodeBuffers[]>(entities.Count())};
+  CUtlVector<int> previous_bits;
+  previous_bits.SetCount(entities.Count());
+  for (intp i{0}; i < entities.Count(); ++i) {
+    previous_bits[i] = EncodeEntity(entities[i], false, false, previous[i]);
+  }
+
+  const double full_ms{TimeRepacks(entities, previous_bits, previous.get(),
+                                   false, iterations_num)};
+  const double repack_ms{TimeRepacks(entities, previous_bits, previous.get(),
+                                     true, iterations_num)};
+
+  Msg("RunSendTableDirtyRepackBenchmark: %d entities, %d / %d flat props "
+      "always dirty.\n",
+      entities.Count(), always_dirty_props_num, flat_props_num);
+  Msg("RunSendTableDirtyRepackBenchmark: %d passes: encode and delta %.2fms, "
+      "repack %.2fms (%.2fx). %s.\n",
+      iterations_num, full_ms, repack_ms,
+      repack_ms > 0 ? full_ms / repack_ms : 0.0,
+      mismatches_num ? "FAILED" : "PASSED");
+
+  return mismatches_num == 0;
+}
+
+}  // namespace se::engine::tests::send_table
@@ -0,0 +1,25 @@
+// Copyright Valve Corporation, All rights reserved.
+//
+// SendTable encoding self-tests.
+
+#ifndef SE_ENGINE_TESTS_SEND_TABLE_H_
+#define SE_ENGINE_TESTS_SEND_TABLE_H_
+
+namespace se::engine::tests::send_table {
+
+// Encodes every entity of the loaded map, so each server class with a live
+// instance, |iterations_num| times through the proxies of all properties and
+// through the compiled encoders, and compares times. Fails if the compiled
+// encoders write any bit differently.
+bool RunSendTableEncodeBenchmark(int iterations_num = 100);
+
+// Repacks every entity of the loaded map against its own full encoding
+// |iterations_num| times, with no props and with all props dirty, the way
+// SV_PackEntity does for entities that reported their changes, and compares
+// times with a full encode and delta. Fails if a repack differs from the full
+// encoding or reports different changed props.
+bool RunSendTableDirtyRepackBenchmark(int iterations_num = 100);
+
+}  // namespace se::engine::tests::send_table
+
+#endif  // !SE_ENGINE_TESTS_SEND_TABLE_H_
@@ -0,0 +1,439 @@
+// Copyright Valve Corporation, All rights reserved.
+//
+// Spatial partition self-tests.
+
+#include "tests_spatial_partition.h"
+
+#include <memory>
+
+#include "tier0/dbg.h"
+#include "tier0/fasttimer.h"
+#include "tier1/utlbuffer.h"
+#include "tier1/utlvector.h"
+#include "vstdlib/random.h"
+
+#include "basehandle.h"
+#include "cmodel.h"
+#include "filesystem.h"
+#include "filesystem_engine.h"
+#include "ihandleentity.h"
+#include "ispatialpartitioninternal.h"
+#include "spatialpartitionrecord.h"
+#include "worldsize.h"
+
+#include "tier0/memdbgon.h"
+
+namespace {
+
+// Max number of spatial partition handles.
+constexpr int kMaxHandlesNum{1 << 16};
+// Synthetic map entities.
+constexpr int kEntitiesNum{4096};
+// Synthetic map half size, open map.
+constexpr float kMapExtent{12288.0f};
+
+constexpr SpatialPartitionListMask_t kServerEntityLists{
+    PARTITION_ENGINE_SOLID_EDICTS | PARTITION_ENGINE_NON_STATIC_EDICTS};
+constexpr SpatialPartitionListMask_t kServerTriggerLists{
+    PARTITION_ENGINE_TRIGGER_EDICTS | PARTITION_ENGINE_NON_STATIC_EDICTS};
+constexpr SpatialPartitionListMask_t kClientEntityLists{
+    PARTITION_CLIENT_SOLID_EDICTS | PARTITION_CLIENT_NON_STATIC_EDICTS};
+
+class FakeHandleEntity final : public IHandleEntity {
+ public:
+  void SetRefEHandle(const CBaseHandle &handle) override { handle_ = handle; }
+  const CBaseHandle &GetRefEHandle() const override { return handle_; }
+
+  int index;
+
+ private:
+  CBaseHandle handle_;
+};
+
+struct QueryResult {
+  int elements_num;
+  uint64 checksum;
+};
+
+class ReplayEnumerator final : public IPartitionEnumerator {
+ public:
+  IterationRetval_t EnumElement(IHandleEntity *handle_entity) override {
+    const auto index = static_cast<uint64>(
+        static_cast<FakeHandleEntity *>(handle_entity)->index);
+
+    ++result.elements_num;
+    // Order independent, partitions enumerate in different order.
+    result.checksum += (index + 1) * 0x9E3779B97F4A7C15ULL;
+    return ITERATION_CONTINUE;
+  }
+
+  QueryResult result;
+};
+
+struct ReplayStats {
+  CCycleCount update_time;
+  CCycleCount query_time;
+  int64 updates_num;
+  int64 queries_num;
+  int64 elements_num;
+};
+
+void AddRecord(CUtlVector<SpatialPartitionRecord_t> &records,
+               SpatialPartitionRecordOp_t op, int handle,
+               SpatialPartitionListMask_t list_mask,
+               const Vector &v0 = vec3_origin, const Vector &v1 = vec3_origin,
+               const Vector &v2 = vec3_origin) {
+  SpatialPartitionRecord_t &record = records[records.AddToTail()];
+  record.m_nOp = static_cast<uint8>(op);
+  record.m_nPad = 0;
+  record.m_hPartition = static_cast<uint16>(handle);
+  record.m_nListMask = static_cast<uint32>(list_mask);
+  record.m_vec[0] = v0;
+  record.m_vec[1] = v1;
+  record.m_vec[2] = v2;
+}
+
+struct SyntheticEntity {
+  Vector origin;
+  Vector velocity;
+  Vector half_size;
+};
+
+void SpawnSyntheticEntity(CUniformRandomStream &random, int index,
+                          SyntheticEntity &entity,
+                          CUtlVector<SpatialPartitionRecord_t> &records) {
+  entity.origin.Init(random.RandomFloat(-kMapExtent, kMapExtent),
+                     random.RandomFloat(-kMapExtent, kMapExtent),
+                     random.RandomFloat(-256.0f, 1024.0f));
+
+  // Mostly small props, some large brush entities.
+  const bool is_large{random.RandomInt(0, 15) == 0};
+  const float size{is_large ? random.RandomFloat(128.0f, 1024.0f)
+                            : random.RandomFloat(4.0f, 32.0f)};
+  entity.half_size.Init(size, size, is_large ? size * 0.25f : size);
+
+  if (random.RandomInt(0, 9) < 3) {
+    entity.velocity.Init(random.RandomFloat(-16.0f, 16.0f),
+                         random.RandomFloat(-16.0f, 16.0f),
+                         random.RandomFloat(-2.0f, 2.0f));
+  } else {
+    entity.velocity.Init();
+  }
+
+  SpatialPartitionListMask_t list_mask{kClientEntityLists};
+  if (index & 1) {
+    list_mask = random.RandomInt(0, 9) == 0 ? kServerTriggerLists
+                                            : kServerEntityLists;
+  }
+
+  AddRecord(records, SPR_CREATE_HANDLE, index, 0);
+  AddRecord(records, SPR_SET_LISTS, index, list_mask);
+  AddRecord(records, SPR_MOVE, index, 0, entity.origin - entity.half_size,
+            entity.origin + entity.half_size);
+}
+
+Vector RandomDirection(CUniformRandomStream &random) {
+  Vector direction{random.RandomFloat(-1.0f, 1.0f),
+                   random.RandomFloat(-1.0f, 1.0f),
+                   random.RandomFloat(-0.25f, 0.25f)};
+  VectorNormalize(direction);
+  return direction;
+}
+
+SpatialPartitionListMask_t RandomQueryLists(CUniformRandomStream &random) {
+  return random.RandomInt(0, 1)
+             ? PARTITION_ENGINE_SOLID_EDICTS | PARTITION_ENGINE_TRIGGER_EDICTS
+             : PARTITION_CLIENT_SOLID_EDICTS;
+}
+
+void BuildSyntheticRecords(int frames_num,
+                           CUtlVector<SpatialPartitionRecord_t> &records) {
+  CUniformRandomStream random;
+  random.SetSeed(1);
+
+  std::unique_ptr<SyntheticEntity[]> entities{
+      std::make_unique<SyntheticEntity[]>(kEntitiesNum)};
+  for (int i{0}; i < kEntitiesNum; ++i) {
+    SpawnSyntheticEntity(random, i, entities[i], records);
+  }
+
+  const Vector hull_extents{16.0f, 16.0f, 36.0f};
+
+  for (int frame{0}; frame < frames_num; ++frame) {
+    for (int i{0}; i < kEntitiesNum; ++i) {
+      SyntheticEntity &entity = entities[i];
+      if (entity.velocity.IsZero()) continue;
+
+      entity.origin += entity.velocity;
+      for (int axis{0}; axis < 2; ++axis) {
+        if (fabsf(entity.origin[axis]) > kMapExtent) {
+          entity.velocity[axis] = -entity.velocity[axis];
+        }
+      }
+
+      AddRecord(records, SPR_MOVE, i, 0, entity.origin - entity.half_size,
+                entity.origin + entity.half_size);
+    }
+
+    // Some entities die and are replaced.
+    for (int i{0}; i < 4; ++i) {
+      const int index{random.RandomInt(0, kEntitiesNum - 1)};
+
+      AddRecord(records, SPR_DESTROY_HANDLE, index, 0);
+      SpawnSyntheticEntity(random, index, entities[index], records);
+    }
+
+    // Queries around entities, like the game does.
+    for (int i{0}; i < 32; ++i) {
+      const Vector &origin{
+          entities[random.RandomInt(0, kEntitiesNum - 1)].origin};
+      const Vector half_size{64.0f, 64.0f, 64.0f};
+
+      AddRecord(records, SPR_QUERY_BOX, PARTITION_INVALID_HANDLE,
+                RandomQueryLists(random), origin - half_size,
+                origin + half_size);
+    }
+
+    for (int i{0}; i < 96; ++i) {
+      const Vector &origin{
+          entities[random.RandomInt(0, kEntitiesNum - 1)].origin};
+
+      AddRecord(records, SPR_QUERY_RAY, PARTITION_INVALID_HANDLE,
+                RandomQueryLists(random), origin,
+                RandomDirection(random) * 4096.0f, vec3_origin);
+    }
+
+    for (int i{0}; i < 32; ++i) {
+      const Vector &origin{
+          entities[random.RandomInt(0, kEntitiesNum - 1)].origin};
+
+      AddRecord(records, SPR_QUERY_RAY, PARTITION_INVALID_HANDLE,
+                RandomQueryLists(random), origin,
+                RandomDirection(random) * 256.0f, hull_extents);
+    }
+
+    for (int i{0}; i < 16; ++i) {
+      const Vector &origin{
+          entities[random.RandomInt(0, kEntitiesNum - 1)].origin};
+
+      AddRecord(records, SPR_QUERY_SPHERE, PARTITION_INVALID_HANDLE,
+                RandomQueryLists(random), origin, Vector{512.0f, 0, 0});
+    }
+
+    for (int i{0}; i < 32; ++i) {
+      const Vector &origin{
+          entities[random.RandomInt(0, kEntitiesNum - 1)].origin};
+
+      AddRecord(records, SPR_QUERY_POINT, PARTITION_INVALID_HANDLE,
+                RandomQueryLists(random), origin);
+    }
+  }
+}
+
+bool LoadRecords(const char *record_path,
+                 CUtlVector<SpatialPartitionRecord_t> &records) {
+  CUtlBuffer buffer;
+  if (!g_pFileSystem->ReadFile(record_path, "MOD", buffer)) {
+    Warning("RunSpatialPartitionBenchmark: Unable to read %s.\n",
+            record_path);
+    return false;
+  }
+
+  SpatialPartitionRecordHeader_t header;
+  if (!buffer.Get(&header, sizeof(header)) ||
+      header.m_nId != SPATIALPARTITION_RECORD_ID ||
+      header.m_nVersion != SPATIALPARTITION_RECORD_VERSION ||
+      header.m_nRecordCount < 0 ||
+      buffer.GetBytesRemaining() !=
+          header.m_nRecordCount *
+              static_cast<intp>(sizeof(SpatialPartitionRecord_t))) {
+    Warning("RunSpatialPartitionBenchmark: %s is not a spatial partition "
+            "record.\n",
+            record_path);
+    return false;
+  }
+
+  records.SetCount(header.m_nRecordCount);
+  buffer.Get(records.Base(),
+             header.m_nRecordCount * sizeof(SpatialPartitionRecord_t));
+  return true;
+}
+
+// Replays records against a new partition with |bvh_trees| dynamic AABB trees.
+void Replay(int bvh_trees, const CUtlVector<SpatialPartitionRecord_t> &records,
+            FakeHandleEntity *entities, CUtlVector<QueryResult> &results,
+            ReplayStats &stats) {
+  ISpatialPartition *partition{CreateSpatialPartition(
+      Vector{MIN_COORD_FLOAT, MIN_COORD_FLOAT, MIN_COORD_FLOAT},
+      Vector{MAX_COORD_FLOAT, MAX_COORD_FLOAT, MAX_COORD_FLOAT}, bvh_trees)};
+
+  std::unique_ptr<SpatialPartitionHandle_t[]> handles{
+      std::make_unique<SpatialPartitionHandle_t[]>(kMaxHandlesNum)};
+  for (int i{0}; i < kMaxHandlesNum; ++i) {
+    handles[i] = PARTITION_INVALID_HANDLE;
+  }
+
+  stats = {};
+  results.RemoveAll();
+  results.EnsureCapacity(records.Count());
+
+  CFastTimer timer;
+  for (const auto &record : records) {
+    const SpatialPartitionHandle_t recorded_handle{record.m_hPartition};
+    SpatialPartitionHandle_t &handle = handles[recorded_handle];
+    const bool is_query{record.m_nOp >= SPR_QUERY_BOX};
+
+    // Record started in the middle of the game may miss some creations.
+    if (!is_query && record.m_nOp != SPR_CREATE_HANDLE &&
+        handle == PARTITION_INVALID_HANDLE) {
+      continue;
+    }
+
+    ReplayEnumerator enumerator;
+    enumerator.result = {};
+
+    timer.Start();
+    switch (record.m_nOp) {
+      case SPR_CREATE_HANDLE:
+        if (handle != PARTITION_INVALID_HANDLE) {
+          partition->DestroyHandle(handle);
+        }
+        handle = partition->CreateHandle(&entities[recorded_handle]);
+        break;
+      case SPR_DESTROY_HANDLE:
+        partition->DestroyHandle(handle);
+        handle = PARTITION_INVALID_HANDLE;
+        break;
+      case SPR_SET_LISTS:
+        partition->RemoveAndInsert(~0, record.m_nListMask, handle);
+        break;
+      case SPR_HIDE:
+        partition->HideElement(handle);
+        break;
+      case SPR_UNHIDE:
+        partition->UnhideElement(handle, 1);
+        break;
+      case SPR_MOVE:
+        partition->ElementMoved(handle, record.m_vec[0], record.m_vec[1]);
+        break;
+      case SPR_QUERY_BOX:
+        partition->EnumerateElementsInBox(record.m_nListMask, record.m_vec[0],
+                                          record.m_vec[1], false, &enumerator);
+        break;
+      case SPR_QUERY_SPHERE:
+        partition->EnumerateElementsInSphere(record.m_nListMask,
+                                             record.m_vec[0],
+                                             record.m_vec[1].x, false,
+                                             &enumerator);
+        break;
+      case SPR_QUERY_RAY: {
+        Ray_t ray;
+        ray.Init(record.m_vec[0], record.m_vec[0] + record.m_vec[1],
+                 -record.m_vec[2], record.m_vec[2]);
+        partition->EnumerateElementsAlongRay(record.m_nListMask, ray, false,
+                                             &enumerator);
+      } break;
+      case SPR_QUERY_POINT:
+        partition->EnumerateElementsAtPoint(record.m_nListMask,
+                                            record.m_vec[0], false,
+                                            &enumerator);
+        break;
+    }
+    timer.End();
+
+    if (is_query) {
+      stats.query_time += timer.GetDuration();
+      ++stats.queries_num;
+      stats.elements_num += enumerator.result.elements_num;
+      results.AddToTail(enumerator.result);
+    } else {
+      stats.update_time += timer.GetDuration();
+      ++stats.updates_num;
+    }
+  }
+
+  for (int i{0}; i < kMaxHandlesNum; ++i) {
+    if (handles[i] != PARTITION_INVALID_HANDLE) {
+      partition->DestroyHandle(handles[i]);
+    }
+  }
+
+  DestroySpatialPartition(partition);
+}
+
+void PrintStats(const char *name, const ReplayStats &stats) {
+  Msg("RunSpatialPartitionBenchmark: %-18s %lld updates in %.2fms, %lld "
+      "queries in %.2fms, %lld elements enumerated.\n",
+      name, stats.updates_num, stats.update_time.GetMillisecondsF(),
+      stats.queries_num, stats.query_time.GetMillisecondsF(),
+      stats.elements_num);
+}
+
+}  // namespace
+
+namespace se::engine::tests::spatial_partition {
+
+bool RunSpatialPartitionBenchmark(const char *record_path, int frames_num) {
+  CUtlVector<SpatialPartitionRecord_t> records;
+
+  if (record_path && record_path[0]) {
+    if (!LoadRecords(record_path, records)) return false;
+
+    Msg("RunSpatialPartitionBenchmark: Replaying %zd operations of %s.\n",
+        records.Count(), record_path);
+  } else {
+    frames_num = max(frames_num, 1);
+    BuildSyntheticRecords(frames_num, records);
+
+    Msg("RunSpatialPartitionBenchmark: Replaying %zd operations of %d "
+        "synthetic frames with %d entities.\n",
+        records.Count(), frames_num, kEntitiesNum);
+  }
+
+  std::unique_ptr<FakeHandleEntity[]> entities{
+      std::make_unique<FakeHandleEntity[]>(kMaxHandlesNum)};
+  for (int i{0}; i < kMaxHandlesNum; ++i) {
+    entities[i].index = i;
+  }
+
+  CUtlVector<QueryResult> voxel_results, bvh_results;
+  ReplayStats voxel_stats, bvh_stats;
+
+  Replay(SPATIAL_PARTITION_BVH_NONE, records, entities.get(), voxel_results,
+         voxel_stats);
+  Replay(SPATIAL_PARTITION_BVH_ALL, records, entities.get(), bvh_results,
+         bvh_stats);
+
+  int mismatches_num{0};
+  for (intp i{0}; i < voxel_results.Count(); ++i) {
+    if (voxel_results[i].elements_num != bvh_results[i].elements_num ||
+        voxel_results[i].checksum != bvh_results[i].checksum) {
+      if (mismatches_num++ < 16) {
+        Warning("RunSpatialPartitionBenchmark: Query %zd enumerated %d "
+                "elements in voxel hash, but %d in dynamic AABB tree.\n",
+                i, voxel_results[i].elements_num,
+                bvh_results[i].elements_num);
+      }
+    }
+  }
+
+  PrintStats("voxel hash:", voxel_stats);
+  PrintStats("dynamic AABB tree:", bvh_stats);
+
+  const double bvh_update_ms{bvh_stats.update_time.GetMillisecondsF()};
+  const double bvh_query_ms{bvh_stats.query_time.GetMillisecondsF()};
+
+  Msg("RunSpatialPartitionBenchmark: Dynamic AABB tree updates %.2fx, "
+      "queries %.2fx of voxel hash speed. %s.\n",
+      bvh_update_ms > 0 ? voxel_stats.update_time.GetMillisecondsF() /
+                              bvh_update_ms
+                        : 0.0,
+      bvh_query_ms > 0
+          ? voxel_stats.query_time.GetMillisecondsF() / bvh_query_ms
+          : 0.0,
+      mismatches_num ? "FAILED" : "PASSED");
+
+  return mismatches_num == 0;
+}
+
+}  // namespace se::engine::tests::spatial_partition
@@ -0,0 +1,20 @@
+// Copyright Valve Corporation, All rights reserved.
+//
+// Spatial partition self-tests.
+
+#ifndef SE_ENGINE_TESTS_SPATIAL_PARTITION_H_
+#define SE_ENGINE_TESTS_SPATIAL_PARTITION_H_
+
+namespace se::engine::tests::spatial_partition {
+
+// Replays insert / move / query stream recorded by spatialpartition_record
+// into |record_path| against voxel hash and dynamic AABB tree partitions and
+// compares their update and query times. When |record_path| is empty, replays
+// |frames_num| frames of a synthetic open map with many small moving props.
+// Fails if any query enumerates different elements.
+bool RunSpatialPartitionBenchmark(const char *record_path = "",
+                                  int frames_num = 300);
+
+}  // namespace se::engine::tests::spatial_partition
+
+#endif  // !SE_ENGINE_TESTS_SPATIAL_PARTITION_H_
@@ -327,10 +327,207 @@ std::uintptr_t GetProcessAffinity() {
 #endif
 }
 
+class BenchmarkJob : public CJob {
+ public:
+  BenchmarkJob(IThreadPool *pool, std::atomic_int &pending_jobs_num,
+               CThreadEvent &done_event, int children_num)
+      : pool_{pool},
+        pending_jobs_num_{pending_jobs_num},
+        done_event_{done_event},
+        children_num_{children_num} {}
+
+  JobStatus_t DoExecute() override {
+    // Tiny work item, like PackWork_t::Process on an idle entity.
+    uint32 acc{static_cast<uint32>(children_num_) + 1};
+    for (int i{0}; i < 64; ++i) acc = HashItem(acc);
+
+    // Spawned from pool thread, lands in its own deque in work-stealing mode.
+    for (int i{0}; i < children_num_; ++i) {
+      auto *job = new BenchmarkJob{pool_, pending_jobs_num_, done_event_, 0};
+      job->SetFlags(JF_QUEUE);
+
+      pool_->AddJob(job);
+
+      job->Release();
+    }
+
+    if (pending_jobs_num_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      done_event_.Set();
+    }
+
+    return acc != 0 ? JOB_OK : -1;
+  }
+
+ private:
+  IThreadPool *pool_;
+  std::atomic_int &pending_jobs_num_;
+  CThreadEvent &done_event_;
+  const int children_num_;
+};
+
+// Returns jobs per millisecond.
+double BenchmarkThroughput(IThreadPool *pool, int threads_num,
+                           bool is_work_stealing, int roots_num,
+                           int children_num) {
+  ThreadPoolStartParams_t params;
+  params.nThreads = threads_num;
+  params.fDistribute = TRS_FALSE;
+  params.bWorkStealing = is_work_stealing;
+  pool->Start(params, is_work_stealing ? "WsBenchJob" : "SqBenchJob");
+
+  const int jobs_num{roots_num * (children_num + 1)};
+
+  std::atomic_int pending_jobs_num{jobs_num};
+  CThreadEvent done_event;
+
+  CFastTimer timer;
+  timer.Start();
+
+  for (int i{0}; i < roots_num; ++i) {
+    auto *job =
+        new BenchmarkJob{pool, pending_jobs_num, done_event, children_num};
+    job->SetFlags(JF_QUEUE);
+
+    pool->AddJob(job);
+
+    job->Release();
+  }
+
+  done_event.Wait();
+
+  timer.End();
+
+  pool->Stop();
+
+  return jobs_num / max(timer.GetDuration().GetMillisecondsF(), 0.001);
+}
+
+// Spin iterations per item of parallel process benchmark.
+int64 g_item_spin_iterations;
+
+FORCEINLINE void SpinItem(uint32 seed) {
+  uint32 acc{seed};
+  for (int64 i{0}; i < g_item_spin_iterations; ++i) {
+    acc = acc * 1664525u + 1013904223u;
+  }
+
+  // Keep the loop from being optimized out.
+  volatile uint32 result{acc};
+  (void)result;
+}
+
+void SpinProcessItem(int &item) { SpinItem(static_cast<uint32>(item)); }
+
+void SpinLoopItem(intp const &index) { SpinItem(static_cast<uint32>(index)); }
+
+// Returns spin iterations taking |ns| nanoseconds.
+int64 CalibrateSpinIterations(double ns) {
+  constexpr int64 kCalibrationIterations{10000000};
+
+  g_item_spin_iterations = kCalibrationIterations;
+
+  CFastTimer timer;
+  timer.Start();
+  SpinItem(1);
+  timer.End();
+
+  const double ns_per_iteration{timer.GetDuration().GetMicrosecondsF() *
+                                1000.0 / kCalibrationIterations};
+  return max(static_cast<int64>(ns / ns_per_iteration), static_cast<int64>(1));
+}
+
 }  // namespace
 
 namespace se::engine::tests::thread_pool {
 
+void RunParallelProcessBenchmark() {
+  struct ItemCost {
+    const char *name;
+    double ns;
+    int items_num;
+  };
+  constexpr ItemCost kItemCosts[]{
+      {"10ns", 10.0, 4000000}, {"1us", 1000.0, 40000}, {"100us", 100000.0, 400}};
+
+  Msg("RunParallelProcessBenchmark: %zd pool threads, items/sec (higher is "
+      "better).\n",
+      g_pThreadPool->NumThreads());
+  Msg("RunParallelProcessBenchmark:  item | ParallelProcess: 1 per claim / "
+      "adaptive | ParallelLoopProcess: 1 per claim / adaptive\n");
+
+  for (const auto &cost : kItemCosts) {
+    const int64 spin_iterations{CalibrateSpinIterations(cost.ns)};
+
+    std::unique_ptr<int[]> items{std::make_unique<int[]>(cost.items_num)};
+    for (int i{0}; i < cost.items_num; ++i) items[i] = i;
+
+    // Grain 1 is how items were handed out before chunking.
+    double items_per_sec[4];
+    for (int run{0}; run < 4; ++run) {
+      const intp grain_size{run % 2 == 0 ? 1 : 0};
+
+      g_item_spin_iterations = spin_iterations;
+
+      CFastTimer timer;
+      timer.Start();
+
+      if (run < 2) {
+        ParallelProcess("SpinProcessItem", items.get(), cost.items_num,
+                        &SpinProcessItem, nullptr, nullptr, PTRDIFF_MAX,
+                        grain_size);
+      } else {
+        ParallelLoopProcess("SpinLoopItem", 0, cost.items_num, &SpinLoopItem,
+                            nullptr, nullptr, PTRDIFF_MAX, grain_size);
+      }
+
+      timer.End();
+
+      items_per_sec[run] =
+          cost.items_num /
+          max(timer.GetDuration().GetMillisecondsF() / 1000.0, 0.000001);
+    }
+
+    Msg("RunParallelProcessBenchmark: %5s | %12.0f / %12.0f (x%.2f) | %12.0f "
+        "/ %12.0f (x%.2f)\n",
+        cost.name, items_per_sec[0], items_per_sec[1],
+        items_per_sec[1] / items_per_sec[0], items_per_sec[2],
+        items_per_sec[3], items_per_sec[3] / items_per_sec[2]);
+  }
+}
+
+void RunThreadPoolBenchmark(int jobs_num) {
+  constexpr int kThreadsNums[]{1, 4, 16, 64};
+  // Each job queued by caller spawns this many jobs from pool thread.
+  constexpr int kChildrenNum{15};
+
+  jobs_num = max(jobs_num, kChildrenNum + 1);
+
+  ScopedThreadPool pool;
+
+  Msg("RunThreadPoolBenchmark: %d jobs, jobs per ms (higher is better).\n",
+      jobs_num);
+  Msg("RunThreadPoolBenchmark: threads | caller queued: shared / stealing | "
+      "job spawned: shared / stealing\n");
+
+  for (const int threads_num : kThreadsNums) {
+    const double flat_shared{
+        BenchmarkThroughput(&pool, threads_num, false, jobs_num, 0)};
+    const double flat_stealing{
+        BenchmarkThroughput(&pool, threads_num, true, jobs_num, 0)};
+
+    const int roots_num{jobs_num / (kChildrenNum + 1)};
+    const double nested_shared{
+        BenchmarkThroughput(&pool, threads_num, false, roots_num, kChildrenNum)};
+    const double nested_stealing{
+        BenchmarkThroughput(&pool, threads_num, true, roots_num, kChildrenNum)};
+
+    Msg("RunThreadPoolBenchmark: %7d | %8.1f / %8.1f (x%.2f) | %8.1f / %8.1f "
+        "(x%.2f)\n",
+        threads_num, flat_shared, flat_stealing, flat_stealing / flat_shared,
+        nested_shared, nested_stealing, nested_stealing / nested_shared);
+  }
+}
+
 void RunThreadPoolTests() {
   ScopedThreadPool pool;
 
@@ -9,6 +9,15 @@ namespace se::engine::tests::thread_pool {
 
 void RunThreadPoolTests();
 
+// Compares job throughput of shared queue and work-stealing thread pools at 1,
+// 4, 16 and 64 threads, for jobs queued by the caller and spawned by jobs.
+void RunThreadPoolBenchmark(int jobs_num = 100000);
+
+// Measures items/sec of ParallelProcess and ParallelLoopProcess on the global
+// thread pool for 10ns, 1us and 100us items, one item per claim vs adaptive
+// chunks.
+void RunParallelProcessBenchmark();
+
 }  // namespace se::engine::tests::thread_pool
 
 #endif  // !SE_ENGINE_TESTS_THREAD_POOL_H_
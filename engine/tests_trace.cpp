@@ -0,0 +1,332 @@
+// Copyright Valve Corporation, All rights reserved.
+//
+// World tracing self-tests.
+
+#include "tests_trace.h"
+
+#include <memory>
+
+#include "tier0/dbg.h"
+#include "tier0/fasttimer.h"
+#include "vstdlib/jobthread.h"
+#include "vstdlib/random.h"
+
+#include "cmodel_engine.h"
+#include "engine/IEngineTrace.h"
+#include "enginetrace.h"
+#include "server.h"
+
+#include "tier0/memdbgon.h"
+
+namespace {
+
+// Rays fired together, like pellets of a shotgun shot.
+constexpr int kBundleRaysNum{8};
+// Max trace length.
+constexpr float kRayLength{8192.0f};
+
+enum class RaysKind { kCoherentRays, kCoherentHulls, kIncoherentRays };
+
+const char *GetRaysKindName(RaysKind kind) {
+  switch (kind) {
+    case RaysKind::kCoherentRays:
+      return "coherent rays";
+    case RaysKind::kCoherentHulls:
+      return "coherent hulls";
+    case RaysKind::kIncoherentRays:
+      return "incoherent rays";
+  }
+  return "unknown";
+}
+
+Vector RandomPoint(CUniformRandomStream &random, const Vector &mins,
+                   const Vector &maxs) {
+  return {random.RandomFloat(mins.x, maxs.x),
+          random.RandomFloat(mins.y, maxs.y),
+          random.RandomFloat(mins.z, maxs.z)};
+}
+
+Vector RandomDirection(CUniformRandomStream &random) {
+  Vector direction{random.RandomFloat(-1, 1), random.RandomFloat(-1, 1),
+                   random.RandomFloat(-1, 1)};
+  if (VectorNormalize(direction) < 0.001f) direction.Init(1, 0, 0);
+  return direction;
+}
+
+void BuildRays(RaysKind kind, const Vector &mins, const Vector &maxs,
+               Ray_t *rays, int rays_num) {
+  CUniformRandomStream random;
+  random.SetSeed(static_cast<int>(kind) + 1);
+
+  const Vector hull_extents{16, 16, 36};
+
+  for (int i{0}; i < rays_num; i += kBundleRaysNum) {
+    const Vector origin{RandomPoint(random, mins, maxs)};
+    const Vector aim{RandomDirection(random)};
+
+    for (int j{i}; j < rays_num && j < i + kBundleRaysNum; ++j) {
+      if (kind == RaysKind::kIncoherentRays) {
+        rays[j].Init(RandomPoint(random, mins, maxs),
+                     RandomPoint(random, mins, maxs));
+        continue;
+      }
+
+      // Small spread around aim direction, like pellets or sensing rays.
+      Vector direction{aim + RandomDirection(random) * 0.05f};
+      VectorNormalize(direction);
+
+      const Vector end{origin + direction * kRayLength};
+      if (kind == RaysKind::kCoherentHulls) {
+        rays[j].Init(origin, end, -hull_extents, hull_extents);
+      } else {
+        rays[j].Init(origin, end);
+      }
+    }
+  }
+}
+
+bool IsSameTrace(const trace_t &a, const trace_t &b) {
+  return a.fraction == b.fraction && a.fractionleftsolid == b.fractionleftsolid &&
+         a.startsolid == b.startsolid && a.allsolid == b.allsolid &&
+         a.contents == b.contents && a.endpos == b.endpos &&
+         a.plane.normal == b.plane.normal && a.plane.dist == b.plane.dist &&
+         a.surface.name == b.surface.name &&
+         a.surface.surfaceProps == b.surface.surfaceProps &&
+         a.dispFlags == b.dispFlags;
+}
+
+// Results of one pass over all rays.
+struct TracePass {
+  std::unique_ptr<trace_t[]> traces;
+  std::unique_ptr<int[]> contents;
+};
+
+struct TraceWorkerContext {
+  const Ray_t *rays;
+  int rays_num;
+  // Workers start at different bundles so they walk different parts of the
+  // map at the same time.
+  int first_bundle;
+  TracePass *pass;
+};
+
+void TraceAll(const Ray_t *rays, int rays_num, int first_bundle,
+              TracePass &pass) {
+  CTraceFilterWorldAndPropsOnly filter;
+
+  const int bundles_num{(rays_num + kBundleRaysNum - 1) / kBundleRaysNum};
+  for (int i{0}; i < bundles_num; ++i) {
+    const int bundle{(first_bundle + i) % bundles_num};
+    const int first_ray{bundle * kBundleRaysNum};
+    const int bundle_rays_num{min(kBundleRaysNum, rays_num - first_ray)};
+
+    // Cover both single and batched traces.
+    if (bundle & 1) {
+      g_pEngineTraceServer->TraceRays(&rays[first_ray], bundle_rays_num,
+                                      MASK_SOLID, &filter,
+                                      &pass.traces[first_ray]);
+    } else {
+      for (int j{first_ray}; j < first_ray + bundle_rays_num; ++j) {
+        g_pEngineTraceServer->TraceRay(rays[j], MASK_SOLID, &filter,
+                                       &pass.traces[j]);
+      }
+    }
+
+    for (int j{first_ray}; j < first_ray + bundle_rays_num; ++j) {
+      pass.contents[j] =
+          g_pEngineTraceServer->GetPointContents(rays[j].m_Start, nullptr);
+    }
+  }
+}
+
+void TraceWorker(TraceWorkerContext *context) {
+  TraceAll(context->rays, context->rays_num, context->first_bundle,
+           *context->pass);
+}
+
+}  // namespace
+
+namespace se::engine::tests::trace {
+
+bool RunTraceRaysBenchmark(int rays_num) {
+  const cmodel_t *world{sv.IsActive() ? CM_InlineModelNumber(0) : nullptr};
+  if (!world) {
+    Warning("RunTraceRaysBenchmark: Load a map before running benchmark.\n");
+    return false;
+  }
+
+  rays_num = max(rays_num, kBundleRaysNum);
+
+  // Keep rays starting inside world bounds, most of them are in open space.
+  const Vector mins{world->mins + Vector{1, 1, 1}};
+  const Vector maxs{world->maxs - Vector{1, 1, 1}};
+
+  std::unique_ptr<Ray_t[]> rays{std::make_unique<Ray_t[]>(rays_num)};
+  std::unique_ptr<trace_t[]> serial_traces{
+      std::make_unique<trace_t[]>(rays_num)};
+  std::unique_ptr<trace_t[]> batch_traces{std::make_unique<trace_t[]>(rays_num)};
+
+  CTraceFilterWorldOnly filter;
+  int mismatches_num{0};
+
+  for (auto kind : {RaysKind::kCoherentRays, RaysKind::kCoherentHulls,
+                    RaysKind::kIncoherentRays}) {
+    BuildRays(kind, mins, maxs, rays.get(), rays_num);
+
+    CFastTimer serial_timer;
+    serial_timer.Start();
+    for (int i{0}; i < rays_num; ++i) {
+      g_pEngineTraceServer->TraceRay(rays[i], MASK_SOLID, &filter,
+                                     &serial_traces[i]);
+    }
+    serial_timer.End();
+
+    CFastTimer batch_timer;
+    batch_timer.Start();
+    for (int i{0}; i < rays_num; i += kBundleRaysNum) {
+      g_pEngineTraceServer->TraceRays(&rays[i], min(kBundleRaysNum, rays_num - i),
+                                      MASK_SOLID, &filter, &batch_traces[i]);
+    }
+    batch_timer.End();
+
+    int kind_mismatches_num{0}, hits_num{0};
+    for (int i{0}; i < rays_num; ++i) {
+      if (!IsSameTrace(serial_traces[i], batch_traces[i])) {
+        if (kind_mismatches_num++ < 4) {
+          Warning(
+              "RunTraceRaysBenchmark: %s ray %d fraction %f differs from "
+              "serial %f.\n",
+              GetRaysKindName(kind), i, batch_traces[i].fraction,
+              serial_traces[i].fraction);
+        }
+      }
+
+      hits_num += serial_traces[i].DidHit() ? 1 : 0;
+    }
+    mismatches_num += kind_mismatches_num;
+
+    const double serial_seconds{serial_timer.GetDuration().GetSeconds()};
+    const double batch_seconds{batch_timer.GetDuration().GetSeconds()};
+
+    Msg("RunTraceRaysBenchmark: %-15s %d rays (%d hits): TraceRay %.0f "
+        "rays/s, TraceRays x%d %.0f rays/s (%.2fx). %s.\n",
+        GetRaysKindName(kind), rays_num, hits_num,
+        serial_seconds > 0 ? rays_num / serial_seconds : 0.0, kBundleRaysNum,
+        batch_seconds > 0 ? rays_num / batch_seconds : 0.0,
+        batch_seconds > 0 ? serial_seconds / batch_seconds : 0.0,
+        kind_mismatches_num ? "FAILED" : "PASSED");
+  }
+
+  return mismatches_num == 0;
+}
+
+bool RunConcurrentTraceTests(int threads_num, int rays_num) {
+  const cmodel_t *world{sv.IsActive() ? CM_InlineModelNumber(0) : nullptr};
+  if (!world) {
+    Warning("RunConcurrentTraceTests: Load a map before running tests.\n");
+    return false;
+  }
+
+  threads_num = clamp(threads_num, 1, 64);
+  rays_num = max(rays_num, 3 * kBundleRaysNum);
+
+  Msg("RunConcurrentTraceTests: Tracing %d rays from %d threads.\n", rays_num,
+      threads_num);
+
+  const Vector mins{world->mins + Vector{1, 1, 1}};
+  const Vector maxs{world->maxs - Vector{1, 1, 1}};
+
+  // A third of rays of each kind, bundles never straddle kinds.
+  const int kind_rays_num{rays_num / 3 / kBundleRaysNum * kBundleRaysNum};
+  rays_num = 3 * kind_rays_num;
+
+  std::unique_ptr<Ray_t[]> rays{std::make_unique<Ray_t[]>(rays_num)};
+  BuildRays(RaysKind::kCoherentRays, mins, maxs, &rays[0], kind_rays_num);
+  BuildRays(RaysKind::kCoherentHulls, mins, maxs, &rays[kind_rays_num],
+            kind_rays_num);
+  BuildRays(RaysKind::kIncoherentRays, mins, maxs, &rays[2 * kind_rays_num],
+            kind_rays_num);
+
+  const auto make_pass = [rays_num]() {
+    return TracePass{std::make_unique<trace_t[]>(rays_num),
+                     std::make_unique<int[]>(rays_num)};
+  };
+
+  TracePass serial_pass{make_pass()};
+  TraceAll(rays.get(), rays_num, 0, serial_pass);
+
+  std::unique_ptr<TracePass[]> passes{
+      std::make_unique<TracePass[]>(threads_num)};
+  std::unique_ptr<TraceWorkerContext[]> contexts{
+      std::make_unique<TraceWorkerContext[]>(threads_num)};
+  std::unique_ptr<CJob *[]> jobs{std::make_unique<CJob *[]>(threads_num)};
+
+  const int bundles_num{rays_num / kBundleRaysNum};
+  for (int i{0}; i < threads_num; ++i) {
+    passes[i] = make_pass();
+    contexts[i] = {rays.get(), rays_num, i * bundles_num / threads_num,
+                   &passes[i]};
+  }
+
+  IThreadPool *pool{CreateThreadPool()};
+
+  ThreadPoolStartParams_t params;
+  params.nThreads = threads_num;
+  params.fDistribute = TRS_FALSE;
+  pool->Start(params, "TraceTstJob");
+
+  CFastTimer timer;
+  timer.Start();
+
+  g_pEngineTraceServer->BeginReadOnlyTraces();
+
+  for (int i{0}; i < threads_num; ++i) {
+    jobs[i] = pool->QueueCall(&TraceWorker, &contexts[i]);
+  }
+
+  for (int i{0}; i < threads_num; ++i) {
+    jobs[i]->WaitForFinish();
+    jobs[i]->Release();
+  }
+
+  g_pEngineTraceServer->EndReadOnlyTraces();
+
+  timer.End();
+
+  pool->Stop();
+  DestroyThreadPool(pool);
+
+  int mismatches_num{0}, hits_num{0};
+  for (int i{0}; i < threads_num; ++i) {
+    for (int j{0}; j < rays_num; ++j) {
+      const trace_t &serial_trace = serial_pass.traces[j];
+      const trace_t &trace = passes[i].traces[j];
+
+      if (!IsSameTrace(serial_trace, trace) ||
+          serial_trace.m_pEnt != trace.m_pEnt ||
+          serial_trace.hitbox != trace.hitbox ||
+          serial_pass.contents[j] != passes[i].contents[j]) {
+        if (mismatches_num++ < 8) {
+          Warning(
+              "RunConcurrentTraceTests: Thread %d ray %d fraction %f (hitbox "
+              "%d) differs from serial %f (hitbox %d).\n",
+              i, j, trace.fraction, trace.hitbox, serial_trace.fraction,
+              serial_trace.hitbox);
+        }
+      }
+    }
+  }
+
+  for (int j{0}; j < rays_num; ++j) {
+    hits_num += serial_pass.traces[j].DidHit() ? 1 : 0;
+  }
+
+  Msg("RunConcurrentTraceTests: %d threads x %d rays (%d hits) in %.2fms, %d "
+      "mismatches. %s.\n",
+      threads_num, rays_num, hits_num, timer.GetDuration().GetMillisecondsF(),
+      mismatches_num, mismatches_num ? "FAILED" : "PASSED");
+
+  return mismatches_num == 0;
+}
+
+}  // namespace se::engine::tests::trace
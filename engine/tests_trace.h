@@ -0,0 +1,22 @@
+// Copyright Valve Corporation, All rights reserved.
+//
+// World tracing self-tests.
+
+#ifndef SE_ENGINE_TESTS_TRACE_H_
+#define SE_ENGINE_TESTS_TRACE_H_
+
+namespace se::engine::tests::trace {
+
+// Compares rays/sec of IEngineTrace::TraceRays against |rays_num| TraceRay
+// calls on the loaded map, for coherent ray bundles, coherent hull bundles and
+// incoherent rays. Fails if any batched trace differs from the serial one.
+bool RunTraceRaysBenchmark(int rays_num = 100000);
+
+// Traces |rays_num| rays against world, displacements and static props of the
+// loaded map from |threads_num| threads at once in read-only trace mode, then
+// compares every result with the serial run. Returns false on any mismatch.
+bool RunConcurrentTraceTests(int threads_num = 8, int rays_num = 30000);
+
+}  // namespace se::engine::tests::trace
+
+#endif  // !SE_ENGINE_TESTS_TRACE_H_
@@ -20,6 +20,7 @@
 #include "sys_dll.h"
 #include "sv_log.h"
 #include "sv_main.h"
+#include "sv_packedentities.h"
 #include "tier1/strtools.h"
 #include "collisionutils.h"
 #include "staticpropmgr.h"
@@ -1401,6 +1402,11 @@ public:
 		return &sv.edictchangeinfo[ NUM_FOR_EDICT( pEdict ) ];
 	}
 
+	void EdictStateChangedOverflow( edict_t *pEdict, unsigned short offset ) override
+	{
+		SV_EdictStateChangedOverflow( pEdict, offset );
+	}
+
 	QueryCvarCookie_t StartQueryCvarValue( edict_t *pPlayerEntity, const char *pCvarName ) override
 	{
 		int clientnum = NUM_FOR_EDICT( pPlayerEntity );
@@ -1681,10 +1687,12 @@ static CVEngineServer22 g_VEngineServer22;
 // INTERFACEVERSION_VENGINESERVER_VERSION_21 is compatible with 22 latest since we only added virtuals to the end, so expose that as well.
 EXPOSE_SINGLE_INTERFACE_GLOBALVAR( CVEngineServer, IVEngineServer021, INTERFACEVERSION_VENGINESERVER_VERSION_21, g_VEngineServer22 );
 EXPOSE_SINGLE_INTERFACE_GLOBALVAR( CVEngineServer, IVEngineServer022, INTERFACEVERSION_VENGINESERVER_VERSION_22, g_VEngineServer22 );
+// INTERFACEVERSION_VENGINESERVER_VERSION_23 only lacks EdictStateChangedOverflow at the end.
+EXPOSE_SINGLE_INTERFACE_GLOBALVAR( CVEngineServer, IVEngineServer023, INTERFACEVERSION_VENGINESERVER_VERSION_23, g_VEngineServer );
 EXPOSE_SINGLE_INTERFACE_GLOBALVAR( CVEngineServer, IVEngineServer, INTERFACEVERSION_VENGINESERVER, g_VEngineServer );
 
 // When bumping the version to this interface, check that our assumption is still valid and expose the older version in the same way
-COMPILE_TIME_ASSERT( INTERFACEVERSION_VENGINESERVER_INT == 23 );
+COMPILE_TIME_ASSERT( INTERFACEVERSION_VENGINESERVER_INT == 24 );
 
 //-----------------------------------------------------------------------------
 // Expose CVEngineServer to the engine.
@@ -326,6 +326,75 @@ CON_COMMAND( vprof_dump_groupnames, "Write the names of all of the vprof groups
 	}
 }
 
+CON_COMMAND( vprof_trace_start, "Start recording a per-thread timeline of VProf scopes and jobs." )
+{
+	VProfTraceEnable( true );
+	Msg( "VProf trace enabled.\n" );
+}
+
+CON_COMMAND( vprof_trace_stop, "Stop recording the VProf timeline." )
+{
+	VProfTraceEnable( false );
+	Msg( "VProf trace disabled.\n" );
+}
+
+static void VProfTraceWriteToFile( const void *pData, size_t nBytes, void *pContext )
+{
+	g_pFileSystem->Write( pData, static_cast<int>( nBytes ), static_cast<FileHandle_t>( pContext ) );
+}
+
+CON_COMMAND( vprof_trace_dump, "Write the last N seconds of the VProf timeline as Chrome trace JSON or Perfetto protobuf." )
+{
+	if ( args.ArgC() < 2 || args.ArgC() > 4 )
+	{
+		Warning( "vprof_trace_dump filename [seconds (default 10, 0 for everything recorded)] [json|perfetto]\n" );
+		return;
+	}
+
+	const char *pFilename = args[ 1 ];
+	const double flSeconds = args.ArgC() >= 3 ? atof( args[ 2 ] ) : 10.0;
+
+	// Perfetto traces are usually named .pftrace, anything else gets JSON unless asked otherwise.
+	const char *pExtension = V_GetFileExtension( pFilename );
+	VProfTraceFormat_t format = pExtension && !Q_stricmp( pExtension, "pftrace" )
+		? VPROF_TRACE_FORMAT_PERFETTO
+		: VPROF_TRACE_FORMAT_JSON;
+
+	if ( args.ArgC() == 4 )
+	{
+		if ( !Q_stricmp( args[ 3 ], "perfetto" ) )
+		{
+			format = VPROF_TRACE_FORMAT_PERFETTO;
+		}
+		else if ( !Q_stricmp( args[ 3 ], "json" ) )
+		{
+			format = VPROF_TRACE_FORMAT_JSON;
+		}
+		else
+		{
+			Warning( "vprof_trace_dump: unknown format \"%s\", expected json or perfetto.\n", args[ 3 ] );
+			return;
+		}
+	}
+
+	if ( !VProfTraceIsEnabled() )
+	{
+		Warning( "vprof_trace_dump: tracing is off, use vprof_trace_start. Writing whatever was recorded before.\n" );
+	}
+
+	FileHandle_t hFile = g_pFileSystem->Open( pFilename, "wb" );
+	if ( !hFile )
+	{
+		Warning( "vprof_trace_dump: couldn't open %s for writing.\n", pFilename );
+		return;
+	}
+
+	const int nEvents = VProfTraceWrite( format, flSeconds, VProfTraceWriteToFile, hFile );
+	g_pFileSystem->Close( hFile );
+
+	Msg( "Wrote %d VProf trace events to %s.\n", nEvents, pFilename );
+}
+
 DEFERRED_CON_COMMAND( vprof_cachemiss, "Toggle VProf cache miss checking" )
 {
 	if ( !g_fVprofCacheMissOnByUI )
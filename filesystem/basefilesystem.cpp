@@ -260,7 +260,8 @@ private:
 //-----------------------------------------------------------------------------
 
 CBaseFileSystem::CBaseFileSystem()
-	: m_FileTracker2( this )
+	: m_FileTracker2( this ),
+	m_FileLocationIndex( this )
 {
 	g_pBaseFileSystem = this;
 	g_pFullFileSystem = this;
@@ -340,6 +341,21 @@ InitReturnVal_t CBaseFileSystem::Init()
 		m_bOutputDebugString = true;
 	}
 
+#if defined( SUPPORT_PACKED_STORE )
+	// Map VPK directories and archives unless told otherwise.
+	if ( CommandLine()->FindParm( "-novpkmmap" ) )
+	{
+		CPackedStore::EnableMapping( false );
+	}
+#endif
+
+	// Index search paths so lookups skip the ones which don't have the file.
+	// Saved on shutdown to -fs_fileindex <file>, revalidated on next startup.
+	if ( CommandLine()->FindParm( "-fs_fileindex" ) )
+	{
+		m_FileLocationIndex.Enable( CommandLine()->ParmValue( "-fs_fileindex", "fs_fileindex.bin" ) );
+	}
+
 	const char *logFileName = CommandLine()->ParmValue( "-fs_log" );
 	if( logFileName )
 	{
@@ -411,6 +427,8 @@ InitReturnVal_t CBaseFileSystem::Init()
 
 void CBaseFileSystem::Shutdown()
 {
+	m_FileLocationIndex.Save();
+
 	ShutdownAsync();
 	m_FileTracker2.ShutdownAsync();
 
@@ -792,6 +810,7 @@ void CBaseFileSystem::AddVPKFile( char const *pPath, const char *pPathID, Search
 	CSearchPath *sp = &m_SearchPaths[ ( addType == PATH_ADD_TO_TAIL ) ? m_SearchPaths.AddToTail() : m_SearchPaths.AddToHead() ];
 	sp->SetPackedStore( pVPK );
 	sp->m_storeId = g_iNextSearchPathID++;
+	sp->m_nFileIndexSource = m_FileLocationIndex.AddPackedStore( pVPK );
 	sp->SetPath( pathIDSym );
 	sp->m_pPathIDInfo = FindOrAddPathIDInfo( g_PathIDTable.AddString( pPathID ), -1 );
 
@@ -1415,6 +1434,7 @@ void CBaseFileSystem::AddSearchPathInternal( const char *pPath, const char *path
 
 	// all matching paths have a reference to the same store
 	sp->m_storeId = id;
+	sp->m_nFileIndexSource = m_FileLocationIndex.AddLooseDirectory( newPath, pathID );
 }
 
 //-----------------------------------------------------------------------------
@@ -1764,13 +1784,69 @@ bool CBaseFileSystem::ReadFile( const char *pFileName, const char *pPath, CUtlBu
 		g_pszReadFilename.Set( pFileName );
 	}
 
-	bool bSuccess = ReadToBuffer( fp, buf, nMaxBytes, pfnAlloc );
+	bool bSuccess = bBinary && buf.IsReadOnly() && !pfnAlloc
+		? ReadToReadOnlyBuffer( fp, buf, nMaxBytes )
+		: ReadToBuffer( fp, buf, nMaxBytes, pfnAlloc );
 
 	Close( fp );
 
 	return bSuccess;
 }
 
+//-----------------------------------------------------------------------------
+// Read-only buffers are never written to after the read, so whole files from
+// preload data or mapped VPK archives are handed out in place, without a copy.
+// They stay valid while the VPK is mounted.  Anything else is read into memory
+// the buffer owns.
+//-----------------------------------------------------------------------------
+bool CBaseFileSystem::ReadToReadOnlyBuffer( FileHandle_t fp, CUtlBuffer &buf, int nMaxBytes )
+{
+	if ( buf.TellPut() != 0 )
+	{
+		// can't append to read-only memory
+		return false;
+	}
+
+	int nStartPos = Tell( fp );
+	int nBytesToRead = Size( fp ) - nStartPos;
+	if ( nMaxBytes > 0 )
+	{
+		// can't read more than file has
+		nBytesToRead = min( nMaxBytes, nBytesToRead );
+	}
+
+	if ( nBytesToRead <= 0 )
+	{
+		// no data in file
+		return true;
+	}
+
+#if defined( SUPPORT_PACKED_STORE )
+	CFileHandle *fh = (CFileHandle *)fp;
+	if ( fh->m_VPKHandle )
+	{
+		const void *pData = fh->m_VPKHandle.DirectData();
+		if ( pData )
+		{
+			buf.SetExternalBuffer( const_cast<byte *>( static_cast<const byte *>( pData ) ) + nStartPos, nBytesToRead, nBytesToRead, buf.GetFlags() );
+			Seek( fp, nStartPos + nBytesToRead, FILESYSTEM_SEEK_HEAD );
+			return true;
+		}
+	}
+#endif
+
+	void *pMemory = malloc( nBytesToRead );
+	if ( !pMemory )
+	{
+		return false;
+	}
+
+	int nBytesRead = Read( pMemory, nBytesToRead, fp );
+	buf.AssumeMemory( pMemory, nBytesToRead, Max( nBytesRead, 0 ), buf.GetFlags() );
+
+	return nBytesRead > 0;
+}
+
 //-----------------------------------------------------------------------------
 //
 //-----------------------------------------------------------------------------
@@ -2346,6 +2422,13 @@ FileHandle_t CBaseFileSystem::OpenForRead( const char *pFileNameT, const char *p
 	PathTypeFilter_t pathFilter = FILTER_NONE;
 
 	CSearchPathsIterator iter( this, &pFileName, pathID, pathFilter );
+
+	uint64 nFileLocations;
+	if ( m_FileLocationIndex.Find( pFileName, nFileLocations ) )
+	{
+		iter.SetFileLocations( nFileLocations );
+	}
+
 	for ( openInfo.m_pSearchPath = iter.GetFirst(); openInfo.m_pSearchPath != nullptr; openInfo.m_pSearchPath = iter.GetNext() )
 	{
 		FileHandle_t filehandle = FindFileInSearchPath( openInfo );
@@ -2415,6 +2498,8 @@ FileHandle_t CBaseFileSystem::OpenForWrite( const char *pFileName, const char *p
 		return nullptr;
 	}
 
+	m_FileLocationIndex.NoteFileAdded( pTmpFileName );
+
 	auto *fh = new CFileHandle( this );
 	fh->m_nLength = size;
 	fh->m_type = FT_NORMAL;
@@ -3159,6 +3244,12 @@ time_t CBaseFileSystem::GetFileTime( const char *pFileName, const char *pPathID
 	V_strlower( tempFileName );
 #endif
 
+	uint64 nFileLocations;
+	if ( m_FileLocationIndex.Find( tempFileName, nFileLocations ) )
+	{
+		iter.SetFileLocations( nFileLocations );
+	}
+
 	for ( CSearchPath *pSearchPath = iter.GetFirst(); pSearchPath != nullptr; pSearchPath = iter.GetNext() )
 	{
 		time_t ft = FastFileTime( pSearchPath, tempFileName );
@@ -4445,7 +4536,10 @@ void CBaseFileSystem::RemoveFile( char const* pRelativePath, const char *pathID
 		Warning( FILESYSTEM_WARNING, "Unable to remove file '%s': %s.\n",
 			szScratchFileName,
 			std::generic_category().message(errno).c_str() );
+		return;
 	}
+
+	m_FileLocationIndex.NoteFileRemoved( szScratchFileName );
 }
 
 
@@ -4509,6 +4603,9 @@ bool CBaseFileSystem::RenameFile( char const *pOldPath, char const *pNewPath, co
 		return false;
 	}
 
+	m_FileLocationIndex.NoteFileRemoved( szScratchFileName );
+	m_FileLocationIndex.NoteFileAdded( pNewFileName );
+
 	return true;
 }
 
@@ -4662,6 +4759,7 @@ CBaseFileSystem::CSearchPath::CSearchPath( void )
 	m_bIsRemotePath = false;
 	m_pPackedStore = nullptr;
 	m_bIsTrustedForPureServer = false;
+	m_nFileIndexSource = -1;
 }
 
 const char *CBaseFileSystem::CSearchPath::GetDebugString() const
@@ -4734,6 +4832,9 @@ CBaseFileSystem::CSearchPath *CBaseFileSystem::CSearchPathsIterator::GetNext()
 		if ( CBaseFileSystem::FilterByPathID( pSearchPath, m_pathID ) )
 			continue;
 
+		if ( !CFileLocationIndex::MayHave( pSearchPath->m_nFileIndexSource, m_nFileLocations ) )
+			continue;
+
 		if ( !m_visits.MarkVisit( *pSearchPath ) )
 			break;
 	}
@@ -60,6 +60,7 @@
 #include "tier1/byteswap.h"
 #include "threadsaferefcountedobject.h"
 #include "filetracker.h"
+#include "filelocationindex.h"
 // #include "filesystem_init.h"
 
 #if defined( SUPPORT_PACKED_STORE )
@@ -219,6 +220,7 @@ abstract_class CBaseFileSystem : public CTier1AppSystem< IFileSystem >
 	friend class CFileTracker;
 	friend class CFileTracker2;
 	friend class CFileOpenInfo;
+	friend class CFileLocationIndex;
 
 	typedef CTier1AppSystem< IFileSystem > BaseClass;
 
@@ -522,6 +524,9 @@ public:
 
 		bool				m_bIsTrustedForPureServer;
 
+		// CFileLocationIndex source, -1 if not indexed.
+		int					m_nFileIndexSource;
+
 	private:
 		CUtlSymbol			m_Path;
 		const char			*m_pDebugPath;
@@ -557,7 +562,8 @@ public:
 	public:
 		CSearchPathsIterator( CBaseFileSystem *pFileSystem, const char **ppszFilename, const char *pszPathID, PathTypeFilter_t pathTypeFilter = FILTER_NONE )
 		  : m_iCurrent( -1 ),
-			m_PathTypeFilter( pathTypeFilter )
+			m_PathTypeFilter( pathTypeFilter ),
+			m_nFileLocations( ~0ull )
 		{
 			char tempPathID[MAX_PATH];
 			if ( *ppszFilename && (*ppszFilename)[0] == '/' && (*ppszFilename)[1] == '/' ) // ONLY '//' (and not '\\') for our special format
@@ -597,7 +603,8 @@ public:
 
 		CSearchPathsIterator( CBaseFileSystem *pFileSystem, const char *pszPathID, PathTypeFilter_t pathTypeFilter = FILTER_NONE )
 		  : m_iCurrent( -1 ),
-			m_PathTypeFilter( pathTypeFilter )
+			m_PathTypeFilter( pathTypeFilter ),
+			m_nFileLocations( ~0ull )
 		{
 			if ( pszPathID ) 
 			{
@@ -617,6 +624,9 @@ public:
 		CSearchPath *GetFirst();
 		CSearchPath *GetNext();
 
+		// Skip indexed search paths which are not in CFileLocationIndex mask.
+		void SetFileLocations( uint64 nSourcesMask ) { m_nFileLocations = nSourcesMask; }
+
 	private:
 		CSearchPathsIterator( const  CSearchPathsIterator & );
 		void operator=(const CSearchPathsIterator &);
@@ -629,6 +639,7 @@ public:
 		CSearchPath					m_EmptySearchPath;
 		CPathIDInfo					m_EmptyPathIDInfo;
 		PathTypeFilter_t			m_PathTypeFilter;
+		uint64						m_nFileLocations;
 		char						m_Filename[MAX_PATH];	// set for relative names only
 	};
 
@@ -690,6 +701,7 @@ public:
 #endif
 
 	CFileTracker2	m_FileTracker2;
+	CFileLocationIndex	m_FileLocationIndex;
 
 protected:
 	//----------------------------------------------------------------------------
@@ -789,6 +801,9 @@ protected:
 
 	void						HandleOpenRegularFile( CFileOpenInfo &openInfo, bool bIsAbsolutePath );
 
+	// Fills read-only buffer for ReadFile, pointing it at mapped pack data when possible.
+	bool						ReadToReadOnlyBuffer( FileHandle_t fp, CUtlBuffer &buf, int nMaxBytes );
+
 	FileHandle_t				FindFileInSearchPath( CFileOpenInfo &openInfo );
 	time_t						FastFileTime( const CSearchPath *path, const char *pFileName );
 
@@ -0,0 +1,768 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Index of which search paths have which files, so relative lookups
+//			only probe search paths which actually have the file.
+//
+//=============================================================================
+
+#include "filelocationindex.h"
+
+#include <ctime>
+
+#include "basefilesystem.h"
+#include "tier0/fasttimer.h"
+#include "tier1/convar.h"
+
+// NOTE: This has to be the last file included!
+#include "tier0/memdbgon.h"
+
+ConVar fs_fileindex_lookups( "fs_fileindex_lookups", "1", 0, "Use file location index (-fs_fileindex) to skip search paths which don't have the file." );
+
+namespace
+{
+
+constexpr unsigned FILELOCATIONINDEX_MAGIC = MAKEID( 'F', 'S', 'I', 'X' );
+constexpr int FILELOCATIONINDEX_VERSION = 1;
+
+// Guards against directory link cycles.
+constexpr int MAX_SCAN_DEPTH = 32;
+
+// Roots are lowercased on Windows only, see CBaseFileSystem::AddSearchPathInternal.
+bool IsUnderRoot( const char *pszName, const char *pszRoot, intp nRootLength )
+{
+#ifdef _WIN32
+	return V_strnicmp( pszName, pszRoot, nRootLength ) == 0;
+#else
+	return V_strncmp( pszName, pszRoot, nRootLength ) == 0;
+#endif
+}
+
+bool IsSameRoot( const char *pszRoot1, const char *pszRoot2 )
+{
+#ifdef _WIN32
+	return V_stricmp( pszRoot1, pszRoot2 ) == 0;
+#else
+	return V_strcmp( pszRoot1, pszRoot2 ) == 0;
+#endif
+}
+
+}  // namespace
+
+CFileLocationIndex::CFileLocationIndex( CBaseFileSystem *pFileSystem )
+	: m_pFileSystem( pFileSystem ),
+	m_bEnabled( false ),
+	m_nSources( 0 ),
+	m_nReusedSources( 0 ),
+	m_nScannedSources( 0 ),
+	m_flBuildSeconds( 0 )
+{
+}
+
+CFileLocationIndex::~CFileLocationIndex()
+{
+	m_CachedListings.PurgeAndDeleteElements();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Turns index on and loads listings saved by previous run.
+//-----------------------------------------------------------------------------
+void CFileLocationIndex::Enable( const char *pszCacheFileName )
+{
+	m_bEnabled = true;
+
+	if ( pszCacheFileName && pszCacheFileName[0] )
+	{
+		char szCacheFileName[MAX_PATH];
+		V_MakeAbsolutePath( szCacheFileName, pszCacheFileName );
+		m_CacheFileName = szCacheFileName;
+
+		Load();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Relative names which can be answered by index.  Anything which
+//			could resolve outside of search path root goes the slow way.
+//-----------------------------------------------------------------------------
+bool CFileLocationIndex::IsIndexableName( const char *pszRelativeName )
+{
+	if ( !pszRelativeName[0] || PATHSEPARATOR( pszRelativeName[0] ) || V_IsAbsolutePath( pszRelativeName ) )
+		return false;
+
+	if ( V_strstr( pszRelativeName, ".." ) || strpbrk( pszRelativeName, ":*?" ) )
+		return false;
+
+	if ( pszRelativeName[0] == '.' && ( !pszRelativeName[1] || PATHSEPARATOR( pszRelativeName[1] ) ) )
+		return false;
+
+	if ( V_strstr( pszRelativeName, CORRECT_PATH_SEPARATOR_S "." CORRECT_PATH_SEPARATOR_S ) )
+		return false;
+
+	return !PATHSEPARATOR( pszRelativeName[V_strlen( pszRelativeName ) - 1] );
+}
+
+int CFileLocationIndex::FindSource( const char *pszRoot ) const
+{
+	for ( int i = 0; i < m_nSources; ++i )
+	{
+		if ( IsSameRoot( m_Sources[i].m_Root.Get(), pszRoot ) )
+			return i;
+	}
+
+	return -1;
+}
+
+int CFileLocationIndex::NewSource( const char *pszRoot, bool bPackedStore )
+{
+	Assert( m_nSources < MAX_SOURCES );
+
+	Source_t &source = m_Sources[m_nSources];
+	source.m_Root = pszRoot;
+	source.m_bPackedStore = bPackedStore;
+	source.m_Dirs.RemoveAll();
+
+	return m_nSources++;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Index loose directory of GAME / MOD search path.  Other paths
+//			(BASE_PATH, EXECUTABLE_PATH, ...) would cover the whole install.
+//-----------------------------------------------------------------------------
+int CFileLocationIndex::AddLooseDirectory( const char *pszRoot, const char *pszPathID )
+{
+	if ( !m_bEnabled || !pszRoot[0] )
+		return -1;
+
+	// Same directory under other path ID shares listing.
+	int nSource = FindSource( pszRoot );
+	if ( nSource >= 0 )
+		return nSource;
+
+	if ( !pszPathID || ( V_stricmp( pszPathID, "GAME" ) && V_stricmp( pszPathID, "MOD" ) ) )
+		return -1;
+
+	if ( m_nSources >= MAX_SOURCES )
+	{
+		DevWarning( "FS: File location index is full, not indexing %s.\n", pszRoot );
+		return -1;
+	}
+
+	CFastTimer timer;
+	timer.Start();
+
+	Listing_t listing;
+	bool bReused;
+	ListLooseDirectory( pszRoot, listing, bReused );
+
+	m_Lock.LockForWrite();
+	nSource = NewSource( pszRoot, false );
+	ReplaceSourceNames( nSource, listing );
+	m_Lock.UnlockWrite();
+
+	timer.End();
+
+	const double flSeconds = timer.GetDuration().GetSeconds();
+	m_flBuildSeconds += flSeconds;
+	++( bReused ? m_nReusedSources : m_nScannedSources );
+
+	DevMsg( "FS: File location index %s %s (%zd names) in %.2f ms.\n",
+		bReused ? "reused" : "listed", pszRoot, listing.m_Files.Count(), flSeconds * 1000 );
+
+	return nSource;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: VPK directories are already in memory, so always list them.
+//-----------------------------------------------------------------------------
+int CFileLocationIndex::AddPackedStore( CPackedStore *pPackedStore )
+{
+#ifdef SUPPORT_PACKED_STORE
+	if ( !m_bEnabled )
+		return -1;
+
+	int nSource = FindSource( pPackedStore->FullPathName() );
+	if ( nSource >= 0 )
+		return nSource;
+
+	if ( m_nSources >= MAX_SOURCES )
+	{
+		DevWarning( "FS: File location index is full, not indexing %s.\n", pPackedStore->FullPathName() );
+		return -1;
+	}
+
+	CFastTimer timer;
+	timer.Start();
+
+	CUtlStringList files;
+	pPackedStore->GetFileList( files, false, false );
+
+	m_Lock.LockForWrite();
+	nSource = NewSource( pPackedStore->FullPathName(), true );
+	for ( char *pszName : files )
+	{
+		V_FixSlashes( pszName, CORRECT_PATH_SEPARATOR );
+		V_strlower( pszName );
+
+		AddName( pszName, nSource );
+	}
+	m_Lock.UnlockWrite();
+
+	timer.End();
+
+	const double flSeconds = timer.GetDuration().GetSeconds();
+	m_flBuildSeconds += flSeconds;
+	++m_nScannedSources;
+
+	DevMsg( "FS: File location index listed %s (%zd files) in %.2f ms.\n",
+		pPackedStore->FullPathName(), files.Count(), flSeconds * 1000 );
+
+	return nSource;
+#else
+	return -1;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Gets mask of sources which have relative name.
+//-----------------------------------------------------------------------------
+bool CFileLocationIndex::Find( const char *pszRelativeName, uint64 &nSourcesMask ) const
+{
+	if ( !m_bEnabled || !fs_fileindex_lookups.GetBool() )
+		return false;
+
+	char szName[MAX_PATH];
+	if ( V_strlen( pszRelativeName ) >= ssize( szName ) )
+		return false;
+
+	V_strcpy_safe( szName, pszRelativeName );
+	V_FixSlashes( szName, CORRECT_PATH_SEPARATOR );
+	V_strlower( szName );
+
+	if ( !IsIndexableName( szName ) )
+		return false;
+
+	m_Lock.LockForRead();
+	const UtlHashHandle_t h = m_Names.Find( szName );
+	nSourcesMask = h != m_Names.InvalidHandle() ? m_Names[h] : 0;
+	m_Lock.UnlockRead();
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Adds name and its parent directories to source.
+//-----------------------------------------------------------------------------
+void CFileLocationIndex::AddName( const char *pszRelativeName, int nSource )
+{
+	const uint64 nSourceBit = 1ull << nSource;
+
+	char szName[MAX_PATH];
+	V_strcpy_safe( szName, pszRelativeName );
+
+	for ( char *pSeparator = strchr( szName, CORRECT_PATH_SEPARATOR ); pSeparator; pSeparator = strchr( pSeparator + 1, CORRECT_PATH_SEPARATOR ) )
+	{
+		*pSeparator = '\0';
+		m_Names[m_Names.Insert( szName, 0 )] |= nSourceBit;
+		*pSeparator = CORRECT_PATH_SEPARATOR;
+	}
+
+	m_Names[m_Names.Insert( szName, 0 )] |= nSourceBit;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Swaps in new listing of loose source.  Names which no source has
+//			any more stay in table with empty mask, which reads as missing.
+//-----------------------------------------------------------------------------
+void CFileLocationIndex::ReplaceSourceNames( int nSource, Listing_t &listing )
+{
+	const uint64 nSourceBit = 1ull << nSource;
+
+	FOR_EACH_HASHTABLE( m_Names, h )
+	{
+		m_Names[h] &= ~nSourceBit;
+	}
+
+	for ( const CUtlString &name : listing.m_Files )
+	{
+		AddName( name.Get(), nSource );
+	}
+
+	Source_t &source = m_Sources[nSource];
+	source.m_Dirs.Swap( listing.m_Dirs );
+}
+
+bool CFileLocationIndex::GetModifyTime( const char *pszName, int64 &nModifyTime ) const
+{
+	char szName[MAX_PATH];
+	V_strcpy_safe( szName, pszName );
+	V_StripTrailingSlash( szName );
+
+	struct _stat buf;
+	if ( m_pFileSystem->FS_stat( szName, &buf ) == -1 )
+		return false;
+
+	nModifyTime = buf.st_mtime;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Lists directory tree.  Directory is stamped before it is listed,
+//			so files added while listing make stamp stale.
+//-----------------------------------------------------------------------------
+void CFileLocationIndex::ScanDirectory( const char *pszRoot, const char *pszDir, int64 nScanTime, int nDepth, Listing_t &listing ) const
+{
+	char szPath[MAX_PATH];
+	V_sprintf_safe( szPath, "%s%s", pszRoot, pszDir );
+
+	// Missing directories are stamped too, so they are relisted once created.
+	DirStamp_t &stamp = listing.m_Dirs[listing.m_Dirs.AddToTail()];
+	stamp.m_Name = pszDir;
+	if ( !GetModifyTime( szPath, stamp.m_nModifyTime ) )
+	{
+		stamp.m_nModifyTime = -1;
+		return;
+	}
+
+	// Times are seconds, so directory changed in this second could change
+	// again after it was listed.  Never trust such stamp.
+	if ( stamp.m_nModifyTime >= nScanTime - 1 )
+	{
+		stamp.m_nModifyTime = -2;
+	}
+
+	char szWildCard[MAX_PATH];
+	V_sprintf_safe( szWildCard, "%s*", szPath );
+
+	WIN32_FIND_DATA findData;
+	HANDLE hFind = m_pFileSystem->FS_FindFirstFile( szWildCard, &findData );
+	if ( hFind == INVALID_HANDLE_VALUE )
+		return;
+
+	do
+	{
+		if ( !V_strcmp( findData.cFileName, "." ) || !V_strcmp( findData.cFileName, ".." ) )
+			continue;
+
+		char szName[MAX_PATH];
+		V_sprintf_safe( szName, "%s%s", pszDir, findData.cFileName );
+
+		char szLowercaseName[MAX_PATH];
+		V_strcpy_safe( szLowercaseName, szName );
+		V_strlower( szLowercaseName );
+		listing.m_Files.AddToTail( szLowercaseName );
+
+		if ( ( findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) && nDepth < MAX_SCAN_DEPTH )
+		{
+			V_strcat_safe( szName, CORRECT_PATH_SEPARATOR_S );
+			ScanDirectory( pszRoot, szName, nScanTime, nDepth + 1, listing );
+		}
+	}
+	while ( m_pFileSystem->FS_FindNextFile( hFind, &findData ) );
+
+	m_pFileSystem->FS_FindClose( hFind );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Listing is current when all its directories have the same modify
+//			time as when they were listed.
+//-----------------------------------------------------------------------------
+bool CFileLocationIndex::IsListingCurrent( const Listing_t &listing ) const
+{
+	char szPath[MAX_PATH];
+
+	for ( const DirStamp_t &stamp : listing.m_Dirs )
+	{
+		V_sprintf_safe( szPath, "%s%s", listing.m_Root.Get(), stamp.m_Name.Get() );
+
+		int64 nModifyTime;
+		if ( !GetModifyTime( szPath, nModifyTime ) )
+		{
+			nModifyTime = -1;
+		}
+
+		if ( nModifyTime != stamp.m_nModifyTime )
+			return false;
+	}
+
+	return listing.m_Dirs.Count() > 0;
+}
+
+bool CFileLocationIndex::TakeCachedListing( const char *pszRoot, Listing_t &listing )
+{
+	FOR_EACH_VEC( m_CachedListings, i )
+	{
+		Listing_t *pCached = m_CachedListings[i];
+		if ( IsSameRoot( pCached->m_Root.Get(), pszRoot ) )
+		{
+			listing.m_Root = pCached->m_Root;
+			listing.m_Dirs.Swap( pCached->m_Dirs );
+			listing.m_Files.Swap( pCached->m_Files );
+
+			delete pCached;
+			m_CachedListings.FastRemove( i );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void CFileLocationIndex::ListLooseDirectory( const char *pszRoot, Listing_t &listing, bool &bReused )
+{
+	bReused = TakeCachedListing( pszRoot, listing ) && IsListingCurrent( listing );
+	if ( bReused )
+		return;
+
+	listing.m_Root = pszRoot;
+	listing.m_Dirs.RemoveAll();
+	listing.m_Files.RemoveAll();
+
+	ScanDirectory( pszRoot, "", time( nullptr ), 0, listing );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Restamps directories from source root to name, so writes done
+//			through file system do not make saved listing stale.
+//-----------------------------------------------------------------------------
+void CFileLocationIndex::RestampParentDirs( int nSource, const char *pszRelativeName )
+{
+	Source_t &source = m_Sources[nSource];
+
+	char szDir[MAX_PATH];
+	V_strcpy_safe( szDir, pszRelativeName );
+
+	char *pEnd = szDir;
+	for ( ;; )
+	{
+		const char cEnd = *pEnd;
+		*pEnd = '\0';
+
+		intp iStamp = source.m_Dirs.Count() - 1;
+		for ( ; iStamp >= 0; --iStamp )
+		{
+			if ( !V_stricmp( source.m_Dirs[iStamp].m_Name.Get(), szDir ) )
+				break;
+		}
+
+		if ( iStamp < 0 )
+		{
+			iStamp = source.m_Dirs.AddToTail();
+			source.m_Dirs[iStamp].m_Name = szDir;
+		}
+
+		char szPath[MAX_PATH];
+		V_sprintf_safe( szPath, "%s%s", source.m_Root.Get(), source.m_Dirs[iStamp].m_Name.Get() );
+
+		int64 nModifyTime;
+		if ( !GetModifyTime( szPath, nModifyTime ) )
+		{
+			nModifyTime = -1;
+		}
+		source.m_Dirs[iStamp].m_nModifyTime = nModifyTime;
+
+		*pEnd = cEnd;
+
+		char *pSeparator = strchr( pEnd, CORRECT_PATH_SEPARATOR );
+		if ( !pSeparator )
+			break;
+
+		pEnd = pSeparator + 1;
+	}
+}
+
+void CFileLocationIndex::NoteFileAdded( const char *pszAbsoluteName )
+{
+	if ( !m_bEnabled )
+		return;
+
+	char szName[MAX_PATH];
+	V_strcpy_safe( szName, pszAbsoluteName );
+	V_FixSlashes( szName, CORRECT_PATH_SEPARATOR );
+
+	m_Lock.LockForWrite();
+	for ( int i = 0; i < m_nSources; ++i )
+	{
+		const Source_t &source = m_Sources[i];
+		const intp nRootLength = source.m_Root.Length();
+		if ( source.m_bPackedStore || !IsUnderRoot( szName, source.m_Root.Get(), nRootLength ) )
+			continue;
+
+		// Stamps keep on disk case, names are lowercase.
+		const char *pszRelativeName = szName + nRootLength;
+
+		char szLowercaseName[MAX_PATH];
+		V_strcpy_safe( szLowercaseName, pszRelativeName );
+		V_strlower( szLowercaseName );
+
+		if ( IsIndexableName( szLowercaseName ) )
+		{
+			AddName( szLowercaseName, i );
+			RestampParentDirs( i, pszRelativeName );
+		}
+	}
+	m_Lock.UnlockWrite();
+}
+
+void CFileLocationIndex::NoteFileRemoved( const char *pszAbsoluteName )
+{
+	if ( !m_bEnabled )
+		return;
+
+	char szName[MAX_PATH];
+	V_strcpy_safe( szName, pszAbsoluteName );
+	V_FixSlashes( szName, CORRECT_PATH_SEPARATOR );
+
+	m_Lock.LockForWrite();
+	for ( int i = 0; i < m_nSources; ++i )
+	{
+		const Source_t &source = m_Sources[i];
+		const intp nRootLength = source.m_Root.Length();
+		if ( source.m_bPackedStore || !IsUnderRoot( szName, source.m_Root.Get(), nRootLength ) )
+			continue;
+
+		const char *pszRelativeName = szName + nRootLength;
+
+		char szLowercaseName[MAX_PATH];
+		V_strcpy_safe( szLowercaseName, pszRelativeName );
+		V_strlower( szLowercaseName );
+
+		if ( IsIndexableName( szLowercaseName ) )
+		{
+			const UtlHashHandle_t h = m_Names.Find( szLowercaseName );
+			if ( h != m_Names.InvalidHandle() )
+			{
+				m_Names[h] &= ~( 1ull << i );
+			}
+
+			RestampParentDirs( i, pszRelativeName );
+		}
+	}
+	m_Lock.UnlockWrite();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Relists loose sources.  Each source is swapped in at once, so
+//			lookups never see half of a listing.
+//-----------------------------------------------------------------------------
+void CFileLocationIndex::Rebuild( bool bReuseCache )
+{
+	if ( !m_bEnabled )
+	{
+		Msg( "File location index is off, run with -fs_fileindex to turn it on.\n" );
+		return;
+	}
+
+	if ( bReuseCache && !( Save() && Load() ) )
+	{
+		Warning( "FS: Unable to save file location index to %s, listing all directories.\n", m_CacheFileName.Get() );
+	}
+
+	CFastTimer timer;
+	timer.Start();
+
+	int nReused = 0, nScanned = 0;
+	for ( int i = 0; i < m_nSources; ++i )
+	{
+		if ( m_Sources[i].m_bPackedStore )
+			continue;
+
+		Listing_t listing;
+		bool bReused;
+		ListLooseDirectory( m_Sources[i].m_Root.Get(), listing, bReused );
+
+		m_Lock.LockForWrite();
+		ReplaceSourceNames( i, listing );
+		m_Lock.UnlockWrite();
+
+		++( bReused ? nReused : nScanned );
+	}
+
+	timer.End();
+
+	Msg( "File location index: %d directories reused, %d listed in %.2f ms.\n",
+		nReused, nScanned, timer.GetDuration().GetMillisecondsF() );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Saves loose listings.  Cached listings of directories which were
+//			not mounted this run are kept.
+//-----------------------------------------------------------------------------
+bool CFileLocationIndex::Save()
+{
+	if ( !m_bEnabled || m_CacheFileName.IsEmpty() )
+		return false;
+
+	CUtlBuffer buf;
+	buf.PutUnsignedInt( FILELOCATIONINDEX_MAGIC );
+	buf.PutInt( FILELOCATIONINDEX_VERSION );
+
+	m_Lock.LockForRead();
+
+	int nListings = m_CachedListings.Count();
+	for ( int i = 0; i < m_nSources; ++i )
+	{
+		if ( !m_Sources[i].m_bPackedStore )
+			++nListings;
+	}
+	buf.PutInt( nListings );
+
+	CUtlVector<const char *> names;
+	for ( int i = 0; i < m_nSources; ++i )
+	{
+		const Source_t &source = m_Sources[i];
+		if ( source.m_bPackedStore )
+			continue;
+
+		buf.PutString( source.m_Root.Get() );
+
+		buf.PutInt( source.m_Dirs.Count() );
+		for ( const DirStamp_t &stamp : source.m_Dirs )
+		{
+			buf.PutString( stamp.m_Name.Get() );
+			buf.PutInt64( stamp.m_nModifyTime );
+		}
+
+		const uint64 nSourceBit = 1ull << i;
+
+		names.RemoveAll();
+		FOR_EACH_HASHTABLE( m_Names, h )
+		{
+			if ( m_Names[h] & nSourceBit )
+			{
+				names.AddToTail( m_Names.Key( h ).Get() );
+			}
+		}
+
+		buf.PutInt( names.Count() );
+		for ( const char *pszName : names )
+		{
+			buf.PutString( pszName );
+		}
+	}
+
+	m_Lock.UnlockRead();
+
+	for ( const Listing_t *pCached : m_CachedListings )
+	{
+		buf.PutString( pCached->m_Root.Get() );
+
+		buf.PutInt( pCached->m_Dirs.Count() );
+		for ( const DirStamp_t &stamp : pCached->m_Dirs )
+		{
+			buf.PutString( stamp.m_Name.Get() );
+			buf.PutInt64( stamp.m_nModifyTime );
+		}
+
+		buf.PutInt( pCached->m_Files.Count() );
+		for ( const CUtlString &name : pCached->m_Files )
+		{
+			buf.PutString( name.Get() );
+		}
+	}
+
+	return m_pFileSystem->WriteFile( m_CacheFileName.Get(), nullptr, buf );
+}
+
+bool CFileLocationIndex::Load()
+{
+	m_CachedListings.PurgeAndDeleteElements();
+
+	CUtlBuffer buf;
+	if ( !m_pFileSystem->ReadFile( m_CacheFileName.Get(), nullptr, buf ) )
+		return false;
+
+	if ( buf.GetUnsignedInt() != FILELOCATIONINDEX_MAGIC || buf.GetInt() != FILELOCATIONINDEX_VERSION )
+	{
+		DevWarning( "FS: Ignoring file location index %s of other version.\n", m_CacheFileName.Get() );
+		return false;
+	}
+
+	char szName[MAX_PATH];
+
+	// Every entry takes at least a byte, so counts above bytes left are garbage.
+	const int nListings = buf.GetInt();
+	bool bValid = nListings >= 0 && nListings <= buf.GetBytesRemaining();
+	for ( int i = 0; bValid && i < nListings; ++i )
+	{
+		auto *pListing = new Listing_t;
+		m_CachedListings.AddToTail( pListing );
+
+		buf.GetString( szName );
+		pListing->m_Root = szName;
+
+		const int nDirs = buf.GetInt();
+		bValid = buf.IsValid() && nDirs >= 0 && nDirs <= buf.GetBytesRemaining();
+		for ( int j = 0; bValid && j < nDirs; ++j )
+		{
+			DirStamp_t &stamp = pListing->m_Dirs[pListing->m_Dirs.AddToTail()];
+			buf.GetString( szName );
+			stamp.m_Name = szName;
+			stamp.m_nModifyTime = buf.GetInt64();
+		}
+
+		const int nFiles = bValid ? buf.GetInt() : -1;
+		bValid = buf.IsValid() && nFiles >= 0 && nFiles <= buf.GetBytesRemaining();
+		if ( bValid )
+		{
+			pListing->m_Files.EnsureCapacity( nFiles );
+		}
+		for ( int j = 0; bValid && j < nFiles; ++j )
+		{
+			buf.GetString( szName );
+			pListing->m_Files.AddToTail( szName );
+		}
+
+		bValid = bValid && buf.IsValid();
+	}
+
+	if ( !bValid )
+	{
+		Warning( "FS: File location index %s is corrupt, ignoring it.\n", m_CacheFileName.Get() );
+		m_CachedListings.PurgeAndDeleteElements();
+		return false;
+	}
+
+	return true;
+}
+
+void CFileLocationIndex::PrintStatus() const
+{
+	if ( !m_bEnabled )
+	{
+		Msg( "File location index is off, run with -fs_fileindex to turn it on.\n" );
+		return;
+	}
+
+	m_Lock.LockForRead();
+
+	Msg( "File location index: %d names, %d sources (%s), cache %s.\n",
+		m_Names.Count(), m_nSources, fs_fileindex_lookups.GetBool() ? "used" : "not used",
+		m_CacheFileName.IsEmpty() ? "off" : m_CacheFileName.Get() );
+	Msg( "Mount: %d directories reused, %d directories and packs listed in %.2f ms.\n",
+		m_nReusedSources, m_nScannedSources, m_flBuildSeconds * 1000 );
+
+	for ( int i = 0; i < m_nSources; ++i )
+	{
+		const Source_t &source = m_Sources[i];
+		if ( source.m_bPackedStore )
+		{
+			Msg( "  %2d: %s (vpk)\n", i, source.m_Root.Get() );
+		}
+		else
+		{
+			Msg( "  %2d: %s (%zd directories)\n", i, source.m_Root.Get(), source.m_Dirs.Count() );
+		}
+	}
+
+	m_Lock.UnlockRead();
+}
+
+CON_COMMAND( fs_fileindex_status, "Print file location index sources and mount times." )
+{
+	BaseFileSystem()->m_FileLocationIndex.PrintStatus();
+}
+
+CON_COMMAND( fs_fileindex_rebuild, "Relist directories in file location index. fs_fileindex_rebuild reuse saves index first and only relists changed directories, like on startup." )
+{
+	BaseFileSystem()->m_FileLocationIndex.Rebuild( args.ArgC() > 1 && !V_stricmp( args[1], "reuse" ) );
+}
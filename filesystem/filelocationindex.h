@@ -0,0 +1,128 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Index of which search paths have which files, so relative lookups
+//			only probe search paths which actually have the file.
+//
+//=============================================================================
+
+#ifndef FILELOCATIONINDEX_H
+#define FILELOCATIONINDEX_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier0/threadtools.h"
+#include "tier1/utlhashtable.h"
+#include "tier1/utlstring.h"
+#include "tier1/utlvector.h"
+
+class CBaseFileSystem;
+class CPackedStore;
+
+//-----------------------------------------------------------------------------
+// Every indexed loose directory tree or VPK is a source.  Each relative name
+// (lowercase, CORRECT_PATH_SEPARATOR) maps to a mask of sources which have
+// a file or directory with this name.  Search paths which are not indexed
+// (zips, map paks, non game paths) have no source and are always probed.
+//
+// Loose directories are invalidated by directory modify times and the index
+// can be saved on shutdown, so the next run revalidates it with one stat per
+// directory instead of listing every file again.
+//-----------------------------------------------------------------------------
+class CFileLocationIndex
+{
+public:
+	enum { MAX_SOURCES = 64 };
+
+	explicit CFileLocationIndex( CBaseFileSystem *pFileSystem );
+	~CFileLocationIndex();
+
+	// Turns index on and loads cache saved by previous run, if any.  Must be
+	// called before search paths are added.
+	void Enable( const char *pszCacheFileName );
+	bool IsEnabled() const { return m_bEnabled; }
+
+	// Index loose directory (absolute, with trailing separator) / VPK.  Returns
+	// source id or -1 when search path is not indexed.
+	int AddLooseDirectory( const char *pszRoot, const char *pszPathID );
+	int AddPackedStore( CPackedStore *pPackedStore );
+
+	// Gets mask of sources which have relative file or directory.  Returns
+	// false when index can't answer for this name and every search path has
+	// to be probed.
+	bool Find( const char *pszRelativeName, uint64 &nSourcesMask ) const;
+
+	static bool MayHave( int nSource, uint64 nSourcesMask )
+	{
+		return nSource < 0 || ( nSourcesMask & ( 1ull << nSource ) ) != 0;
+	}
+
+	// Keep loose sources in sync with files written through the file system.
+	void NoteFileAdded( const char *pszAbsoluteName );
+	void NoteFileRemoved( const char *pszAbsoluteName );
+
+	// Relists all loose sources.  When bReuseCache, saves index first and
+	// reuses listings whose directories did not change, like on startup.
+	void Rebuild( bool bReuseCache );
+
+	bool Save();
+	void PrintStatus() const;
+
+private:
+	struct DirStamp_t
+	{
+		CUtlString m_Name;		// relative to source root, "" for root itself
+		int64 m_nModifyTime;
+	};
+
+	struct Listing_t
+	{
+		CUtlString m_Root;
+		CUtlVector<DirStamp_t> m_Dirs;
+		CUtlVector<CUtlString> m_Files;
+	};
+
+	struct Source_t
+	{
+		CUtlString m_Root;		// loose directory or VPK full path name
+		bool m_bPackedStore;
+		CUtlVector<DirStamp_t> m_Dirs;
+	};
+
+	int FindSource( const char *pszRoot ) const;
+	int NewSource( const char *pszRoot, bool bPackedStore );
+
+	// Uses cached listing if its directories are unchanged, lists directory otherwise.
+	void ListLooseDirectory( const char *pszRoot, Listing_t &listing, bool &bReused );
+	bool TakeCachedListing( const char *pszRoot, Listing_t &listing );
+	bool IsListingCurrent( const Listing_t &listing ) const;
+	void ScanDirectory( const char *pszRoot, const char *pszDir, int64 nScanTime, int nDepth, Listing_t &listing ) const;
+	bool GetModifyTime( const char *pszName, int64 &nModifyTime ) const;
+
+	// Must hold write lock.
+	void AddName( const char *pszRelativeName, int nSource );
+	void ReplaceSourceNames( int nSource, Listing_t &listing );
+	void RestampParentDirs( int nSource, const char *pszRelativeName );
+
+	bool Load();
+	static bool IsIndexableName( const char *pszRelativeName );
+
+	CBaseFileSystem *m_pFileSystem;
+	bool m_bEnabled;
+	CUtlString m_CacheFileName;
+
+	mutable CThreadSpinRWLock m_Lock;
+	CUtlHashtable<CUtlString, uint64> m_Names;
+	Source_t m_Sources[MAX_SOURCES];
+	int m_nSources;
+
+	// Loose listings loaded from cache, waiting for their directories to be mounted.
+	CUtlVector<Listing_t *> m_CachedListings;
+
+	// Stats.
+	int m_nReusedSources;
+	int m_nScannedSources;
+	double m_flBuildSeconds;
+};
+
+#endif // FILELOCATIONINDEX_H
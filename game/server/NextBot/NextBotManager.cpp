@@ -6,6 +6,10 @@
 
 #include "NextBotManager.h"
 #include "NextBotInterface.h"
+#include "nav_mesh.h"
+#include "nav_pathfind.h"
+#include "Path/NextBotPath.h"
+#include "vstdlib/jobthread.h"
 
 #ifdef TERROR
 #include "ZombieBot/Infected/Infected.h"
@@ -25,6 +29,7 @@ ConVar nb_update_frequency( "nb_update_frequency", ".1", FCVAR_CHEAT );
 ConVar nb_update_framelimit( "nb_update_framelimit", ( IsDebug() ) ? "30" : "15", FCVAR_CHEAT );
 ConVar nb_update_maxslide( "nb_update_maxslide", "2", FCVAR_CHEAT );
 ConVar nb_update_debug( "nb_update_debug", "0", FCVAR_CHEAT );
+ConVar nb_path_compute_parallel( "nb_path_compute_parallel", "1", FCVAR_CHEAT, "Run the searches of deferred path computes on the thread pool" );
 
 //---------------------------------------------------------------------------------------------
 //---------------------------------------------------------------------------------------------
@@ -247,6 +252,8 @@ NextBotManager::NextBotManager( void )
 //---------------------------------------------------------------------------------------------
 NextBotManager::~NextBotManager()
 {
+	CancelPathComputes( NULL );
+	m_pathComputeQueue.PurgeAndDeleteElements();
 }
 
 
@@ -269,6 +276,9 @@ void NextBotManager::Reset( void )
 		i = iNext;
 	}
 
+	// the nav mesh may be going away
+	CancelPathComputes( NULL );
+
 	m_selectedBot = NULL;
 }
 
@@ -307,6 +317,9 @@ static int g_nBlockedSlides;
 
 void NextBotManager::Update( void )
 {
+	// finish paths bots asked for since the last update
+	ComputeQueuedPaths();
+
 	// do lightweight upkeep every tick
 	for( int u=m_botList.Head(); u != m_botList.InvalidIndex(); u = m_botList.Next( u ) )
 	{
@@ -515,6 +528,8 @@ void NextBotManager::UnRegister( INextBot *bot )
 {
 	m_botList.Remove( bot->GetBotId() );
 
+	CancelPathComputes( bot );
+
 	if ( bot == m_selectedBot)
 	{
 		// we can't access virtual methods because this is called from a destructor, so just clear it
@@ -523,6 +538,109 @@ void NextBotManager::UnRegister( INextBot *bot )
 }
 
 
+//---------------------------------------------------------------------------------------------
+void NextBotManager::QueuePathCompute( PathComputeRequest *request )
+{
+	m_pathComputeQueue.AddToTail( request );
+}
+
+
+//---------------------------------------------------------------------------------------------
+void NextBotManager::CancelPathComputes( INextBot *bot )
+{
+	CUtlVector< PathComputeRequest * > *lists[] = { &m_pathComputeQueue, &m_pathComputeBatch };
+	for( CUtlVector< PathComputeRequest * > *list : lists )
+	{
+		FOR_EACH_VEC( *list, it )
+		{
+			PathComputeRequest *request = list->Element( it );
+			if ( request->m_path && ( bot == NULL || request->m_bot == bot ) )
+			{
+				request->m_path->CancelDeferredCompute();
+			}
+		}
+	}
+}
+
+
+//---------------------------------------------------------------------------------------------
+void NextBotManager::SearchQueuedPath( PathComputeRequest *&request )
+{
+	// search state of this query, instead of the shared state in the areas
+	CNavSearchScope scope;
+
+	request->Search();
+	request->m_path->AssembleAreas( &request->m_state );
+}
+
+
+//---------------------------------------------------------------------------------------------
+/**
+ * Run all queued path computes. Start and goal areas are found and results are
+ * finished on the main thread, the A* searches in between run concurrently.
+ */
+void NextBotManager::ComputeQueuedPaths( void )
+{
+	if ( m_pathComputeQueue.Count() == 0 )
+		return;
+
+	VPROF_BUDGET( "NextBotManager::ComputeQueuedPaths", "NextBotSpiky" );
+
+	// OnPathChanged() may queue new requests, they run next update
+	Assert( m_pathComputeBatch.Count() == 0 );
+	m_pathComputeBatch.Swap( m_pathComputeQueue );
+
+	CUtlVector< PathComputeRequest * > searches( 0, m_pathComputeBatch.Count() );
+	FOR_EACH_VEC( m_pathComputeBatch, it )
+	{
+		PathComputeRequest *request = m_pathComputeBatch[ it ];
+		Path *path = request->m_path;
+		if ( path == NULL )
+			continue;
+
+		// unlinked while OnPathChanged() may run, it may queue the path again
+		path->m_computeRequest = NULL;
+		request->m_path = NULL;
+
+		bool result;
+		if ( path->BeginCompute( request->m_bot, request->m_goal, &request->m_state, &result ) )
+		{
+			// linked again, so the path can be cancelled until it is finished
+			path->m_computeRequest = request;
+			request->m_path = path;
+			searches.AddToTail( request );
+		}
+	}
+
+	if ( nb_path_compute_parallel.GetBool() && searches.Count() > 1 )
+	{
+		ParallelProcess( "NextBotManager::ComputeQueuedPaths", searches.Base(), searches.Count(), &NextBotManager::SearchQueuedPath );
+	}
+	else
+	{
+		FOR_EACH_VEC( searches, it )
+		{
+			SearchQueuedPath( searches[ it ] );
+		}
+	}
+
+	FOR_EACH_VEC( searches, it )
+	{
+		// an earlier OnPathChanged() may have cancelled this one
+		PathComputeRequest *request = searches[ it ];
+		Path *path = request->m_path;
+		if ( path == NULL )
+			continue;
+
+		path->m_computeRequest = NULL;
+		request->m_path = NULL;
+		path->FinishCompute( request->m_bot, request->m_goal, request->m_includeGoalIfPathFails, request->m_state );
+	}
+
+	m_pathComputeBatch.PurgeAndDeleteElements();
+}
+
+
 //--------------------------------------------------------------------------------------------------------
 void NextBotManager::OnBeginChangeLevel( void )
 {
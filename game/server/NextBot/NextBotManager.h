@@ -8,6 +8,7 @@
 #include "NextBotInterface.h"
 
 class CTerrorPlayer;
+class PathComputeRequest;
 
 //----------------------------------------------------------------------------------------------------------------
 /**
@@ -28,6 +29,13 @@ public:
 
 	int GetNextBotCount( void ) const;				// How many nextbots are alive right now?
 
+	/**
+	 * Path computes queued with Path::ComputeDeferred(). All requests queued before an Update()
+	 * are run by it, with their searches spread over the thread pool.
+	 */
+	void QueuePathCompute( PathComputeRequest *request );	// takes ownership
+	void ComputeQueuedPaths( void );
+
 
 	/**
 	 * Populate given vector with all bots in the system
@@ -147,6 +155,11 @@ protected:
 
 	CUtlLinkedList< INextBot * > m_botList;				// list of all active NextBots
 
+	CUtlVector< PathComputeRequest * > m_pathComputeQueue;	// requests for the next Update()
+	CUtlVector< PathComputeRequest * > m_pathComputeBatch;	// requests ComputeQueuedPaths() is running
+	void CancelPathComputes( INextBot *bot );			// cancel all requests of bot, or all if NULL
+	static void SearchQueuedPath( PathComputeRequest *&request );
+
 	int m_iUpdateTickrate;
 	double m_CurUpdateStartTime;
 	double m_SumFrameTime;
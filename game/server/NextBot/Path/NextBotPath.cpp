@@ -13,6 +13,7 @@
 #include "NextBotLocomotionInterface.h"
 #include "NextBotBodyInterface.h"
 #include "NextBotUtil.h"
+#include "NextBotManager.h"
 
 #include "tier0/vprof.h"
 
@@ -33,6 +34,176 @@ Path::Path( void )
 	m_cursorData.segmentPrior = NULL;
 	m_ageTimer.Invalidate();
 	m_subject = NULL;
+	m_computeRequest = NULL;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+Path::~Path()
+{
+	CancelDeferredCompute();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Start Compute( bot, goal ): find start and goal areas.
+ * Returns false if there is nothing to search, with the result of Compute() in 'result'.
+ */
+bool Path::BeginCompute( INextBot *bot, const Vector &goal, PathComputeState *state, bool *result )
+{
+	Invalidate();
+
+	state->m_startArea = bot->GetEntity()->GetLastKnownArea();
+	state->m_goalArea = NULL;
+	state->m_closestArea = NULL;
+	state->m_teamID = bot->GetEntity()->GetTeamNumber();
+	state->m_pathResult = false;
+	state->m_areaCount = 0;
+
+	if ( !state->m_startArea )
+	{
+		OnPathChanged( bot, NO_PATH );
+		*result = false;
+		return false;
+	}
+
+	// check line-of-sight to the goal position when finding it's nav area
+	const float maxDistanceToArea = 200.0f;
+	state->m_goalArea = TheNavMesh->GetNearestNavArea( goal, true, maxDistanceToArea, true );
+
+	// if we are already in the goal area, build trivial path
+	if ( state->m_startArea == state->m_goalArea )
+	{
+		BuildTrivialPath( bot, goal );
+		*result = true;
+		return false;
+	}
+
+	// make sure path end position is on the ground
+	state->m_pathEndPosition = goal;
+	if ( state->m_goalArea )
+	{
+		state->m_pathEndPosition.z = state->m_goalArea->GetZ( state->m_pathEndPosition );
+	}
+	else
+	{
+		TheNavMesh->GetGroundHeight( state->m_pathEndPosition, &state->m_pathEndPosition.z );
+	}
+
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Build actual path by following parent links back from goal area.
+ * Touches only this path and the search state, so it runs on the thread which did the search.
+ */
+void Path::AssembleAreas( PathComputeState *state )
+{
+	// Failed?
+	if ( state->m_closestArea == NULL )
+		return;
+
+	// get count
+	int count = 0;
+	CNavArea *area;
+	for( area = state->m_closestArea; area; area = area->GetParent() )
+	{
+		++count;
+
+		if ( area == state->m_startArea )
+		{
+			// startArea can be re-evaluated during the pathfind and given a parent...
+			break;
+		}
+		if ( count >= MAX_PATH_SEGMENTS-1 ) // save room for endpoint
+			break;
+	}
+
+	state->m_areaCount = count;
+
+	if ( count == 1 )
+		return;
+
+	// assemble path
+	m_segmentCount = count;
+	for( area = state->m_closestArea; count && area; area = area->GetParent() )
+	{
+		--count;
+		m_path[ count ].area = area;
+		m_path[ count ].how = area->GetParentHow();
+		m_path[ count ].type = ON_GROUND;
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Finish Compute( bot, goal ) once areas are assembled: compute positions and notify
+ */
+bool Path::FinishCompute( INextBot *bot, const Vector &goal, bool includeGoalIfPathFails, const PathComputeState &state )
+{
+	// Failed?
+	if ( state.m_closestArea == NULL )
+		return false;
+
+	if ( state.m_areaCount == 1 )
+	{
+		BuildTrivialPath( bot, goal );
+		return state.m_pathResult;
+	}
+
+	if ( state.m_pathResult || includeGoalIfPathFails )
+	{
+		// append actual goal position
+		m_path[ m_segmentCount ].area = state.m_closestArea;
+		m_path[ m_segmentCount ].pos = state.m_pathEndPosition;
+		m_path[ m_segmentCount ].ladder = NULL;
+		m_path[ m_segmentCount ].how = NUM_TRAVERSE_TYPES;
+		m_path[ m_segmentCount ].type = ON_GROUND;
+		++m_segmentCount;
+	}
+
+	// compute path positions
+	if ( ComputePathDetails( bot, bot->GetPosition() ) == false )
+	{
+		Invalidate();
+		OnPathChanged( bot, NO_PATH );
+		return false;
+	}
+
+	// remove redundant nodes and clean up path
+	Optimize( bot );
+
+	PostProcess();
+
+	OnPathChanged( bot, state.m_pathResult ? COMPLETE_PATH : PARTIAL_PATH );
+
+	return state.m_pathResult;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void Path::QueueCompute( PathComputeRequest *request )
+{
+	CancelDeferredCompute();
+
+	m_computeRequest = request;
+	TheNextBots().QueuePathCompute( request );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void Path::CancelDeferredCompute( void )
+{
+	if ( m_computeRequest )
+	{
+		// the manager deletes it
+		m_computeRequest->m_path = NULL;
+		m_computeRequest = NULL;
+	}
 }
 
 
@@ -845,6 +1016,7 @@ void Path::Copy( INextBot *bot, const Path &path )
 {
 	VPROF_BUDGET( "Path::Copy", "NextBot" );
 
+	CancelDeferredCompute();
 	Invalidate();
 	
 	for( int i = 0; i < path.m_segmentCount; ++i )
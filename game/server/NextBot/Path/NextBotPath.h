@@ -42,6 +42,51 @@ public:
 };
 
 
+class Path;
+
+
+//---------------------------------------------------------------------------------------------------------------
+/**
+ * Search state of a Path::Compute() to a goal position
+ */
+struct PathComputeState
+{
+	CNavArea *m_startArea;
+	CNavArea *m_goalArea;
+	CNavArea *m_closestArea;
+	Vector m_pathEndPosition;
+	int m_teamID;
+	bool m_pathResult;
+	int m_areaCount;							// areas from the closest area back to the start area
+};
+
+
+//---------------------------------------------------------------------------------------------------------------
+/**
+ * A Path::Compute() to a goal position queued with Path::ComputeDeferred().
+ * NextBotManager runs the searches of all requests queued during a tick concurrently.
+ */
+class PathComputeRequest
+{
+public:
+	PathComputeRequest( Path *path, INextBot *bot, const Vector &goal, float maxPathLength, bool includeGoalIfPathFails )
+		: m_path( path ), m_bot( bot ), m_goal( goal ), m_maxPathLength( maxPathLength ), m_includeGoalIfPathFails( includeGoalIfPathFails )
+	{
+	}
+	virtual ~PathComputeRequest() { }
+
+	virtual void Search( void ) = 0;			// A* search with the request's cost functor
+
+	Path *m_path;								// NULL once cancelled
+	INextBot *m_bot;
+	Vector m_goal;
+	float m_maxPathLength;
+	bool m_includeGoalIfPathFails;
+
+	PathComputeState m_state;
+};
+
+
 //---------------------------------------------------------------------------------------------------------------
 /**
  * A Path through the world.
@@ -52,7 +97,7 @@ class Path
 {
 public:
 	Path( void );
-	virtual ~Path() { }
+	virtual ~Path();
 	
 	enum SegmentType
 	{
@@ -157,6 +202,8 @@ public:
 	{
 		VPROF_BUDGET( "Path::Compute(subject)", "NextBot" );
 
+		CancelDeferredCompute();
+
 		Invalidate();
 
 		m_subject = subject;
@@ -190,7 +237,7 @@ public:
 		// Compute shortest path to subject
 		//
 		CNavArea *closestArea = NULL;
-		bool pathResult = NavAreaBuildPath( startArea, subjectArea, &subjectPos, costFunc, &closestArea, maxPathLength, bot->GetEntity()->GetTeamNumber() );
+		bool pathResult = NavAreaBuildPathHierarchical( startArea, subjectArea, &subjectPos, costFunc, &closestArea, maxPathLength, bot->GetEntity()->GetTeamNumber() );
 
 		// Failed?
 		if ( closestArea == NULL )
@@ -274,114 +321,40 @@ public:
 	{
 		VPROF_BUDGET( "Path::Compute(goal)", "NextBotSpiky" );
 
-		Invalidate();
-		
-		const Vector &start = bot->GetPosition();
-		
-		CNavArea *startArea = bot->GetEntity()->GetLastKnownArea();
-		if ( !startArea )
-		{
-			OnPathChanged( bot, NO_PATH );
-			return false;
-		}
-
-		// check line-of-sight to the goal position when finding it's nav area
-		const float maxDistanceToArea = 200.0f;
-		CNavArea *goalArea = TheNavMesh->GetNearestNavArea( goal, true, maxDistanceToArea, true );
-
-		// if we are already in the goal area, build trivial path
-		if ( startArea == goalArea )
-		{
-			BuildTrivialPath( bot, goal );
-			return true;
-		}
+		CancelDeferredCompute();
 
-		// make sure path end position is on the ground
-		Vector pathEndPosition = goal;
-		if ( goalArea )
-		{
-			pathEndPosition.z = goalArea->GetZ( pathEndPosition );
-		}
-		else
-		{
-			TheNavMesh->GetGroundHeight( pathEndPosition, &pathEndPosition.z );
-		}
+		PathComputeState state;
+		bool result;
+		if ( !BeginCompute( bot, goal, &state, &result ) )
+			return result;
 
 		//
 		// Compute shortest path to goal
 		//
-		CNavArea *closestArea = NULL;
-		bool pathResult = NavAreaBuildPath( startArea, goalArea, &goal, costFunc, &closestArea, maxPathLength, bot->GetEntity()->GetTeamNumber() );
-
-		// Failed?
-		if ( closestArea == NULL )
-			return false;
-
-		//
-		// Build actual path by following parent links back from goal area
-		//
-
-		// get count
-		int count = 0;
-		CNavArea *area;
-		for( area = closestArea; area; area = area->GetParent() )
-		{
-			++count;
-
-			if ( area == startArea )
-			{
-				// startArea can be re-evaluated during the pathfind and given a parent...
-				break;
-			}
-			if ( count >= MAX_PATH_SEGMENTS-1 ) // save room for endpoint
-				break;
-		}
-		
-		if ( count == 1 )
-		{
-			BuildTrivialPath( bot, goal );
-			return pathResult;
-		}
-
-		// assemble path
-		m_segmentCount = count;
-		for( area = closestArea; count && area; area = area->GetParent() )
-		{
-			--count;
-			m_path[ count ].area = area;
-			m_path[ count ].how = area->GetParentHow();
-			m_path[ count ].type = ON_GROUND;
-		}
+		state.m_pathResult = NavAreaBuildPathHierarchical( state.m_startArea, state.m_goalArea, &goal, costFunc, &state.m_closestArea, maxPathLength, state.m_teamID );
 
-		if ( pathResult || includeGoalIfPathFails )
-		{
-			// append actual goal position
-			m_path[ m_segmentCount ].area = closestArea;
-			m_path[ m_segmentCount ].pos = pathEndPosition;
-			m_path[ m_segmentCount ].ladder = NULL;
-			m_path[ m_segmentCount ].how = NUM_TRAVERSE_TYPES;
-			m_path[ m_segmentCount ].type = ON_GROUND;
-			++m_segmentCount;
-		}
-				
-		// compute path positions
-		if ( ComputePathDetails( bot, start ) == false )
-		{
-			Invalidate();
-			OnPathChanged( bot, NO_PATH );
-			return false;
-		}
+		AssembleAreas( &state );
 
-		// remove redundant nodes and clean up path
-		Optimize( bot );
-		
-		PostProcess();
+		return FinishCompute( bot, goal, includeGoalIfPathFails, state );
+	}
 
-		OnPathChanged( bot, pathResult ? COMPLETE_PATH : PARTIAL_PATH );
 
-		return pathResult;
+	//-----------------------------------------------------------------------------------------------------------------
+	/**
+	 * Queue Compute( bot, goal, costFunc ) to run with every other path queued this tick, when
+	 * NextBotManager next updates. The path is unchanged until then, OnPathChanged() reports the result.
+	 * A copy of 'costFunc' is evaluated on a worker thread, so it must only read game state.
+	 * Queueing again or calling Compute() replaces a pending request.
+	 */
+	template< typename CostFunctor >
+	void ComputeDeferred( INextBot *bot, const Vector &goal, const CostFunctor &costFunc, float maxPathLength = 0.0f, bool includeGoalIfPathFails = true )
+	{
+		QueueCompute( new PathComputeRequestWithCost< CostFunctor >( this, bot, goal, costFunc, maxPathLength, includeGoalIfPathFails ) );
 	}
 
+	bool IsComputePending( void ) const	{ return m_computeRequest != NULL; }	// true while a ComputeDeferred() has not run yet
+	void CancelDeferredCompute( void );
+
 
 	//-----------------------------------------------------------------------------------------------------------------
 	/**
@@ -393,6 +366,8 @@ public:
 	{
 		VPROF_BUDGET( "ComputeWithOpenGoal", "NextBot" );
 
+		CancelDeferredCompute();
+
 		int teamID = bot->GetEntity()->GetTeamNumber();
 
 		CNavArea *startArea = bot->GetEntity()->GetLastKnownArea();
@@ -581,6 +556,33 @@ public:
 
 
 private:
+	friend class NextBotManager;
+
+	template< typename CostFunctor >
+	class PathComputeRequestWithCost : public PathComputeRequest
+	{
+	public:
+		PathComputeRequestWithCost( Path *path, INextBot *bot, const Vector &goal, const CostFunctor &costFunc, float maxPathLength, bool includeGoalIfPathFails )
+			: PathComputeRequest( path, bot, goal, maxPathLength, includeGoalIfPathFails ), m_costFunc( costFunc )
+		{
+		}
+
+		void Search( void ) override
+		{
+			m_state.m_pathResult = NavAreaBuildPathHierarchical( m_state.m_startArea, m_state.m_goalArea, &m_goal, m_costFunc, &m_state.m_closestArea, m_maxPathLength, m_state.m_teamID );
+		}
+
+		CostFunctor m_costFunc;
+	};
+
+	// Compute( bot, goal ) in steps, so NextBotManager can run the searches of many paths concurrently
+	bool BeginCompute( INextBot *bot, const Vector &goal, PathComputeState *state, bool *result );	// returns false if no search is needed, 'result' is the result of Compute()
+	void AssembleAreas( PathComputeState *state );		// follow parent links of the search, on the thread which searched
+	bool FinishCompute( INextBot *bot, const Vector &goal, bool includeGoalIfPathFails, const PathComputeState &state );
+	void QueueCompute( PathComputeRequest *request );
+
+	PathComputeRequest *m_computeRequest;		// pending ComputeDeferred()
+
 	enum { MAX_PATH_SEGMENTS = 256 };
 	Segment m_path[ MAX_PATH_SEGMENTS ];
 	int m_segmentCount;
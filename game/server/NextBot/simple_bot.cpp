@@ -154,15 +154,16 @@ public:
 			// PathFollower::Update() moves the bot along the path using the bot's ILocomotion and IBody interfaces
 			m_path.Update( me );
 		}
-		else
+		else if ( !m_path.IsComputePending() )
 		{
 			SelectNthAreaFunctor pick( RandomInt( 0, TheNavMesh->GetNavAreaCount() - 1 ) );
 			TheNavMesh->ForAllAreas( pick );
 
 			if ( pick.m_area )
 			{
+				// the search runs with those of all other bots at the next NextBotManager update
 				CSimpleBotPathCost cost( me );
-				m_path.Compute( me, pick.m_area->GetCenter(), cost );
+				m_path.ComputeDeferred( me, pick.m_area->GetCenter(), cost );
 			}
 
 			// follow this path for a random duration (or until we reach the end)
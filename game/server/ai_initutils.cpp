@@ -120,6 +120,32 @@ void CAI_TestHull::ReturnTestHull(void)
 	pTestHull = NULL;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Create a hull for connectivity tests on other threads.  Unlike the
+//			shared test hull it stays non-solid, so hulls don't block each
+//			other's traces.
+//-----------------------------------------------------------------------------
+CAI_TestHull* CAI_TestHull::CreateExtraTestHull(void)
+{
+	CAI_TestHull *pHull = CREATE_ENTITY( CAI_TestHull, "aitesthull" );
+	pHull->Spawn();
+	pHull->AddFlag( FL_NPC );
+	pHull->bInUse = true;
+
+	return pHull;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Destroy a hull created by CreateExtraTestHull
+//-----------------------------------------------------------------------------
+void CAI_TestHull::DestroyExtraTestHull(CAI_TestHull *pHull)
+{
+	Assert( pHull != pTestHull );
+
+	pHull->bInUse = false;
+	UTIL_RemoveImmediate( pHull );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : &startPos - 
@@ -141,7 +167,10 @@ bool CAI_TestHull::IsJumpLegal(const Vector &startPos, const Vector &apex, const
 //-----------------------------------------------------------------------------
 CAI_TestHull::~CAI_TestHull(void)
 {
-	CAI_TestHull::pTestHull = NULL;
+	if ( CAI_TestHull::pTestHull == this )
+	{
+		CAI_TestHull::pTestHull = NULL;
+	}
 }
 
 //###########################################################
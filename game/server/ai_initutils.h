@@ -90,6 +90,8 @@ private:
 public:
 	static CAI_TestHull*	GetTestHull(void);						// Get the test hull
 	static void				ReturnTestHull(void);					// Return the test hull
+	static CAI_TestHull*	CreateExtraTestHull(void);				// Additional non-solid hull for parallel tests
+	static void				DestroyExtraTestHull(CAI_TestHull *pHull);
 
 	bool					bInUse;
 	virtual void			Precache();
@@ -25,6 +25,7 @@
 #include "ndebugoverlay.h"
 #include "ai_hint.h"
 #include "tier0/icommandline.h"
+#include "vstdlib/jobthread.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -70,6 +71,16 @@ CON_COMMAND( ai_debug_node_connect, "Debug the attempted connection between two
 
 ConVar g_ai_norebuildgraph( "ai_norebuildgraph", "0" );
 
+ConVar ai_threaded_graph_build( "ai_threaded_graph_build", "1", 0, "Run node graph visibility and connection tests on the thread pool. Builds the same graph as the serial build." );
+
+CON_COMMAND_F( ai_graph_build_benchmark, "Rebuild AI node graph serially and threaded, report time of each phase and check both graphs match", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	g_AINetworkBuilder.BenchmarkBuild( g_pBigAINet );
+}
+
 
 //-----------------------------------------------------------------------------
 // CAI_NetworkManager
@@ -2199,6 +2210,378 @@ void CAI_NetworkBuilder::EndBuild()
 	CAI_TestHull::ReturnTestHull();
 }
 
+//-----------------------------------------------------------------------------
+// Threaded graph build
+//
+// Visibility and connection tests are traces against the static world, so
+// they run on the thread pool between BeginReadOnlyTraces and
+// EndReadOnlyTraces.  Everything that depends on the order nodes are visited
+// in (duplicate node removal, reuse of neighbors of earlier nodes, link
+// creation) is replayed on the main thread in node order, so the threaded
+// build produces exactly the same graph as the serial one.
+//-----------------------------------------------------------------------------
+
+static thread_local CAI_TestHull *s_pThreadTestHull;
+
+static bool IsNodeVisible( const Vector &srcPos, const Vector &destPos );
+
+//-----------------------------------------------------------------------------
+// Purpose: Initializes neighbors of all nodes in node order
+//-----------------------------------------------------------------------------
+void CAI_NetworkBuilder::InitAllNeighbors( CAI_Network *pNetwork, bool bParallel )
+{
+	int nNodes = pNetwork->NumNodes();
+	CAI_Node **ppNodes = pNetwork->AccessNodes();
+	int i;
+
+	m_DidSetNeighborsTable.Resize( nNodes );
+	m_DidSetNeighborsTable.ClearAll();
+	m_NeighborsTable.SetSize( nNodes );
+	for (i = 0; i < nNodes; i++)
+	{
+		m_NeighborsTable[i].Resize( nNodes );
+		m_NeighborsTable[i].ClearAll();
+	}
+
+	if ( !bParallel )
+	{
+		for (i = 0; i < nNodes; i++)
+		{	
+			InitNeighbors( pNetwork, ppNodes[i] );
+		}
+		return;
+	}
+
+	// ---------------------------
+	// Visibility checks of a node delete later duplicates of it, and skip
+	// nodes deleted so far.  Replay just the deletions, remembering which
+	// node deleted each one, then restore types for the traces.
+	// ---------------------------
+	CUtlVector<NodeType_e> nodeTypes;
+	CUtlVector<int> deletedNodes;
+	nodeTypes.SetCount( nNodes );
+	m_NodeDeletedAt.SetCount( nNodes );
+	for (i = 0; i < nNodes; i++)
+	{
+		nodeTypes[i] = ppNodes[i]->GetType();
+		m_NodeDeletedAt[i] = ( nodeTypes[i] == NODE_DELETED ) ? -1 : nNodes;
+	}
+	for (i = 0; i < nNodes; i++)
+	{
+		if ( ppNodes[i]->GetType() == NODE_DELETED )
+			continue;
+
+		for (int testnode = 0; testnode < nNodes; testnode++)
+		{
+			CAI_Node *testNode = ppNodes[testnode];
+			if ( testnode == i )
+				continue;
+
+			if (testNode->GetOrigin() == ppNodes[i]->GetOrigin() && testNode->GetType() != NODE_CLIMB)
+			{
+				testNode->SetType( NODE_DELETED );
+				DevMsg( 2, "Probable duplicate node placed at %s\n", VecToString(testNode->GetOrigin()) );
+
+				if ( m_NodeDeletedAt[testnode] == nNodes )
+				{
+					m_NodeDeletedAt[testnode] = i;
+					deletedNodes.AddToTail( testnode );
+				}
+			}
+		}
+	}
+	for (i = 0; i < nNodes; i++)
+	{
+		ppNodes[i]->SetType( nodeTypes[i] );
+	}
+
+	// ---------------------------
+	// Trace visibility to all later nodes on the thread pool
+	// ---------------------------
+	CUtlVector<int> visibilityNodes;
+	for (i = 0; i < nNodes; i++)
+	{
+		// Skip ones already deleted when their turn comes
+		if ( m_NodeDeletedAt[i] > i )
+			visibilityNodes.AddToTail( i );
+	}
+
+	m_pParallelNetwork = pNetwork;
+	enginetrace->BeginReadOnlyTraces();
+	ParallelProcess( "CAI_NetworkBuilder::InitVisibility", visibilityNodes.Base(), visibilityNodes.Count(), this, &CAI_NetworkBuilder::InitForwardVisibility );
+	enginetrace->EndReadOnlyTraces();
+
+	// ---------------------------
+	// Visibility to earlier nodes is taken from their final neighbors, so
+	// add it and prune redundant neighbors in node order
+	// ---------------------------
+	int iNextDeleted = 0;
+	for (i = 0; i < nNodes; i++)
+	{
+		CAI_Node *pNode = ppNodes[i];
+
+		while ( iNextDeleted < deletedNodes.Count() && m_NodeDeletedAt[deletedNodes[iNextDeleted]] == i )
+		{
+			ppNodes[deletedNodes[iNextDeleted++]]->SetType( NODE_DELETED );
+		}
+
+		if ( m_NodeDeletedAt[i] > i )
+		{
+			for (int testnode = 0; testnode < i; testnode++)
+			{
+				CAI_Node *testNode = ppNodes[testnode];
+
+				if (testNode->GetOrigin() == pNode->GetOrigin() && testNode->GetType() != NODE_CLIMB)
+					continue;
+
+				if (testNode->GetType() == NODE_DELETED)
+					continue;
+
+				if ( m_NeighborsTable[testnode].IsBitSet( i ) )
+					m_NeighborsTable[i].Set( testnode );
+			}
+
+			PruneRedundantNeighbors( pNetwork, pNode );
+		}
+
+		m_DidSetNeighborsTable.Set( i );
+	}
+
+	Assert( iNextDeleted == deletedNodes.Count() );
+	m_NodeDeletedAt.Purge();
+	m_pParallelNetwork = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Thread pool part of InitVisibility.  Sets visibility of the node
+//			to nodes after it, which InitVisibility traces in serial build.
+//-----------------------------------------------------------------------------
+void CAI_NetworkBuilder::InitForwardVisibility( int &iNode )
+{
+	AI_PROFILE_SCOPE( CAI_Node_InitVisibility );
+
+	CAI_Network *pNetwork = m_pParallelNetwork;
+	CAI_Node *pNode = pNetwork->GetNode( iNode );
+	Vector srcPos = pNode->GetPosition(HULL_SMALL_CENTERED);
+
+	for (int testnode = iNode + 1; testnode < pNetwork->NumNodes(); testnode++ )
+	{
+		CAI_Node *testNode = pNetwork->GetNode( testnode );
+
+		// Duplicates are deleted by this node
+		if (testNode->GetOrigin() == pNode->GetOrigin() && testNode->GetType() != NODE_CLIMB)
+			continue;
+
+		// Deleted by an earlier node
+		if ( m_NodeDeletedAt[testnode] < iNode )
+			continue;
+
+		float flDistToCheckNode = ( testNode->GetOrigin() - pNode->GetOrigin() ).LengthSqr(); 
+
+		if ( testNode->GetType() == NODE_AIR )
+		{
+			if (flDistToCheckNode > MAX_AIR_NODE_LINK_DIST_SQ) 
+				continue;
+		}
+		else
+		{
+			if (flDistToCheckNode > MAX_NODE_LINK_DIST_SQ) 
+				continue;
+		}
+
+		if ( IsNodeVisible( srcPos, testNode->GetPosition(HULL_SMALL_CENTERED) ) )
+			m_NeighborsTable[iNode].Set( testnode );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Creates links of all nodes in node order
+//-----------------------------------------------------------------------------
+void CAI_NetworkBuilder::InitAllLinks( CAI_Network *pNetwork, bool bParallel )
+{
+	int nNodes = pNetwork->NumNodes();
+	CAI_Node **ppNodes = pNetwork->AccessNodes();
+	int i, j;
+
+	for (i = 0; i < nNodes; i++)
+	{	
+		// Make sure all the links are clear
+		ppNodes[i]->ClearLinks();
+	}
+
+	if ( bParallel )
+	{
+		// Node tests connections to later neighbors first.  Connection from a
+		// later node is only tested if the earlier one did not connect them.
+		for (i = 0; i < nNodes; i++)
+		{
+			for (j = i + 1; j < nNodes; j++)
+			{
+				if ( NeedsConnectionTest( pNetwork, i, j ) )
+				{
+					ConnectionTest_t &test = m_ConnectionTests[m_ConnectionTests.AddToTail()];
+					test.iSrcNode = i;
+					test.iDestNode = j;
+				}
+			}
+		}
+		RunConnectionTests( pNetwork, m_ConnectionTests );
+
+		CUtlVector<ConnectionTest_t> retests;
+		for (i = 0; i < nNodes; i++)
+		{
+			for (j = 0; j < i; j++)
+			{
+				if ( !NeedsConnectionTest( pNetwork, i, j ) )
+					continue;
+
+				const ConnectionTest_t *pTest = FindConnectionTest( j, i );
+				bool bConnected = false;
+				for (int hull = 0; pTest && hull < NUM_HULLS; hull++)
+				{
+					if ( pTest->acceptedMotions[hull] != 0 )
+						bConnected = true;
+				}
+
+				if ( !bConnected )
+				{
+					ConnectionTest_t &test = retests[retests.AddToTail()];
+					test.iSrcNode = i;
+					test.iDestNode = j;
+				}
+			}
+		}
+		RunConnectionTests( pNetwork, retests );
+
+		m_ConnectionTests.AddVectorToTail( retests );
+		m_ConnectionTests.SortPredicate( []( const ConnectionTest_t &left, const ConnectionTest_t &right )
+		{
+			return left.iSrcNode < right.iSrcNode || ( left.iSrcNode == right.iSrcNode && left.iDestNode < right.iDestNode );
+		} );
+	}
+
+	// Tests missing above (link not created as node had too many links) are
+	// run here
+	for (i = 0; i < nNodes; i++)
+	{	
+		InitLinks( pNetwork, ppNodes[i] );
+	}
+
+	m_ConnectionTests.Purge();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Whether InitLinks of source node tests connection to dest node if
+//			they are not linked yet
+//-----------------------------------------------------------------------------
+bool CAI_NetworkBuilder::NeedsConnectionTest( CAI_Network *pNetwork, int iSrcNode, int iDestNode )
+{
+	if ( !m_NeighborsTable[iSrcNode].IsBitSet( iDestNode ) )
+		return false;
+
+	return !( pNetwork->GetNode( iSrcNode )->m_eNodeInfo & bits_NODE_FALLEN ) &&
+		   !( pNetwork->GetNode( iDestNode )->m_eNodeInfo & bits_NODE_FALLEN );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Finds precomputed connection test, if any
+//-----------------------------------------------------------------------------
+const CAI_NetworkBuilder::ConnectionTest_t *CAI_NetworkBuilder::FindConnectionTest( int iSrcNode, int iDestNode ) const
+{
+	int iLow = 0;
+	int iHigh = m_ConnectionTests.Count() - 1;
+
+	while ( iLow <= iHigh )
+	{
+		int iMid = ( iLow + iHigh ) / 2;
+		const ConnectionTest_t &test = m_ConnectionTests[iMid];
+
+		if ( test.iSrcNode == iSrcNode && test.iDestNode == iDestNode )
+			return &test;
+
+		if ( test.iSrcNode < iSrcNode || ( test.iSrcNode == iSrcNode && test.iDestNode < iDestNode ) )
+			iLow = iMid + 1;
+		else
+			iHigh = iMid - 1;
+	}
+
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Runs ComputeConnection of tests for all hulls on the thread pool
+//-----------------------------------------------------------------------------
+void CAI_NetworkBuilder::RunConnectionTests( CAI_Network *pNetwork, CUtlVector<ConnectionTest_t> &tests )
+{
+	if ( !tests.Count() )
+		return;
+
+	// Each thread needs own test hull, as hulls are ignored by own traces
+	int nThreads = ( g_pThreadPool ? g_pThreadPool->NumThreads() : 0 ) + 1;
+	for (int i = 0; i < nThreads; i++)
+	{
+		CAI_TestHull *pHull = CAI_TestHull::CreateExtraTestHull();
+		pHull->GetNavigator()->SetNetwork( pNetwork );
+		pHull->AddFlag( FL_ONGROUND );
+		pHull->SetGravity( 1.0 );
+		m_ThreadTestHulls.AddToTail( pHull );
+	}
+
+	// Shared hull is ignored by serial tests only
+	m_pTestHull->AddSolidFlags( FSOLID_NOT_SOLID );
+
+	m_pParallelNetwork = pNetwork;
+
+	// Resizing hulls moves them in spatial partition, which is not allowed
+	// during read-only traces, so run one pass per hull
+	for (int hull = 0; hull < NUM_HULLS; hull++)
+	{
+		m_ParallelHull = (Hull_t)hull;
+
+		for (int i = 0; i < m_ThreadTestHulls.Count(); i++)
+		{
+			m_ThreadTestHulls[i]->SetHullType( m_ParallelHull );
+			m_ThreadTestHulls[i]->SetHullSizeNormal( true );
+		}
+
+		m_nNextThreadTestHull = 0;
+
+		enginetrace->BeginReadOnlyTraces();
+		ParallelProcess( "CAI_NetworkBuilder::ComputeConnection", tests.Base(), tests.Count(), this,
+			&CAI_NetworkBuilder::ComputeConnectionTest, &CAI_NetworkBuilder::BeginConnectionTests, &CAI_NetworkBuilder::EndConnectionTests );
+		enginetrace->EndReadOnlyTraces();
+	}
+
+	m_pParallelNetwork = NULL;
+
+	m_pTestHull->RemoveSolidFlags( FSOLID_NOT_SOLID );
+
+	for (int i = 0; i < m_ThreadTestHulls.Count(); i++)
+	{
+		CAI_TestHull::DestroyExtraTestHull( m_ThreadTestHulls[i] );
+	}
+	m_ThreadTestHulls.Purge();
+}
+
+void CAI_NetworkBuilder::BeginConnectionTests()
+{
+	int iHull = m_nNextThreadTestHull++;
+	Assert( iHull < m_ThreadTestHulls.Count() );
+
+	s_pThreadTestHull = m_ThreadTestHulls[iHull];
+}
+
+void CAI_NetworkBuilder::EndConnectionTests()
+{
+	s_pThreadTestHull = NULL;
+}
+
+void CAI_NetworkBuilder::ComputeConnectionTest( ConnectionTest_t &test )
+{
+	test.acceptedMotions[m_ParallelHull] = ComputeConnection( s_pThreadTestHull,
+		m_pParallelNetwork->GetNode( test.iSrcNode ), m_pParallelNetwork->GetNode( test.iDestNode ), m_ParallelHull );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose:  Only called if network has changed since last time level
 //			 was loaded
@@ -2237,7 +2620,6 @@ void CAI_NetworkBuilder::Build( CAI_Network *pNetwork )
 		if ( pHelper )
 			pHelper->PostInitNodePosition( pNetwork, ppNodes[i] );
 	}
-	nNodes = pNetwork->NumNodes(); // InitNodePosition can create nodes
 	timer.End();
 	DevMsg( "...done initializing node positions. %f seconds\n", timer.GetDuration().GetSeconds() );
 
@@ -2246,18 +2628,7 @@ void CAI_NetworkBuilder::Build( CAI_Network *pNetwork )
 	// ---------------------------
 	DevMsg( "Initializing node neighbors...\n" );
 	timer.Start();
-	m_DidSetNeighborsTable.Resize( nNodes );
-	m_DidSetNeighborsTable.ClearAll();
-	m_NeighborsTable.SetSize( nNodes );
-	for (i = 0; i < nNodes; i++)
-	{
-		m_NeighborsTable[i].Resize( nNodes );
-		m_NeighborsTable[i].ClearAll();
-	}
-	for (i = 0; i < nNodes; i++)
-	{	
-		InitNeighbors( pNetwork, ppNodes[i] );
-	}
+	InitAllNeighbors( pNetwork, ai_threaded_graph_build.GetBool() );
 	timer.End();
 	DevMsg( "...done initializing node neighbors. %f seconds\n", timer.GetDuration().GetSeconds() );
 
@@ -2275,15 +2646,7 @@ void CAI_NetworkBuilder::Build( CAI_Network *pNetwork )
 	// ---------------------------
 	DevMsg( "Determining links...\n" );
 	timer.Start();
-	for (i = 0; i < nNodes; i++)
-	{	
-		// Make sure all the links are clear
-		ppNodes[i]->ClearLinks();
-	}
-	for (i = 0; i < nNodes; i++)
-	{	
-		InitLinks( pNetwork, ppNodes[i] );
-	}
+	InitAllLinks( pNetwork, ai_threaded_graph_build.GetBool() );
 	timer.End();
 	DevMsg( "...done determining links. %f seconds\n", timer.GetDuration().GetSeconds() );
 
@@ -2306,6 +2669,114 @@ void CAI_NetworkBuilder::Build( CAI_Network *pNetwork )
 		UTIL_Remove( pHelper );
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Writes what .ain stores about nodes and links, for comparing builds
+//-----------------------------------------------------------------------------
+static void WriteNetworkGraph( CAI_Network *pNetwork, CUtlBuffer &buf )
+{
+	for ( int i = 0; i < pNetwork->NumNodes(); i++ )
+	{
+		CAI_Node *pNode = pNetwork->GetNode( i );
+
+		buf.PutInt( pNode->GetType() );
+		buf.PutInt( pNode->GetZone() );
+		buf.PutInt( pNode->m_eNodeInfo );
+		buf.PutInt( pNode->NumLinks() );
+
+		for ( int j = 0; j < pNode->NumLinks(); j++ )
+		{
+			CAI_Link *pLink = pNode->GetLinkByIndex( j );
+
+			buf.PutShort( pLink->m_iSrcID );
+			buf.PutShort( pLink->m_iDestID );
+			buf.Put( pLink->m_iAcceptedMoveTypes, sizeof( pLink->m_iAcceptedMoveTypes ) );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+
+void CAI_NetworkBuilder::BenchmarkBuild( CAI_Network *pNetwork )
+{
+	int nNodes = pNetwork->NumNodes();
+	CAI_Node **ppNodes = pNetwork->AccessNodes();
+
+	if ( !nNodes )
+	{
+		Msg( "No AI nodes to build graph for\n" );
+		return;
+	}
+
+	// Duplicate node removal changes types, so start both builds from same ones
+	CUtlVector<NodeType_e> nodeTypes;
+	nodeTypes.SetCount( nNodes );
+	for ( int i = 0; i < nNodes; i++ )
+	{
+		nodeTypes[i] = ppNodes[i]->GetType();
+	}
+
+	const char *pszPhases[] = { "neighbors", "links", "zones" };
+	constexpr int nPhases = ARRAYSIZE( pszPhases );
+	float flPhaseSeconds[2][nPhases];
+	CUtlBuffer graphs[2];
+
+	for ( int pass = 0; pass < 2; pass++ )
+	{
+		bool bParallel = ( pass == 1 );
+		CFastTimer timer;
+
+		for ( int i = 0; i < nNodes; i++ )
+		{
+			ppNodes[i]->SetType( nodeTypes[i] );
+		}
+
+		BeginBuild();
+
+		timer.Start();
+		InitAllNeighbors( pNetwork, bParallel );
+		ForceDynamicLinkNeighbors();
+		timer.End();
+		flPhaseSeconds[pass][0] = timer.GetDuration().GetSeconds();
+
+		timer.Start();
+		InitAllLinks( pNetwork, bParallel );
+		timer.End();
+		flPhaseSeconds[pass][1] = timer.GetDuration().GetSeconds();
+
+		timer.Start();
+		InitZones( pNetwork );
+		timer.End();
+		flPhaseSeconds[pass][2] = timer.GetDuration().GetSeconds();
+
+		EndBuild();
+
+		WriteNetworkGraph( pNetwork, graphs[pass] );
+	}
+
+	Msg( "AI graph build of %d nodes on %d threads:\n", nNodes, ( g_pThreadPool ? g_pThreadPool->NumThreads() : 0 ) + 1 );
+	Msg( "  %-10s %10s %10s %8s\n", "phase", "serial", "threaded", "speedup" );
+
+	float flTotal[2] = { 0, 0 };
+	for ( int i = 0; i < nPhases; i++ )
+	{
+		Msg( "  %-10s %9.3fs %9.3fs %7.2fx\n", pszPhases[i], flPhaseSeconds[0][i], flPhaseSeconds[1][i],
+			flPhaseSeconds[1][i] > 0 ? flPhaseSeconds[0][i] / flPhaseSeconds[1][i] : 0.0f );
+		flTotal[0] += flPhaseSeconds[0][i];
+		flTotal[1] += flPhaseSeconds[1][i];
+	}
+	Msg( "  %-10s %9.3fs %9.3fs %7.2fx\n", "total", flTotal[0], flTotal[1], flTotal[1] > 0 ? flTotal[0] / flTotal[1] : 0.0f );
+
+	bool bSame = graphs[0].TellPut() == graphs[1].TellPut() &&
+				 !memcmp( graphs[0].Base(), graphs[1].Base(), graphs[0].TellPut() );
+	if ( bSame )
+		Msg( "Threaded build graph matches serial build\n" );
+	else
+		Warning( "ERROR: Threaded build graph differs from serial build!\n" );
+
+	g_pAINetworkManager->FixupHints();
+	CAI_DynamicLink::ResetDynamicLinks();
+}
+
 //------------------------------------------------------------------------------
 // Purpose : Forces testing of a connection between src and dest IDs for all dynamic links
 //			 	
@@ -2584,6 +3055,65 @@ void CAI_NetworkBuilder::InitNodePosition(CAI_Network *pNetwork, CAI_Node *pNode
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Line of sight checks between node positions.  Only reads the world,
+//			so it is safe to call on the thread pool during read-only traces.
+//-----------------------------------------------------------------------------
+static bool IsNodeVisible( const Vector &srcPos, const Vector &destPos )
+{
+	trace_t	tr;
+	tr.m_pEnt = NULL;
+
+	bool isVisible = false;
+
+	// ------------------
+	//  Bottom to bottom
+	// ------------------
+	AI_TraceLine ( srcPos, destPos,MASK_NPCWORLDSTATIC,NULL,COLLISION_GROUP_NONE, &tr );
+	if (!tr.startsolid && tr.fraction == 1.0)
+	{
+		isVisible = true;
+	}
+
+	// ------------------
+	//  Top to top
+	// ------------------
+	if (!isVisible)
+	{
+		AI_TraceLine ( srcPos + Vector( 0, 0, 70 ),destPos + Vector( 0, 0, 70 ),MASK_NPCWORLDSTATIC,NULL,COLLISION_GROUP_NONE, &tr );
+		if (!tr.startsolid && tr.fraction == 1.0)
+		{	
+			isVisible = true;
+		}
+	}
+
+	// ------------------
+	//  Top to Bottom
+	// ------------------
+	if (!isVisible)
+	{
+		AI_TraceLine ( srcPos + Vector( 0, 0, 70 ),destPos,MASK_NPCWORLDSTATIC,NULL,COLLISION_GROUP_NONE, &tr );
+		if (!tr.startsolid && tr.fraction == 1.0)
+		{	
+			isVisible = true;
+		}
+	}
+
+	// ------------------
+	//  Bottom to Top
+	// ------------------
+	if (!isVisible)
+	{
+		AI_TraceLine ( srcPos,destPos + Vector( 0, 0, 70 ),MASK_NPCWORLDSTATIC,NULL,COLLISION_GROUP_NONE, &tr );
+		if (!tr.startsolid && tr.fraction == 1.0)
+		{	
+			isVisible = true;
+		}
+	}
+
+	return isVisible;
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Set the visibility for this node.  (What nodes it can see with a
 //			line trace)
@@ -2661,57 +3191,8 @@ void CAI_NetworkBuilder::InitVisibility(CAI_Network *pNetwork, CAI_Node *pNode)
 		// position using the smallest hull to make sure were not in geometry
 		Vector destPos = pNetwork->GetNode( testnode )->GetPosition(HULL_SMALL_CENTERED);
 
-		trace_t	tr;
-		tr.m_pEnt = NULL;
-
 		// Try several line of sight checks
-
-		bool isVisible = false;
-
-		// ------------------
-		//  Bottom to bottom
-		// ------------------
-		AI_TraceLine ( srcPos, destPos,MASK_NPCWORLDSTATIC,NULL,COLLISION_GROUP_NONE, &tr );
-		if (!tr.startsolid && tr.fraction == 1.0)
-		{
-			isVisible = true;
-		}
-
-		// ------------------
-		//  Top to top
-		// ------------------
-		if (!isVisible)
-		{
-			AI_TraceLine ( srcPos + Vector( 0, 0, 70 ),destPos + Vector( 0, 0, 70 ),MASK_NPCWORLDSTATIC,NULL,COLLISION_GROUP_NONE, &tr );
-			if (!tr.startsolid && tr.fraction == 1.0)
-			{	
-				isVisible = true;
-			}
-		}
-
-		// ------------------
-		//  Top to Bottom
-		// ------------------
-		if (!isVisible)
-		{
-			AI_TraceLine ( srcPos + Vector( 0, 0, 70 ),destPos,MASK_NPCWORLDSTATIC,NULL,COLLISION_GROUP_NONE, &tr );
-			if (!tr.startsolid && tr.fraction == 1.0)
-			{	
-				isVisible = true;
-			}
-		}
-
-		// ------------------
-		//  Bottom to Top
-		// ------------------
-		if (!isVisible)
-		{
-			AI_TraceLine ( srcPos,destPos + Vector( 0, 0, 70 ),MASK_NPCWORLDSTATIC,NULL,COLLISION_GROUP_NONE, &tr );
-			if (!tr.startsolid && tr.fraction == 1.0)
-			{	
-				isVisible = true;
-			}
-		}
+		bool isVisible = IsNodeVisible( srcPos, destPos );
 
 		// ------------------
 		//  Failure
@@ -2784,6 +3265,18 @@ void CAI_NetworkBuilder::InitNeighbors(CAI_Network *pNetwork, CAI_Node *pNode)
 	// Begin by establishing viewability to limit the number of nodes tested
 	InitVisibility( pNetwork, pNode );
 
+	PruneRedundantNeighbors( pNetwork, pNode );
+
+	m_DidSetNeighborsTable.Set(pNode->m_iID);
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Removes visible nodes which are reachable through a closer
+//			neighbor in about the same direction
+//-----------------------------------------------------------------------------
+
+void CAI_NetworkBuilder::PruneRedundantNeighbors(CAI_Network *pNetwork, CAI_Node *pNode)
+{
 	AI_PROFILE_SCOPE_BEGIN( CAI_Node_InitNeighbors );
 
 	// Now check each neighbor against all other neighbors to see if one of
@@ -2889,8 +3382,6 @@ void CAI_NetworkBuilder::InitNeighbors(CAI_Network *pNetwork, CAI_Node *pNode)
 	}
 	
 	AI_PROFILE_SCOPE_END();
-
-	m_DidSetNeighborsTable.Set(pNode->m_iID);
 }
 
 //-----------------------------------------------------------------------------
@@ -2936,7 +3427,7 @@ static bool IsInLineForClimb( const Vector &srcPos, const Vector &srcFacing, con
 
 //-------------------------------------
 
-int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNode, Hull_t hull )
+int CAI_NetworkBuilder::ComputeConnection( CAI_TestHull *pTestHull, CAI_Node *pSrcNode, CAI_Node *pDestNode, Hull_t hull )
 {
 	int srcId = pSrcNode->m_iID;
 	int destId = pDestNode->m_iID;
@@ -2944,31 +3435,31 @@ int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNo
 	trace_t tr;
 	
 	// Set the size of the test hull
-	if ( m_pTestHull->GetHullType() != hull ) 
+	if ( pTestHull->GetHullType() != hull ) 
 	{
-		m_pTestHull->SetHullType( hull );
-		m_pTestHull->SetHullSizeNormal( true );
+		pTestHull->SetHullType( hull );
+		pTestHull->SetHullSizeNormal( true );
 	}
 
-	if ( !( m_pTestHull->GetFlags() & FL_ONGROUND ) )
+	if ( !( pTestHull->GetFlags() & FL_ONGROUND ) )
 	{
 		DevWarning( 2, "OFFGROUND!\n" );
 	}
-	m_pTestHull->AddFlag( FL_ONGROUND );
+	pTestHull->AddFlag( FL_ONGROUND );
 
 	// ==============================================================
 	// FIRST CHECK IF HULL CAN EVEN FIT AT THESE NODES
 	// ==============================================================
 	// @Note (toml 02-10-03): this should be optimized, caching the results of CanFitAtNode() 
 	if ( !( pSrcNode->m_eNodeInfo & ( HullToBit( hull ) << NODE_ENT_FLAGS_SHIFT ) ) &&
-		 !m_pTestHull->GetNavigator()->CanFitAtNode(srcId,MASK_NPCWORLDSTATIC) )
+		 !pTestHull->GetNavigator()->CanFitAtNode(srcId,MASK_NPCWORLDSTATIC) )
 	{
 		DebugConnectMsg( srcId, destId, "      Cannot fit at node %d\n", srcId );
 		return 0;
 	}
 	
 	if (  !( pDestNode->m_eNodeInfo & ( HullToBit( hull ) << NODE_ENT_FLAGS_SHIFT ) ) &&
-		 !m_pTestHull->GetNavigator()->CanFitAtNode(destId,MASK_NPCWORLDSTATIC) )
+		 !pTestHull->GetNavigator()->CanFitAtNode(destId,MASK_NPCWORLDSTATIC) )
 	{
 		DebugConnectMsg( srcId, destId, "      Cannot fit at node %d\n", destId );
 		return 0;
@@ -2984,7 +3475,7 @@ int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNo
 		// Air nodes only connect to other air nodes and nothing else
 		if (pSrcNode->m_eNodeType == NODE_AIR && pDestNode->GetType() == NODE_AIR)
 		{
-			AI_TraceHull( pSrcNode->GetOrigin(), pDestNode->GetOrigin(), NAI_Hull::Mins(hull),NAI_Hull::Maxs(hull), MASK_NPCWORLDSTATIC, m_pTestHull, COLLISION_GROUP_NONE, &tr );
+			AI_TraceHull( pSrcNode->GetOrigin(), pDestNode->GetOrigin(), NAI_Hull::Mins(hull),NAI_Hull::Maxs(hull), MASK_NPCWORLDSTATIC, pTestHull, COLLISION_GROUP_NONE, &tr );
 			if (!tr.startsolid && tr.fraction == 1.0)
 			{
 				result |= bits_CAP_MOVE_FLY;
@@ -3009,7 +3500,7 @@ int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNo
 		{
 			AI_TraceHull( srcPos, destPos, 
 							NAI_Hull::Mins(hull),NAI_Hull::Maxs(hull), 
-							MASK_NPCWORLDSTATIC, m_pTestHull, COLLISION_GROUP_NONE, &tr );
+							MASK_NPCWORLDSTATIC, pTestHull, COLLISION_GROUP_NONE, &tr );
 			if (!tr.startsolid && tr.fraction == 1.0)
 			{
 				result |= bits_CAP_MOVE_CLIMB;
@@ -3025,7 +3516,7 @@ int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNo
 				return 0;
 			}
 
-			AI_TraceHull( srcPos, destPos, NAI_Hull::Mins(hull),NAI_Hull::Maxs(hull), MASK_NPCWORLDSTATIC, m_pTestHull, COLLISION_GROUP_NONE, &tr );
+			AI_TraceHull( srcPos, destPos, NAI_Hull::Mins(hull),NAI_Hull::Maxs(hull), MASK_NPCWORLDSTATIC, pTestHull, COLLISION_GROUP_NONE, &tr );
 			if (!tr.startsolid && tr.fraction == 1.0)
 			{
 				result |= bits_CAP_MOVE_CLIMB;
@@ -3053,13 +3544,13 @@ int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNo
 		Vector srcPos	 = pSrcNode->GetPosition(hull);
 		Vector destPos	 = pDestNode->GetPosition(hull);
 
-		if (!m_pTestHull->GetMoveProbe()->CheckStandPosition( srcPos, MASK_NPCWORLDSTATIC))
+		if (!pTestHull->GetMoveProbe()->CheckStandPosition( srcPos, MASK_NPCWORLDSTATIC))
 		{
 			DebugConnectMsg( srcId, destId, "      Failed to stand at %d\n", srcId );
 			fStandFailed = true;
 		}
 
-		if (!m_pTestHull->GetMoveProbe()->CheckStandPosition( destPos, MASK_NPCWORLDSTATIC))
+		if (!pTestHull->GetMoveProbe()->CheckStandPosition( destPos, MASK_NPCWORLDSTATIC))
 		{
 			DebugConnectMsg( srcId, destId, "      Failed to stand at %d\n", destId );
 			fStandFailed = true;
@@ -3070,7 +3561,7 @@ int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNo
 
 		if ( !fStandFailed )
 		{
-			fWalkFailed = !m_pTestHull->GetMoveProbe()->TestGroundMove( srcPos, destPos, MASK_NPCWORLDSTATIC, AITGM_IGNORE_INITIAL_STAND_POS, NULL );
+			fWalkFailed = !pTestHull->GetMoveProbe()->TestGroundMove( srcPos, destPos, MASK_NPCWORLDSTATIC, AITGM_IGNORE_INITIAL_STAND_POS, NULL );
 			if ( fWalkFailed )
 				DebugConnectMsg( srcId, destId, "      Failed to walk between nodes\n" );
 		}
@@ -3096,15 +3587,15 @@ int CAI_NetworkBuilder::ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNo
 
 			// Jumps aren't bi-directional.  We can jump down further than we can jump up so
 			// we have to test for either one
-			bool canDestJump = m_pTestHull->IsJumpLegal(srcPos, destPos, destPos);
-			bool canSrcJump  = m_pTestHull->IsJumpLegal(destPos, srcPos, srcPos);
+			bool canDestJump = pTestHull->IsJumpLegal(srcPos, destPos, destPos);
+			bool canSrcJump  = pTestHull->IsJumpLegal(destPos, srcPos, srcPos);
 
 			if (canDestJump || canSrcJump) 
 			{
-				CAI_MoveProbe *pMoveProbe = m_pTestHull->GetMoveProbe();
+				CAI_MoveProbe *pMoveProbe = pTestHull->GetMoveProbe();
 
 				bool fJumpLegal = false;
-				m_pTestHull->SetGravity(1.0);
+				pTestHull->SetGravity(1.0);
 
 				AIMoveTrace_t moveTrace;
 				pMoveProbe->MoveLimit( NAV_JUMP, srcPos,destPos, MASK_NPCWORLDSTATIC, NULL, &moveTrace);
@@ -3187,11 +3678,14 @@ void CAI_NetworkBuilder::InitLinks(CAI_Network *pNetwork, CAI_Node *pNode)
 
 			if ( !(pNode->m_eNodeInfo & bits_NODE_FALLEN) && !(pDestNode->m_eNodeInfo & bits_NODE_FALLEN) )
 			{
+				// Threaded build tested the connection already
+				const ConnectionTest_t *pTest = FindConnectionTest( pNode->m_iID, i );
+
 				for (int hull = 0 ; hull < NUM_HULLS; hull++ )
 				{
 					DebugConnectMsg( pNode->m_iID, i, "   Testing for hull %s\n", NAI_Hull::Name( (Hull_t)hull  ) );
 					
-					acceptedMotions[hull] = ComputeConnection( pNode, pDestNode, (Hull_t)hull );
+					acceptedMotions[hull] = pTest ? pTest->acceptedMotions[hull] : ComputeConnection( m_pTestHull, pNode, pDestNode, (Hull_t)hull );
 					if ( acceptedMotions[hull] != 0 )
 						bAllFailed = false;
 				}
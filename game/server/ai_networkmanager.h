@@ -9,6 +9,7 @@
 
 #include "utlvector.h"
 #include "bitstring.h"
+#include "ai_hull.h"
 
 #if defined( _WIN32 )
 #pragma once
@@ -98,13 +99,29 @@ public:
 	void			Build( CAI_Network *pNetwork );
 	void			Rebuild( CAI_Network *pNetwork );
 
+	// Rebuilds neighbors, links and zones of an already built network serially
+	// and on the thread pool, reports time of each phase and checks that both
+	// builds produce the same graph.
+	void			BenchmarkBuild( CAI_Network *pNetwork );
+
 	void			InitNodePosition( CAI_Network *pNetwork, CAI_Node *pNode );
 
 	void			InitZones( CAI_Network *pNetwork );
 
 private:
+	// Result of ComputeConnection for every hull, precomputed on the thread pool
+	struct ConnectionTest_t
+	{
+		int				iSrcNode;
+		int				iDestNode;
+		int				acceptedMotions[NUM_HULLS];
+	};
+
 	void			InitVisibility( CAI_Network *pNetwork, CAI_Node *pNode );
 	void			InitNeighbors( CAI_Network *pNetwork, CAI_Node *pNode );
+	void			PruneRedundantNeighbors( CAI_Network *pNetwork, CAI_Node *pNode );
+	void			InitAllNeighbors( CAI_Network *pNetwork, bool bParallel );
+	void			InitAllLinks( CAI_Network *pNetwork, bool bParallel );
 	void			InitClimbNodePosition( CAI_Network *pNetwork, CAI_Node *pNode );
 	void			InitGroundNodePosition( CAI_Network *pNetwork, CAI_Node *pNode );
 	void			InitLinks( CAI_Network *pNetwork, CAI_Node *pNode );
@@ -112,7 +129,16 @@ private:
 	
 	void			FloodFillZone( CAI_Node **ppNodes, CAI_Node *pNode, int zone );
 
-	int				ComputeConnection( CAI_Node *pSrcNode, CAI_Node *pDestNode, Hull_t hull );
+	int				ComputeConnection( CAI_TestHull *pTestHull, CAI_Node *pSrcNode, CAI_Node *pDestNode, Hull_t hull );
+
+	// Thread pool passes
+	void			InitForwardVisibility( int &iNode );
+	void			ComputeConnectionTest( ConnectionTest_t &test );
+	void			BeginConnectionTests();
+	void			EndConnectionTests();
+	void			RunConnectionTests( CAI_Network *pNetwork, CUtlVector<ConnectionTest_t> &tests );
+	bool			NeedsConnectionTest( CAI_Network *pNetwork, int iSrcNode, int iDestNode );
+	const ConnectionTest_t *FindConnectionTest( int iSrcNode, int iDestNode ) const;
 	
 	void 			BeginBuild();
 	void			EndBuild();
@@ -120,6 +146,13 @@ private:
 	CUtlVector<CVarBitVec>	m_NeighborsTable;
 	CVarBitVec				m_DidSetNeighborsTable;
 	CAI_TestHull *			m_pTestHull;
+
+	CAI_Network *			m_pParallelNetwork;
+	CUtlVector<int>			m_NodeDeletedAt;			// Node whose visibility check deleted this one as a duplicate
+	CUtlVector<ConnectionTest_t> m_ConnectionTests;	// Sorted by source, then dest node
+	CUtlVector<CAI_TestHull *> m_ThreadTestHulls;		// One per thread, all of m_ParallelHull size
+	CInterlockedInt			m_nNextThreadTestHull;
+	Hull_t					m_ParallelHull;
 };
 
 extern CAI_NetworkBuilder g_AINetworkBuilder;
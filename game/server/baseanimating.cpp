@@ -20,6 +20,7 @@
 #include "isaverestore.h"
 #include "KeyValues.h"
 #include "tier0/vprof.h"
+#include "vstdlib/jobthread.h"
 #include "EntityFlame.h"
 #include "EntityDissolve.h"
 #include "ai_basenpc.h"
@@ -1760,6 +1761,141 @@ void CBaseAnimating::BuildMatricesWithBoneMerge(
 
 ConVar sv_pvsskipanimation( "sv_pvsskipanimation", "1", FCVAR_ARCHIVE, "Skips SetupBones when npc's are outside the PVS" );
 ConVar ai_setupbones_debug( "ai_setupbones_debug", "0", 0, "Shows that bones that are setup every think" );
+ConVar sv_parallel_setupbones( "sv_parallel_setupbones", "1", 0, "Sets up bones of stale bone caches on the thread pool when many are requested at once" );
+
+//-----------------------------------------------------------------------------
+// Bone setup benchmark: poses every model in the level at a few sequences and
+// cycles, with a second sequence layered on top, once with anim_simd_bones 0
+// and once with 1.
+//-----------------------------------------------------------------------------
+struct BoneSetupBenchmarkPose_t
+{
+	CStudioHdr *m_pStudioHdr;
+	int m_nSequence;
+	int m_nLayerSequence;
+	float m_flCycle;
+	float m_flPoseParameter[MAXSTUDIOPOSEPARAM];
+};
+
+static void BoneSetupBenchmarkPose( const BoneSetupBenchmarkPose_t &pose, Vector pos[], Quaternion q[] )
+{
+	IBoneSetup boneSetup( pose.m_pStudioHdr, BONE_USED_BY_ANYTHING, pose.m_flPoseParameter );
+	boneSetup.InitPose( pos, q );
+	boneSetup.AccumulatePose( pos, q, pose.m_nSequence, pose.m_flCycle, 1.0f, gpGlobals->curtime, NULL );
+	boneSetup.AccumulatePose( pos, q, pose.m_nLayerSequence, pose.m_flCycle, 0.5f, gpGlobals->curtime, NULL );
+}
+
+CON_COMMAND_F( anim_bone_setup_benchmark, "Pose every model in the level with scalar and SIMD bone setup, report bones/sec of both and max difference. Usage: anim_bone_setup_benchmark [passes]", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	ConVarRef anim_simd_bones( "anim_simd_bones" );
+	if ( !anim_simd_bones.IsValid() )
+		return;
+
+	const int nPasses = std::max( args.ArgC() > 1 ? atoi( args[1] ) : 20, 1 );
+	const float flCycles[] = { 0.1f, 0.45f, 0.8f };
+	const int nMaxSequences = 16;
+
+	CUtlVector<const studiohdr_t *> models;
+	CUtlVector<BoneSetupBenchmarkPose_t> poses;
+	int nPoseBones = 0;
+
+	for ( CBaseEntity *pEntity = gEntList.FirstEnt(); pEntity; pEntity = gEntList.NextEnt( pEntity ) )
+	{
+		CBaseAnimating *pAnimating = pEntity->GetBaseAnimating();
+		CStudioHdr *pStudioHdr = pAnimating ? pAnimating->GetModelPtr() : NULL;
+		if ( !pStudioHdr || !pStudioHdr->SequencesAvailable() || pStudioHdr->GetNumSeq() == 0 )
+			continue;
+
+		if ( models.Find( pStudioHdr->GetRenderHdr() ) != models.InvalidIndex() )
+			continue;
+		models.AddToTail( pStudioHdr->GetRenderHdr() );
+
+		const int nSequences = std::min( pStudioHdr->GetNumSeq(), nMaxSequences );
+		for ( int iSequence = 0; iSequence < nSequences; iSequence++ )
+		{
+			for ( float flCycle : flCycles )
+			{
+				BoneSetupBenchmarkPose_t &pose = poses[ poses.AddToTail() ];
+				pose.m_pStudioHdr = pStudioHdr;
+				pose.m_nSequence = iSequence;
+				pose.m_nLayerSequence = ( iSequence + 1 ) % pStudioHdr->GetNumSeq();
+				pose.m_flCycle = flCycle;
+				Studio_CalcDefaultPoseParameters( pStudioHdr, pose.m_flPoseParameter, MAXSTUDIOPOSEPARAM );
+				nPoseBones += pStudioHdr->numbones();
+			}
+		}
+	}
+
+	if ( poses.IsEmpty() )
+	{
+		Msg( "anim_bone_setup_benchmark: No animated models in the level.\n" );
+		return;
+	}
+
+	const bool bWasSIMD = anim_simd_bones.GetBool();
+
+	Vector pos[MAXSTUDIOBONES], simdPos[MAXSTUDIOBONES];
+	QuaternionAligned q[MAXSTUDIOBONES], simdQ[MAXSTUDIOBONES];
+
+	// compare poses first, this also brings all animation data in
+	float flMaxQuaternionError = 0.0f;
+	float flMaxPositionError = 0.0f;
+	for ( const BoneSetupBenchmarkPose_t &pose : poses )
+	{
+		anim_simd_bones.SetValue( 0 );
+		BoneSetupBenchmarkPose( pose, pos, q );
+		anim_simd_bones.SetValue( 1 );
+		BoneSetupBenchmarkPose( pose, simdPos, simdQ );
+
+		for ( int i = 0; i < pose.m_pStudioHdr->numbones(); i++ )
+		{
+			// q and -q are the same rotation
+			float flSame = 0.0f, flFlipped = 0.0f;
+			for ( int j = 0; j < 4; j++ )
+			{
+				flSame = std::max( flSame, fabsf( q[i][j] - simdQ[i][j] ) );
+				flFlipped = std::max( flFlipped, fabsf( q[i][j] + simdQ[i][j] ) );
+			}
+			flMaxQuaternionError = std::max( flMaxQuaternionError, std::min( flSame, flFlipped ) );
+
+			for ( int j = 0; j < 3; j++ )
+			{
+				flMaxPositionError = std::max( flMaxPositionError, fabsf( pos[i][j] - simdPos[i][j] ) );
+			}
+		}
+	}
+
+	double flBonesPerSecond[2];
+	for ( int iSIMD = 0; iSIMD < 2; iSIMD++ )
+	{
+		anim_simd_bones.SetValue( iSIMD );
+
+		CFastTimer timer;
+		timer.Start();
+		for ( int iPass = 0; iPass < nPasses; iPass++ )
+		{
+			for ( const BoneSetupBenchmarkPose_t &pose : poses )
+			{
+				BoneSetupBenchmarkPose( pose, pos, q );
+			}
+		}
+		timer.End();
+
+		const double flSeconds = timer.GetDuration().GetSeconds();
+		flBonesPerSecond[iSIMD] = flSeconds > 0 ? (double)nPoseBones * nPasses / flSeconds : 0.0;
+	}
+
+	anim_simd_bones.SetValue( bWasSIMD ? 1 : 0 );
+
+	Msg( "anim_bone_setup_benchmark: %d models, %d poses, %d bones per pass, %d passes.\n", models.Count(), poses.Count(), nPoseBones, nPasses );
+	Msg( "anim_bone_setup_benchmark: scalar %.2f M bones/sec, SIMD %.2f M bones/sec (x%.2f).\n",
+		flBonesPerSecond[0] / 1e6, flBonesPerSecond[1] / 1e6,
+		flBonesPerSecond[0] > 0 ? flBonesPerSecond[1] / flBonesPerSecond[0] : 0.0 );
+	Msg( "anim_bone_setup_benchmark: max difference %g in quaternion components, %g in positions.\n", flMaxQuaternionError, flMaxPositionError );
+}
 
 
 
@@ -2606,36 +2742,37 @@ void CBaseAnimating::UnlockStudioHdr()
 }
 
 //-----------------------------------------------------------------------------
-// Purpose: return the index to the shared bone cache
-// Output :
+// Purpose: bones every bone cache holds
 //-----------------------------------------------------------------------------
-CBoneCache *CBaseAnimating::GetBoneCache( void )
+int CBaseAnimating::GetBoneCacheMask()
 {
-	CStudioHdr *pStudioHdr = GetModelPtr( );
-	Assert(pStudioHdr);
-
-	CBoneCache *pcache = Studio_GetBoneCache( m_boneCacheHandle );
 	int boneMask = BONE_USED_BY_HITBOX | BONE_USED_BY_ATTACHMENT;
 
 	// TF queries these bones to position weapons when players are killed
 #if defined( TF_DLL )
 	boneMask |= BONE_USED_BY_BONE_MERGE;
 #endif
-	if ( pcache )
+	return boneMask;
+}
+
+bool CBaseAnimating::IsBoneCacheCurrent( CBoneCache *pcache, int boneMask ) const
+{
+	// Msg("%s:%s:%s (%x:%x:%8.4f) cache\n", GetClassname(), GetDebugName(), STRING(GetModelName()), boneMask, pcache->m_boneMask, pcache->m_timeValid );
+	return pcache && pcache->IsValid( gpGlobals->curtime ) && (pcache->m_boneMask & boneMask) == boneMask && pcache->m_timeValid <= gpGlobals->curtime;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: sets up bones and stores them in the bone cache, creating it when
+//			missing
+//-----------------------------------------------------------------------------
+CBoneCache *CBaseAnimating::UpdateBoneCache( CStudioHdr *pStudioHdr, CBoneCache *pcache, int boneMask )
+{
+	// in memory, but missing some of the bone masks
+	if ( pcache && (pcache->m_boneMask & boneMask) != boneMask )
 	{
-		if ( pcache->IsValid( gpGlobals->curtime ) && (pcache->m_boneMask & boneMask) == boneMask && pcache->m_timeValid <= gpGlobals->curtime)
-		{
-			// Msg("%s:%s:%s (%x:%x:%8.4f) cache\n", GetClassname(), GetDebugName(), STRING(GetModelName()), boneMask, pcache->m_boneMask, pcache->m_timeValid );
-			// in memory and still valid, use it!
-			return pcache;
-		}
-		// in memory, but missing some of the bone masks
-		if ( (pcache->m_boneMask & boneMask) != boneMask )
-		{
-			Studio_DestroyBoneCache( m_boneCacheHandle );
-			m_boneCacheHandle = 0;
-			pcache = NULL;
-		}
+		Studio_DestroyBoneCache( m_boneCacheHandle );
+		m_boneCacheHandle = 0;
+		pcache = NULL;
 	}
 
 	matrix3x4_t bonetoworld[MAXSTUDIOBONES];
@@ -2661,6 +2798,153 @@ CBoneCache *CBaseAnimating::GetBoneCache( void )
 	return pcache;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: return the index to the shared bone cache
+// Output :
+//-----------------------------------------------------------------------------
+CBoneCache *CBaseAnimating::GetBoneCache( void )
+{
+	CStudioHdr *pStudioHdr = GetModelPtr( );
+	Assert(pStudioHdr);
+
+	CBoneCache *pcache = Studio_GetBoneCache( m_boneCacheHandle );
+	const int boneMask = GetBoneCacheMask();
+
+	if ( IsBoneCacheCurrent( pcache, boneMask ) )
+	{
+		// in memory and still valid, use it!
+		VPROF_INCREMENT_COUNTER( "SetupBones bones reused", pStudioHdr->numbones() );
+		return pcache;
+	}
+
+	VPROF_INCREMENT_COUNTER( "SetupBones bones computed", pStudioHdr->numbones() );
+	return UpdateBoneCache( pStudioHdr, pcache, boneMask );
+}
+
+void CBaseAnimating::SetupBoneCacheJob( BoneCacheJob_t &job )
+{
+	matrix3x4_t bonetoworld[MAXSTUDIOBONES];
+	job.m_pEntity->SetupBones( bonetoworld, GetBoneCacheMask() );
+	job.m_pCache->UpdateBones( bonetoworld, job.m_pEntity->GetModelPtr()->numbones(), gpGlobals->curtime );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: brings bone caches of entities up to date for the current time, so
+//			later hitbox traces find them valid.  Bones are set up in parallel,
+//			except for entities which read other entities while doing it.
+//			Caches are created and locked here, so jobs never touch the shared
+//			bone cache and creating one can't evict another job's cache.
+//-----------------------------------------------------------------------------
+void CBaseAnimating::SetupBoneCaches( CBaseAnimating * const *ppEntities, int nEntities )
+{
+	VPROF_BUDGET( "CBaseAnimating::SetupBoneCaches", VPROF_BUDGETGROUP_SERVER_ANIM );
+
+	MDLCACHE_CRITICAL_SECTION();
+
+	const int boneMask = GetBoneCacheMask();
+	const bool bParallel = sv_parallel_setupbones.GetBool() && !ai_setupbones_debug.GetBool();
+
+	// room for every cache of the batch, so filling one doesn't evict another
+	// before the traces read it
+	size_t nCacheBytes = 0;
+	for ( int i = 0; i < nEntities; i++ )
+	{
+		// loads the model here, not on a job
+		CStudioHdr *pStudioHdr = ppEntities[i]->GetModelPtr();
+		if ( pStudioHdr )
+		{
+			bonecacheparams_t params;
+			params.pStudioHdr = pStudioHdr;
+			params.boneMask = boneMask;
+			nCacheBytes += sizeof( CBoneCache ) + CBoneCache::EstimatedSize( params );
+		}
+	}
+	Studio_ReserveBoneCaches( nCacheBytes );
+
+	BoneCacheJob_t *pJobs = (BoneCacheJob_t *)stackalloc( nEntities * sizeof( BoneCacheJob_t ) );
+	int nJobs = 0;
+	int nComputedBones = 0;
+	int nReusedBones = 0;
+
+	for ( int i = 0; i < nEntities; i++ )
+	{
+		CBaseAnimating *pEntity = ppEntities[i];
+
+		CStudioHdr *pStudioHdr = pEntity->GetModelPtr();
+		if ( !pStudioHdr )
+			continue;
+
+		CBoneCache *pcache = Studio_GetBoneCache( pEntity->m_boneCacheHandle );
+		if ( pEntity->IsBoneCacheCurrent( pcache, boneMask ) )
+		{
+			nReusedBones += pStudioHdr->numbones();
+			continue;
+		}
+
+		nComputedBones += pStudioHdr->numbones();
+
+		// IK traces the world and bone merge sets up the parent, keep them serial
+		if ( !bParallel || pEntity->m_pIk || dynamic_cast< CBaseAnimating* >( pEntity->GetMoveParent() ) )
+		{
+			pEntity->UpdateBoneCache( pStudioHdr, pcache, boneMask );
+			continue;
+		}
+
+		// in memory, but missing some of the bone masks
+		if ( pcache && (pcache->m_boneMask & boneMask) != boneMask )
+		{
+			Studio_DestroyBoneCache( pEntity->m_boneCacheHandle );
+			pEntity->m_boneCacheHandle = 0;
+			pcache = NULL;
+		}
+
+		if ( pcache )
+		{
+			pcache = Studio_LockBoneCache( pEntity->m_boneCacheHandle );
+		}
+		else
+		{
+			// the job fills the bones in, until then the cache stays invalid
+			static matrix3x4_t s_PlaceholderBones[MAXSTUDIOBONES];
+
+			bonecacheparams_t params;
+			params.pStudioHdr = pStudioHdr;
+			params.pBoneToWorld = s_PlaceholderBones;
+			params.curtime = -1.0f;
+			params.boneMask = boneMask;
+
+			pEntity->m_boneCacheHandle = Studio_CreateBoneCache( params, true );
+			pcache = Studio_GetBoneCache( pEntity->m_boneCacheHandle );
+		}
+		Assert( pcache );
+
+		// resolve dirty abs transforms here, not on a job
+		pEntity->GetAbsOrigin();
+		pEntity->GetAbsAngles();
+
+		pJobs[nJobs].m_pEntity = pEntity;
+		pJobs[nJobs].m_pCache = pcache;
+		nJobs++;
+	}
+
+	if ( nJobs == 1 )
+	{
+		SetupBoneCacheJob( pJobs[0] );
+	}
+	else if ( nJobs > 1 )
+	{
+		ParallelProcess( "CBaseAnimating::SetupBoneCaches", pJobs, nJobs, &CBaseAnimating::SetupBoneCacheJob );
+	}
+
+	for ( int i = 0; i < nJobs; i++ )
+	{
+		Studio_UnlockBoneCache( pJobs[i].m_pEntity->m_boneCacheHandle );
+	}
+
+	VPROF_INCREMENT_COUNTER( "SetupBones bones computed", nComputedBones );
+	VPROF_INCREMENT_COUNTER( "SetupBones bones reused", nReusedBones );
+}
+
 
 void CBaseAnimating::InvalidateBoneCache( void )
 {
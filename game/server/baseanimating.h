@@ -257,6 +257,8 @@ public:
 	virtual bool TestCollision( const Ray_t &ray, unsigned int fContentsMask, trace_t& tr );
 	virtual bool TestHitboxes( const Ray_t &ray, unsigned int fContentsMask, trace_t& tr );
 	class CBoneCache *GetBoneCache( void );
+	// Brings bone caches of many entities up to date at once, stale ones are set up on the thread pool
+	static void SetupBoneCaches( CBaseAnimating * const *ppEntities, int nEntities );
 	void InvalidateBoneCache();
 	void InvalidateBoneCacheIfOlderThan( float deltaTime );
 	virtual int DrawDebugTextOverlays( void );
@@ -344,6 +346,17 @@ private:
 
 	bool CanSkipAnimation( void );
 
+	static int GetBoneCacheMask();
+	bool IsBoneCacheCurrent( CBoneCache *pcache, int boneMask ) const;
+	CBoneCache *UpdateBoneCache( CStudioHdr *pStudioHdr, CBoneCache *pcache, int boneMask );
+
+	struct BoneCacheJob_t
+	{
+		CBaseAnimating *m_pEntity;
+		CBoneCache *m_pCache;	// locked until the batch is done
+	};
+	static void SetupBoneCacheJob( BoneCacheJob_t &job );
+
 public:
 	CNetworkVar( int, m_nForceBone );
 	CNetworkVector( m_vecForce );
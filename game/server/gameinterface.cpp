@@ -262,6 +262,18 @@ const IChangeInfoAccessor *CBaseEdict::GetChangeAccessor() const
 	return engine->GetChangeAccessor( (const edict_t *)this );
 }
 
+// Engines older than INTERFACEVERSION_VENGINESERVER lack EdictStateChangedOverflow.
+static bool g_bEngineTracksOverflowChanges = false;
+
+bool CBaseEdict::StateChangedOverflow( unsigned short offset )
+{
+	if ( !g_bEngineTracksOverflowChanges )
+		return false;
+
+	engine->EdictStateChangedOverflow( (edict_t *)this, offset );
+	return true;
+}
+
 const char *GetHintTypeDescription( CAI_Hint *pHint );
 
 void ClientPutInServerOverride( ClientPutInServerOverrideFn fn )
@@ -587,7 +599,8 @@ bool CServerGameDLL::DLLInit( CreateInterfaceFn appSystemFactory,
 #endif
 
 	// init each (seperated for ease of debugging)
-	if ( (engine = (IVEngineServer*)appSystemFactory(INTERFACEVERSION_VENGINESERVER, NULL)) == NULL )
+	g_bEngineTracksOverflowChanges = (engine = (IVEngineServer*)appSystemFactory(INTERFACEVERSION_VENGINESERVER, NULL)) != NULL;
+	if ( !engine && (engine = (IVEngineServer*)appSystemFactory(INTERFACEVERSION_VENGINESERVER_VERSION_23, NULL)) == NULL )
 		return false;
 	if ( (g_pVoiceServer = (IVoiceServer*)appSystemFactory(INTERFACEVERSION_VOICESERVER, NULL)) == NULL )
 		return false;
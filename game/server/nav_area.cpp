@@ -813,6 +813,8 @@ void CNavArea::ConnectTo( CNavArea *area, NavDirType dir )
 	{
 		area->AddIncomingConnection( this, dirOpposite );
 	}	
+
+	TheNavClusterGraph.Invalidate();
 	
 	//static char *dirName[] = { "NORTH", "EAST", "SOUTH", "WEST" };
 	//CONSOLE_ECHO( "  Connected area #%d to #%d, %s\n", m_id, area->m_id, dirName[ dir ] );
@@ -837,6 +839,8 @@ void CNavArea::ConnectTo( CNavLadder *ladder )
 	{
 		AddLadderUp( ladder );
 	}
+
+	TheNavClusterGraph.Invalidate();
 }
 
 //--------------------------------------------------------------------------------------------------------------
@@ -867,6 +871,8 @@ void CNavArea::Disconnect( CNavArea *area )
 			}
 		}		
 	}
+
+	TheNavClusterGraph.Invalidate();
 }
 
 
@@ -3363,6 +3369,12 @@ void CNavArea::DrawConnectedAreas( void ) const
  */
 void CNavArea::AddToOpenList( void )
 {
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+	{
+		context->AddToOpenList( this, false );
+		return;
+	}
+
 	Assert( (m_openList && m_openList->m_prevOpen == NULL) || m_openList == NULL );
 
 	if ( IsOpen() )
@@ -3433,6 +3445,12 @@ void CNavArea::AddToOpenList( void )
  */
 void CNavArea::AddToOpenListTail( void )
 {
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+	{
+		context->AddToOpenList( this, true );
+		return;
+	}
+
 	Assert( (m_openList && m_openList->m_prevOpen == NULL) || m_openList == NULL );
 
 	if ( IsOpen() )
@@ -3474,6 +3492,12 @@ void CNavArea::AddToOpenListTail( void )
  */
 void CNavArea::UpdateOnOpenList( void )
 {
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+	{
+		context->UpdateOnOpenList( this );
+		return;
+	}
+
 	// since value can only decrease, bubble this area up from current spot
 	while( m_prevOpen && this->GetTotalCost() < m_prevOpen->GetTotalCost() )
 	{
@@ -3511,6 +3535,12 @@ void CNavArea::UpdateOnOpenList( void )
 //--------------------------------------------------------------------------------------------------------------
 void CNavArea::RemoveFromOpenList( void )
 {
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+	{
+		context->RemoveFromOpenList( this );
+		return;
+	}
+
 	if ( m_openMarker == 0 )
 	{
 		// not on the list
@@ -3545,6 +3575,12 @@ void CNavArea::RemoveFromOpenList( void )
  */
 void CNavArea::ClearSearchLists( void )
 {
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+	{
+		context->ClearSearchLists();
+		return;
+	}
+
 	// effectively clears all open list pointers and closed flags
 	CNavArea::MakeNewMarker();
 
@@ -3552,6 +3588,199 @@ void CNavArea::ClearSearchLists( void )
 	m_openListTail = NULL;
 }
 
+//--------------------------------------------------------------------------------------------------------------
+thread_local CNavSearchContext *CNavSearchContext::s_bound = NULL;
+
+static CThreadFastMutex s_navSearchContextPoolMutex;
+static CNavSearchContext *s_idleNavSearchContexts = NULL;
+
+//--------------------------------------------------------------------------------------------------------------
+CNavSearchContext::CNavSearchContext( void ) : m_openList( 0, 0, OpenEntryLessPriority )
+{
+	m_masterMarker = 1;
+	m_openOrder = 0;
+	m_expandedCount = 0;
+	m_nextIdle = NULL;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Forget all area state, but keep the memory for the next query
+ */
+void CNavSearchContext::Reset( void )
+{
+	m_stateIndex.RemoveAll();
+	m_states.RemoveAll();
+	m_openList.RemoveAll();
+	m_masterMarker = 1;
+	m_openOrder = 0;
+	m_expandedCount = 0;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+CNavSearchContext *CNavSearchContext::Acquire( void )
+{
+	{
+		AUTO_LOCK( s_navSearchContextPoolMutex );
+
+		CNavSearchContext *context = s_idleNavSearchContexts;
+		if ( context )
+		{
+			s_idleNavSearchContexts = context->m_nextIdle;
+			context->m_nextIdle = NULL;
+			return context;
+		}
+	}
+
+	return new CNavSearchContext;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavSearchContext::Release( CNavSearchContext *context )
+{
+	context->Reset();
+
+	AUTO_LOCK( s_navSearchContextPoolMutex );
+
+	context->m_nextIdle = s_idleNavSearchContexts;
+	s_idleNavSearchContexts = context;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavSearchContext::PurgePool( void )
+{
+	AUTO_LOCK( s_navSearchContextPoolMutex );
+
+	while( s_idleNavSearchContexts )
+	{
+		CNavSearchContext *context = s_idleNavSearchContexts;
+		s_idleNavSearchContexts = context->m_nextIdle;
+		delete context;
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+CNavSearchContext::AreaState *CNavSearchContext::FindState( const CNavArea *area )
+{
+	UtlHashHandle_t h = m_stateIndex.Find( area );
+	return ( h != m_stateIndex.InvalidHandle() ) ? &m_states[ m_stateIndex[ h ] ] : NULL;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+const CNavSearchContext::AreaState *CNavSearchContext::FindState( const CNavArea *area ) const
+{
+	UtlHashHandle_t h = m_stateIndex.Find( area );
+	return ( h != m_stateIndex.InvalidHandle() ) ? &m_states[ m_stateIndex[ h ] ] : NULL;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+CNavSearchContext::AreaState &CNavSearchContext::GetState( const CNavArea *area )
+{
+	UtlHashHandle_t h = m_stateIndex.Find( area );
+	if ( h != m_stateIndex.InvalidHandle() )
+		return m_states[ m_stateIndex[ h ] ];
+
+	int index = m_states.AddToTail();
+	m_stateIndex.Insert( area, index );
+
+	AreaState &state = m_states[ index ];
+	state.m_area = const_cast< CNavArea * >( area );
+	state.m_parent = NULL;
+	state.m_parentHow = NUM_TRAVERSE_TYPES;
+	state.m_marker = 0;
+	state.m_openMarker = 0;
+	state.m_openOrder = 0;
+	state.m_totalCost = 0.0f;
+	state.m_costSoFar = 0.0f;
+	state.m_pathLengthSoFar = 0.0f;
+	return state;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+bool CNavSearchContext::OpenEntryLessPriority( const OpenEntry &lhs, const OpenEntry &rhs )
+{
+	// lowest cost at the head, earliest insertion first among equal costs
+	if ( lhs.m_totalCost != rhs.m_totalCost )
+		return lhs.m_totalCost > rhs.m_totalCost;
+
+	return lhs.m_order > rhs.m_order;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+bool CNavSearchContext::IsStale( const OpenEntry &entry ) const
+{
+	const AreaState &state = m_states[ entry.m_state ];
+	return state.m_openMarker != m_masterMarker || state.m_openOrder != entry.m_order;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Add area to open list in ascending cost order, or behind everything else if 'tail'
+ */
+void CNavSearchContext::AddToOpenList( CNavArea *area, bool tail )
+{
+	AreaState &state = GetState( area );
+	if ( state.m_openMarker == m_masterMarker )
+	{
+		// already on list
+		return;
+	}
+
+	state.m_openMarker = m_masterMarker;
+	state.m_openOrder = ++m_openOrder;
+
+	OpenEntry entry;
+	entry.m_totalCost = tail ? FLT_MAX : state.m_totalCost;
+	entry.m_order = state.m_openOrder;
+	entry.m_state = &state - m_states.Base();
+	m_openList.Insert( entry );
+}
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * A smaller cost has been found, the entry with the old cost is left to go stale
+ */
+void CNavSearchContext::UpdateOnOpenList( CNavArea *area )
+{
+	AreaState *state = FindState( area );
+	if ( !state || state->m_openMarker != m_masterMarker )
+		return;
+
+	state->m_openOrder = ++m_openOrder;
+
+	OpenEntry entry;
+	entry.m_totalCost = state->m_totalCost;
+	entry.m_order = state->m_openOrder;
+	entry.m_state = state - m_states.Base();
+	m_openList.Insert( entry );
+}
+
+//--------------------------------------------------------------------------------------------------------------
+bool CNavSearchContext::IsOpenListEmpty( void )
+{
+	while( m_openList.Count() && IsStale( m_openList.ElementAtHead() ) )
+	{
+		m_openList.RemoveAtHead();
+	}
+
+	return m_openList.Count() == 0;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+CNavArea *CNavSearchContext::PopOpenList( void )
+{
+	if ( IsOpenListEmpty() )
+		return NULL;
+
+	AreaState &state = m_states[ m_openList.ElementAtHead().m_state ];
+	m_openList.RemoveAtHead();
+	++m_expandedCount;
+
+	state.m_openMarker = 0;
+	return state.m_area;
+}
+
+
 //--------------------------------------------------------------------------------------------------------------
 void CNavArea::SetCorner( NavCornerType corner, const Vector& newPosition )
 {
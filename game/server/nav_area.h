@@ -14,6 +14,8 @@
 
 #include "nav_ladder.h"
 #include "tier1/memstack.h"
+#include "tier1/utlhashtable.h"
+#include "tier1/utlpriorityqueue.h"
 
 // BOTPORT: Clean up relationship between team index and danger storage in nav areas
 enum { MAX_NAV_TEAMS = 2 };
@@ -432,13 +434,14 @@ public:
 	float GetLightIntensity( void ) const;						// returns a 0..1 light intensity averaged over the whole area
 
 	//- A* pathfinding algorithm ------------------------------------------------------------------------
-	static void MakeNewMarker( void )	{ ++m_masterMarker; if (m_masterMarker == 0) m_masterMarker = 1; }
-	void Mark( void )					{ m_marker = m_masterMarker; }
-	BOOL IsMarked( void ) const			{ return (m_marker == m_masterMarker) ? true : false; }
+	// While a CNavSearchContext is bound to the calling thread, these use the context instead of the members below
+	static void MakeNewMarker( void );
+	void Mark( void );
+	BOOL IsMarked( void ) const;
 	
-	void SetParent( CNavArea *parent, NavTraverseType how = NUM_TRAVERSE_TYPES )	{ m_parent = parent; m_parentHow = how; }
-	CNavArea *GetParent( void ) const	{ return m_parent; }
-	NavTraverseType GetParentHow( void ) const	{ return m_parentHow; }
+	void SetParent( CNavArea *parent, NavTraverseType how = NUM_TRAVERSE_TYPES );
+	CNavArea *GetParent( void ) const;
+	NavTraverseType GetParentHow( void ) const;
 
 	bool IsOpen( void ) const;									// true if on "open list"
 	void AddToOpenList( void );									// add to open list in decreasing value order
@@ -454,14 +457,14 @@ public:
 
 	static void ClearSearchLists( void );						// clears the open and closed lists for a new search
 
-	void SetTotalCost( float value )	{ DebuggerBreakOnNaN_StagingOnly( value ); Assert( value >= 0.0 && !IS_NAN(value) ); m_totalCost = value; }
-	float GetTotalCost( void ) const	{ DebuggerBreakOnNaN_StagingOnly( m_totalCost ); return m_totalCost; }
+	void SetTotalCost( float value );
+	float GetTotalCost( void ) const;
 
-	void SetCostSoFar( float value )	{ DebuggerBreakOnNaN_StagingOnly( value ); Assert( value >= 0.0 && !IS_NAN(value) ); m_costSoFar = value; }
-	float GetCostSoFar( void ) const	{ DebuggerBreakOnNaN_StagingOnly( m_costSoFar ); return m_costSoFar; }
+	void SetCostSoFar( float value );
+	float GetCostSoFar( void ) const;
 
-	void SetPathLengthSoFar( float value )	{ DebuggerBreakOnNaN_StagingOnly( value ); Assert( value >= 0.0 && !IS_NAN(value) ); m_pathLengthSoFar = value; }
-	float GetPathLengthSoFar( void ) const	{ DebuggerBreakOnNaN_StagingOnly( m_pathLengthSoFar ); return m_pathLengthSoFar; }
+	void SetPathLengthSoFar( float value );
+	float GetPathLengthSoFar( void ) const;
 
 	//- editing -----------------------------------------------------------------------------------------
 	virtual void Draw( void ) const;							// draw area for debugging & editing
@@ -771,6 +774,120 @@ typedef CUtlVector< CNavArea * > NavAreaVector;
 extern NavAreaVector TheNavAreas;
 
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * The A* search state of one query: markers, open list, parents and costs of the areas it touched.
+ * Bind one to a thread with CNavSearchScope and NavAreaBuildPath(), and any other search using the
+ * CNavArea pathfinding methods, can run on that thread concurrently with searches on other threads.
+ * Contexts are pooled and keep their memory between queries.
+ */
+class CNavSearchContext
+{
+public:
+	static CNavSearchContext *GetBound( void )	{ return s_bound; }	// context bound to the calling thread, or NULL
+
+	static CNavSearchContext *Acquire( void );			// get an idle context from the pool
+	static void Release( CNavSearchContext *context );	// return context to the pool
+	static void PurgePool( void );						// free idle contexts, when the mesh is unloaded
+
+	void MakeNewMarker( void )							{ ++m_masterMarker; if (m_masterMarker == 0) m_masterMarker = 1; }
+	void Mark( const CNavArea *area )					{ GetState( area ).m_marker = m_masterMarker; }
+	bool IsMarked( const CNavArea *area ) const			{ const AreaState *state = FindState( area ); return state && state->m_marker == m_masterMarker; }
+
+	void SetParent( const CNavArea *area, CNavArea *parent, NavTraverseType how )	{ AreaState &state = GetState( area ); state.m_parent = parent; state.m_parentHow = how; }
+	CNavArea *GetParent( const CNavArea *area ) const	{ const AreaState *state = FindState( area ); return state ? state->m_parent : NULL; }
+	NavTraverseType GetParentHow( const CNavArea *area ) const	{ const AreaState *state = FindState( area ); return state ? state->m_parentHow : NUM_TRAVERSE_TYPES; }
+
+	bool IsOpen( const CNavArea *area ) const			{ const AreaState *state = FindState( area ); return state && state->m_openMarker == m_masterMarker; }
+	void AddToOpenList( CNavArea *area, bool tail );
+	void UpdateOnOpenList( CNavArea *area );
+	void RemoveFromOpenList( const CNavArea *area )		{ AreaState *state = FindState( area ); if ( state ) state->m_openMarker = 0; }
+	bool IsOpenListEmpty( void );
+	CNavArea *PopOpenList( void );
+	void ClearSearchLists( void )						{ MakeNewMarker(); m_openList.RemoveAll(); }
+
+	void SetTotalCost( const CNavArea *area, float value )	{ GetState( area ).m_totalCost = value; }
+	float GetTotalCost( const CNavArea *area ) const		{ const AreaState *state = FindState( area ); return state ? state->m_totalCost : 0.0f; }
+	void SetCostSoFar( const CNavArea *area, float value )	{ GetState( area ).m_costSoFar = value; }
+	float GetCostSoFar( const CNavArea *area ) const		{ const AreaState *state = FindState( area ); return state ? state->m_costSoFar : 0.0f; }
+	void SetPathLengthSoFar( const CNavArea *area, float value )	{ GetState( area ).m_pathLengthSoFar = value; }
+	float GetPathLengthSoFar( const CNavArea *area ) const			{ const AreaState *state = FindState( area ); return state ? state->m_pathLengthSoFar : 0.0f; }
+
+	int GetTouchedAreaCount( void ) const				{ return m_states.Count(); }	// areas this query has written state for
+	unsigned int GetExpandedAreaCount( void ) const		{ return m_expandedCount; }		// areas popped from the open list since the context was bound
+
+private:
+	friend class CNavSearchScope;
+
+	CNavSearchContext( void );
+	void Reset( void );
+
+	struct AreaState
+	{
+		CNavArea *m_area;
+		CNavArea *m_parent;
+		NavTraverseType m_parentHow;
+		unsigned int m_marker;
+		unsigned int m_openMarker;
+		unsigned int m_openOrder;			// order of the open list entry which is current for this area
+		float m_totalCost;
+		float m_costSoFar;
+		float m_pathLengthSoFar;
+	};
+
+	// open list is a heap with lazy deletion, entries left behind by updates and removals are skipped when popped
+	struct OpenEntry
+	{
+		float m_totalCost;
+		unsigned int m_order;				// insertion order, so equal costs pop first-in first-out like the area list
+		int m_state;
+	};
+	static bool OpenEntryLessPriority( const OpenEntry &lhs, const OpenEntry &rhs );
+	bool IsStale( const OpenEntry &entry ) const;
+
+	AreaState *FindState( const CNavArea *area );
+	const AreaState *FindState( const CNavArea *area ) const;
+	AreaState &GetState( const CNavArea *area );
+
+	CUtlHashtable< const CNavArea *, int > m_stateIndex;
+	CUtlVector< AreaState > m_states;
+	CUtlPriorityQueue< OpenEntry > m_openList;
+	unsigned int m_masterMarker;
+	unsigned int m_openOrder;
+	unsigned int m_expandedCount;
+
+	CNavSearchContext *m_nextIdle;
+
+	static thread_local CNavSearchContext *s_bound;
+};
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Binds a pooled search context to the calling thread for the lifetime of the scope
+ */
+class CNavSearchScope
+{
+public:
+	CNavSearchScope( void ) : m_context( CNavSearchContext::Acquire() ), m_previous( CNavSearchContext::s_bound )
+	{
+		CNavSearchContext::s_bound = m_context;
+	}
+
+	~CNavSearchScope()
+	{
+		CNavSearchContext::s_bound = m_previous;
+		CNavSearchContext::Release( m_context );
+	}
+
+	CNavSearchContext *GetContext( void ) const	{ return m_context; }
+
+private:
+	CNavSearchContext *m_context;
+	CNavSearchContext *m_previous;
+};
+
+
 //--------------------------------------------------------------------------------------------------------------
 //--------------------------------------------------------------------------------------------------------------
 //
@@ -828,15 +945,162 @@ inline CNavArea *CNavArea::GetAdjacentArea( NavDirType dir, int i ) const
 	return m_connect[dir][i].area;
 }
 
+//--------------------------------------------------------------------------------------------------------------
+inline void CNavArea::MakeNewMarker( void )
+{
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+	{
+		context->MakeNewMarker();
+		return;
+	}
+
+	++m_masterMarker;
+	if (m_masterMarker == 0)
+		m_masterMarker = 1;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline void CNavArea::Mark( void )
+{
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+	{
+		context->Mark( this );
+		return;
+	}
+
+	m_marker = m_masterMarker;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline BOOL CNavArea::IsMarked( void ) const
+{
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+		return context->IsMarked( this );
+
+	return (m_marker == m_masterMarker) ? true : false;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline void CNavArea::SetParent( CNavArea *parent, NavTraverseType how )
+{
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+	{
+		context->SetParent( this, parent, how );
+		return;
+	}
+
+	m_parent = parent;
+	m_parentHow = how;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline CNavArea *CNavArea::GetParent( void ) const
+{
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+		return context->GetParent( this );
+
+	return m_parent;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline NavTraverseType CNavArea::GetParentHow( void ) const
+{
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+		return context->GetParentHow( this );
+
+	return m_parentHow;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline void CNavArea::SetTotalCost( float value )
+{
+	DebuggerBreakOnNaN_StagingOnly( value );
+	Assert( value >= 0.0 && !IS_NAN(value) );
+
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+	{
+		context->SetTotalCost( this, value );
+		return;
+	}
+
+	m_totalCost = value;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline float CNavArea::GetTotalCost( void ) const
+{
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+		return context->GetTotalCost( this );
+
+	DebuggerBreakOnNaN_StagingOnly( m_totalCost );
+	return m_totalCost;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline void CNavArea::SetCostSoFar( float value )
+{
+	DebuggerBreakOnNaN_StagingOnly( value );
+	Assert( value >= 0.0 && !IS_NAN(value) );
+
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+	{
+		context->SetCostSoFar( this, value );
+		return;
+	}
+
+	m_costSoFar = value;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline float CNavArea::GetCostSoFar( void ) const
+{
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+		return context->GetCostSoFar( this );
+
+	DebuggerBreakOnNaN_StagingOnly( m_costSoFar );
+	return m_costSoFar;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline void CNavArea::SetPathLengthSoFar( float value )
+{
+	DebuggerBreakOnNaN_StagingOnly( value );
+	Assert( value >= 0.0 && !IS_NAN(value) );
+
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+	{
+		context->SetPathLengthSoFar( this, value );
+		return;
+	}
+
+	m_pathLengthSoFar = value;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline float CNavArea::GetPathLengthSoFar( void ) const
+{
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+		return context->GetPathLengthSoFar( this );
+
+	DebuggerBreakOnNaN_StagingOnly( m_pathLengthSoFar );
+	return m_pathLengthSoFar;
+}
+
 //--------------------------------------------------------------------------------------------------------------
 inline bool CNavArea::IsOpen( void ) const
 {
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+		return context->IsOpen( this );
+
 	return (m_openMarker == m_masterMarker) ? true : false;
 }
 
 //--------------------------------------------------------------------------------------------------------------
 inline bool CNavArea::IsOpenListEmpty( void )
 {
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+		return context->IsOpenListEmpty();
+
 	Assert( (m_openList && m_openList->m_prevOpen == NULL) || m_openList == NULL );
 	return (m_openList) ? false : true;
 }
@@ -844,6 +1108,9 @@ inline bool CNavArea::IsOpenListEmpty( void )
 //--------------------------------------------------------------------------------------------------------------
 inline CNavArea *CNavArea::PopOpenList( void )
 {
+	if ( CNavSearchContext *context = CNavSearchContext::GetBound() )
+		return context->PopOpenList();
+
 	Assert( (m_openList && m_openList->m_prevOpen == NULL) || m_openList == NULL );
 
 	if ( m_openList )
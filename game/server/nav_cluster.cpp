@@ -0,0 +1,726 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose:
+//
+// $NoKeywords: $
+//===========================================================================//
+
+// Cluster graph over the Navigation Mesh, for hierarchical path-finding
+
+#include "cbase.h"
+#include "filesystem.h"
+#include "nav_mesh.h"
+#include "nav_pathfind.h"
+#include "nav_cluster.h"
+#include "checksum_crc.h"
+#include "utlbuffer.h"
+#include "utlpriorityqueue.h"
+#include "vstdlib/random.h"
+
+// NOTE: This has to be the last file included!
+#include "tier0/memdbgon.h"
+
+
+ConVar nav_cluster_size( "nav_cluster_size", "1024", FCVAR_GAMEDLL | FCVAR_CHEAT, "Size of the grid cells the Navigation Mesh is clustered by, for hierarchical path-finding. Takes effect when the mesh is next saved." );
+static void NavHPAPathfindChanged( IConVar *var, const char *pOldValue, float flOldValue );
+
+ConVar nav_hpa_pathfind( "nav_hpa_pathfind", "0", FCVAR_GAMEDLL, "Set to one to restrict long path searches to a corridor of nav clusters. Paths may be worse when the cost functor adds more than travel distance.", NavHPAPathfindChanged );
+ConVar nav_hpa_corridor_slack( "nav_hpa_corridor_slack", "1.25", FCVAR_GAMEDLL | FCVAR_CHEAT, "How much longer than the shortest cluster distance a path in the corridor may be." );
+ConVar nav_hpa_corridor_margin( "nav_hpa_corridor_margin", "3072", FCVAR_GAMEDLL | FCVAR_CHEAT, "Extra travel distance allowed in the corridor, to cover travel within the first and last clusters." );
+
+#define NAV_CLUSTER_MAGIC_NUMBER 0xFEEDC1A5		// to help identify cluster files
+#define NAV_CLUSTER_VERSION 1
+#define NAV_CLUSTER_MAX_COUNT 4096				// distance tables grow with the square of the cluster count
+
+CNavClusterGraph TheNavClusterGraph;
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Collect the areas NavAreaBuildPath() can move to from 'area', in the order it visits them
+ */
+static void CollectNavClusterNeighbors( const CNavArea *area, CUtlVector< const CNavArea * > *neighbors )
+{
+	neighbors->RemoveAll();
+
+	for( int dir=0; dir<NUM_DIRECTIONS; ++dir )
+	{
+		const NavConnectVector *floorList = area->GetAdjacentAreas( (NavDirType)dir );
+		FOR_EACH_VEC( (*floorList), it )
+		{
+			neighbors->AddToTail( floorList->Element( it ).area );
+		}
+	}
+
+	// do not use BEHIND connection, as its very hard to get to when going up a ladder
+	const NavLadderConnectVector *ladderList = area->GetLadders( CNavLadder::LADDER_UP );
+	FOR_EACH_VEC( (*ladderList), it )
+	{
+		const CNavLadder *ladder = ladderList->Element( it ).ladder;
+		neighbors->AddToTail( ladder->m_topForwardArea );
+		neighbors->AddToTail( ladder->m_topLeftArea );
+		neighbors->AddToTail( ladder->m_topRightArea );
+	}
+
+	ladderList = area->GetLadders( CNavLadder::LADDER_DOWN );
+	FOR_EACH_VEC( (*ladderList), it )
+	{
+		neighbors->AddToTail( ladderList->Element( it ).ladder->m_bottomArea );
+	}
+
+	if ( area->GetElevator() )
+	{
+		const NavConnectVector &elevatorAreas = area->GetElevatorAreas();
+		FOR_EACH_VEC( elevatorAreas, it )
+		{
+			neighbors->AddToTail( elevatorAreas[ it ].area );
+		}
+	}
+
+	for( int i=neighbors->Count()-1; i>=0; --i )
+	{
+		if ( neighbors->Element( i ) == NULL || neighbors->Element( i ) == area )
+		{
+			neighbors->Remove( i );
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+CNavClusterGraph::CNavClusterGraph( void )
+{
+	m_isBuilt = false;
+	m_clusterCount = 0;
+	m_meshChecksum = 0;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavClusterGraph::Reset( void )
+{
+	m_isBuilt = false;
+	m_clusterCount = 0;
+	m_meshChecksum = 0;
+	m_clusterByID.Purge();
+	m_distance.Purge();
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Build the graph unless it is already built, reading it from the .navcluster file next to navFilename when
+ * that still matches the mesh
+ */
+void CNavClusterGraph::EnsureBuilt( const char *navFilename )
+{
+	if ( m_isBuilt )
+		return;
+
+	if ( !navFilename || !Load( navFilename ) )
+	{
+		Build();
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+static void NavHPAPathfindChanged( IConVar *var, const char *pOldValue, float flOldValue )
+{
+	// the graph is only built while it is used
+	if ( nav_hpa_pathfind.GetBool() && TheNavMesh && TheNavMesh->IsLoaded() )
+	{
+		TheNavClusterGraph.EnsureBuilt( TheNavMesh->GetFilename() );
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+int CNavClusterGraph::GetCluster( const CNavArea *area ) const
+{
+	unsigned int id = area->GetID();
+	return ( id < (unsigned int)m_clusterByID.Count() ) ? m_clusterByID[ id ] : -1;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+float CNavClusterGraph::GetMinTravelDistance( const CNavArea *from, const CNavArea *to ) const
+{
+	if ( !m_isBuilt || !nav_hpa_pathfind.GetBool() )
+		return 0.0f;
+
+	int fromCluster = GetCluster( from );
+	int toCluster = GetCluster( to );
+	if ( fromCluster < 0 || toCluster < 0 )
+		return 0.0f;
+
+	return GetMinTravelDistance( fromCluster, toCluster );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+bool CNavClusterGraph::BuildCorridor( const CNavArea *from, const CNavArea *to, CVarBitVec *corridor ) const
+{
+	if ( !m_isBuilt || !nav_hpa_pathfind.GetBool() )
+		return false;
+
+	int fromCluster = GetCluster( from );
+	int toCluster = GetCluster( to );
+	if ( fromCluster < 0 || toCluster < 0 )
+		return false;
+
+	// if the clusters are not connected, a full search still finds the closest area
+	float minDistance = GetMinTravelDistance( fromCluster, toCluster );
+	if ( minDistance == FLT_MAX )
+		return false;
+
+	float maxDistance = nav_hpa_corridor_slack.GetFloat() * minDistance + nav_hpa_corridor_margin.GetFloat();
+
+	corridor->Resize( m_clusterCount, true );
+
+	// a path through a cluster is at least as long as the distance to it plus the distance from it
+	const float *fromDistance = &m_distance[ fromCluster * m_clusterCount ];
+	int count = 0;
+	for( int c=0; c<m_clusterCount; ++c )
+	{
+		float viaDistance = fromDistance[ c ] + m_distance[ c * m_clusterCount + toCluster ];
+		if ( viaDistance <= maxDistance )
+		{
+			corridor->Set( c );
+			++count;
+		}
+	}
+
+	// not worth it if the corridor is most of the mesh
+	return count < m_clusterCount - m_clusterCount / 4;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Sum of checksums of each area's ID, center, and connections
+ */
+unsigned int CNavClusterGraph::ComputeMeshChecksum( void ) const
+{
+	CUtlVector< const CNavArea * > neighbors;
+	unsigned int checksum = TheNavAreas.Count();
+
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		const CNavArea *area = TheNavAreas[ it ];
+
+		CRC32_t crc;
+		CRC32_Init( &crc );
+
+		unsigned int id = area->GetID();
+		CRC32_ProcessBuffer( &crc, &id, sizeof( id ) );
+		CRC32_ProcessBuffer( &crc, &area->GetCenter(), sizeof( Vector ) );
+
+		CollectNavClusterNeighbors( area, &neighbors );
+		FOR_EACH_VEC( neighbors, n )
+		{
+			id = neighbors[ n ]->GetID();
+			CRC32_ProcessBuffer( &crc, &id, sizeof( id ) );
+		}
+
+		CRC32_Final( &crc );
+
+		// summed, so the order of TheNavAreas doesn't matter
+		checksum += crc;
+	}
+
+	return checksum;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+struct NavClusterEdge
+{
+	int m_to;
+	float m_length;
+};
+
+struct NavClusterOpenEntry
+{
+	float m_distance;
+	int m_area;
+};
+
+static bool NavClusterOpenEntryLessPriority( const NavClusterOpenEntry &lhs, const NavClusterOpenEntry &rhs )
+{
+	return lhs.m_distance > rhs.m_distance;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Flood fill areas that share a grid cell into clusters, then find the distance from each cluster to
+ * every other with a Dijkstra search started from all of its areas at once
+ */
+void CNavClusterGraph::Build( void )
+{
+	Reset();
+
+	const int areaCount = TheNavAreas.Count();
+	if ( areaCount == 0 )
+		return;
+
+	double startTime = Plat_FloatTime();
+
+	unsigned int maxID = 0;
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		maxID = MAX( maxID, TheNavAreas[ it ]->GetID() );
+	}
+
+	CUtlVector< int > indexByID;
+	indexByID.SetCount( maxID + 1 );
+	FOR_EACH_VEC( indexByID, it )
+	{
+		indexByID[ it ] = -1;
+	}
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		indexByID[ TheNavAreas[ it ]->GetID() ] = it;
+	}
+
+	// outgoing connections of each area, and the incoming ones for the flood fill
+	CUtlVector< int > edgeStart;
+	CUtlVector< NavClusterEdge > edges;
+	CUtlVector< int > incomingStart;
+	CUtlVector< int > incoming;
+	CUtlVector< const CNavArea * > neighbors;
+
+	edgeStart.SetCount( areaCount + 1 );
+	incomingStart.SetCount( areaCount + 1 );
+	FOR_EACH_VEC( incomingStart, it )
+	{
+		incomingStart[ it ] = 0;
+	}
+
+	for( int i=0; i<areaCount; ++i )
+	{
+		const CNavArea *area = TheNavAreas[ i ];
+		edgeStart[ i ] = edges.Count();
+
+		CollectNavClusterNeighbors( area, &neighbors );
+		FOR_EACH_VEC( neighbors, n )
+		{
+			unsigned int id = neighbors[ n ]->GetID();
+			int to = ( id <= maxID ) ? indexByID[ id ] : -1;
+			if ( to < 0 )
+				continue;
+
+			NavClusterEdge &edge = edges[ edges.AddToTail() ];
+			edge.m_to = to;
+			edge.m_length = ( neighbors[ n ]->GetCenter() - area->GetCenter() ).Length();
+
+			++incomingStart[ to + 1 ];
+		}
+	}
+	edgeStart[ areaCount ] = edges.Count();
+
+	for( int i=0; i<areaCount; ++i )
+	{
+		incomingStart[ i + 1 ] += incomingStart[ i ];
+	}
+	incoming.SetCount( edges.Count() );
+	{
+		CUtlVector< int > fill;
+		fill.CopyArray( incomingStart.Base(), areaCount );
+		for( int i=0; i<areaCount; ++i )
+		{
+			for( int e=edgeStart[ i ]; e<edgeStart[ i + 1 ]; ++e )
+			{
+				incoming[ fill[ edges[ e ].m_to ]++ ] = i;
+			}
+		}
+	}
+
+	// clusters are connected areas within one grid cell
+	const float cellSize = MAX( nav_cluster_size.GetFloat(), 1.0f );
+	CUtlVector< int > cellX, cellY, clusterOf;
+	cellX.SetCount( areaCount );
+	cellY.SetCount( areaCount );
+	clusterOf.SetCount( areaCount );
+	for( int i=0; i<areaCount; ++i )
+	{
+		const Vector &center = TheNavAreas[ i ]->GetCenter();
+		cellX[ i ] = (int)floor( center.x / cellSize );
+		cellY[ i ] = (int)floor( center.y / cellSize );
+		clusterOf[ i ] = -1;
+	}
+
+	int clusterCount = 0;
+	CUtlVector< int > stack;
+	for( int i=0; i<areaCount; ++i )
+	{
+		if ( clusterOf[ i ] >= 0 )
+			continue;
+
+		clusterOf[ i ] = clusterCount;
+		stack.AddToTail( i );
+
+		while( stack.Count() )
+		{
+			int area = stack.Tail();
+			stack.RemoveMultipleFromTail( 1 );
+
+			for( int e=edgeStart[ area ]; e<edgeStart[ area + 1 ]; ++e )
+			{
+				int to = edges[ e ].m_to;
+				if ( clusterOf[ to ] < 0 && cellX[ to ] == cellX[ i ] && cellY[ to ] == cellY[ i ] )
+				{
+					clusterOf[ to ] = clusterCount;
+					stack.AddToTail( to );
+				}
+			}
+
+			for( int e=incomingStart[ area ]; e<incomingStart[ area + 1 ]; ++e )
+			{
+				int from = incoming[ e ];
+				if ( clusterOf[ from ] < 0 && cellX[ from ] == cellX[ i ] && cellY[ from ] == cellY[ i ] )
+				{
+					clusterOf[ from ] = clusterCount;
+					stack.AddToTail( from );
+				}
+			}
+		}
+
+		++clusterCount;
+	}
+
+	if ( clusterCount > NAV_CLUSTER_MAX_COUNT )
+	{
+		Warning( "Navigation Mesh has %d clusters, more than %d. Increase nav_cluster_size to use hierarchical path-finding.\n", clusterCount, NAV_CLUSTER_MAX_COUNT );
+		return;
+	}
+
+	// areas of each cluster
+	CUtlVector< int > memberStart;
+	CUtlVector< int > members;
+	memberStart.SetCount( clusterCount + 1 );
+	FOR_EACH_VEC( memberStart, it )
+	{
+		memberStart[ it ] = 0;
+	}
+	for( int i=0; i<areaCount; ++i )
+	{
+		++memberStart[ clusterOf[ i ] + 1 ];
+	}
+	for( int c=0; c<clusterCount; ++c )
+	{
+		memberStart[ c + 1 ] += memberStart[ c ];
+	}
+	members.SetCount( areaCount );
+	{
+		CUtlVector< int > fill;
+		fill.CopyArray( memberStart.Base(), clusterCount );
+		for( int i=0; i<areaCount; ++i )
+		{
+			members[ fill[ clusterOf[ i ] ]++ ] = i;
+		}
+	}
+
+	m_distance.SetCount( clusterCount * clusterCount );
+
+	CUtlVector< float > distance;
+	distance.SetCount( areaCount );
+	CUtlPriorityQueue< NavClusterOpenEntry > openList( 0, 0, NavClusterOpenEntryLessPriority );
+
+	for( int c=0; c<clusterCount; ++c )
+	{
+		float *clusterDistance = &m_distance[ c * clusterCount ];
+		for( int other=0; other<clusterCount; ++other )
+		{
+			clusterDistance[ other ] = FLT_MAX;
+		}
+
+		for( int i=0; i<areaCount; ++i )
+		{
+			distance[ i ] = FLT_MAX;
+		}
+
+		openList.RemoveAll();
+		for( int m=memberStart[ c ]; m<memberStart[ c + 1 ]; ++m )
+		{
+			NavClusterOpenEntry entry;
+			entry.m_distance = 0.0f;
+			entry.m_area = members[ m ];
+			distance[ entry.m_area ] = 0.0f;
+			openList.Insert( entry );
+		}
+
+		while( openList.Count() )
+		{
+			NavClusterOpenEntry entry = openList.ElementAtHead();
+			openList.RemoveAtHead();
+
+			// left behind by a shorter route
+			if ( entry.m_distance > distance[ entry.m_area ] )
+				continue;
+
+			float &toCluster = clusterDistance[ clusterOf[ entry.m_area ] ];
+			toCluster = MIN( toCluster, entry.m_distance );
+
+			for( int e=edgeStart[ entry.m_area ]; e<edgeStart[ entry.m_area + 1 ]; ++e )
+			{
+				float newDistance = entry.m_distance + edges[ e ].m_length;
+				int to = edges[ e ].m_to;
+				if ( newDistance < distance[ to ] )
+				{
+					distance[ to ] = newDistance;
+
+					NavClusterOpenEntry newEntry;
+					newEntry.m_distance = newDistance;
+					newEntry.m_area = to;
+					openList.Insert( newEntry );
+				}
+			}
+		}
+	}
+
+	m_clusterByID.SetCount( maxID + 1 );
+	FOR_EACH_VEC( m_clusterByID, it )
+	{
+		m_clusterByID[ it ] = -1;
+	}
+	for( int i=0; i<areaCount; ++i )
+	{
+		m_clusterByID[ TheNavAreas[ i ]->GetID() ] = clusterOf[ i ];
+	}
+
+	m_clusterCount = clusterCount;
+	m_meshChecksum = ComputeMeshChecksum();
+	m_isBuilt = true;
+
+	DevMsg( "Built %d nav clusters from %d areas in %.1f ms.\n", clusterCount, areaCount, ( Plat_FloatTime() - startTime ) * 1000.0 );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * The cluster file is named after the nav file, with another extension
+ */
+static void GetNavClusterFilename( const char *navFilename, char *clusterFilename, int size )
+{
+	Q_strncpy( clusterFilename, navFilename, size );
+	Q_SetExtension( clusterFilename, ".navcluster", size );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+bool CNavClusterGraph::Save( const char *navFilename ) const
+{
+	if ( !m_isBuilt )
+		return false;
+
+	char filename[ MAX_PATH ];
+	GetNavClusterFilename( navFilename, filename, sizeof( filename ) );
+
+	CUtlBuffer fileBuffer( 4096, 1024*1024 );
+
+	fileBuffer.PutUnsignedInt( NAV_CLUSTER_MAGIC_NUMBER );
+	fileBuffer.PutUnsignedInt( NAV_CLUSTER_VERSION );
+	fileBuffer.PutUnsignedInt( m_meshChecksum );
+	fileBuffer.PutInt( m_clusterCount );
+
+	fileBuffer.PutInt( TheNavAreas.Count() );
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		fileBuffer.PutUnsignedInt( TheNavAreas[ it ]->GetID() );
+		fileBuffer.PutInt( GetCluster( TheNavAreas[ it ] ) );
+	}
+
+	FOR_EACH_VEC( m_distance, it )
+	{
+		fileBuffer.PutFloat( m_distance[ it ] );
+	}
+
+	if ( !filesystem->WriteFile( filename, "MOD", fileBuffer ) )
+	{
+		Warning( "Unable to save %d bytes to %s\n", fileBuffer.Size(), filename );
+		return false;
+	}
+
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+bool CNavClusterGraph::Load( const char *navFilename )
+{
+	Reset();
+
+	char filename[ MAX_PATH ];
+	GetNavClusterFilename( navFilename, filename, sizeof( filename ) );
+
+	CUtlBuffer fileBuffer( 4096, 1024*1024, CUtlBuffer::READ_ONLY );
+	if ( !filesystem->ReadFile( filename, "GAME", fileBuffer ) )
+		return false;
+
+	unsigned int magic = fileBuffer.GetUnsignedInt();
+	unsigned int version = fileBuffer.GetUnsignedInt();
+	if ( !fileBuffer.IsValid() || magic != NAV_CLUSTER_MAGIC_NUMBER || version != NAV_CLUSTER_VERSION )
+		return false;
+
+	// the mesh may have been edited or regenerated since
+	unsigned int meshChecksum = fileBuffer.GetUnsignedInt();
+	if ( !fileBuffer.IsValid() || meshChecksum != ComputeMeshChecksum() )
+	{
+		DevMsg( "%s is out of date.\n", filename );
+		return false;
+	}
+
+	int clusterCount = fileBuffer.GetInt();
+	int areaCount = fileBuffer.GetInt();
+	if ( !fileBuffer.IsValid() || clusterCount <= 0 || clusterCount > NAV_CLUSTER_MAX_COUNT || areaCount != TheNavAreas.Count() )
+		return false;
+
+	unsigned int maxID = 0;
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		maxID = MAX( maxID, TheNavAreas[ it ]->GetID() );
+	}
+
+	m_clusterByID.SetCount( maxID + 1 );
+	FOR_EACH_VEC( m_clusterByID, it )
+	{
+		m_clusterByID[ it ] = -1;
+	}
+
+	for( int i=0; i<areaCount; ++i )
+	{
+		unsigned int id = fileBuffer.GetUnsignedInt();
+		int cluster = fileBuffer.GetInt();
+		if ( !fileBuffer.IsValid() || id > maxID || cluster < 0 || cluster >= clusterCount )
+		{
+			Reset();
+			return false;
+		}
+
+		m_clusterByID[ id ] = cluster;
+	}
+
+	m_distance.SetCount( clusterCount * clusterCount );
+	FOR_EACH_VEC( m_distance, it )
+	{
+		m_distance[ it ] = fileBuffer.GetFloat();
+	}
+
+	if ( !fileBuffer.IsValid() )
+	{
+		Reset();
+		return false;
+	}
+
+	m_clusterCount = clusterCount;
+	m_meshChecksum = meshChecksum;
+	m_isBuilt = true;
+
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Travel distance along the parent links of the last search
+ */
+static float NavClusterBenchmarkPathLength( CNavArea *goalArea )
+{
+	float length = 0.0f;
+	for( CNavArea *area = goalArea; area->GetParent(); area = area->GetParent() )
+	{
+		length += ( area->GetCenter() - area->GetParent()->GetCenter() ).Length();
+	}
+	return length;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+CON_COMMAND_F( nav_hpa_benchmark, "Compares full and hierarchical path searches between random pairs of areas. Arguments: [queries]", FCVAR_GAMEDLL | FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	if ( TheNavAreas.Count() < 2 )
+	{
+		Msg( "No Navigation Mesh loaded.\n" );
+		return;
+	}
+
+	if ( !nav_hpa_pathfind.GetBool() )
+	{
+		Msg( "nav_hpa_pathfind is 0, both searches would be full searches.\n" );
+		return;
+	}
+
+	TheNavClusterGraph.EnsureBuilt( TheNavMesh->GetFilename() );
+	if ( !TheNavClusterGraph.IsBuilt() )
+		return;
+
+	const int queryCount = ( args.ArgC() > 1 ) ? MAX( atoi( args[ 1 ] ), 1 ) : 1000;
+
+	// the same pairs for both searches, and from run to run
+	CUniformRandomStream random;
+	random.SetSeed( 1 );
+
+	CUtlVector< CNavArea * > from, to;
+	from.SetCount( queryCount );
+	to.SetCount( queryCount );
+	for( int i=0; i<queryCount; ++i )
+	{
+		from[ i ] = TheNavAreas[ random.RandomInt( 0, TheNavAreas.Count()-1 ) ];
+		to[ i ] = TheNavAreas[ random.RandomInt( 0, TheNavAreas.Count()-1 ) ];
+	}
+
+	// searches count the areas they expand in a bound context
+	CNavSearchScope scope;
+	ShortestPathCost cost;
+
+	CUtlVector< float > fullLength;
+	fullLength.SetCount( queryCount );
+
+	unsigned int expanded = scope.GetContext()->GetExpandedAreaCount();
+	double startTime = Plat_FloatTime();
+	for( int i=0; i<queryCount; ++i )
+	{
+		fullLength[ i ] = NavAreaBuildPath( from[ i ], to[ i ], NULL, cost ) ? NavClusterBenchmarkPathLength( to[ i ] ) : -1.0f;
+	}
+	double fullTime = Plat_FloatTime() - startTime;
+	unsigned int fullExpanded = scope.GetContext()->GetExpandedAreaCount() - expanded;
+
+	int found = 0;
+	int mismatched = 0;
+	double fullTotalLength = 0.0;
+	double hpaTotalLength = 0.0;
+
+	expanded = scope.GetContext()->GetExpandedAreaCount();
+	startTime = Plat_FloatTime();
+	for( int i=0; i<queryCount; ++i )
+	{
+		float length = NavAreaBuildPathHierarchical( from[ i ], to[ i ], NULL, cost ) ? NavClusterBenchmarkPathLength( to[ i ] ) : -1.0f;
+
+		if ( ( length < 0.0f ) != ( fullLength[ i ] < 0.0f ) )
+		{
+			++mismatched;
+		}
+		else if ( length >= 0.0f )
+		{
+			++found;
+			fullTotalLength += fullLength[ i ];
+			hpaTotalLength += length;
+		}
+	}
+	double hpaTime = Plat_FloatTime() - startTime;
+	unsigned int hpaExpanded = scope.GetContext()->GetExpandedAreaCount() - expanded;
+
+	Msg( "%d queries over %d areas in %d clusters, %d paths found:\n", queryCount, TheNavAreas.Count(), TheNavClusterGraph.GetClusterCount(), found );
+	Msg( "  full:         %8.1f areas expanded, %8.1f us per query\n", (float)fullExpanded / queryCount, fullTime * 1000000.0 / queryCount );
+	Msg( "  hierarchical: %8.1f areas expanded, %8.1f us per query\n", (float)hpaExpanded / queryCount, hpaTime * 1000000.0 / queryCount );
+	Msg( "  hierarchical paths are %.3fx as long as full paths\n", ( fullTotalLength > 0.0 ) ? hpaTotalLength / fullTotalLength : 1.0 );
+	if ( mismatched )
+	{
+		Warning( "  %d queries found a path with only one of the searches!\n", mismatched );
+	}
+}
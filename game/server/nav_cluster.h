@@ -0,0 +1,105 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose:
+//
+// $NoKeywords: $
+//===========================================================================//
+
+// Cluster graph over the Navigation Mesh, for hierarchical path-finding
+
+#ifndef _NAV_CLUSTER_H_
+#define _NAV_CLUSTER_H_
+
+#include "bitvec.h"
+#include "utlvector.h"
+
+class CNavArea;
+class CNavLadder;
+class CFuncElevator;
+class ConVar;
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Clusters of connected areas that share a cell of a coarse XY grid, and the shortest travel distance
+ * between every pair of clusters.
+ * Distances are measured between area centers along the same connections NavAreaBuildPath() follows,
+ * from the closest area of one cluster to the closest area of the other. That is never more than the
+ * travel distance between any two areas of those clusters, so it is a lower bound usable for pruning.
+ * The graph is only built while nav_hpa_pathfind is set or nav_hpa_benchmark runs, since it costs one
+ * search per cluster over the whole mesh. Once built, it is saved alongside the .nav file.
+ */
+class CNavClusterGraph
+{
+public:
+	CNavClusterGraph( void );
+
+	void Build( void );									// partition TheNavAreas into clusters and compute distance tables
+	void EnsureBuilt( const char *navFilename );		// load or build the graph if it isn't built, navFilename may be NULL
+	void Reset( void );
+	void Invalidate( void )								{ if ( m_isBuilt ) Reset(); }	// the mesh connections changed
+
+	bool Load( const char *filename );					// returns false if the file is missing or doesn't match the mesh
+	bool Save( const char *filename ) const;
+
+	bool IsBuilt( void ) const							{ return m_isBuilt; }
+	int GetClusterCount( void ) const					{ return m_clusterCount; }
+
+	int GetCluster( const CNavArea *area ) const;		// returns -1 if the area isn't part of the graph
+
+	// lower bound of travel distance, FLT_MAX if the clusters are not connected
+	float GetMinTravelDistance( int fromCluster, int toCluster ) const	{ return m_distance[ fromCluster * m_clusterCount + toCluster ]; }
+	float GetMinTravelDistance( const CNavArea *from, const CNavArea *to ) const;	// zero if unknown or nav_hpa_pathfind is 0
+
+	/**
+	 * Collect the clusters a path from 'from' to 'to' can cross without being longer than the
+	 * corridor allows. A path shorter than that is entirely inside the corridor.
+	 * Returns false if the graph can't narrow this search.
+	 */
+	bool BuildCorridor( const CNavArea *from, const CNavArea *to, CVarBitVec *corridor ) const;
+
+private:
+	unsigned int ComputeMeshChecksum( void ) const;
+
+	bool m_isBuilt;
+	int m_clusterCount;
+	unsigned int m_meshChecksum;				// of the mesh connections the graph was built from
+
+	CUtlVector< int > m_clusterByID;			// cluster of each area, indexed by area ID
+	CUtlVector< float > m_distance;				// m_clusterCount x m_clusterCount, row is the cluster traveled from
+};
+
+extern CNavClusterGraph TheNavClusterGraph;
+extern ConVar nav_hpa_pathfind;
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Wraps a NavAreaBuildPath() cost functor, treating areas outside the corridor as dead ends
+ */
+template< typename CostFunctor >
+class NavClusterCorridorCost
+{
+public:
+	NavClusterCorridorCost( CostFunctor &costFunc, const CVarBitVec &corridor ) : m_costFunc( costFunc ), m_corridor( corridor )
+	{
+	}
+
+	float operator() ( CNavArea *area, CNavArea *fromArea, const CNavLadder *ladder, const CFuncElevator *elevator, float length )
+	{
+		if ( fromArea )
+		{
+			int cluster = TheNavClusterGraph.GetCluster( area );
+			if ( cluster >= 0 && !m_corridor.IsBitSet( cluster ) )
+				return -1.0f;
+		}
+
+		return m_costFunc( area, fromArea, ladder, elevator, length );
+	}
+
+private:
+	CostFunctor &m_costFunc;
+	const CVarBitVec &m_corridor;
+};
+
+
+#endif // _NAV_CLUSTER_H_
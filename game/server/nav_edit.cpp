@@ -3940,6 +3940,8 @@ void CNavMesh::OnEditDestroyNotify( CNavArea *deadArea )
 	m_avoidanceObstacleAreas.FindAndRemove( deadArea );
 	m_blockedAreas.FindAndRemove( deadArea );
 
+	TheNavClusterGraph.Invalidate();
+
 	FOR_EACH_VEC( TheNavAreas, it )
 	{
 		TheNavAreas[ it ]->OnEditDestroyNotify( deadArea );
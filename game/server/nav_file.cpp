@@ -1206,6 +1206,13 @@ bool CNavMesh::Save( void ) const
 	unsigned int navSize = filesystem->Size( filename );
 	DevMsg( "Size of nav file '%s' is %u bytes.\n", filename, navSize );
 
+	// hierarchical path-finding data is saved alongside the mesh, when it is in use
+	if ( nav_hpa_pathfind.GetBool() || TheNavClusterGraph.IsBuilt() )
+	{
+		TheNavClusterGraph.Build();
+		TheNavClusterGraph.Save( filename );
+	}
+
 	return true;
 }
 
@@ -1702,6 +1709,14 @@ NavErrorType CNavMesh::PostLoad( unsigned int version )
 		m_avoidanceObstacles[i]->OnNavMeshLoaded();
 	}
 
+	// use saved hierarchical path-finding data, unless the mesh changed since
+	if ( nav_hpa_pathfind.GetBool() )
+	{
+		char navFilename[256];
+		Q_snprintf( navFilename, sizeof( navFilename ), FORMAT_NAVFILE, STRING( gpGlobals->mapname ) );
+		TheNavClusterGraph.EnsureBuilt( navFilename );
+	}
+
 	// the Navigation Mesh has been successfully loaded
 	m_isLoaded = true;
 	
@@ -13,6 +13,7 @@
 #include "filesystem.h"
 #include "nav_mesh.h"
 #include "nav_node.h"
+#include "nav_cluster.h"
 #include "fmtstr.h"
 #include "utlbuffer.h"
 #include "tier0/vprof.h"
@@ -162,6 +163,9 @@ void CNavMesh::DestroyNavigationMesh( bool incremental )
 	m_avoidanceObstacleAreas.RemoveAll();
 	m_transientAreas.RemoveAll();
 
+	// cluster distances describe the old mesh
+	TheNavClusterGraph.Reset();
+
 	if ( !incremental )
 	{
 		// destroy all areas
@@ -182,6 +186,9 @@ void CNavMesh::DestroyNavigationMesh( bool incremental )
 
 		TheNavAreas.RemoveAll();
 
+		// free search state memory sized for the old mesh
+		CNavSearchContext::PurgePool();
+
 		CNavArea::m_isReset = false;
 
 
@@ -15,6 +15,7 @@
 #include "tier0/vprof.h"
 #include "mathlib/ssemath.h"
 #include "nav_area.h"
+#include "nav_cluster.h"
 
 #ifdef STAGING_ONLY
 extern int g_DebugPathfindCounter;
@@ -98,6 +99,9 @@ public:
  * If 'goalPos' is NULL, will use the center of 'goalArea' as the goal position.
  * If 'maxPathLength' is nonzero, path building will stop when this length is reached.
  * Returns true if a path exists.
+ * Search state lives in the areas, unless the calling thread has a CNavSearchContext bound with
+ * CNavSearchScope. Then it lives in the context, and searches on different threads can run at
+ * once as long as 'costFunc' only reads. Follow the parents while the same context is still bound.
  */
 #define IGNORE_NAV_BLOCKERS true
 template< typename CostFunctor >
@@ -427,6 +431,33 @@ bool NavAreaBuildPath( CNavArea *startArea, CNavArea *goalArea, const Vector *go
 }
 
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Same as NavAreaBuildPath(), but when nav_hpa_pathfind is set, first narrows the search to the corridor of
+ * nav clusters a short path from startArea to goalArea can cross. If the corridor has no path, the whole mesh
+ * is searched. When costFunc returns travel distance, paths no longer than the corridor allows are the same
+ * as a whole mesh search finds. Costs which add penalties (danger, team, crouching) may have a cheaper path
+ * outside the corridor, which is not found.
+ */
+template< typename CostFunctor >
+bool NavAreaBuildPathHierarchical( CNavArea *startArea, CNavArea *goalArea, const Vector *goalPos, CostFunctor &costFunc, CNavArea **closestArea = NULL, float maxPathLength = 0.0f, int teamID = TEAM_ANY, bool ignoreNavBlockers = false )
+{
+	CVarBitVec corridor;
+	if ( startArea && goalArea && TheNavClusterGraph.BuildCorridor( startArea, goalArea, &corridor ) )
+	{
+		// a path longer than the limit fails either way, don't search twice
+		if ( maxPathLength <= 0.0f || TheNavClusterGraph.GetMinTravelDistance( startArea, goalArea ) <= maxPathLength )
+		{
+			NavClusterCorridorCost< CostFunctor > corridorCost( costFunc, corridor );
+			if ( NavAreaBuildPath( startArea, goalArea, goalPos, corridorCost, closestArea, maxPathLength, teamID, ignoreNavBlockers ) )
+				return true;
+		}
+	}
+
+	return NavAreaBuildPath( startArea, goalArea, goalPos, costFunc, closestArea, maxPathLength, teamID, ignoreNavBlockers );
+}
+
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Compute distance between two areas. Return -1 if can't reach 'endArea' from 'startArea'.
@@ -443,8 +474,13 @@ float NavAreaTravelDistance( CNavArea *startArea, CNavArea *endArea, CostFunctor
 	if (startArea == endArea)
 		return 0.0f;
 
+	// the cluster graph knows if the areas are not connected, or too far apart
+	float minDistance = TheNavClusterGraph.GetMinTravelDistance( startArea, endArea );
+	if (minDistance == FLT_MAX || (maxPathLength > 0.0f && minDistance > maxPathLength))
+		return -1.0f;
+
 	// compute path between areas using given cost heuristic
-	if (NavAreaBuildPath( startArea, endArea, NULL, costFunc, NULL, maxPathLength ) == false)
+	if (NavAreaBuildPathHierarchical( startArea, endArea, NULL, costFunc, NULL, maxPathLength ) == false)
 		return -1.0f;
 
 	// compute distance along path
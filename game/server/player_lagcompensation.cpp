@@ -33,6 +33,7 @@ static ConVar sv_lagcompensation_teleport_dist( "sv_lagcompensation_teleport_dis
 ConVar sv_unlag( "sv_unlag", "1", FCVAR_DEVELOPMENTONLY, "Enables player lag compensation" );
 ConVar sv_maxunlag( "sv_maxunlag", "1.0", FCVAR_DEVELOPMENTONLY, "Maximum lag compensation in seconds", true, 0.0f, true, 1.0f );
 ConVar sv_lagflushbonecache( "sv_lagflushbonecache", "1", FCVAR_DEVELOPMENTONLY, "Flushes entity bone cache on lag compensation" );
+ConVar sv_lagsetupbones( "sv_lagsetupbones", "1", FCVAR_DEVELOPMENTONLY, "Sets up bones of all lag compensated players at once, before hitscan traces need them" );
 ConVar sv_showlagcompensation( "sv_showlagcompensation", "0", FCVAR_CHEAT, "Show lag compensated hitboxes whenever a player is lag compensated." );
 
 ConVar sv_unlag_fixstuck( "sv_unlag_fixstuck", "0", FCVAR_DEVELOPMENTONLY, "Disallow backtracking a player for lag compensation if it will cause them to become stuck" );
@@ -426,6 +427,24 @@ void CLagCompensationManager::StartLagCompensation( CBasePlayer *player, CUserCm
 		// Move other player back in time
 		BacktrackPlayer( pPlayer, TICKS_TO_TIME( targettick ) );
 	}
+
+	if ( sv_lagsetupbones.GetBool() && m_bNeedToRestore )
+	{
+		// The hitscan trace that follows sets up bones of every moved player it
+		// touches one by one, set them all up now at once.
+		CBaseAnimating *pMovedPlayers[MAX_PLAYERS];
+		int nMovedPlayers = 0;
+		for ( int i = 1; i <= gpGlobals->maxClients; i++ )
+		{
+			CBasePlayer *pPlayer = UTIL_PlayerByIndex( i );
+			if ( pPlayer && m_RestorePlayer.Get( i - 1 ) )
+			{
+				pMovedPlayers[nMovedPlayers++] = pPlayer;
+			}
+		}
+
+		CBaseAnimating::SetupBoneCaches( pMovedPlayers, nMovedPlayers );
+	}
 }
 
 void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTargetTime )
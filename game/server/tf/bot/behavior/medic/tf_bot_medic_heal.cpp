@@ -809,8 +809,9 @@ ActionResult< CTFBot >	CTFBotMedicHeal::Update( CTFBot *me, float interval )
 
 			ComputeFollowPosition( me );
 
+			// the search runs with those of all other bots at the next NextBotManager update
 			CTFBotPathCost cost( me, FASTEST_ROUTE );
-			m_coverPath.Compute( me, m_followGoal, cost );
+			m_coverPath.ComputeDeferred( me, m_followGoal, cost );
 		}
 
 		m_coverPath.Update( me );
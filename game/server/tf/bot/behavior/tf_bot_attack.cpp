@@ -102,16 +102,17 @@ ActionResult< CTFBot >	CTFBotAttack::Update( CTFBot *me, float interval )
 				//m_repathTimer.Start( RandomFloat( 0.3f, 0.5f ) );
 				m_repathTimer.Start( RandomFloat( 3.0f, 5.0f ) );
 
+				// the search runs with those of all other bots at the next NextBotManager update
 				if ( isUsingCloseRangeWeapon && !TFGameRules()->IsMannVsMachineMode() )	// all bots in MvM use the default route
 				{
 					CTFBotPathCost cost( me, SAFEST_ROUTE );
-					m_path.Compute( me, threat->GetLastKnownPosition(), cost );
+					m_path.ComputeDeferred( me, threat->GetLastKnownPosition(), cost );
 				}
 				else
 				{
 					CTFBotPathCost cost( me, DEFAULT_ROUTE );
 					float maxPathLength = TFGameRules()->IsMannVsMachineMode() ? TFBOT_MVM_MAX_PATH_LENGTH : 0.0f;
-					m_path.Compute( me, threat->GetLastKnownPosition(), cost, maxPathLength );
+					m_path.ComputeDeferred( me, threat->GetLastKnownPosition(), cost, maxPathLength );
 				}
 			}
 		}
@@ -66,8 +66,9 @@ ActionResult< CTFBot >	CTFBotEscort::Update( CTFBot *me, float interval )
 			{
 				if ( m_repathTimer.IsElapsed() )
 				{
+					// the search runs with those of all other bots at the next NextBotManager update
 					CTFBotPathCost cost( me, FASTEST_ROUTE );
-					m_pathToWho.Compute( me, m_who->GetAbsOrigin(), cost );
+					m_pathToWho.ComputeDeferred( me, m_who->GetAbsOrigin(), cost );
 					m_repathTimer.Start( RandomFloat( 2.0f, 3.0f ) );
 				}
 
@@ -868,6 +868,28 @@ public:
 		m_stepHeight = me->GetLocomotionInterface()->GetStepHeight();
 		m_maxJumpHeight = me->GetLocomotionInterface()->GetMaxJumpHeight();
 		m_maxDropHeight = me->GetLocomotionInterface()->GetDeathDropHeight();
+
+		if ( me->IsPlayerClass( TF_CLASS_SPY ) )
+		{
+			// find enemy sentry areas up front, so the cost only reads game state and can run deferred
+			int enemyTeam = GetEnemyTeam( me->GetTeamNumber() );
+
+			for ( int oit = 0; oit < IBaseObjectAutoList::AutoList().Count(); ++oit )
+			{
+				CBaseObject *enemyObj = static_cast< CBaseObject* >( IBaseObjectAutoList::AutoList()[ oit ] );
+
+				if ( ( enemyObj->ObjectType() == OBJ_SENTRYGUN ) &&
+					( enemyObj->GetTeamNumber() == enemyTeam ) )
+				{
+					enemyObj->UpdateLastKnownArea();
+
+					if ( enemyObj->GetLastKnownArea() )
+					{
+						m_enemySentryAreas.AddToTail( enemyObj->GetLastKnownArea() );
+					}
+				}
+			}
+		}
 	}
 
 	virtual float operator()( CNavArea *baseArea, CNavArea *fromArea, const CNavLadder *ladder, const CFuncElevator *elevator, float length ) const
@@ -976,24 +998,14 @@ public:
 
 			if ( m_me->IsPlayerClass( TF_CLASS_SPY ) )
 			{
-				int enemyTeam = GetEnemyTeam( m_me->GetTeamNumber() );
-
 				// Since spies can get right up to enemy buildings, avoid them.
-				for ( int oit = 0; oit < IBaseObjectAutoList::AutoList().Count(); ++oit )
+				for ( int it = 0; it < m_enemySentryAreas.Count(); ++it )
 				{
-					CBaseObject *enemyObj = static_cast< CBaseObject* >( IBaseObjectAutoList::AutoList()[ oit ] );
-
-					if ( ( enemyObj->ObjectType() == OBJ_SENTRYGUN ) &&
-						( enemyObj->GetTeamNumber() == enemyTeam ) )
+					if ( m_enemySentryAreas[ it ] == area )
 					{
-						enemyObj->UpdateLastKnownArea();
-
-						if ( enemyObj->GetLastKnownArea() == area )
-						{
-							// There is an enemy building in this area - avoid it as a spy.
-							const float enemyBuildingCost = 10.0f;
-							dist *= enemyBuildingCost;
-						}
+						// There is an enemy building in this area - avoid it as a spy.
+						const float enemyBuildingCost = 10.0f;
+						dist *= enemyBuildingCost;
 					}
 				}
 
@@ -1023,6 +1035,7 @@ public:
 	float m_stepHeight;
 	float m_maxJumpHeight;
 	float m_maxDropHeight;
+	CCopyableUtlVector< CNavArea * > m_enemySentryAreas;		// spies only
 };
 
 
@@ -209,7 +209,8 @@ unsigned short *CBoneCache::CachedToStudio()
 }
 
 // Construct a singleton
-static CDataManager<CBoneCache, bonecacheparams_t, CBoneCache *, CThreadFastMutex> g_StudioBoneCache( 128 * 1024L );
+constexpr size_t STUDIO_BONE_CACHE_SIZE = 128 * 1024L;
+static CDataManager<CBoneCache, bonecacheparams_t, CBoneCache *, CThreadFastMutex> g_StudioBoneCache( STUDIO_BONE_CACHE_SIZE );
 
 CBoneCache *Studio_GetBoneCache( memhandle_t cacheHandle )
 {
@@ -217,10 +218,33 @@ CBoneCache *Studio_GetBoneCache( memhandle_t cacheHandle )
 	return g_StudioBoneCache.GetResource_NoLock( cacheHandle );
 }
 
-memhandle_t Studio_CreateBoneCache( bonecacheparams_t &params )
+memhandle_t Studio_CreateBoneCache( bonecacheparams_t &params, bool bCreateLocked )
 {
 	AUTO_LOCK( g_StudioBoneCache.AccessMutex() );
-	return g_StudioBoneCache.CreateResource( params );
+	return g_StudioBoneCache.CreateResource( params, bCreateLocked );
+}
+
+CBoneCache *Studio_LockBoneCache( memhandle_t cacheHandle )
+{
+	AUTO_LOCK( g_StudioBoneCache.AccessMutex() );
+	return g_StudioBoneCache.LockResource( cacheHandle );
+}
+
+void Studio_UnlockBoneCache( memhandle_t cacheHandle )
+{
+	AUTO_LOCK( g_StudioBoneCache.AccessMutex() );
+	g_StudioBoneCache.UnlockResource( cacheHandle );
+}
+
+// Grows the cache so nBytes of caches fit on top of the default budget.  Never shrinks.
+void Studio_ReserveBoneCaches( size_t nBytes )
+{
+	AUTO_LOCK( g_StudioBoneCache.AccessMutex() );
+	const size_t targetSize = STUDIO_BONE_CACHE_SIZE + nBytes;
+	if ( targetSize > g_StudioBoneCache.TargetSize() )
+	{
+		g_StudioBoneCache.SetTargetSize( targetSize );
+	}
 }
 
 void Studio_DestroyBoneCache( memhandle_t cacheHandle )
@@ -562,6 +586,181 @@ inline void CalcBonePosition( int frame, float s,
 }
 
 
+static ConVar anim_simd_bones( "anim_simd_bones", "1", 0, "Convert, blend and accumulate bone rotations 4 bones at a time." );
+
+//-----------------------------------------------------------------------------
+// Purpose: CalcBoneQuaternion for many bones of one animation frame.  Animation
+//			values are unpacked per bone, then euler to quaternion conversion,
+//			sub frame blend and alignment run on 4 bones at once.  Rotations
+//			are written when 4 are pending or on Flush().
+//-----------------------------------------------------------------------------
+class CBoneQuaternionBatch
+{
+public:
+	CBoneQuaternionBatch( int frame, float s )
+		: m_nFrame( frame ), m_flS( s ), m_nLanes( 0 ), m_bSIMD( anim_simd_bones.GetBool() )
+	{
+	}
+
+	~CBoneQuaternionBatch()
+	{
+		Assert( m_nLanes == 0 );
+	}
+
+	void Add( const mstudiobone_t *pBone, const mstudiolinearbone_t *pLinearBones, const mstudioanim_t *panim, Quaternion &q )
+	{
+		if (pLinearBones)
+		{
+			Add( pLinearBones->quat(panim->bone), pLinearBones->rot(panim->bone), pLinearBones->rotscale(panim->bone), pLinearBones->flags(panim->bone), pLinearBones->qalignment(panim->bone), panim, q );
+		}
+		else
+		{
+			Add( pBone->quat, pBone->rot, pBone->rotscale, pBone->flags, pBone->qAlignment, panim, q );
+		}
+	}
+
+	void Add( const Quaternion &baseQuat, const RadianEuler &baseRot, const Vector &baseRotScale,
+		int iBaseFlags, const Quaternion &baseAlignment, const mstudioanim_t *panim, Quaternion &q );
+
+	void Flush();
+
+private:
+	int m_nFrame;
+	float m_flS;
+	int m_nLanes;
+	bool m_bSIMD;
+
+	alignas(16) float m_Angle1[3][4];
+	alignas(16) float m_Angle2[3][4];
+	alignas(16) float m_Alignment[4][4];
+	alignas(16) float m_flBlend[4];		// 1 when lane blends to next frame
+	alignas(16) float m_flAlign[4];		// 1 when lane is aligned to unified bone
+	Quaternion *m_pOut[4];
+};
+
+void CBoneQuaternionBatch::Add( const Quaternion &baseQuat, const RadianEuler &baseRot, const Vector &baseRotScale,
+	int iBaseFlags, const Quaternion &baseAlignment, const mstudioanim_t *panim, Quaternion &q )
+{
+	// raw and constant rotations need no conversion, write them right away.
+	// bones of one animation are unique, so pending lanes never write them again.
+	if ( !m_bSIMD || (panim->flags & (STUDIO_ANIM_RAWROT | STUDIO_ANIM_RAWROT2)) || !(panim->flags & STUDIO_ANIM_ANIMROT) )
+	{
+		CalcBoneQuaternion( m_nFrame, m_flS, baseQuat, baseRot, baseRotScale, iBaseFlags, baseAlignment, panim, q );
+		return;
+	}
+
+	mstudioanim_valueptr_t *pValuesPtr = panim->pRotV();
+	RadianEuler angle1, angle2;
+
+	if (m_flS > 0.001f)
+	{
+		ExtractAnimValue( m_nFrame, pValuesPtr->pAnimvalue( 0 ), baseRotScale.x, angle1.x, angle2.x );
+		ExtractAnimValue( m_nFrame, pValuesPtr->pAnimvalue( 1 ), baseRotScale.y, angle1.y, angle2.y );
+		ExtractAnimValue( m_nFrame, pValuesPtr->pAnimvalue( 2 ), baseRotScale.z, angle1.z, angle2.z );
+	}
+	else
+	{
+		ExtractAnimValue( m_nFrame, pValuesPtr->pAnimvalue( 0 ), baseRotScale.x, angle1.x );
+		ExtractAnimValue( m_nFrame, pValuesPtr->pAnimvalue( 1 ), baseRotScale.y, angle1.y );
+		ExtractAnimValue( m_nFrame, pValuesPtr->pAnimvalue( 2 ), baseRotScale.z, angle1.z );
+		angle2 = angle1;
+	}
+
+	if (!(panim->flags & STUDIO_ANIM_DELTA))
+	{
+		angle1.x = angle1.x + baseRot.x;
+		angle1.y = angle1.y + baseRot.y;
+		angle1.z = angle1.z + baseRot.z;
+		angle2.x = angle2.x + baseRot.x;
+		angle2.y = angle2.y + baseRot.y;
+		angle2.z = angle2.z + baseRot.z;
+	}
+
+	Assert( angle1.IsValid() && angle2.IsValid() );
+
+	const int i = m_nLanes;
+	m_Angle1[0][i] = angle1.x;
+	m_Angle1[1][i] = angle1.y;
+	m_Angle1[2][i] = angle1.z;
+	m_Angle2[0][i] = angle2.x;
+	m_Angle2[1][i] = angle2.y;
+	m_Angle2[2][i] = angle2.z;
+	m_flBlend[i] = (angle1.x != angle2.x || angle1.y != angle2.y || angle1.z != angle2.z) ? 1.0f : 0.0f;
+	m_flAlign[i] = (!(panim->flags & STUDIO_ANIM_DELTA) && (iBaseFlags & BONE_FIXED_ALIGNMENT)) ? 1.0f : 0.0f;
+	m_Alignment[0][i] = baseAlignment.x;
+	m_Alignment[1][i] = baseAlignment.y;
+	m_Alignment[2][i] = baseAlignment.z;
+	m_Alignment[3][i] = baseAlignment.w;
+	m_pOut[i] = &q;
+
+	if ( ++m_nLanes == 4 )
+	{
+		Flush();
+	}
+}
+
+void CBoneQuaternionBatch::Flush()
+{
+	if ( !m_nLanes )
+		return;
+
+	// unused lanes repeat the last bone, storing it again is harmless
+	for ( int i = m_nLanes; i < 4; i++ )
+	{
+		const int last = m_nLanes - 1;
+		for ( int j = 0; j < 3; j++ )
+		{
+			m_Angle1[j][i] = m_Angle1[j][last];
+			m_Angle2[j][i] = m_Angle2[j][last];
+		}
+		for ( int j = 0; j < 4; j++ )
+		{
+			m_Alignment[j][i] = m_Alignment[j][last];
+		}
+		m_flBlend[i] = m_flBlend[last];
+		m_flAlign[i] = m_flAlign[last];
+		m_pOut[i] = m_pOut[last];
+	}
+
+	FourQuaternions q = AngleQuaternionSIMD( LoadAlignedSIMD( m_Angle1[0] ), LoadAlignedSIMD( m_Angle1[1] ), LoadAlignedSIMD( m_Angle1[2] ) );
+
+	const fltx4 blendMask = CmpGtSIMD( LoadAlignedSIMD( m_flBlend ), Four_Zeros );
+	if ( TestSignSIMD( blendMask ) )
+	{
+		FourQuaternions q2 = AngleQuaternionSIMD( LoadAlignedSIMD( m_Angle2[0] ), LoadAlignedSIMD( m_Angle2[1] ), LoadAlignedSIMD( m_Angle2[2] ) );
+		q = MaskedAssign( blendMask, QuaternionBlendSIMD( q, q2, ReplicateX4( m_flS ) ), q );
+	}
+
+	// align to unified bone
+	const fltx4 alignMask = CmpGtSIMD( LoadAlignedSIMD( m_flAlign ), Four_Zeros );
+	if ( TestSignSIMD( alignMask ) )
+	{
+		FourQuaternions alignment;
+		alignment.x = LoadAlignedSIMD( m_Alignment[0] );
+		alignment.y = LoadAlignedSIMD( m_Alignment[1] );
+		alignment.z = LoadAlignedSIMD( m_Alignment[2] );
+		alignment.w = LoadAlignedSIMD( m_Alignment[3] );
+		q = MaskedAssign( alignMask, QuaternionAlignSIMD( alignment, q ), q );
+	}
+
+	q.SwizzleAndStore( *m_pOut[0], *m_pOut[1], *m_pOut[2], *m_pOut[3] );
+
+	m_nLanes = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Gets bones of lanes for 4 at a time loops over a bone list, unused
+//			lanes repeat the last bone.
+//-----------------------------------------------------------------------------
+static inline void GetBoneLanes( const int *pBones, int nBones, int iFirst, int iLanes[4] )
+{
+	for ( int i = 0; i < 4; i++ )
+	{
+		iLanes[i] = pBones[ min( iFirst + i, nBones - 1 ) ];
+	}
+}
+
+
 
 void SetupSingleBoneMatrix( 
 	CStudioHdr *pOwnerHdr, 
@@ -945,6 +1144,8 @@ static void CalcVirtualAnimation( virtualmodel_t *pVModel, const CStudioHdr *pSt
 		return;
 	}
 
+	CBoneQuaternionBatch quaternions( iLocalFrame, s );
+
 	// FIXME: change encoding so that bone -1 is never the case
 	while (panim && panim->bone < 255)
 	{
@@ -955,7 +1156,7 @@ static void CalcVirtualAnimation( virtualmodel_t *pVModel, const CStudioHdr *pSt
 
 			if (k >= 0 && pweight[k] > 0.0f)
 			{
-				CalcBoneQuaternion( iLocalFrame, s, &pAnimbone[panim->bone], pAnimLinearBones, panim, q[j] );
+				quaternions.Add( &pAnimbone[panim->bone], pAnimLinearBones, panim, q[j] );
 				CalcBonePosition  ( iLocalFrame, s, &pAnimbone[panim->bone], pAnimLinearBones, panim, pos[j] );
 #ifdef STUDIO_ENABLE_PERF_COUNTERS
 				pStudioHdr->m_nPerfAnimatedBones++;
@@ -965,6 +1166,8 @@ static void CalcVirtualAnimation( virtualmodel_t *pVModel, const CStudioHdr *pSt
 		panim = panim->pNext();
 	}
 
+	quaternions.Flush();
+
 	// cross fade in previous zeroframe data
 	if (flStall > 0.0f)
 	{
@@ -1074,6 +1277,8 @@ static void CalcAnimation( const CStudioHdr *pStudioHdr, Vector *pos, Quaternion
 		return;
 	}
 
+	CBoneQuaternionBatch quaternions( iLocalFrame, s );
+
 	// BUGBUG: the sequence, the anim, and the model can have all different bone mappings.
 	for (int i = 0; i < pStudioHdr->numbones(); i++, pbone++, pweight++)
 	{
@@ -1081,7 +1286,7 @@ static void CalcAnimation( const CStudioHdr *pStudioHdr, Vector *pos, Quaternion
 		{
 			if (*pweight > 0 && (pStudioHdr->boneFlags(i) & boneMask))
 			{
-				CalcBoneQuaternion( iLocalFrame, s, pbone, pLinearBones, panim, q[i] );
+				quaternions.Add( pbone, pLinearBones, panim, q[i] );
 				CalcBonePosition  ( iLocalFrame, s, pbone, pLinearBones, panim, pos[i] );
 #ifdef STUDIO_ENABLE_PERF_COUNTERS
 				pStudioHdr->m_nPerfAnimatedBones++;
@@ -1108,6 +1313,8 @@ static void CalcAnimation( const CStudioHdr *pStudioHdr, Vector *pos, Quaternion
 		}
 	}
 
+	quaternions.Flush();
+
 	// cross fade in previous zeroframe data
 	if (flStall > 0.0f)
 	{
@@ -1280,6 +1487,132 @@ static void QuaternionAccumulate( const Quaternion &p, float s, const Quaternion
 }
 
 
+//-----------------------------------------------------------------------------
+// Purpose: SlerpBones for bones with pS2[i] > 0, 4 bones at a time
+//-----------------------------------------------------------------------------
+static void SlerpBonesSIMD(
+	const CStudioHdr *pStudioHdr,
+	Quaternion q1[MAXSTUDIOBONES], 
+	Vector pos1[MAXSTUDIOBONES], 
+	const mstudioseqdesc_t &seqdesc,
+	const QuaternionAligned q2[MAXSTUDIOBONES], 
+	const Vector pos2[MAXSTUDIOBONES], 
+	const float *pS2,
+	int nBoneCount )
+{
+	int *pBones = (int *)stackalloc( nBoneCount * sizeof(int) );
+	int nBones = 0;
+	for ( int i = 0; i < nBoneCount; i++ )
+	{
+		if ( pS2[i] > 0.0f )
+		{
+			pBones[nBones++] = i;
+		}
+	}
+
+	for ( int k = 0; k < nBones; k += 4 )
+	{
+		int i[4];
+		GetBoneLanes( pBones, nBones, k, i );
+
+		alignas(16) float flS2[4], flNoAlign[4];
+		for ( int j = 0; j < 4; j++ )
+		{
+			flS2[j] = pS2[i[j]];
+			flNoAlign[j] = (pStudioHdr->boneFlags(i[j]) & BONE_FIXED_ALIGNMENT) ? 1.0f : 0.0f;
+		}
+
+		FourQuaternions p, q, result;
+		p.LoadAndSwizzle( q1[i[0]], q1[i[1]], q1[i[2]], q1[i[3]] );
+		q.LoadAndSwizzle( q2[i[0]], q2[i[1]], q2[i[2]], q2[i[3]] );
+
+		const fltx4 s2 = LoadAlignedSIMD( flS2 );
+		if ( seqdesc.flags & STUDIO_DELTA )
+		{
+			result = ( seqdesc.flags & STUDIO_POST )
+				? QuaternionMASIMD( p, s2, q )
+				: QuaternionSMSIMD( s2, q, p );
+		}
+		else
+		{
+			const fltx4 noAlignMask = CmpGtSIMD( LoadAlignedSIMD( flNoAlign ), Four_Zeros );
+			result = QuaternionSlerpNoAlignSIMD( q, MaskedAssign( noAlignMask, p, QuaternionAlignSIMD( q, p ) ), SubSIMD( Four_Ones, s2 ) );
+		}
+
+		result.SwizzleAndStore( q1[i[0]], q1[i[1]], q1[i[2]], q1[i[3]] );
+
+		const int nLanes = min( 4, nBones - k );
+		for ( int j = 0; j < nLanes; j++ )
+		{
+			const int b = i[j];
+			const float w2 = flS2[j];
+
+			if ( seqdesc.flags & STUDIO_DELTA )
+			{
+				// FIXME: are these correct?
+				VectorMA( pos1[b], w2, pos2[b], pos1[b] );
+			}
+			else
+			{
+				const float w1 = 1.0f - w2;
+				pos1[b][0] = pos1[b][0] * w1 + pos2[b][0] * w2;
+				pos1[b][1] = pos1[b][1] * w1 + pos2[b][1] * w2;
+				pos1[b][2] = pos1[b][2] * w1 + pos2[b][2] * w2;
+			}
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: BlendBones for bones in pBones, 4 bones at a time
+//-----------------------------------------------------------------------------
+static void BlendBonesSIMD(
+	const CStudioHdr *pStudioHdr,
+	Quaternion q1[MAXSTUDIOBONES], 
+	Vector pos1[MAXSTUDIOBONES], 
+	const Quaternion q2[MAXSTUDIOBONES], 
+	const Vector pos2[MAXSTUDIOBONES], 
+	const int *pBones,
+	int nBones,
+	float s )
+{
+	const float s2 = s;
+	const float s1 = 1.0F - s2;
+	const fltx4 s1x4 = ReplicateX4( s1 );
+
+	for ( int k = 0; k < nBones; k += 4 )
+	{
+		int i[4];
+		GetBoneLanes( pBones, nBones, k, i );
+
+		alignas(16) float flNoAlign[4];
+		for ( int j = 0; j < 4; j++ )
+		{
+			flNoAlign[j] = (pStudioHdr->boneFlags(i[j]) & BONE_FIXED_ALIGNMENT) ? 1.0f : 0.0f;
+		}
+
+		FourQuaternions p, q;
+		p.LoadAndSwizzle( q1[i[0]], q1[i[1]], q1[i[2]], q1[i[3]] );
+		q.LoadAndSwizzle( q2[i[0]], q2[i[1]], q2[i[2]], q2[i[3]] );
+
+		const fltx4 noAlignMask = CmpGtSIMD( LoadAlignedSIMD( flNoAlign ), Four_Zeros );
+		FourQuaternions result = QuaternionBlendNoAlignSIMD( q, MaskedAssign( noAlignMask, p, QuaternionAlignSIMD( q, p ) ), s1x4 );
+
+		result.SwizzleAndStore( q1[i[0]], q1[i[1]], q1[i[2]], q1[i[3]] );
+
+		const int nLanes = min( 4, nBones - k );
+		for ( int j = 0; j < nLanes; j++ )
+		{
+			const int b = i[j];
+			pos1[b][0] = pos1[b][0] * s1 + pos2[b][0] * s2;
+			pos1[b][1] = pos1[b][1] * s1 + pos2[b][1] * s2;
+			pos1[b][2] = pos1[b][2] * s1 + pos2[b][2] * s2;
+		}
+	}
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: blend together in world space q1,pos1 with q2,pos2.  Return result in q1,pos1.  
 //			0 returns q1, pos1.  1 returns q2, pos2
@@ -1467,6 +1800,12 @@ void SlerpBones(
 		}
 	}
 
+	if ( anim_simd_bones.GetBool() )
+	{
+		SlerpBonesSIMD( pStudioHdr, q1, pos1, seqdesc, q2, pos2, pS2, nBoneCount );
+		return;
+	}
+
 	float s1, s2;
 	if ( seqdesc.flags & STUDIO_DELTA )
 	{
@@ -1580,6 +1919,29 @@ void BlendBones(
 		return;
 	}
 
+	if ( anim_simd_bones.GetBool() )
+	{
+		int *pBones = (int *)stackalloc( pStudioHdr->numbones() * sizeof(int) );
+		int nBones = 0;
+		for (i = 0; i < pStudioHdr->numbones(); i++)
+		{
+			// skip unused bones
+			if (!(pStudioHdr->boneFlags(i) & boneMask))
+			{
+				continue;
+			}
+
+			j = pSeqGroup ? pSeqGroup->boneMap[i] : i;
+			if (j >= 0 && seqdesc.weight( j ) > 0.0)
+			{
+				pBones[nBones++] = i;
+			}
+		}
+
+		BlendBonesSIMD( pStudioHdr, q1, pos1, q2, pos2, pBones, nBones, s );
+		return;
+	}
+
 	float s2 = s;
 	float s1 = 1.0F - s2;
 
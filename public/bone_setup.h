@@ -428,7 +428,11 @@ private:
 };
 
 CBoneCache *Studio_GetBoneCache( memhandle_t cacheHandle );
-memhandle_t Studio_CreateBoneCache( bonecacheparams_t &params );
+memhandle_t Studio_CreateBoneCache( bonecacheparams_t &params, bool bCreateLocked = false );
+// Locked caches are never evicted, so they can be written without holding the cache mutex.
+CBoneCache *Studio_LockBoneCache( memhandle_t cacheHandle );
+void Studio_UnlockBoneCache( memhandle_t cacheHandle );
+void Studio_ReserveBoneCaches( size_t nBytes );
 void Studio_DestroyBoneCache( memhandle_t cacheHandle );
 void Studio_InvalidateBoneCache( memhandle_t cacheHandle );
 
@@ -98,8 +98,8 @@ class IServerEntity;
 #define FL_FULL_EDICT_CHANGED			(1<<8)
 
 
-// Max # of variable changes we'll track in an entity before we treat it
-// like they all changed.
+// Max # of variable changes we'll track in an entity's CEdictChangeInfo. Further changes
+// are handed to the engine through CBaseEdict::StateChangedOverflow.
 #define MAX_CHANGE_OFFSETS	19
 #define MAX_EDICT_CHANGE_INFOS	100
 
@@ -236,6 +236,10 @@ public:
 	const IChangeInfoAccessor *GetChangeAccessor() const; // The engine implements this and the game .dll implements as
 	// as callback through to the engine!!!
 
+	// Records a changed offset that doesn't fit in the shared change infos. Same deal as GetChangeAccessor.
+	// Returns false if the engine can't record it.
+	bool StateChangedOverflow( unsigned short offset );
+
 	// NOTE: YOU CAN'T CHANGE THE LAYOUT OR SIZE OF CBASEEDICT AND REMAIN COMPATIBLE WITH HL2_VC6!!!!!
 	// This breaks HL2_VC6!!!!!
 	// References a CEdictChangeInfo with a list of modified network props.
@@ -304,9 +308,13 @@ inline void	CBaseEdict::StateChanged( unsigned short offset )
 
 		if ( p->m_nChangeOffsets == MAX_CHANGE_OFFSETS )
 		{
-			// Invalidate our change info.
-			accessor->SetChangeInfoSerialNumber( 0 );
-			m_fStateFlags |= FL_FULL_EDICT_CHANGED; // So we don't get in here again.
+			// The engine keeps the rest of the changes.
+			if ( !StateChangedOverflow( offset ) )
+			{
+				// Invalidate our change info.
+				accessor->SetChangeInfoSerialNumber( 0 );
+				m_fStateFlags |= FL_FULL_EDICT_CHANGED; // So we don't get in here again.
+			}
 		}
 		else
 		{
@@ -317,9 +325,13 @@ inline void	CBaseEdict::StateChanged( unsigned short offset )
 	{
 		if ( g_pSharedChangeInfo->m_nChangeInfos == MAX_EDICT_CHANGE_INFOS )
 		{
-			// Shucks.. have to mark the edict as fully changed because we don't have room to remember this change.
-			accessor->SetChangeInfoSerialNumber( 0 );
-			m_fStateFlags |= FL_FULL_EDICT_CHANGED;
+			// No room to remember this change here, so the engine keeps it.
+			if ( !StateChangedOverflow( offset ) )
+			{
+				// Shucks.. have to mark the edict as fully changed because we don't have room to remember this change.
+				accessor->SetChangeInfoSerialNumber( 0 );
+				m_fStateFlags |= FL_FULL_EDICT_CHANGED;
+			}
 		}
 		else
 		{
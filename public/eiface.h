@@ -75,8 +75,9 @@ typedef struct player_info_s player_info_t;
 
 #define INTERFACEVERSION_VENGINESERVER_VERSION_21	"VEngineServer021"
 #define INTERFACEVERSION_VENGINESERVER_VERSION_22	"VEngineServer022"
-#define INTERFACEVERSION_VENGINESERVER				"VEngineServer023"
-#define INTERFACEVERSION_VENGINESERVER_INT			23
+#define INTERFACEVERSION_VENGINESERVER_VERSION_23	"VEngineServer023"
+#define INTERFACEVERSION_VENGINESERVER				"VEngineServer024"
+#define INTERFACEVERSION_VENGINESERVER_INT			24
 
 struct bbox_t
 {
@@ -445,11 +446,16 @@ public:
 	virtual eFindMapResult FindMap( /* in/out */ char *pMapName, int nMapNameMax ) = 0;
 	
 	virtual void SetPausedForced( bool bPaused, float flDuration = -1.f ) = 0;
+
+	// Records a changed network var offset of an edict whose CEdictChangeInfo is full, or
+	// that couldn't get one this frame. Use CBaseEdict::StateChanged rather than calling this.
+	virtual void EdictStateChangedOverflow( edict_t *pEdict, unsigned short offset ) = 0;
 };
 
 // These only differ in new items added to the end
 typedef IVEngineServer IVEngineServer021;
 typedef IVEngineServer IVEngineServer022;
+typedef IVEngineServer IVEngineServer023;
 
 
 #define INTERFACEVERSION_SERVERGAMEDLL_VERSION_8	"ServerGameDLL008"
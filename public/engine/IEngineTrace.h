@@ -123,8 +123,10 @@ public:
 //-----------------------------------------------------------------------------
 // Interface the engine exposes to the game DLL
 //-----------------------------------------------------------------------------
-#define INTERFACEVERSION_ENGINETRACE_SERVER	"EngineTraceServer003"
-#define INTERFACEVERSION_ENGINETRACE_CLIENT	"EngineTraceClient003"
+#define INTERFACEVERSION_ENGINETRACE_SERVER_VERSION_3	"EngineTraceServer003"
+#define INTERFACEVERSION_ENGINETRACE_CLIENT_VERSION_3	"EngineTraceClient003"
+#define INTERFACEVERSION_ENGINETRACE_SERVER	"EngineTraceServer004"
+#define INTERFACEVERSION_ENGINETRACE_CLIENT	"EngineTraceClient004"
 abstract_class IEngineTrace
 {
 public:
@@ -185,8 +187,23 @@ public:
 
 	// Walks bsp to find the leaf containing the specified point
 	virtual int GetLeafContainingPoint( const Vector &ptTest ) = 0;
+
+	// Same as calling TraceRay for each of nRays rays, results are written into pTraces.
+	// Coherent rays (shotgun pellets, sensing rays from one eye) share the world BSP walk in SIMD packets.
+	virtual void TraceRays( const Ray_t *pRays, int nRays, unsigned int fMask, ITraceFilter *pTraceFilter, trace_t *pTraces ) = 0;
+
+	// Read-only tracing. Between BeginReadOnlyTraces and EndReadOnlyTraces, both called from the main thread,
+	// TraceRay, TraceRays, ClipRayToEntity, ClipRayToCollideable, GetPointContents and EnumerateEntities
+	// may be called from any thread. World and entity collision must not change meanwhile, and trace
+	// filters and entity collision callbacks used must be thread-safe.
+	virtual void BeginReadOnlyTraces() = 0;
+	virtual void EndReadOnlyTraces() = 0;
+	virtual bool IsInReadOnlyTraces() const = 0;
 };
 
+// These only differ in new items added to the end
+typedef IEngineTrace IEngineTrace003;
+
 
 
 #endif // ENGINE_IENGINETRACE_H
@@ -519,6 +519,8 @@ public:
 
 	//--------------------------------------------------------
 	// Reads/writes files to utlbuffers. Use this for optimal read performance when doing open/read/close
+	// Empty CUtlBuffer::READ_ONLY binary buffer may get whole file from a mounted VPK without a copy,
+	// pointing at data which is valid while the VPK stays mounted.
 	//--------------------------------------------------------
 	virtual bool			ReadFile( const char *pFileName, const char *pPath, CUtlBuffer &buf, int nMaxBytes = 0, int nStartingByte = 0, FSAllocFunc_t pfnAlloc = nullptr ) = 0;
 	virtual bool			WriteFile( const char *pFileName, const char *pPath, CUtlBuffer &buf ) = 0;
@@ -327,6 +327,237 @@ FORCEINLINE void StoreAlignedSIMD( QuaternionAligned * RESTRICT pSIMD, const flt
 }
 
 
+//---------------------------------------------------------------------
+// Four quaternions stored as x x x x y y y y z z z z w w w w, so ops
+// below work on 4 independent quaternions with per lane parameters.
+// Each op matches its single quaternion version above.
+//---------------------------------------------------------------------
+class alignas(16) FourQuaternions
+{
+public:
+	fltx4 x, y, z, w;
+
+	// Load 4 quaternions performing transpose op, any of them may be the same.
+	FORCEINLINE void LoadAndSwizzle( const Quaternion &a, const Quaternion &b, const Quaternion &c, const Quaternion &d )
+	{
+		x = DirectX::XMLoadFloat4( a.XmBase() );
+		y = DirectX::XMLoadFloat4( b.XmBase() );
+		z = DirectX::XMLoadFloat4( c.XmBase() );
+		w = DirectX::XMLoadFloat4( d.XmBase() );
+		TransposeSIMD( x, y, z, w );
+	}
+
+	// Store 4 quaternions performing transpose op.  Lanes stored to the same
+	// quaternion must hold the same value.
+	FORCEINLINE void SwizzleAndStore( Quaternion &a, Quaternion &b, Quaternion &c, Quaternion &d ) const
+	{
+		fltx4 qa = x, qb = y, qc = z, qd = w;
+		TransposeSIMD( qa, qb, qc, qd );
+		DirectX::XMStoreFloat4( a.XmBase(), qa );
+		DirectX::XMStoreFloat4( b.XmBase(), qb );
+		DirectX::XMStoreFloat4( c.XmBase(), qc );
+		DirectX::XMStoreFloat4( d.XmBase(), qd );
+	}
+
+	[[nodiscard]] FORCEINLINE fltx4 operator*( const FourQuaternions &q ) const	// 4 dot products
+	{
+		fltx4 dot = MulSIMD( x, q.x );
+		dot = MaddSIMD( y, q.y, dot );
+		dot = MaddSIMD( z, q.z, dot );
+		return MaddSIMD( w, q.w, dot );
+	}
+};
+
+// mask ? a : b per lane.
+[[nodiscard]] FORCEINLINE FourQuaternions MaskedAssign( const fltx4 &ReplacementMask, const FourQuaternions &NewValue, const FourQuaternions &OldValue )
+{
+	FourQuaternions result;
+	result.x = MaskedAssign( ReplacementMask, NewValue.x, OldValue.x );
+	result.y = MaskedAssign( ReplacementMask, NewValue.y, OldValue.y );
+	result.z = MaskedAssign( ReplacementMask, NewValue.z, OldValue.z );
+	result.w = MaskedAssign( ReplacementMask, NewValue.w, OldValue.w );
+	return result;
+}
+
+//---------------------------------------------------------------------
+// Radian euler angles (roll, pitch, yaw as x, y, z) to quaternions
+//---------------------------------------------------------------------
+[[nodiscard]] FORCEINLINE FourQuaternions AngleQuaternionSIMD( const fltx4 &roll, const fltx4 &pitch, const fltx4 &yaw )
+{
+	const fltx4 half = ReplicateX4( 0.5f );
+	fltx4 sr, sp, sy, cr, cp, cy;
+	SinCosSIMD( sr, cr, MulSIMD( roll, half ) );
+	SinCosSIMD( sp, cp, MulSIMD( pitch, half ) );
+	SinCosSIMD( sy, cy, MulSIMD( yaw, half ) );
+
+	const fltx4 srXcp = MulSIMD( sr, cp ), crXsp = MulSIMD( cr, sp );
+	const fltx4 crXcp = MulSIMD( cr, cp ), srXsp = MulSIMD( sr, sp );
+
+	FourQuaternions q;
+	q.x = MsubSIMD( crXsp, sy, MulSIMD( srXcp, cy ) );
+	q.y = MaddSIMD( srXcp, sy, MulSIMD( crXsp, cy ) );
+	q.z = MsubSIMD( srXsp, cy, MulSIMD( crXcp, sy ) );
+	q.w = MaddSIMD( srXsp, sy, MulSIMD( crXcp, cy ) );
+	return q;
+}
+
+[[nodiscard]] FORCEINLINE FourQuaternions QuaternionAlignSIMD( const FourQuaternions &p, const FourQuaternions &q )
+{
+	// decide if one of the quaternions is backwards
+	const fltx4 dx = SubSIMD( p.x, q.x ), sx = AddSIMD( p.x, q.x );
+	const fltx4 dy = SubSIMD( p.y, q.y ), sy = AddSIMD( p.y, q.y );
+	const fltx4 dz = SubSIMD( p.z, q.z ), sz = AddSIMD( p.z, q.z );
+	const fltx4 dw = SubSIMD( p.w, q.w ), sw = AddSIMD( p.w, q.w );
+
+	fltx4 a = MulSIMD( dx, dx );
+	a = MaddSIMD( dy, dy, a );
+	a = MaddSIMD( dz, dz, a );
+	a = MaddSIMD( dw, dw, a );
+
+	fltx4 b = MulSIMD( sx, sx );
+	b = MaddSIMD( sy, sy, b );
+	b = MaddSIMD( sz, sz, b );
+	b = MaddSIMD( sw, sw, b );
+
+	const fltx4 cmp = CmpGtSIMD( a, b );
+
+	FourQuaternions result;
+	result.x = MaskedAssign( cmp, NegSIMD( q.x ), q.x );
+	result.y = MaskedAssign( cmp, NegSIMD( q.y ), q.y );
+	result.z = MaskedAssign( cmp, NegSIMD( q.z ), q.z );
+	result.w = MaskedAssign( cmp, NegSIMD( q.w ), q.w );
+	return result;
+}
+
+[[nodiscard]] FORCEINLINE FourQuaternions QuaternionNormalizeSIMD( const FourQuaternions &q )
+{
+	const fltx4 radiusSq = q * q;
+	const fltx4 zeroMask = CmpEqSIMD( radiusSq, Four_Zeros );	// if radius was 0, just return q
+	const fltx4 iradius = ReciprocalSqrtSIMD( radiusSq );
+
+	FourQuaternions result;
+	result.x = MaskedAssign( zeroMask, q.x, MulSIMD( iradius, q.x ) );
+	result.y = MaskedAssign( zeroMask, q.y, MulSIMD( iradius, q.y ) );
+	result.z = MaskedAssign( zeroMask, q.z, MulSIMD( iradius, q.z ) );
+	result.w = MaskedAssign( zeroMask, q.w, MulSIMD( iradius, q.w ) );
+	return result;
+}
+
+// 0.0 returns p, 1.0 return q.
+[[nodiscard]] FORCEINLINE FourQuaternions QuaternionBlendNoAlignSIMD( const FourQuaternions &p, const FourQuaternions &q, const fltx4 &t )
+{
+	const fltx4 sclp = SubSIMD( Four_Ones, t );
+
+	FourQuaternions result;
+	result.x = MaddSIMD( t, q.x, MulSIMD( sclp, p.x ) );
+	result.y = MaddSIMD( t, q.y, MulSIMD( sclp, p.y ) );
+	result.z = MaddSIMD( t, q.z, MulSIMD( sclp, p.z ) );
+	result.w = MaddSIMD( t, q.w, MulSIMD( sclp, p.w ) );
+	return QuaternionNormalizeSIMD( result );
+}
+
+[[nodiscard]] FORCEINLINE FourQuaternions QuaternionBlendSIMD( const FourQuaternions &p, const FourQuaternions &q, const fltx4 &t )
+{
+	return QuaternionBlendNoAlignSIMD( p, QuaternionAlignSIMD( p, q ), t );
+}
+
+// p * q, q is aligned to p first.
+[[nodiscard]] FORCEINLINE FourQuaternions QuaternionMultSIMD( const FourQuaternions &p, const FourQuaternions &q )
+{
+	const FourQuaternions q1 = QuaternionAlignSIMD( p, q );
+
+	FourQuaternions result;
+	result.x = MaddSIMD( p.w, q1.x, MsubSIMD( p.z, q1.y, MaddSIMD( p.y, q1.z, MulSIMD( p.x, q1.w ) ) ) );
+	result.y = MaddSIMD( p.w, q1.y, MaddSIMD( p.z, q1.x, MsubSIMD( p.x, q1.z, MulSIMD( p.y, q1.w ) ) ) );
+	result.z = MaddSIMD( p.w, q1.z, MsubSIMD( p.y, q1.x, MaddSIMD( p.x, q1.y, MulSIMD( p.z, q1.w ) ) ) );
+	result.w = MsubSIMD( p.z, q1.z, MsubSIMD( p.y, q1.y, MsubSIMD( p.x, q1.x, MulSIMD( p.w, q1.w ) ) ) );
+	return result;
+}
+
+[[nodiscard]] FORCEINLINE FourQuaternions QuaternionScaleSIMD( const FourQuaternions &p, const fltx4 &t )
+{
+	fltx4 sinom = MaddSIMD( p.x, p.x, MaddSIMD( p.y, p.y, MulSIMD( p.z, p.z ) ) );
+	sinom = MinSIMD( SqrtSIMD( sinom ), Four_Ones );
+	const fltx4 sinsom = SinSIMD( MulSIMD( ArcSinSIMD( sinom ), t ) );
+	const fltx4 tvec = DivSIMD( sinsom, AddSIMD( sinom, Four_Epsilons ) );
+
+	// rescale rotation, keep sign of rotation
+	const fltx4 rr = SqrtSIMD( MaxSIMD( MsubSIMD( sinsom, sinsom, Four_Ones ), Four_Zeros ) );
+
+	FourQuaternions q;
+	q.x = MulSIMD( tvec, p.x );
+	q.y = MulSIMD( tvec, p.y );
+	q.z = MulSIMD( tvec, p.z );
+	q.w = MaskedAssign( CmpGeSIMD( p.w, Four_Zeros ), rr, NegSIMD( rr ) );
+	return q;
+}
+
+// qt = ( s * p ) * q
+[[nodiscard]] FORCEINLINE FourQuaternions QuaternionSMSIMD( const fltx4 &s, const FourQuaternions &p, const FourQuaternions &q )
+{
+	return QuaternionNormalizeSIMD( QuaternionMultSIMD( QuaternionScaleSIMD( p, s ), q ) );
+}
+
+// qt = p * ( s * q )
+[[nodiscard]] FORCEINLINE FourQuaternions QuaternionMASIMD( const FourQuaternions &p, const fltx4 &s, const FourQuaternions &q )
+{
+	return QuaternionNormalizeSIMD( QuaternionMultSIMD( p, QuaternionScaleSIMD( q, s ) ) );
+}
+
+// Same cases and thresholds as the single quaternion version.
+[[nodiscard]] FORCEINLINE FourQuaternions QuaternionSlerpNoAlignSIMD( const FourQuaternions &p, const FourQuaternions &q, const fltx4 &t )
+{
+	const fltx4 cosom = p * q;
+	const fltx4 threshold = ReplicateX4( 0.099999f );
+	const fltx4 sameHalfMask = CmpGtSIMD( cosom, NegSIMD( threshold ) );
+	const fltx4 slerpMask = AndSIMD( sameHalfMask, CmpGtSIMD( threshold, cosom ) );
+
+	// 0.0 returns p, 1.0 return q.
+	fltx4 sclp = SubSIMD( Four_Ones, t );
+	fltx4 sclq = t;
+
+	if ( TestSignSIMD( slerpMask ) )
+	{
+		const fltx4 omega = ArcCosSIMD( cosom );
+		const fltx4 tom = MulSIMD( t, omega );
+		const fltx4 isinom = ReciprocalSIMD( SinSIMD( omega ) );
+
+		sclp = MaskedAssign( slerpMask, MulSIMD( SinSIMD( SubSIMD( omega, tom ) ), isinom ), sclp );
+		sclq = MaskedAssign( slerpMask, MulSIMD( SinSIMD( tom ), isinom ), sclq );
+	}
+
+	FourQuaternions result;
+	result.x = MaddSIMD( sclq, q.x, MulSIMD( sclp, p.x ) );
+	result.y = MaddSIMD( sclq, q.y, MulSIMD( sclp, p.y ) );
+	result.z = MaddSIMD( sclq, q.z, MulSIMD( sclp, p.z ) );
+	result.w = MaddSIMD( sclq, q.w, MulSIMD( sclp, p.w ) );
+
+	if ( TestSignSIMD( sameHalfMask ) != 0xF )
+	{
+		// opposite halves, rotate through perpendicular quaternion
+		const fltx4 halfPi = ReplicateX4( 0.5f * M_PI_F );
+		const fltx4 tt = MulSIMD( t, halfPi );
+		const fltx4 sp = SinSIMD( SubSIMD( halfPi, tt ) );
+		const fltx4 sq = SinSIMD( tt );
+
+		FourQuaternions perpendicular;
+		perpendicular.x = MsubSIMD( q.y, sq, MulSIMD( p.x, sp ) );
+		perpendicular.y = MaddSIMD( q.x, sq, MulSIMD( p.y, sp ) );
+		perpendicular.z = MsubSIMD( q.w, sq, MulSIMD( p.z, sp ) );
+		perpendicular.w = q.z;
+
+		result = MaskedAssign( sameHalfMask, result, perpendicular );
+	}
+
+	return result;
+}
+
+[[nodiscard]] FORCEINLINE FourQuaternions QuaternionSlerpSIMD( const FourQuaternions &p, const FourQuaternions &q, const fltx4 &t )
+{
+	return QuaternionSlerpNoAlignSIMD( p, QuaternionAlignSIMD( p, q ), t );
+}
+
+
 #endif // ALLOW_SIMD_QUATERNION_MATH
 
 #endif // SSEQUATMATH_H
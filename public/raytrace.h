@@ -40,6 +40,19 @@ public:
 
 };
 
+/// 8 rays for the AVX2 tracer, stored as plain floats so that users don't need AVX. Like
+/// FourRays, all 8 rays must have the same signs in all of their direction components to be
+/// traced as a group.
+struct ALIGN32 EightRays
+{
+	float origin[3][8];
+	float direction[3][8];
+
+	// returns direction sign mask for 8 rays. returns -1 if the rays can not be traced as a
+	// bundle.
+	int CalculateDirectionSignMask(void) const;
+} ALIGN32_POST;
+
 /// The format a triangle is stored in for intersections. size of this structure is important.
 /// This structure can be in one of two forms. Before the ray tracing environment is set up, the
 /// ProjectedEdgeEquations hold the coordinates of the 3 vertices, for facilitating bounding box
@@ -208,6 +221,14 @@ struct RayTracingResult
 };
 
 
+struct ALIGN32 RayTracingResult8
+{
+	float surface_normal[3][8];								// surface normal at intersection
+	int32 HitIds[8];										// -1=no hit. otherwise, triangle index
+	float HitDistance[8];									// distance to intersection
+} ALIGN32_POST;
+
+
 class RayTraceLight
 {
 public:
@@ -244,6 +265,31 @@ public:
 	}
 };
 
+/// Ray stream which keeps all rays until FinishRayStream, then sorts them by direction octant and
+/// traces them 8 at a time with AVX2 (or 4 at a time without it). Packets are always full and
+/// rays added close to each other stay together, at the cost of storing the rays.
+class SortedRayStream
+{
+	friend class RayTracingEnvironment;
+
+	struct PendingRay_t
+	{
+		Vector start;
+		Vector delta;
+		RayTracingSingleResult *pResult;
+	};
+
+	CUtlVector<PendingRay_t> m_Rays;
+	CUtlVector<int> m_SortedRays;
+	int m_nOctantCounts[8];
+
+public:
+	SortedRayStream()
+	{
+		memset(m_nOctantCounts,0,sizeof(m_nOctantCounts));
+	}
+};
+
 // When transparent triangles are in the list, the caller can provide a callback that will get called at each triangle
 // allowing the callback to stop processing if desired.
 // UNDONE: This is not currently SIMD - it really only supports single rays
@@ -313,6 +359,16 @@ public:
 					RayTracingResult *rslt_out,
 					int32 skip_id=-1, ITransparentTriangleCallback *pCallback = NULL);
 
+	// 8 ray version of the lowest level Trace4Rays. all 8 rays must pass the direction sign
+	// check. Uses AVX2 when enabled, otherwise traces the rays as two sets of 4.
+	void Trace8Rays(const EightRays &rays, const float *TMin, const float *TMax,
+					int DirectionSignMask, RayTracingResult8 *rslt_out, int32 skip_id=-1);
+
+	// AVX2 tracing is enabled by default if the CPU supports it. Disabling it forces the SSE
+	// tracer, mostly for comparisons. Returns the previous state.
+	static bool EnableAVX2Tracing(bool bEnable);
+	static bool IsAVX2TracingEnabled(void);
+
 	// compute virtual light sources to model inter-reflection
 	void ComputeVirtualLightSources(void);
 
@@ -344,6 +400,11 @@ public:
 	/// previously passed to AddToRaySteam will have been filled in.
 	void FinishRayStream(RayStream &s);
 
+	/// same as above for the sorting stream. Results are only written by FinishRayStream.
+	void AddToRayStream(SortedRayStream &s,
+						Vector const &start,Vector const &end,RayTracingSingleResult *rslt_out);
+	void FinishRayStream(SortedRayStream &s);
+
 
 	intp MakeLeafNode(int first_tri, int last_tri);
 
@@ -1178,7 +1178,9 @@ struct CPUInformation
 		 m_bSSSE3 : 1,
 		 m_bSSE4a : 1,
 		 m_bSSE41 : 1,
-		 m_bSSE42 : 1;	
+		 m_bSSE42 : 1,
+		 m_bAVX   : 1,	// Is AVX supported by CPU and OS?
+		 m_bAVX2  : 1;	// Is AVX2 supported by CPU and OS?
 
 	int64 m_Speed;						// In cycles per second.
 
@@ -10,6 +10,7 @@
 #include "tier0/l2cache.h"
 #include "tier0/threadtools.h"
 #include "tier0/vprof_telemetry.h"
+#include "tier0/vprof_trace.h"
 
 // VProf is enabled by default in all configurations.
 #define VPROF_ENABLED
@@ -671,6 +672,7 @@ public:
 
 private:
 	bool m_bEnabled;
+	bool m_bTraced;
 };
 
 //-----------------------------------------------------------------------------
@@ -1078,8 +1080,15 @@ inline int CVProfile::GetBudgetGroupFlags( int budgetGroupID ) const
 //-----------------------------------------------------------------------------
 
 inline CVProfScope::CVProfScope( const tchar * pszName, int detailLevel, const tchar *pBudgetGroupName, bool bAssertAccounted, int budgetFlags )
-	: m_bEnabled( g_VProfCurrentProfile.IsEnabled() )
+	: m_bEnabled( g_VProfCurrentProfile.IsEnabled() ),
+	  m_bTraced( VProfTraceIsEnabled() )
 { 
+	// Traced on every thread, unlike the node tree which only profiles the target thread.
+	if ( m_bTraced )
+	{
+		VProfTraceBegin( pszName );
+	}
+
 	if ( m_bEnabled )
 	{
 		g_VProfCurrentProfile.EnterScope( pszName, detailLevel, pBudgetGroupName, bAssertAccounted, budgetFlags ); 
@@ -1094,6 +1103,11 @@ inline CVProfScope::~CVProfScope()
 	{
 		g_VProfCurrentProfile.ExitScope(); 
 	}
+
+	if ( m_bTraced )
+	{
+		VProfTraceEnd();
+	}
 }
 
 class CVProfCounter
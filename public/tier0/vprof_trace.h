@@ -0,0 +1,75 @@
+// Copyright Valve Corporation, All rights reserved.
+//
+// Purpose: Per-thread timeline of VProf scopes and jobs, exported as
+// Chrome trace-event JSON or Perfetto protobuf.
+
+#ifndef TIER0_VPROF_TRACE_H_
+#define TIER0_VPROF_TRACE_H_
+
+#include "tier0/platform.h"
+#include "tier0/threadtools.h"
+
+enum VProfTraceFormat_t
+{
+	VPROF_TRACE_FORMAT_JSON,		// Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev)
+	VPROF_TRACE_FORMAT_PERFETTO,	// Perfetto TracePacket protobuf (ui.perfetto.dev)
+};
+
+// Each thread records into its own ring buffer, so only the most recent
+// events per thread are kept.  Once VPROF_TRACE_MAX_THREADS buffers exist,
+// new threads take over the buffers of threads that have exited.
+constexpr inline int VPROF_TRACE_EVENTS_PER_THREAD = 32768;
+constexpr inline int VPROF_TRACE_MAX_THREADS = 64;
+
+// Tested inline before every traced scope, so tracing costs one load when off.
+PLATFORM_INTERFACE bool g_bVProfTraceEnabled;
+
+inline bool VProfTraceIsEnabled()
+{
+	return g_bVProfTraceEnabled;
+}
+
+PLATFORM_INTERFACE void VProfTraceEnable( bool bEnable );
+
+// pszName is stored by pointer and must stay valid, like VProf node names.
+PLATFORM_INTERFACE void VProfTraceBegin( const tchar *pszName );
+// Copies the first 31 characters of pszName, for names that don't outlive the scope.
+PLATFORM_INTERFACE void VProfTraceBeginCopy( const char *pszName );
+PLATFORM_INTERFACE void VProfTraceEnd();
+
+// Called by ThreadSetDebugName so tracks are labelled in the viewer.
+PLATFORM_INTERFACE void VProfTraceSetThreadName( ThreadId_t id, const char *pszName );
+
+// Traces the enclosing scope under a copied name, for names that don't outlive it.
+class CVProfTraceScope
+{
+public:
+	explicit CVProfTraceScope( const char *pszName )
+		: m_bTraced( VProfTraceIsEnabled() )
+	{
+		if ( m_bTraced )
+		{
+			VProfTraceBeginCopy( pszName );
+		}
+	}
+
+	~CVProfTraceScope()
+	{
+		if ( m_bTraced )
+		{
+			VProfTraceEnd();
+		}
+	}
+
+private:
+	bool m_bTraced;
+};
+
+using VProfTraceWriteFunc_t = void (*)( const void *pData, size_t nBytes, void *pContext );
+
+// Serializes the last flSeconds of every thread's events (all of them when flSeconds <= 0)
+// through pfnWrite.  Safe to call while other threads keep recording.  Returns the number
+// of events written.
+PLATFORM_INTERFACE int VProfTraceWrite( VProfTraceFormat_t format, double flSeconds, VProfTraceWriteFunc_t pfnWrite, void *pContext );
+
+#endif  // TIER0_VPROF_TRACE_H_
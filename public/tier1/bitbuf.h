@@ -21,6 +21,8 @@
 #include "tier0/basetypes.h"
 #include "tier0/dbg.h"
 
+#include <cstring>
+
 
 #if _DEBUG
 #define BITBUF_INLINE inline
@@ -28,6 +30,26 @@
 #define BITBUF_INLINE FORCEINLINE
 #endif
 
+// On 64 bit little endian targets fields are read through the 64 bit window
+// starting at their dword, so a field that straddles two dwords costs one load
+// instead of two.  Single fields are still written a dword at a time: the next
+// field's window would partly overlap this one's store, which stalls store
+// forwarding.
+#if defined( PLATFORM_64BITS ) && !defined( VALVE_BIG_ENDIAN )
+#define BITBUF_64BIT_WINDOWS 1
+#else
+#define BITBUF_64BIT_WINDOWS 0
+#endif
+
+// BMI2 masks fields with BZHI and packs varints with PDEP/PEXT. MSVC has no
+// BMI switch, but every CPU /arch:AVX2 targets has BMI1 and BMI2.
+#if BITBUF_64BIT_WINDOWS && ( ( defined( __BMI__ ) && defined( __BMI2__ ) ) || ( defined( _MSC_VER ) && defined( __AVX2__ ) ) )
+#define BITBUF_BMI2 1
+#include <immintrin.h>
+#else
+#define BITBUF_BMI2 0
+#endif
+
 //-----------------------------------------------------------------------------
 // Forward declarations.
 //-----------------------------------------------------------------------------
@@ -133,6 +155,34 @@ namespace bitbuf
 
 	constexpr inline int kMaxVarintBytes = 10;
 	constexpr inline int kMaxVarint32Bytes = 5;
+
+#if BITBUF_64BIT_WINDOWS
+	// Low numbits (< 64) bits of a window.
+	[[nodiscard]] BITBUF_INLINE uint64 LowBits64( uint64 window, unsigned numbits )
+	{
+#if BITBUF_BMI2
+		return _bzhi_u64( window, numbits );
+#else
+		return window & ( ( uint64{1} << numbits ) - 1 );
+#endif
+	}
+
+	[[nodiscard]] BITBUF_INLINE uint64 LoadWindow64( const void *p )
+	{
+		uint64 window;
+		memcpy( &window, p, sizeof( window ) );
+		return window;
+	}
+
+	BITBUF_INLINE void StoreWindow64( void *p, uint64 window )
+	{
+		memcpy( p, &window, sizeof( window ) );
+	}
+#endif
+
+	// Copies nBits from pIn starting at bit iInBit to pOut starting at bit
+	// iOutBit, without bounds checks. Bits around the range are preserved.
+	void CopyBits( void *pOut, intp iOutBit, intp nOutBytes, const void *pIn, intp iInBit, intp nInBytes, intp nBits );
 }
 
 //-----------------------------------------------------------------------------
@@ -808,6 +858,14 @@ BITBUF_INLINE uint32 bf_read::ReadUBitLong( int numbits )
 	size_t iWordOffset1 = m_iCurBit >> 5;
 	size_t iWordOffset2 = iLastBit >> 5;
 	m_iCurBit += numbits;
+
+#if BITBUF_64BIT_WINDOWS
+	if ( (intp)( iWordOffset1 * sizeof(uint32) + sizeof(uint64) ) <= m_nDataBytes )
+	{
+		const uint64 window = bitbuf::LoadWindow64( m_pData + iWordOffset1 * sizeof(uint32) );
+		return static_cast<uint32>( bitbuf::LowBits64( window >> iStartBit, numbits ) );
+	}
+#endif
 	
 #if __i386__
 	unsigned int bitmask = (2 << (numbits-1)) - 1;
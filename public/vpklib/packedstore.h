@@ -11,6 +11,9 @@
 #endif
 
 
+#include <atomic>
+#include <memory>
+
 #include <tier0/platform.h>
 #include <tier0/threadtools.h>
 #include <tier0/tslist.h>
@@ -77,6 +80,10 @@ public:
 
 	FORCEINLINE int Read( void *pOutData, int nNumBytes );
 
+	// Whole file contents in memory, or NULL when file has to be Read.
+	// Valid while the owning pack is alive.
+	FORCEINLINE const void *DirectData( void );
+
 	CPackedStoreFileHandle( void )
 	{
 		m_nFileNumber = -1;
@@ -137,6 +144,33 @@ typedef HANDLE PackDataFileHandle_t;
 typedef FileHandle_t PackDataFileHandle_t;
 #endif
 
+// Read-only view of a whole pack file.  See CPackedStore::EnableMapping.
+struct PackMappedFile_t
+{
+	const uint8 *m_pData;
+	int64 m_nSize;
+
+	PackMappedFile_t( void )
+	{
+		m_pData = nullptr;
+		m_nSize = 0;
+	}
+
+	bool Map( char const *pszFileName );
+	void Unmap( void );
+
+	FORCEINLINE bool IsMapped( void ) const
+	{
+		return m_pData != nullptr;
+	}
+
+	// Is [nOffset, nOffset + nNumBytes) inside the view?
+	FORCEINLINE bool Contains( int64 nOffset, int64 nNumBytes ) const
+	{
+		return m_pData && nOffset >= 0 && nNumBytes >= 0 && nOffset + nNumBytes <= m_nSize;
+	}
+};
+
 struct FileHandleTracker_t
 {
 	int m_nFileNumber;
@@ -144,11 +178,18 @@ struct FileHandleTracker_t
 	int m_nCurOfs;
 	CThreadFastMutex m_Mutex;
 
+	// Mapped archive, reads from it need neither seek nor m_Mutex.
+	PackMappedFile_t m_Mapping;
+	// One flag per 1MB fraction of m_Mapping which was submitted for MD5 check.
+	std::unique_ptr<std::atomic_bool[]> m_pMappedFractionsHashed;
+	int m_nMappedFractions;
+
 	FileHandleTracker_t( void )
 	{
 		m_nFileNumber = -1;
 		m_hFileHandle = nullptr;
 		m_nCurOfs = 0;
+		m_nMappedFractions = 0;
 	}
 };
 
@@ -252,6 +293,11 @@ public:
 	void RetryBadCacheLine( CachedVPKRead_t &cachedVPKRead );
 	void RetryAllBadCacheLines();
 
+	// Mapped archives skip the cache lines, but their 1MB fractions are still
+	// MD5 checked on first touch, straight from the mapping.
+	void NoteMappedRead( FileHandleTracker_t &fHandle, int nDesiredPos, int nNumBytes );
+	void CheckMappedMD5Results( bool bBlock );
+
 
 	// cache 64 MiB total
 	static constexpr inline int k_nCacheBuffersToKeep = 8;
@@ -264,6 +310,9 @@ public:
 	CTSQueue<CachedVPKRead_t> m_queueCachedVPKReadsRetry; // all the reads that have failed
 	CUtlLinkedList<CachedVPKRead_t> m_listCachedVPKReadsFailed; // all the reads that have failed
 
+	CThreadFastMutex m_MappedMD5Mutex;
+	CUtlVector<CachedVPKRead_t> m_vecMappedMD5Pending; // MD5 requests on mapped fractions
+
 	// current items in the cache
 	int m_cItemsInCache;
 	unsigned short m_rgCurrentCacheIndex[k_nCacheBuffersToKeep];
@@ -310,11 +359,26 @@ public:
 
 	int ReadData( CPackedStoreFileHandle &handle, void *pOutData, int nNumBytes );
 
+	// Pointer to the whole file when it lives in preload data or in a mapped
+	// archive, NULL otherwise.
+	const void *DirectData( CPackedStoreFileHandle &handle );
+
 	~CPackedStore( void );
 
+	// Map directory and archives of packs opened for read instead of reading
+	// them into heap / through file handles.  On by default on 64 bit platforms.
+	// Affects packs opened afterwards, returns previous value.
+	static bool EnableMapping( bool bEnable );
+	static bool IsMappingEnabled( void );
+
 	FORCEINLINE void *DirectoryData( void )
 	{
-		return m_DirectoryData.Base();
+		return m_pMappedDirectoryData ? m_pMappedDirectoryData : m_DirectoryData.Base();
+	}
+
+	FORCEINLINE intp DirectoryDataSize( void ) const
+	{
+		return m_pMappedDirectoryData ? m_nDirectoryDataSize : m_DirectoryData.Count();
 	}
 
 	// Get a list of all the files in the zip You are responsible for freeing the contents of
@@ -428,6 +492,12 @@ private:
 	CUtlVector<uint8> m_DirectoryData;
 	CUtlBlockVector<uint8> m_EmbeddedChunkData;
 
+	// Mapped dir file, when set directory data points into it instead of m_DirectoryData.
+	PackMappedFile_t m_DirFileMapping;
+	uint8 *m_pMappedDirectoryData;
+	// Map archives as they are opened.
+	bool m_bMapFiles;
+
 	CUtlSortVector<ChunkHashFraction_t, ChunkHashFractionLess_t > m_vecChunkHashFraction;
 	bool BFileContainedHashes() { return m_vecChunkHashFraction.Count() > 0; }
 	// these are valid if BFileContainedHashes() is true
@@ -478,6 +548,11 @@ FORCEINLINE int CPackedStoreFileHandle::Read( void *pOutData, int nNumBytes )
 	return m_pOwner->ReadData( *this, pOutData, nNumBytes );
 }
 
+FORCEINLINE const void *CPackedStoreFileHandle::DirectData( void )
+{
+	return m_pOwner->DirectData( *this );
+}
+
 FORCEINLINE void CPackedStoreFileHandle::GetPackFileName( OUT_Z_CAP(cchFileNameOut) char *pchFileNameOut, int cchFileNameOut )
 {
 	m_pOwner->GetPackFileName( *this, pchFileNameOut, cchFileNameOut );
@@ -28,11 +28,13 @@
 //=============================================================================
 
 #include "tier0/threadtools.h"
+#include "tier0/fasttimer.h"
 #include "tier1/refcount.h"
 #include "tier1/utllinkedlist.h"
 #include "tier1/utlvector.h"
 #include "tier1/functors.h"
 #include "tier0/vprof_telemetry.h"
+#include "tier0/vprof_trace.h"
 
 #include "vstdlib/vstdlib.h"
 
@@ -109,6 +111,7 @@ struct ThreadPoolStartParams_t
 		  bIOThreads( bIOThreads_ )
 	{
 		bExecOnThreadPoolThreadsOnly = false;
+		bWorkStealing = false;
 
 		bUseAffinityTable = ( pAffinities != nullptr ) && ( fDistribute == TRS_TRUE ) && ( nThreads != -1 );
 		if ( bUseAffinityTable )
@@ -137,6 +140,9 @@ struct ThreadPoolStartParams_t
 	bool			bIOThreads : 1;
 	bool			bUseAffinityTable : 1;
 	bool			bExecOnThreadPoolThreadsOnly : 1;
+	// Queue jobs to per thread work-stealing deques and a shared injection
+	// queue instead of the single shared queue. Helps pools running many tiny jobs.
+	bool			bWorkStealing : 1;
 };
 
 //-----------------------------------------------------------------------------
@@ -844,30 +850,92 @@ protected:
 	void (FUNCTION_CLASS::*m_pfnEnd)();
 };
 
+//-----------------------------------------------------------------------------
+// Chunk sizes for parallel processors. Items are claimed in chunks so cheap
+// items don't spend their time on interlocked traffic:
+//  - nGrainSize > 0: fixed chunks of nGrainSize items.
+//  - nGrainSize == 0: guided. Chunk grows to take about TARGET_CHUNK_US by
+//    item cost measured on the previous chunk, but stays below remaining items
+//    split between threads, so threads still finish together.
+//-----------------------------------------------------------------------------
+class CParallelChunkSizer
+{
+public:
+	enum
+	{
+		TARGET_CHUNK_US = 20,
+		MAX_CHUNK_GROWTH = 4
+	};
+
+	CParallelChunkSizer( intp nGrainSize = 0, intp nThreads = 1 )
+	{
+		Init( nGrainSize, nThreads );
+	}
+
+	void Init( intp nGrainSize, intp nThreads )
+	{
+		m_nGrainSize = nGrainSize > 0 ? nGrainSize : 0;
+		m_nThreads = nThreads > 0 ? nThreads : 1;
+		m_nTargetCycles = g_ClockSpeed * TARGET_CHUNK_US / 1000000;
+	}
+
+	bool IsAdaptive() const { return m_nGrainSize == 0; }
+
+	intp First() const { return IsAdaptive() ? 1 : m_nGrainSize; }
+
+	// nCycles spent on nDone items of last chunk of nLastChunk size.
+	intp Next( intp nLastChunk, intp nDone, uint64 nCycles, intp nRemaining ) const
+	{
+		if ( !IsAdaptive() )
+		{
+			return m_nGrainSize;
+		}
+
+		const uint64 nCyclesPerItem = nDone > 0 && nCycles > (uint64)nDone ? nCycles / nDone : 1;
+
+		intp nChunk = static_cast<intp>( MIN( m_nTargetCycles / nCyclesPerItem, (uint64)PTRDIFF_MAX ) );
+		nChunk = MIN( nChunk, nLastChunk * MAX_CHUNK_GROWTH );
+		nChunk = MIN( nChunk, nRemaining / ( 2 * m_nThreads ) );
+		return nChunk > 0 ? nChunk : 1;
+	}
+
+private:
+	intp	m_nGrainSize;
+	intp	m_nThreads;
+	uint64	m_nTargetCycles;
+};
+
 template <typename ITEM_TYPE, class ITEM_PROCESSOR_TYPE>
 class CParallelProcessor
 {
 public:
 	CParallelProcessor( const char *pszDescription )
 	{
-		m_pItems = m_pLimit = 0;
+		m_pItems = 0;
+		m_nItems = 0;
+		m_iNextItem.store( 0, std::memory_order::memory_order_relaxed );
 		m_szDescription = pszDescription;
 	}
 
-	void Run( ITEM_TYPE *pItems, size_t nItems, intp nMaxParallel = PTRDIFF_MAX, IThreadPool *pThreadPool = nullptr )
+	// nGrainSize 0 picks chunk size by measured item cost, see CParallelChunkSizer.
+	void Run( ITEM_TYPE *pItems, size_t nItems, intp nMaxParallel = PTRDIFF_MAX, IThreadPool *pThreadPool = nullptr, intp nGrainSize = 0 )
 	{
 		tmZone( TELEMETRY_LEVEL0, TMZF_NONE, "Run %s %zd", m_szDescription, nItems );
 
 		if ( nItems == 0 )
 			return;
 
+		// Covers the caller's share plus the wait, so stalls on workers show up on its track.
+		CVProfTraceScope traceScope( m_szDescription ? m_szDescription : "ParallelProcess" );
+
 		if ( !pThreadPool )
 		{
 			pThreadPool = g_pThreadPool;
 		}
 
 		m_pItems = pItems;
-		m_pLimit = pItems + nItems;
+		m_nItems = static_cast<intp>( nItems );
+		m_iNextItem.store( 0, std::memory_order::memory_order_relaxed );
 
 		intp nJobs = nItems - 1;
 
@@ -878,6 +946,7 @@ public:
 
 		if (! pThreadPool )									// only possible on linux
 		{
+			m_ChunkSizer.Init( nGrainSize, 1 );
 			DoExecute( );
 			return;
 		}
@@ -888,6 +957,8 @@ public:
 			nJobs = nThreads;
 		}
 
+		m_ChunkSizer.Init( nGrainSize, nJobs > 1 ? nJobs + 1 : 1 );
+
 		if ( nJobs > 1 )
 		{
 			CJob **jobs = (CJob **)stackalloc( nJobs * sizeof(CJob **) );
@@ -920,57 +991,68 @@ private:
 	{
 		tmZone( TELEMETRY_LEVEL0, TMZF_NONE, "DoExecute %s", m_szDescription );
 
-		if ( m_pItems < m_pLimit )
+		if ( m_iNextItem.load( std::memory_order::memory_order_relaxed ) < m_nItems )
 		{
 			m_ItemProcessor.Begin();
 
-			ITEM_TYPE *pLimit = m_pLimit;
+			const intp nItems = m_nItems;
+			intp nChunk = m_ChunkSizer.First();
 
 			for (;;)
 			{
-				ITEM_TYPE *pCurrent = m_pItems++;
-				if ( pCurrent < pLimit )
+				const intp iBegin = m_iNextItem.fetch_add( nChunk, std::memory_order::memory_order_relaxed );
+				if ( iBegin >= nItems )
 				{
-					m_ItemProcessor.Process( *pCurrent );
+					break;
 				}
-				else
+
+				const intp iEnd = MIN( iBegin + nChunk, nItems );
+				const uint64 nStart = Plat_Rdtsc();
+
+				for ( intp i = iBegin; i < iEnd; ++i )
 				{
-					break;
+					m_ItemProcessor.Process( m_pItems[i] );
 				}
+
+				const intp nRemaining = nItems - m_iNextItem.load( std::memory_order::memory_order_relaxed );
+				nChunk = m_ChunkSizer.Next( nChunk, iEnd - iBegin, Plat_Rdtsc() - nStart, nRemaining );
 			}
 
 			m_ItemProcessor.End();
 		}
 	}
-	CInterlockedPtr<ITEM_TYPE>	m_pItems;
-	ITEM_TYPE *					m_pLimit;
+
+	ITEM_TYPE *					m_pItems;
+	intp						m_nItems;
+	std::atomic<intp>			m_iNextItem;
+	CParallelChunkSizer			m_ChunkSizer;
 	const char *				m_szDescription;
 };
 
 template <typename ITEM_TYPE> 
-inline void ParallelProcess( const char *pszDescription, ITEM_TYPE *pItems, size_t nItems, void (*pfnProcess)( ITEM_TYPE & ), void (*pfnBegin)() = NULL, void (*pfnEnd)() = NULL, intp nMaxParallel = PTRDIFF_MAX )
+inline void ParallelProcess( const char *pszDescription, ITEM_TYPE *pItems, size_t nItems, void (*pfnProcess)( ITEM_TYPE & ), void (*pfnBegin)() = NULL, void (*pfnEnd)() = NULL, intp nMaxParallel = PTRDIFF_MAX, intp nGrainSize = 0 )
 {
 	CParallelProcessor<ITEM_TYPE, CFuncJobItemProcessor<ITEM_TYPE> > processor( pszDescription );
 	processor.m_ItemProcessor.Init( pfnProcess, pfnBegin, pfnEnd );
-	processor.Run( pItems, nItems, nMaxParallel );
+	processor.Run( pItems, nItems, nMaxParallel, nullptr, nGrainSize );
 
 }
 
 template <typename ITEM_TYPE, typename OBJECT_TYPE, typename FUNCTION_CLASS > 
-inline void ParallelProcess( const char *pszDescription, ITEM_TYPE *pItems, size_t nItems, OBJECT_TYPE *pObject, void (FUNCTION_CLASS::*pfnProcess)( ITEM_TYPE & ), void (FUNCTION_CLASS::*pfnBegin)() = NULL, void (FUNCTION_CLASS::*pfnEnd)() = NULL, intp nMaxParallel = PTRDIFF_MAX )
+inline void ParallelProcess( const char *pszDescription, ITEM_TYPE *pItems, size_t nItems, OBJECT_TYPE *pObject, void (FUNCTION_CLASS::*pfnProcess)( ITEM_TYPE & ), void (FUNCTION_CLASS::*pfnBegin)() = NULL, void (FUNCTION_CLASS::*pfnEnd)() = NULL, intp nMaxParallel = PTRDIFF_MAX, intp nGrainSize = 0 )
 {
 	CParallelProcessor<ITEM_TYPE, CMemberFuncJobItemProcessor<ITEM_TYPE, OBJECT_TYPE, FUNCTION_CLASS> > processor( pszDescription );
 	processor.m_ItemProcessor.Init( pObject, pfnProcess, pfnBegin, pfnEnd );
-	processor.Run( pItems, nItems, nMaxParallel );
+	processor.Run( pItems, nItems, nMaxParallel, nullptr, nGrainSize );
 }
 
 // Parallel Process that lets you specify threadpool
 template <typename ITEM_TYPE> 
-inline void ParallelProcess( const char *pszDescription, IThreadPool *pPool, ITEM_TYPE *pItems, size_t nItems, void (*pfnProcess)( ITEM_TYPE & ), void (*pfnBegin)() = NULL, void (*pfnEnd)() = NULL, intp nMaxParallel = PTRDIFF_MAX )
+inline void ParallelProcess( const char *pszDescription, IThreadPool *pPool, ITEM_TYPE *pItems, size_t nItems, void (*pfnProcess)( ITEM_TYPE & ), void (*pfnBegin)() = NULL, void (*pfnEnd)() = NULL, intp nMaxParallel = PTRDIFF_MAX, intp nGrainSize = 0 )
 {
 	CParallelProcessor<ITEM_TYPE, CFuncJobItemProcessor<ITEM_TYPE> > processor( pszDescription );
 	processor.m_ItemProcessor.Init( pfnProcess, pfnBegin, pfnEnd );
-	processor.Run( pItems, nItems, nMaxParallel, pPool );
+	processor.Run( pItems, nItems, nMaxParallel, pPool, nGrainSize );
 }
 
 
@@ -987,7 +1069,8 @@ public:
 		m_szDescription = pszDescription;
 	}
 
-	void Run( intp lBegin, intp nItems, intp nMaxParallel = PTRDIFF_MAX )
+	// nGrainSize 0 picks chunk size by measured item cost, see CParallelChunkSizer.
+	void Run( intp lBegin, intp nItems, intp nMaxParallel = PTRDIFF_MAX, intp nGrainSize = 0 )
 	{
 		if ( nItems )
 		{
@@ -1001,6 +1084,8 @@ public:
 				i = nMaxParallel;
 			}
 
+			m_ChunkSizer.Init( nGrainSize, i + 1 );
+
 			while( i-- )
 			{
 				m_nActive.fetch_add(1, std::memory_order::memory_order_relaxed);
@@ -1026,20 +1111,28 @@ private:
 
 		m_ItemProcessor.Begin();
 
-		intp lLimit = m_lLimit;
+		const intp lLimit = m_lLimit;
+		intp nChunk = m_ChunkSizer.First();
 
 		for (;;)
 		{
-			intp lIndex = m_lIndex.fetch_add(1, std::memory_order::memory_order_relaxed);
+			const intp lBegin = m_lIndex.fetch_add(nChunk, std::memory_order::memory_order_relaxed);
 
-			if ( lIndex < lLimit )
+			if ( lBegin >= lLimit )
 			{
-				m_ItemProcessor.Process( lIndex );
+				break;
 			}
-			else
+
+			const intp lEnd = MIN( lBegin + nChunk, lLimit );
+			const uint64 nStart = Plat_Rdtsc();
+
+			for ( intp lIndex = lBegin; lIndex < lEnd; ++lIndex )
 			{
-				break;
+				m_ItemProcessor.Process( lIndex );
 			}
+
+			const intp nRemaining = lLimit - static_cast<intp>( m_lIndex.load( std::memory_order::memory_order_relaxed ) );
+			nChunk = m_ChunkSizer.Next( nChunk, lEnd - lBegin, Plat_Rdtsc() - nStart, nRemaining );
 		}
 
 		m_ItemProcessor.End();
@@ -1054,6 +1147,7 @@ private:
 #endif
 
 	intp						m_lLimit;
+	CParallelChunkSizer			m_ChunkSizer;
 
 #ifdef PLATFORM_64BITS
 	std::atomic_int64_t			m_nActive;
@@ -1064,20 +1158,20 @@ private:
 	const char *				m_szDescription;
 };
 
-inline void ParallelLoopProcess( const char *szDescription, intp lBegin, size_t nItems, void (*pfnProcess)( intp const & ), void (*pfnBegin)() = NULL, void (*pfnEnd)() = NULL, intp nMaxParallel = PTRDIFF_MAX )
+inline void ParallelLoopProcess( const char *szDescription, intp lBegin, size_t nItems, void (*pfnProcess)( intp const & ), void (*pfnBegin)() = NULL, void (*pfnEnd)() = NULL, intp nMaxParallel = PTRDIFF_MAX, intp nGrainSize = 0 )
 {
 	CParallelLoopProcessor< CFuncJobItemProcessor< intp const > > processor( szDescription );
 	processor.m_ItemProcessor.Init( pfnProcess, pfnBegin, pfnEnd );
-	processor.Run( lBegin, nItems, nMaxParallel );
+	processor.Run( lBegin, nItems, nMaxParallel, nGrainSize );
 
 }
 
 template < typename OBJECT_TYPE, typename FUNCTION_CLASS > 
-inline void ParallelLoopProcess( const char *szDescription, intp lBegin, size_t nItems, OBJECT_TYPE *pObject, void (FUNCTION_CLASS::*pfnProcess)( intp const & ), void (FUNCTION_CLASS::*pfnBegin)() = NULL, void (FUNCTION_CLASS::*pfnEnd)() = NULL, intp nMaxParallel = PTRDIFF_MAX )
+inline void ParallelLoopProcess( const char *szDescription, intp lBegin, size_t nItems, OBJECT_TYPE *pObject, void (FUNCTION_CLASS::*pfnProcess)( intp const & ), void (FUNCTION_CLASS::*pfnBegin)() = NULL, void (FUNCTION_CLASS::*pfnEnd)() = NULL, intp nMaxParallel = PTRDIFF_MAX, intp nGrainSize = 0 )
 {
 	CParallelLoopProcessor< CMemberFuncJobItemProcessor< intp const, OBJECT_TYPE, FUNCTION_CLASS> > processor( szDescription );
 	processor.m_ItemProcessor.Init( pObject, pfnProcess, pfnBegin, pfnEnd );
-	processor.Run( lBegin, nItems, nMaxParallel );
+	processor.Run( lBegin, nItems, nMaxParallel, nGrainSize );
 }
 
 
@@ -1267,7 +1361,17 @@ inline JobStatus_t CJob::Execute()
 		{
 			// Service it
 			m_status = JOB_STATUS_INPROGRESS;
+			// Job descriptions live in the job, so the trace copies them.
+			const bool bTraced = VProfTraceIsEnabled();
+			if ( bTraced )
+			{
+				VProfTraceBeginCopy( Describe() );
+			}
 			result = m_status = DoExecute();
+			if ( bTraced )
+			{
+				VProfTraceEnd();
+			}
 			DoCleanup();
 			m_CompleteEvent.Set();
 			break;
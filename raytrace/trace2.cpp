@@ -365,3 +365,100 @@ void RayTracingEnvironment::FinishRayStream(RayStream &s)
 		}
 	}
 }
+
+void RayTracingEnvironment::AddToRayStream(SortedRayStream &s,
+										   Vector const &start,Vector const &end,
+										   RayTracingSingleResult *rslt_out)
+{
+	SortedRayStream::PendingRay_t &ray=s.m_Rays[s.m_Rays.AddToTail()];
+	ray.start=start;
+	ray.delta=end;
+	ray.delta-=start;
+	ray.pResult=rslt_out;
+	s.m_nOctantCounts[GetSignMask(ray.delta)]++;
+}
+
+void RayTracingEnvironment::FinishRayStream(SortedRayStream &s)
+{
+	int nrays=s.m_Rays.Count();
+	if (! nrays)
+		return;
+
+	// counting sort by octant. it is stable, so rays which were added next to each other (and
+	// are usually coherent) stay next to each other.
+	int octant_start[8];
+	int pos=0;
+	for(int msk=0;msk<8;msk++)
+	{
+		octant_start[msk]=pos;
+		pos+=s.m_nOctantCounts[msk];
+	}
+	s.m_SortedRays.SetCount(nrays);
+	for(int i=0;i<nrays;i++)
+		s.m_SortedRays[octant_start[GetSignMask(s.m_Rays[i].delta)]++]=i;
+
+	int first=0;
+	for(int msk=0;msk<8;msk++)
+	{
+		int cnt=s.m_nOctantCounts[msk];
+		for(int base=0;base<cnt;base+=8)
+		{
+			int nvalid=min(8,cnt-base);
+			EightRays rays;
+			float tmin[8];
+			float tmax[8];
+			for(int half=0;half<2;half++)
+			{
+				FourVectors org;
+				FourVectors dir;
+				for(int r=0;r<4;r++)
+				{
+					// fill in unfilled entries with dups of first
+					int idx=half*4+r;
+					if (idx>=nvalid)
+						idx=0;
+					SortedRayStream::PendingRay_t const &ray=s.m_Rays[s.m_SortedRays[first+base+idx]];
+					org.X(r)=ray.start.x;
+					org.Y(r)=ray.start.y;
+					org.Z(r)=ray.start.z;
+					dir.X(r)=ray.delta.x;
+					dir.Y(r)=ray.delta.y;
+					dir.Z(r)=ray.delta.z;
+				}
+				// normalize the same way as FlushStreamEntry, so both streams give same results
+				fltx4 len=dir.length();
+				fltx4 scl=ReciprocalSaturateSIMD(len);
+				dir*=scl;
+				StoreUnalignedSIMD(tmax+half*4,len);
+				StoreUnalignedSIMD(tmin+half*4,Four_Zeros);
+				for(int r=0;r<4;r++)
+				{
+					rays.origin[0][half*4+r]=org.X(r);
+					rays.origin[1][half*4+r]=org.Y(r);
+					rays.origin[2][half*4+r]=org.Z(r);
+					rays.direction[0][half*4+r]=dir.X(r);
+					rays.direction[1][half*4+r]=dir.Y(r);
+					rays.direction[2][half*4+r]=dir.Z(r);
+				}
+			}
+			RayTracingResult8 tmpresult;
+			Trace8Rays(rays,tmin,tmax,msk,&tmpresult);
+			// now, write out results
+			for(int r=0;r<nvalid;r++)
+			{
+				RayTracingSingleResult *out=s.m_Rays[s.m_SortedRays[first+base+r]].pResult;
+				out->ray_length=tmax[r];
+				out->surface_normal.x=tmpresult.surface_normal[0][r];
+				out->surface_normal.y=tmpresult.surface_normal[1][r];
+				out->surface_normal.z=tmpresult.surface_normal[2][r];
+				out->HitID=tmpresult.HitIds[r];
+				out->HitDistance=tmpresult.HitDistance[r];
+			}
+		}
+		first+=cnt;
+	}
+
+	s.m_Rays.RemoveAll();
+	s.m_SortedRays.RemoveAll();
+	memset(s.m_nOctantCounts,0,sizeof(s.m_nOctantCounts));
+}
@@ -0,0 +1,367 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: 8-wide AVX2 ray tracing of the kd-tree.
+//
+// The AVX2 kernel is selected at runtime, so this file is not built with /arch:AVX2 (which would
+// also change codegen of inline SSE helpers shared with other files). MSVC allows AVX2 intrinsics
+// anyway, gcc and clang get a per function target attribute.
+//
+// The kernel mirrors Trace4Rays operation by operation (no FMA, same reciprocal refinement), so
+// it finds the same hits as the SSE tracer.
+//
+//=============================================================================//
+
+#include "raytrace.h"
+
+#include <immintrin.h>
+#include <cfloat>
+#include <cstring>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define RT_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define RT_AVX2_TARGET
+#endif
+
+#define MAILBOX_HASH_SIZE 256
+#define MAX_TREE_DEPTH 21
+#define MAX_NODE_STACK_LEN (40*MAX_TREE_DEPTH)
+
+static bool s_bAVX2TracingEnabled = GetCPUInformation()->m_bAVX2;
+
+
+int EightRays::CalculateDirectionSignMask(void) const
+{
+	// same as FourRays - only sign bits matter, so treat floats as integers.
+	int ret = 0;
+	for ( int c = 0; c < 3; c++ )
+	{
+		int32 ormask, andmask;
+		memcpy( &ormask, &direction[c][0], sizeof(ormask) );
+		andmask = ormask;
+
+		for ( int i = 1; i < 8; i++ )
+		{
+			int32 bits;
+			memcpy( &bits, &direction[c][i], sizeof(bits) );
+			ormask |= bits;
+			andmask &= bits;
+		}
+
+		if ( ormask < 0 )
+		{
+			if ( andmask >= 0 )
+				return -1;
+
+			ret |= 1 << c;
+		}
+	}
+	return ret;
+}
+
+
+bool RayTracingEnvironment::EnableAVX2Tracing( bool bEnable )
+{
+	bool bOld = s_bAVX2TracingEnabled;
+	s_bAVX2TracingEnabled = bEnable && GetCPUInformation()->m_bAVX2;
+	return bOld;
+}
+
+bool RayTracingEnvironment::IsAVX2TracingEnabled( void )
+{
+	return s_bAVX2TracingEnabled;
+}
+
+
+namespace
+{
+
+struct NodeToVisit8
+{
+	CacheOptimizedKDNode const *node;
+	__m256 TMin;
+	__m256 TMax;
+};
+
+RT_AVX2_TARGET FORCEINLINE __m256 Replicate8( float f )
+{
+	return _mm256_set1_ps( f );
+}
+
+RT_AVX2_TARGET FORCEINLINE bool IsAnyNegative8( __m256 a )
+{
+	return _mm256_movemask_ps( a ) != 0;
+}
+
+// Same as ReciprocalSaturateSIMD: 0 -> FLT_EPSILON, estimate and one newton iteration.
+RT_AVX2_TARGET FORCEINLINE __m256 ReciprocalSaturate8( __m256 a )
+{
+	__m256 zero_mask = _mm256_cmp_ps( a, _mm256_setzero_ps(), _CMP_EQ_OQ );
+	__m256 ret = _mm256_or_ps( a, _mm256_and_ps( Replicate8( FLT_EPSILON ), zero_mask ) );
+	__m256 est = _mm256_rcp_ps( ret );
+	return _mm256_sub_ps( _mm256_add_ps( est, est ), _mm256_mul_ps( ret, _mm256_mul_ps( est, est ) ) );
+}
+
+// a*b + c without FMA, like MaddSIMD.
+RT_AVX2_TARGET FORCEINLINE __m256 Madd8( __m256 a, __m256 b, __m256 c )
+{
+	return _mm256_add_ps( _mm256_mul_ps( a, b ), c );
+}
+
+RT_AVX2_TARGET FORCEINLINE __m256 Select8( __m256 old, __m256 value, __m256 mask )
+{
+	return _mm256_blendv_ps( old, value, mask );
+}
+
+struct Trace8State
+{
+	__m256 HitIds;
+	__m256 HitDistance;
+	__m256 Normal[3];
+};
+
+RT_AVX2_TARGET void Trace8RaysAVX2Impl( RayTracingEnvironment &env, const EightRays &rays,
+										const float *pTMin, const float *pTMax,
+										int DirectionSignMask, int32 skip_id, Trace8State &state )
+{
+	// FourZeros of Trace4Rays is epsilon as well.
+	const __m256 Epsilons = Replicate8( 1.0e-10f );
+	const __m256 NegativeEpsilons = Replicate8( -1.0e-10f );
+	const __m256 Ones = Replicate8( 1.0f );
+
+	state.HitIds = _mm256_castsi256_ps( _mm256_set1_epi32( -1 ) );
+	state.HitDistance = Replicate8( 1.0e23f );
+	state.Normal[0] = state.Normal[1] = state.Normal[2] = _mm256_setzero_ps();
+
+	__m256 Origin[3], Direction[3], OneOverRayDir[3];
+	for ( int c = 0; c < 3; c++ )
+	{
+		Origin[c] = _mm256_loadu_ps( rays.origin[c] );
+		Direction[c] = _mm256_loadu_ps( rays.direction[c] );
+		OneOverRayDir[c] = ReciprocalSaturate8( Direction[c] );
+	}
+
+	__m256 TMin = _mm256_loadu_ps( pTMin );
+	__m256 TMax = _mm256_loadu_ps( pTMax );
+
+	// now, clip rays against bounding box
+	for ( int c = 0; c < 3; c++ )
+	{
+		__m256 isect_min_t = _mm256_mul_ps( _mm256_sub_ps( Replicate8( env.m_MinBound[c] ), Origin[c] ), OneOverRayDir[c] );
+		__m256 isect_max_t = _mm256_mul_ps( _mm256_sub_ps( Replicate8( env.m_MaxBound[c] ), Origin[c] ), OneOverRayDir[c] );
+		TMin = _mm256_max_ps( TMin, _mm256_min_ps( isect_min_t, isect_max_t ) );
+		TMax = _mm256_min_ps( TMax, _mm256_max_ps( isect_min_t, isect_max_t ) );
+	}
+	__m256 active = _mm256_cmp_ps( TMin, TMax, _CMP_LE_OS );	// mask of which rays are active
+	if ( !IsAnyNegative8( active ) )
+		return;												// missed bounding box
+
+	int32 mailboxids[MAILBOX_HASH_SIZE];					// used to avoid redundant triangle tests
+	memset( mailboxids, 0xff, sizeof(mailboxids) );
+
+	int front_idx[3], back_idx[3];							// based on ray direction, whether to
+															// visit left or right node first
+	for ( int c = 0; c < 3; c++ )
+	{
+		back_idx[c] = ( DirectionSignMask & ( 1 << c ) ) ? 0 : 1;
+		front_idx[c] = 1 - back_idx[c];
+	}
+
+	NodeToVisit8 NodeQueue[MAX_NODE_STACK_LEN];
+	CacheOptimizedKDNode const *CurNode = &( env.OptimizedKDTree[0] );
+	NodeToVisit8 *stack_ptr = &NodeQueue[MAX_NODE_STACK_LEN];
+	while ( 1 )
+	{
+		while ( CurNode->NodeType() != KDNODE_STATE_LEAF )		// traverse until next leaf
+		{
+			int split_plane_number = CurNode->NodeType();
+			CacheOptimizedKDNode const *FrontChild = &( env.OptimizedKDTree[CurNode->LeftChild()] );
+
+			__m256 dist_to_sep_plane =						// dist=(split-org)/dir
+				_mm256_mul_ps(
+					_mm256_sub_ps( Replicate8( CurNode->SplittingPlaneValue ), Origin[split_plane_number] ),
+					OneOverRayDir[split_plane_number] );
+			active = _mm256_cmp_ps( TMin, TMax, _CMP_LE_OS );
+
+			// now, decide how to traverse children. can either do front,back, or do front and push
+			// back.
+			__m256 hits_front = _mm256_and_ps( active, _mm256_cmp_ps( dist_to_sep_plane, TMin, _CMP_GE_OS ) );
+			if ( !IsAnyNegative8( hits_front ) )
+			{
+				// missed the front. only traverse back
+				CurNode = FrontChild + back_idx[split_plane_number];
+				TMin = _mm256_max_ps( TMin, dist_to_sep_plane );
+			}
+			else
+			{
+				__m256 hits_back = _mm256_and_ps( active, _mm256_cmp_ps( dist_to_sep_plane, TMax, _CMP_LE_OS ) );
+				if ( !IsAnyNegative8( hits_back ) )
+				{
+					// missed the back - only need to traverse front node
+					CurNode = FrontChild + front_idx[split_plane_number];
+					TMax = _mm256_min_ps( TMax, dist_to_sep_plane );
+				}
+				else
+				{
+					// at least some rays hit both nodes.
+					// must push far, traverse near
+					Assert( stack_ptr > NodeQueue );
+					--stack_ptr;
+					stack_ptr->node = FrontChild + back_idx[split_plane_number];
+					stack_ptr->TMin = _mm256_max_ps( TMin, dist_to_sep_plane );
+					stack_ptr->TMax = TMax;
+					CurNode = FrontChild + front_idx[split_plane_number];
+					TMax = _mm256_min_ps( TMax, dist_to_sep_plane );
+				}
+			}
+		}
+		// hit a leaf! must do intersection check
+		int ntris = CurNode->NumberOfTrianglesInLeaf();
+		if ( ntris )
+		{
+			int32 const *tlist = &( env.TriangleIndexList[CurNode->TriangleIndexStart()] );
+			do
+			{
+				int tnum = *( tlist++ );
+				// check mailbox
+				int mbox_slot = tnum & ( MAILBOX_HASH_SIZE - 1 );
+				TriIntersectData_t const *tri = &( env.OptimizedTriangleList[tnum].m_Data.m_IntersectData );
+				if ( ( mailboxids[mbox_slot] == tnum ) || ( tri->m_nTriangleID == skip_id ) )
+					continue;
+
+				mailboxids[mbox_slot] = tnum;
+
+				// compute plane intersection
+				__m256 Nx = Replicate8( tri->m_flNx );
+				__m256 Ny = Replicate8( tri->m_flNy );
+				__m256 Nz = Replicate8( tri->m_flNz );
+
+				__m256 DDotN = _mm256_mul_ps( Direction[0], Nx );
+				DDotN = Madd8( Direction[1], Ny, DDotN );
+				DDotN = Madd8( Direction[2], Nz, DDotN );
+
+				// mask off zero or near zero (ray parallel to surface)
+				__m256 did_hit = _mm256_or_ps( _mm256_cmp_ps( DDotN, Epsilons, _CMP_GT_OS ),
+											   _mm256_cmp_ps( DDotN, NegativeEpsilons, _CMP_LT_OS ) );
+
+				__m256 ODotN = _mm256_mul_ps( Origin[0], Nx );
+				ODotN = Madd8( Origin[1], Ny, ODotN );
+				ODotN = Madd8( Origin[2], Nz, ODotN );
+
+				__m256 numerator = _mm256_sub_ps( Replicate8( tri->m_flD ), ODotN );
+
+				__m256 isect_t = _mm256_div_ps( numerator, DDotN );
+				// now, we have the distance to the plane. lets update our mask
+				did_hit = _mm256_and_ps( did_hit, _mm256_cmp_ps( isect_t, Epsilons, _CMP_GT_OS ) );
+				did_hit = _mm256_and_ps( did_hit, _mm256_cmp_ps( isect_t, state.HitDistance, _CMP_LT_OS ) );
+
+				if ( !IsAnyNegative8( did_hit ) )
+					continue;
+
+				// now, check 3 edges
+				__m256 hitc1 = Madd8( isect_t, Direction[tri->m_nCoordSelect0], Origin[tri->m_nCoordSelect0] );
+				__m256 hitc2 = Madd8( isect_t, Direction[tri->m_nCoordSelect1], Origin[tri->m_nCoordSelect1] );
+
+				// do barycentric coordinate check
+				__m256 B0 = _mm256_mul_ps( Replicate8( tri->m_ProjectedEdgeEquations[0] ), hitc1 );
+				B0 = Madd8( Replicate8( tri->m_ProjectedEdgeEquations[1] ), hitc2, B0 );
+				B0 = _mm256_add_ps( B0, Replicate8( tri->m_ProjectedEdgeEquations[2] ) );
+
+				did_hit = _mm256_and_ps( did_hit, _mm256_cmp_ps( B0, Epsilons, _CMP_GE_OS ) );
+
+				__m256 B1 = _mm256_mul_ps( Replicate8( tri->m_ProjectedEdgeEquations[3] ), hitc1 );
+				B1 = Madd8( Replicate8( tri->m_ProjectedEdgeEquations[4] ), hitc2, B1 );
+				B1 = _mm256_add_ps( B1, Replicate8( tri->m_ProjectedEdgeEquations[5] ) );
+
+				did_hit = _mm256_and_ps( did_hit, _mm256_cmp_ps( B1, Epsilons, _CMP_GE_OS ) );
+
+				__m256 B2 = _mm256_add_ps( B1, B0 );
+				did_hit = _mm256_and_ps( did_hit, _mm256_cmp_ps( B2, Ones, _CMP_LE_OS ) );
+
+				if ( !IsAnyNegative8( did_hit ) )
+					continue;
+
+				// now, set the hit_id and closest_hit fields for any enabled rays
+				state.HitIds = Select8( state.HitIds, _mm256_castsi256_ps( _mm256_set1_epi32( tnum ) ), did_hit );
+				state.HitDistance = Select8( state.HitDistance, isect_t, did_hit );
+				state.Normal[0] = Select8( state.Normal[0], Nx, did_hit );
+				state.Normal[1] = Select8( state.Normal[1], Ny, did_hit );
+				state.Normal[2] = Select8( state.Normal[2], Nz, did_hit );
+			} while ( --ntris );
+
+			// now, check if all rays have terminated
+			__m256 raydone = _mm256_cmp_ps( TMax, state.HitDistance, _CMP_LE_OS );
+			if ( !IsAnyNegative8( raydone ) )
+				return;
+		}
+
+		if ( stack_ptr == &NodeQueue[MAX_NODE_STACK_LEN] )
+			return;
+
+		// pop stack!
+		CurNode = stack_ptr->node;
+		TMin = stack_ptr->TMin;
+		TMax = stack_ptr->TMax;
+		stack_ptr++;
+	}
+}
+
+RT_AVX2_TARGET void Trace8RaysAVX2( RayTracingEnvironment &env, const EightRays &rays,
+									const float *pTMin, const float *pTMax,
+									int DirectionSignMask, RayTracingResult8 *rslt_out, int32 skip_id )
+{
+	Trace8State state;
+	Trace8RaysAVX2Impl( env, rays, pTMin, pTMax, DirectionSignMask, skip_id, state );
+
+	_mm256_storeu_si256( reinterpret_cast<__m256i *>( rslt_out->HitIds ), _mm256_castps_si256( state.HitIds ) );
+	_mm256_storeu_ps( rslt_out->HitDistance, state.HitDistance );
+	for ( int c = 0; c < 3; c++ )
+		_mm256_storeu_ps( rslt_out->surface_normal[c], state.Normal[c] );
+
+	// Avoid AVX to SSE transition penalty in callers.
+	_mm256_zeroupper();
+}
+
+}  // namespace
+
+
+void RayTracingEnvironment::Trace8Rays( const EightRays &rays, const float *TMin, const float *TMax,
+										int DirectionSignMask, RayTracingResult8 *rslt_out,
+										int32 skip_id )
+{
+	if ( s_bAVX2TracingEnabled )
+	{
+		Trace8RaysAVX2( *this, rays, TMin, TMax, DirectionSignMask, rslt_out, skip_id );
+		return;
+	}
+
+	// no AVX2, trace as two sets of 4.
+	for ( int half = 0; half < 2; half++ )
+	{
+		const int first = half * 4;
+
+		FourRays four;
+		for ( int i = 0; i < 4; i++ )
+		{
+			four.origin.X( i ) = rays.origin[0][first + i];
+			four.origin.Y( i ) = rays.origin[1][first + i];
+			four.origin.Z( i ) = rays.origin[2][first + i];
+			four.direction.X( i ) = rays.direction[0][first + i];
+			four.direction.Y( i ) = rays.direction[1][first + i];
+			four.direction.Z( i ) = rays.direction[2][first + i];
+		}
+
+		RayTracingResult result;
+		Trace4Rays( four, LoadUnalignedSIMD( TMin + first ), LoadUnalignedSIMD( TMax + first ),
+					DirectionSignMask, &result, skip_id );
+
+		for ( int i = 0; i < 4; i++ )
+		{
+			rslt_out->HitIds[first + i] = result.HitIds[i];
+			rslt_out->HitDistance[first + i] = SubFloat( result.HitDistance, i );
+			rslt_out->surface_normal[0][first + i] = result.surface_normal.X( i );
+			rslt_out->surface_normal[1][first + i] = result.surface_normal.Y( i );
+			rslt_out->surface_normal[2][first + i] = result.surface_normal.Z( i );
+		}
+	}
+}
@@ -300,6 +300,49 @@ bool CheckSSE42Technology( unsigned ecx )
 #endif
 }
 
+// Are AVX and YMM registers state saving by OS supported?
+bool CheckAVXTechnology( unsigned ecx )
+{
+#if defined( _PS3 )
+	return false;
+#else
+	// OSXSAVE (bit 27) and AVX (bit 28) of ECX.
+	constexpr unsigned kOsxsaveAndAvx{ ( 1U << 27U ) | ( 1U << 28U ) };
+	if ( ( ecx & kOsxsaveAndAvx ) != kOsxsaveAndAvx )
+		return false;
+
+	// XCR0 should have both XMM (bit 1) and YMM (bit 2) state enabled by OS.
+#if defined(_MSC_VER)
+	const unsigned long long xcr0{ _xgetbv( 0 ) };
+#else
+	unsigned int xcr0_lo, xcr0_hi;
+	__asm__ __volatile__( "xgetbv" : "=a"( xcr0_lo ), "=d"( xcr0_hi ) : "c"( 0 ) );
+	const unsigned long long xcr0{ ( static_cast<unsigned long long>( xcr0_hi ) << 32U ) | xcr0_lo };
+#endif
+
+	return ( xcr0 & 6U ) == 6U;
+#endif
+}
+
+bool CheckAVX2Technology( unsigned ecx )
+{
+#if defined( _PS3 )
+	return false;
+#else
+	if ( !CheckAVXTechnology( ecx ) )
+		return false;
+
+	unsigned int eax, ebx, unused;
+	if ( !cpuid( 0, eax, unused, unused, unused ) || eax < 7 )
+		return false;
+
+	if ( !cpuidex( 7, 0, eax, ebx, unused, unused ) )
+		return false;
+
+	return ( ebx & ( 1U << 5U ) ) != 0;	// bit 5 of EBX
+#endif
+}
+
 bool CheckSSE4aTechnology()
 {
 #if defined( _PS3 )
@@ -672,6 +715,8 @@ const CPUInformation* GetCPUInformation()
 	pi.m_bSSE4a           = CheckSSE4aTechnology();
 	pi.m_bSSE41           = CheckSSE41Technology( ecx );
 	pi.m_bSSE42           = CheckSSE42Technology( ecx );
+	pi.m_bAVX             = CheckAVXTechnology( ecx );
+	pi.m_bAVX2            = CheckAVX2Technology( ecx );
 	pi.m_szProcessorID    = GetProcessorVendorId();
 	pi.m_szProcessorBrand = GetProcessorBrand();
 
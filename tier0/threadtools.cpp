@@ -6,6 +6,7 @@
 
 #include "tier1/strtools.h"
 #include "tier0/dynfunction.h"
+#include "tier0/vprof_trace.h"
 #ifdef _WIN32
 	#include "winlite.h"
 	#include <process.h>
@@ -407,6 +408,8 @@ void ThreadSetDebugName( ThreadId_t id, const char *pszName )
 	TelemetryThreadSetDebugName( id, pszName );
 #endif
 
+	VProfTraceSetThreadName( id, pszName );
+
 #ifdef _WIN32
 	// dimhotepus: Always set thread debug name, not just for debug session.
 	{
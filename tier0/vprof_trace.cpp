@@ -0,0 +1,760 @@
+// Copyright Valve Corporation, All rights reserved.
+//
+// Purpose: Per-thread timeline of VProf scopes and jobs, exported as
+// Chrome trace-event JSON or Perfetto protobuf.
+
+#include "stdafx.h"
+
+#include "tier0/valve_off.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include "winlite.h"
+#elif defined( POSIX )
+#include <unistd.h>
+#endif
+
+#include "tier0/valve_on.h"
+#include "tier0/vprof_trace.h"
+#include "tier0/fasttimer.h"
+
+#include "tier0/memdbgon.h"
+
+// NOTE: Explicitly and intentionally using STL in here, like vprof.cpp, to not
+// depend on higher level data structures.
+
+bool g_bVProfTraceEnabled;
+
+namespace
+{
+
+enum VProfTraceEventType_t : uint8
+{
+	VPROF_TRACE_BEGIN,
+	VPROF_TRACE_END,
+};
+
+struct VProfTraceEvent_t
+{
+	uint64 m_nTimestamp;
+	const tchar *m_pszName;	// NULL when the name was copied into m_szName
+	char m_szName[31];
+	uint8 m_nType;
+
+	const char *GetName() const
+	{
+		return m_pszName ? m_pszName : m_szName;
+	}
+};
+
+static_assert( ( VPROF_TRACE_EVENTS_PER_THREAD & ( VPROF_TRACE_EVENTS_PER_THREAD - 1 ) ) == 0,
+	"VPROF_TRACE_EVENTS_PER_THREAD must be a power of two." );
+
+// Written only by its own thread.  Readers snapshot it and discard whatever the writer
+// may have overwritten while they copied.  m_nWritten keeps counting when a new thread
+// takes the buffer over, so snapshots never mistake the old owner's events for new ones.
+struct CVProfTraceBuffer
+{
+	ThreadId_t m_ThreadId;
+	uint64 m_nFirstEvent;	// m_nWritten when the current owner took the buffer over
+	uint32 m_nGeneration;	// Bumped on every takeover so each owner gets its own track
+	bool m_bExited;			// Owner is gone and the buffer can be taken over
+	std::atomic<uint64> m_nWritten;
+	VProfTraceEvent_t m_Events[VPROF_TRACE_EVENTS_PER_THREAD];
+};
+
+struct VProfTraceThreadName_t
+{
+	ThreadId_t m_ThreadId;
+	char m_szName[64];
+};
+
+// Guards buffer ownership and thread names.  Writers only take it when a thread gets
+// or gives up its buffer.
+CThreadFastMutex s_VProfTraceMutex;
+
+// Buffers are never freed.  An exited thread's buffer keeps its tail for dumps until
+// all VPROF_TRACE_MAX_THREADS are allocated and a new thread takes it over.
+CVProfTraceBuffer *s_pVProfTraceBuffers[VPROF_TRACE_MAX_THREADS];
+std::atomic<int> s_nVProfTraceBuffers;
+bool s_bVProfTraceBuffersFullWarned;
+
+VProfTraceThreadName_t s_VProfTraceThreadNames[VPROF_TRACE_MAX_THREADS];
+int s_nVProfTraceThreadNames;
+
+thread_local CVProfTraceBuffer *t_pVProfTraceBuffer;
+thread_local bool t_bVProfTraceBufferFailed;
+
+// Only touched when a thread gets its buffer, so the destructor's TLS guard stays off
+// the per-event path.
+struct CVProfTraceThreadExit
+{
+	~CVProfTraceThreadExit()
+	{
+		if ( m_pBuffer )
+		{
+			AUTO_LOCK( s_VProfTraceMutex );
+			m_pBuffer->m_bExited = true;
+		}
+
+		// Scopes traced by later TLS destructors must not take a buffer again.
+		t_pVProfTraceBuffer = NULL;
+		t_bVProfTraceBufferFailed = true;
+	}
+
+	CVProfTraceBuffer *m_pBuffer;
+};
+
+thread_local CVProfTraceThreadExit t_VProfTraceThreadExit;
+
+uint64 GetLastTraceTimestamp( const CVProfTraceBuffer *pBuffer )
+{
+	const uint64 nWritten = pBuffer->m_nWritten.load( std::memory_order_relaxed );
+	return nWritten > pBuffer->m_nFirstEvent
+		? pBuffer->m_Events[( nWritten - 1 ) & ( VPROF_TRACE_EVENTS_PER_THREAD - 1 )].m_nTimestamp
+		: 0;
+}
+
+// Takes over the exited thread's buffer whose last event is oldest.
+CVProfTraceBuffer *ReuseTraceBuffer()
+{
+	CVProfTraceBuffer *pBuffer = NULL;
+	uint64 nOldest = 0;
+	for ( int i = 0; i < VPROF_TRACE_MAX_THREADS; ++i )
+	{
+		CVProfTraceBuffer *pCandidate = s_pVProfTraceBuffers[i];
+		if ( !pCandidate->m_bExited )
+		{
+			continue;
+		}
+
+		const uint64 nLast = GetLastTraceTimestamp( pCandidate );
+		if ( !pBuffer || nLast < nOldest )
+		{
+			pBuffer = pCandidate;
+			nOldest = nLast;
+		}
+	}
+
+	if ( pBuffer )
+	{
+		pBuffer->m_nFirstEvent = pBuffer->m_nWritten.load( std::memory_order_relaxed );
+		++pBuffer->m_nGeneration;
+	}
+	return pBuffer;
+}
+
+CVProfTraceBuffer *CreateTraceBuffer()
+{
+	AUTO_LOCK( s_VProfTraceMutex );
+
+	CVProfTraceBuffer *pBuffer;
+	const int nBuffers = s_nVProfTraceBuffers.load( std::memory_order_relaxed );
+	if ( nBuffers == VPROF_TRACE_MAX_THREADS )
+	{
+		pBuffer = ReuseTraceBuffer();
+		if ( !pBuffer )
+		{
+			if ( !s_bVProfTraceBuffersFullWarned )
+			{
+				Warning( "VProf trace: %d threads are already tracing, new threads will not be traced.\n", VPROF_TRACE_MAX_THREADS );
+				s_bVProfTraceBuffersFullWarned = true;
+			}
+			t_bVProfTraceBufferFailed = true;
+			return NULL;
+		}
+		pBuffer->m_ThreadId = ThreadGetCurrentId();
+		pBuffer->m_bExited = false;
+	}
+	else
+	{
+		pBuffer = new CVProfTraceBuffer;
+		pBuffer->m_ThreadId = ThreadGetCurrentId();
+		pBuffer->m_nFirstEvent = 0;
+		pBuffer->m_nGeneration = 0;
+		pBuffer->m_bExited = false;
+		pBuffer->m_nWritten.store( 0, std::memory_order_relaxed );
+
+		s_pVProfTraceBuffers[nBuffers] = pBuffer;
+		s_nVProfTraceBuffers.store( nBuffers + 1, std::memory_order_release );
+	}
+
+	t_VProfTraceThreadExit.m_pBuffer = pBuffer;
+	t_pVProfTraceBuffer = pBuffer;
+	return pBuffer;
+}
+
+// Names of threads that still own a buffer are kept.  Used when the name table is full.
+bool IsTraceThreadLive( ThreadId_t id )
+{
+	const int nBuffers = s_nVProfTraceBuffers.load( std::memory_order_relaxed );
+	for ( int i = 0; i < nBuffers; ++i )
+	{
+		if ( s_pVProfTraceBuffers[i]->m_ThreadId == id && !s_pVProfTraceBuffers[i]->m_bExited )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+inline VProfTraceEvent_t *BeginTraceEvent( CVProfTraceBuffer **ppBuffer, uint64 *pnIndex )
+{
+	CVProfTraceBuffer *pBuffer = t_pVProfTraceBuffer;
+	if ( !pBuffer )
+	{
+		if ( t_bVProfTraceBufferFailed || ( pBuffer = CreateTraceBuffer() ) == NULL )
+		{
+			return NULL;
+		}
+	}
+
+	const uint64 nIndex = pBuffer->m_nWritten.load( std::memory_order_relaxed );
+	*ppBuffer = pBuffer;
+	*pnIndex = nIndex;
+	return &pBuffer->m_Events[nIndex & ( VPROF_TRACE_EVENTS_PER_THREAD - 1 )];
+}
+
+inline void EndTraceEvent( CVProfTraceBuffer *pBuffer, uint64 nIndex )
+{
+	pBuffer->m_nWritten.store( nIndex + 1, std::memory_order_release );
+}
+
+//-----------------------------------------------------------------------------
+// Export
+//-----------------------------------------------------------------------------
+
+struct VProfTraceThread_t
+{
+	ThreadId_t m_ThreadId;
+	uint64 m_nTrackUUID;
+	const char *m_pszName;
+	std::vector<VProfTraceEvent_t> m_Events;
+};
+
+class CVProfTraceWriter
+{
+public:
+	CVProfTraceWriter( VProfTraceWriteFunc_t pfnWrite, void *pContext )
+		: m_pfnWrite( pfnWrite ), m_pContext( pContext )
+	{
+	}
+
+	virtual ~CVProfTraceWriter() = default;
+
+	virtual void WriteHeader() = 0;
+	virtual void WriteThread( const VProfTraceThread_t &thread ) = 0;
+	virtual void WriteEvent( const VProfTraceThread_t &thread, uint8 nType, const char *pszName, uint64 nTimestamp ) = 0;
+	virtual void WriteFooter() = 0;
+
+	void Flush( bool bForce )
+	{
+		if ( !m_Buffer.empty() && ( bForce || m_Buffer.size() >= 64 * 1024 ) )
+		{
+			m_pfnWrite( m_Buffer.data(), m_Buffer.size(), m_pContext );
+			m_Buffer.clear();
+		}
+	}
+
+protected:
+	std::string m_Buffer;
+
+private:
+	VProfTraceWriteFunc_t m_pfnWrite;
+	void *m_pContext;
+};
+
+class CVProfTraceJSONWriter final : public CVProfTraceWriter
+{
+public:
+	CVProfTraceJSONWriter( VProfTraceWriteFunc_t pfnWrite, void *pContext, uint64 nBaseTimestamp, int nProcessId )
+		: CVProfTraceWriter( pfnWrite, pContext ), m_nBaseTimestamp( nBaseTimestamp ), m_nProcessId( nProcessId )
+	{
+	}
+
+	void WriteHeader() override
+	{
+		m_Buffer += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	}
+
+	void WriteThread( const VProfTraceThread_t &thread ) override
+	{
+		char szEvent[128];
+		snprintf( szEvent, sizeof( szEvent ), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%lu,\"args\":{\"name\":\"",
+			m_bFirst ? "\n" : ",\n", m_nProcessId, static_cast<unsigned long>( thread.m_ThreadId ) );
+		m_Buffer += szEvent;
+		AppendEscaped( thread.m_pszName );
+		m_Buffer += "\"}}";
+		m_bFirst = false;
+	}
+
+	void WriteEvent( const VProfTraceThread_t &thread, uint8 nType, const char *pszName, uint64 nTimestamp ) override
+	{
+		const double flMicroseconds = ( nTimestamp - m_nBaseTimestamp ) * g_ClockSpeedMicrosecondsMultiplier;
+
+		char szEvent[128];
+		snprintf( szEvent, sizeof( szEvent ), "%s{\"ph\":\"%c\",\"pid\":%d,\"tid\":%lu,\"ts\":%.3f",
+			m_bFirst ? "\n" : ",\n", nType == VPROF_TRACE_BEGIN ? 'B' : 'E', m_nProcessId,
+			static_cast<unsigned long>( thread.m_ThreadId ), flMicroseconds );
+		m_Buffer += szEvent;
+
+		if ( nType == VPROF_TRACE_BEGIN )
+		{
+			m_Buffer += ",\"name\":\"";
+			AppendEscaped( pszName );
+			m_Buffer += '"';
+		}
+		m_Buffer += '}';
+		m_bFirst = false;
+	}
+
+	void WriteFooter() override
+	{
+		m_Buffer += "\n]}\n";
+	}
+
+private:
+	void AppendEscaped( const char *pszString )
+	{
+		for ( const char *p = pszString; *p; ++p )
+		{
+			const unsigned char c = *p;
+			if ( c == '"' || c == '\\' )
+			{
+				m_Buffer += '\\';
+				m_Buffer += c;
+			}
+			else if ( c < 0x20 )
+			{
+				char szEscape[8];
+				snprintf( szEscape, sizeof( szEscape ), "\\u%04x", c );
+				m_Buffer += szEscape;
+			}
+			else
+			{
+				m_Buffer += c;
+			}
+		}
+	}
+
+	uint64 m_nBaseTimestamp;
+	int m_nProcessId;
+	bool m_bFirst{ true };
+};
+
+// Hand-rolled encoder for the handful of Perfetto trace fields used here, see
+// protos/perfetto/trace/trace_packet.proto and track_event/*.proto.
+class CVProfTracePerfettoWriter final : public CVProfTraceWriter
+{
+public:
+	CVProfTracePerfettoWriter( VProfTraceWriteFunc_t pfnWrite, void *pContext, uint64 nBaseTimestamp, int nProcessId )
+		: CVProfTraceWriter( pfnWrite, pContext ), m_nBaseTimestamp( nBaseTimestamp ), m_nProcessId( nProcessId )
+	{
+	}
+
+	void WriteHeader() override
+	{
+	}
+
+	void WriteThread( const VProfTraceThread_t &thread ) override
+	{
+		std::string threadDesc;
+		AppendVarIntField( threadDesc, THREAD_DESCRIPTOR_PID, static_cast<uint64>( m_nProcessId ) );
+		AppendVarIntField( threadDesc, THREAD_DESCRIPTOR_TID, static_cast<uint32>( thread.m_ThreadId ) );
+		AppendStringField( threadDesc, THREAD_DESCRIPTOR_THREAD_NAME, thread.m_pszName );
+
+		std::string trackDesc;
+		AppendVarIntField( trackDesc, TRACK_DESCRIPTOR_UUID, thread.m_nTrackUUID );
+		AppendBytesField( trackDesc, TRACK_DESCRIPTOR_THREAD, threadDesc );
+
+		std::string packet;
+		AppendBytesField( packet, TRACE_PACKET_TRACK_DESCRIPTOR, trackDesc );
+		WritePacket( packet );
+	}
+
+	void WriteEvent( const VProfTraceThread_t &thread, uint8 nType, const char *pszName, uint64 nTimestamp ) override
+	{
+		std::string trackEvent;
+		AppendVarIntField( trackEvent, TRACK_EVENT_TYPE, nType == VPROF_TRACE_BEGIN ? TYPE_SLICE_BEGIN : TYPE_SLICE_END );
+		AppendVarIntField( trackEvent, TRACK_EVENT_TRACK_UUID, thread.m_nTrackUUID );
+		if ( nType == VPROF_TRACE_BEGIN )
+		{
+			AppendStringField( trackEvent, TRACK_EVENT_NAME, pszName );
+		}
+
+		const double flNanoseconds = ( nTimestamp - m_nBaseTimestamp ) * g_ClockSpeedMicrosecondsMultiplier * 1000.0;
+
+		std::string packet;
+		AppendVarIntField( packet, TRACE_PACKET_TIMESTAMP, static_cast<uint64>( flNanoseconds ) );
+		AppendBytesField( packet, TRACE_PACKET_TRACK_EVENT, trackEvent );
+		WritePacket( packet );
+	}
+
+	void WriteFooter() override
+	{
+	}
+
+private:
+	enum
+	{
+		// Trace
+		TRACE_PACKET = 1,
+
+		// TracePacket
+		TRACE_PACKET_TIMESTAMP = 8,
+		TRACE_PACKET_TRUSTED_PACKET_SEQUENCE_ID = 10,
+		TRACE_PACKET_TRACK_EVENT = 11,
+		TRACE_PACKET_SEQUENCE_FLAGS = 13,
+		TRACE_PACKET_TRACK_DESCRIPTOR = 60,
+
+		// TracePacket.sequence_flags
+		SEQ_INCREMENTAL_STATE_CLEARED = 1,
+
+		// TrackDescriptor
+		TRACK_DESCRIPTOR_UUID = 1,
+		TRACK_DESCRIPTOR_THREAD = 4,
+
+		// ThreadDescriptor
+		THREAD_DESCRIPTOR_PID = 1,
+		THREAD_DESCRIPTOR_TID = 2,
+		THREAD_DESCRIPTOR_THREAD_NAME = 5,
+
+		// TrackEvent
+		TRACK_EVENT_TYPE = 9,
+		TRACK_EVENT_TRACK_UUID = 11,
+		TRACK_EVENT_NAME = 23,
+
+		// TrackEvent.Type
+		TYPE_SLICE_BEGIN = 1,
+		TYPE_SLICE_END = 2,
+	};
+
+	enum
+	{
+		WIRE_TYPE_VARINT = 0,
+		WIRE_TYPE_LENGTH_DELIMITED = 2,
+	};
+
+	static void AppendVarInt( std::string &out, uint64 nValue )
+	{
+		while ( nValue >= 0x80 )
+		{
+			out += static_cast<char>( ( nValue & 0x7f ) | 0x80 );
+			nValue >>= 7;
+		}
+		out += static_cast<char>( nValue );
+	}
+
+	static void AppendVarIntField( std::string &out, int nField, uint64 nValue )
+	{
+		AppendVarInt( out, ( nField << 3 ) | WIRE_TYPE_VARINT );
+		AppendVarInt( out, nValue );
+	}
+
+	static void AppendBytesField( std::string &out, int nField, const char *pData, size_t nBytes )
+	{
+		AppendVarInt( out, ( nField << 3 ) | WIRE_TYPE_LENGTH_DELIMITED );
+		AppendVarInt( out, nBytes );
+		out.append( pData, nBytes );
+	}
+
+	static void AppendBytesField( std::string &out, int nField, const std::string &message )
+	{
+		AppendBytesField( out, nField, message.data(), message.size() );
+	}
+
+	static void AppendStringField( std::string &out, int nField, const char *pszString )
+	{
+		AppendBytesField( out, nField, pszString, strlen( pszString ) );
+	}
+
+	void WritePacket( std::string &packet )
+	{
+		AppendVarIntField( packet, TRACE_PACKET_TRUSTED_PACKET_SEQUENCE_ID, 1 );
+		if ( m_bFirst )
+		{
+			AppendVarIntField( packet, TRACE_PACKET_SEQUENCE_FLAGS, SEQ_INCREMENTAL_STATE_CLEARED );
+			m_bFirst = false;
+		}
+		AppendBytesField( m_Buffer, TRACE_PACKET, packet );
+	}
+
+	uint64 m_nBaseTimestamp;
+	int m_nProcessId;
+	bool m_bFirst{ true };
+};
+
+// Copies whatever part of a thread's ring the writer can't have overwritten during the copy.
+// Called with s_VProfTraceMutex held so the buffer can't change owners underneath.
+void SnapshotTraceBuffer( const CVProfTraceBuffer *pBuffer, std::vector<VProfTraceEvent_t> &events )
+{
+	const uint64 nEnd = pBuffer->m_nWritten.load( std::memory_order_acquire );
+	const uint64 nStart = std::max( nEnd > VPROF_TRACE_EVENTS_PER_THREAD ? nEnd - VPROF_TRACE_EVENTS_PER_THREAD : 0,
+		pBuffer->m_nFirstEvent );
+
+	events.resize( static_cast<size_t>( nEnd - nStart ) );
+	for ( uint64 i = nStart; i < nEnd; ++i )
+	{
+		events[static_cast<size_t>( i - nStart )] = pBuffer->m_Events[i & ( VPROF_TRACE_EVENTS_PER_THREAD - 1 )];
+	}
+
+	// The writer may also be filling the slot after the last one it published.
+	const uint64 nEndAfterCopy = pBuffer->m_nWritten.load( std::memory_order_acquire ) + 1;
+	if ( nEndAfterCopy > VPROF_TRACE_EVENTS_PER_THREAD && nEndAfterCopy - VPROF_TRACE_EVENTS_PER_THREAD > nStart )
+	{
+		const uint64 nOverwritten = std::min( nEndAfterCopy - VPROF_TRACE_EVENTS_PER_THREAD, nEnd ) - nStart;
+		events.erase( events.begin(), events.begin() + static_cast<ptrdiff_t>( nOverwritten ) );
+	}
+
+	// A name copied while it was being written may be missing its terminator.
+	for ( VProfTraceEvent_t &event : events )
+	{
+		event.m_szName[sizeof( event.m_szName ) - 1] = '\0';
+	}
+}
+
+// Emits one thread's events from nCutoff on.  Slices still open at the cutoff are
+// reopened at it, ends whose begin fell out of the ring are dropped, and slices still
+// open at the end are closed at the thread's last event, so the output always nests.
+int WriteThreadEvents( CVProfTraceWriter &writer, const VProfTraceThread_t &thread, uint64 nCutoff )
+{
+	constexpr int MAX_DEPTH = 256;
+	const VProfTraceEvent_t *openEvents[MAX_DEPTH];
+	int nDepth = 0;
+	int nOverflowDepth = 0;
+	bool bInWindow = false;
+	int nWritten = 0;
+
+	for ( const VProfTraceEvent_t &event : thread.m_Events )
+	{
+		if ( !bInWindow && event.m_nTimestamp >= nCutoff )
+		{
+			for ( int i = 0; i < nDepth; ++i )
+			{
+				writer.WriteEvent( thread, VPROF_TRACE_BEGIN, openEvents[i]->GetName(), nCutoff );
+				++nWritten;
+			}
+			bInWindow = true;
+		}
+
+		if ( event.m_nType == VPROF_TRACE_BEGIN )
+		{
+			if ( nDepth == MAX_DEPTH )
+			{
+				++nOverflowDepth;
+				continue;
+			}
+			openEvents[nDepth++] = &event;
+		}
+		else
+		{
+			if ( nOverflowDepth )
+			{
+				--nOverflowDepth;
+				continue;
+			}
+			if ( !nDepth )
+			{
+				continue;
+			}
+			--nDepth;
+		}
+
+		if ( bInWindow )
+		{
+			writer.WriteEvent( thread, event.m_nType, event.GetName(), event.m_nTimestamp );
+			++nWritten;
+			writer.Flush( false );
+		}
+	}
+
+	if ( bInWindow )
+	{
+		const uint64 nLastTimestamp = thread.m_Events.back().m_nTimestamp;
+		while ( nDepth-- > 0 )
+		{
+			writer.WriteEvent( thread, VPROF_TRACE_END, NULL, nLastTimestamp );
+			++nWritten;
+		}
+	}
+
+	return nWritten;
+}
+
+int GetTraceProcessId()
+{
+#ifdef _WIN32
+	return static_cast<int>( GetCurrentProcessId() );
+#else
+	return static_cast<int>( getpid() );
+#endif
+}
+
+}  // namespace
+
+//-----------------------------------------------------------------------------
+
+void VProfTraceEnable( bool bEnable )
+{
+	g_bVProfTraceEnabled = bEnable;
+}
+
+void VProfTraceBegin( const tchar *pszName )
+{
+	CVProfTraceBuffer *pBuffer;
+	uint64 nIndex;
+	VProfTraceEvent_t *pEvent = BeginTraceEvent( &pBuffer, &nIndex );
+	if ( pEvent )
+	{
+		pEvent->m_nTimestamp = CCycleCount::GetTimestamp();
+		pEvent->m_pszName = pszName;
+		pEvent->m_nType = VPROF_TRACE_BEGIN;
+		EndTraceEvent( pBuffer, nIndex );
+	}
+}
+
+void VProfTraceBeginCopy( const char *pszName )
+{
+	CVProfTraceBuffer *pBuffer;
+	uint64 nIndex;
+	VProfTraceEvent_t *pEvent = BeginTraceEvent( &pBuffer, &nIndex );
+	if ( pEvent )
+	{
+		pEvent->m_nTimestamp = CCycleCount::GetTimestamp();
+		pEvent->m_pszName = NULL;
+		strncpy( pEvent->m_szName, pszName, sizeof( pEvent->m_szName ) - 1 );
+		pEvent->m_szName[sizeof( pEvent->m_szName ) - 1] = '\0';
+		pEvent->m_nType = VPROF_TRACE_BEGIN;
+		EndTraceEvent( pBuffer, nIndex );
+	}
+}
+
+void VProfTraceEnd()
+{
+	CVProfTraceBuffer *pBuffer;
+	uint64 nIndex;
+	VProfTraceEvent_t *pEvent = BeginTraceEvent( &pBuffer, &nIndex );
+	if ( pEvent )
+	{
+		pEvent->m_nTimestamp = CCycleCount::GetTimestamp();
+		pEvent->m_nType = VPROF_TRACE_END;
+		EndTraceEvent( pBuffer, nIndex );
+	}
+}
+
+void VProfTraceSetThreadName( ThreadId_t id, const char *pszName )
+{
+	if ( id == static_cast<ThreadId_t>( -1 ) )
+	{
+		id = ThreadGetCurrentId();
+	}
+
+	AUTO_LOCK( s_VProfTraceMutex );
+
+	int i = 0;
+	while ( i < s_nVProfTraceThreadNames && s_VProfTraceThreadNames[i].m_ThreadId != id )
+	{
+		++i;
+	}
+
+	if ( i == s_nVProfTraceThreadNames )
+	{
+		if ( s_nVProfTraceThreadNames < VPROF_TRACE_MAX_THREADS )
+		{
+			++s_nVProfTraceThreadNames;
+		}
+		else
+		{
+			i = 0;
+			while ( i < s_nVProfTraceThreadNames && IsTraceThreadLive( s_VProfTraceThreadNames[i].m_ThreadId ) )
+			{
+				++i;
+			}
+			if ( i == s_nVProfTraceThreadNames )
+			{
+				return;
+			}
+		}
+	}
+
+	VProfTraceThreadName_t &threadName = s_VProfTraceThreadNames[i];
+	threadName.m_ThreadId = id;
+	strncpy( threadName.m_szName, pszName, sizeof( threadName.m_szName ) - 1 );
+	threadName.m_szName[sizeof( threadName.m_szName ) - 1] = '\0';
+}
+
+int VProfTraceWrite( VProfTraceFormat_t format, double flSeconds, VProfTraceWriteFunc_t pfnWrite, void *pContext )
+{
+	const uint64 nNow = CCycleCount::GetTimestamp();
+	const uint64 nWindow = flSeconds > 0 && g_ClockSpeedSecondsMultiplier > 0
+		? static_cast<uint64>( flSeconds / g_ClockSpeedSecondsMultiplier )
+		: nNow;
+	const uint64 nCutoff = nWindow < nNow ? nNow - nWindow : 0;
+
+	const int nBuffers = s_nVProfTraceBuffers.load( std::memory_order_acquire );
+	std::vector<VProfTraceThread_t> threads( nBuffers );
+	std::vector<std::string> threadNames( nBuffers );
+
+	uint64 nBaseTimestamp = nNow;
+	{
+		AUTO_LOCK( s_VProfTraceMutex );
+
+		for ( int i = 0; i < nBuffers; ++i )
+		{
+			const CVProfTraceBuffer *pBuffer = s_pVProfTraceBuffers[i];
+			VProfTraceThread_t &thread = threads[i];
+			thread.m_ThreadId = pBuffer->m_ThreadId;
+			// Thread ids and buffers get reused, so key tracks by buffer and owner too.
+			thread.m_nTrackUUID = ( static_cast<uint64>( pBuffer->m_nGeneration ) << 40 ) |
+				( static_cast<uint64>( i + 1 ) << 32 ) | static_cast<uint32>( thread.m_ThreadId );
+			SnapshotTraceBuffer( pBuffer, thread.m_Events );
+
+			// Slices open at the cutoff are reopened at it, so no thread starts earlier.
+			if ( !thread.m_Events.empty() && thread.m_Events.back().m_nTimestamp >= nCutoff )
+			{
+				nBaseTimestamp = std::min( nBaseTimestamp, std::max( thread.m_Events.front().m_nTimestamp, nCutoff ) );
+			}
+
+			char szName[64];
+			snprintf( szName, sizeof( szName ), "Thread %lu", static_cast<unsigned long>( thread.m_ThreadId ) );
+			threadNames[i] = szName;
+
+			for ( int j = 0; j < s_nVProfTraceThreadNames; ++j )
+			{
+				if ( s_VProfTraceThreadNames[j].m_ThreadId == thread.m_ThreadId )
+				{
+					threadNames[i] = s_VProfTraceThreadNames[j].m_szName;
+					break;
+				}
+			}
+			thread.m_pszName = threadNames[i].c_str();
+		}
+	}
+
+	const int nProcessId = GetTraceProcessId();
+	CVProfTraceJSONWriter jsonWriter( pfnWrite, pContext, nBaseTimestamp, nProcessId );
+	CVProfTracePerfettoWriter perfettoWriter( pfnWrite, pContext, nBaseTimestamp, nProcessId );
+	CVProfTraceWriter &writer = format == VPROF_TRACE_FORMAT_PERFETTO
+		? static_cast<CVProfTraceWriter &>( perfettoWriter )
+		: static_cast<CVProfTraceWriter &>( jsonWriter );
+
+	int nWritten = 0;
+	writer.WriteHeader();
+	for ( const VProfTraceThread_t &thread : threads )
+	{
+		if ( thread.m_Events.empty() || thread.m_Events.back().m_nTimestamp < nCutoff )
+		{
+			continue;
+		}
+		writer.WriteThread( thread );
+		nWritten += WriteThreadEvents( writer, thread, nCutoff );
+	}
+	writer.WriteFooter();
+	writer.Flush( true );
+
+	return nWritten;
+}
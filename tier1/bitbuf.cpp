@@ -69,11 +69,6 @@ BitBufErrorHandler SetBitBufErrorHandler( BitBufErrorHandler fn )
 
 unsigned g_LittleBits[CHAR_BIT * sizeof(uint32)];
 
-// Precalculated bit masks for WriteUBitLong. Using these tables instead of 
-// doing the calculations gives a 33% speedup in WriteUBitLong.
-static unsigned g_BitWriteMasks[CHAR_BIT * sizeof(uint32)]
-                               [CHAR_BIT * sizeof(uint32) + 1];
-
 // (1 << i) - 1
 unsigned g_ExtraMasks[CHAR_BIT * sizeof(uint32) + 1];
 
@@ -82,18 +77,6 @@ class CBitWriteMasksInit
 public:
 	CBitWriteMasksInit()
 	{
-		for ( unsigned startbit=0; startbit < CHAR_BIT * sizeof(uint32); startbit++ )
-		{
-			for ( unsigned nBitsLeft=0; nBitsLeft < std::size(g_BitWriteMasks[0]); nBitsLeft++ )
-			{
-				unsigned endbit = startbit + nBitsLeft;
-				g_BitWriteMasks[startbit][nBitsLeft] = BitForBitnum(startbit) - 1;
-
-				if (endbit < CHAR_BIT * sizeof(uint32))
-					g_BitWriteMasks[startbit][nBitsLeft] |= ~(BitForBitnum(endbit) - 1);
-			}
-		}
-
 		for ( unsigned maskBit=0; maskBit < CHAR_BIT * sizeof(uint32); maskBit++ )
 			g_ExtraMasks[maskBit] = BitForBitnum(maskBit) - 1;
 
@@ -106,6 +89,107 @@ public:
 static CBitWriteMasksInit g_BitWriteMasksInit;
 
 
+// ---------------------------------------------------------------------------------------- //
+// Bulk bit copies
+// ---------------------------------------------------------------------------------------- //
+
+namespace
+{
+
+#if BITBUF_64BIT_WINDOWS
+using BitWindow = uint64;
+#else
+using BitWindow = uint32;
+#endif
+
+// Bits a window loaded from the byte holding the first bit always covers.
+constexpr int kBitWindowChunkBits = CHAR_BIT * ( sizeof(BitWindow) - 1 );
+
+// Near the end of the buffer only the bytes left are touched.
+[[nodiscard]] inline BitWindow LoadBitWindow( const unsigned char *pData, intp nBytes, intp iByte )
+{
+	BitWindow window = 0;
+	if ( iByte + (intp)sizeof(window) <= nBytes )
+		memcpy( &window, pData + iByte, sizeof(window) );
+	else
+		memcpy( &window, pData + iByte, static_cast<size_t>( nBytes - iByte ) );
+	return window;
+}
+
+inline void StoreBitWindow( unsigned char *pData, intp nBytes, intp iByte, BitWindow window )
+{
+	if ( iByte + (intp)sizeof(window) <= nBytes )
+		memcpy( pData + iByte, &window, sizeof(window) );
+	else
+		memcpy( pData + iByte, &window, static_cast<size_t>( nBytes - iByte ) );
+}
+
+// Copies up to kBitWindowChunkBits bits with one load and one load and store.
+inline void CopyBitChunk( unsigned char *pOut, intp nOutBytes, intp iOutBit, const unsigned char *pIn, intp nInBytes, intp iInBit, int nBits )
+{
+	Assert( nBits > 0 && nBits <= kBitWindowChunkBits );
+
+	const BitWindow value = LoadBitWindow( pIn, nInBytes, iInBit >> 3 ) >> ( iInBit & 7 );
+
+	const unsigned iShift = iOutBit & 7;
+	const BitWindow mask = ( ( BitWindow{1} << nBits ) - 1 ) << iShift;
+
+	BitWindow window = LoadBitWindow( pOut, nOutBytes, iOutBit >> 3 );
+	window ^= mask & ( ( value << iShift ) ^ window );
+	StoreBitWindow( pOut, nOutBytes, iOutBit >> 3, window );
+}
+
+}  // namespace
+
+void bitbuf::CopyBits( void *pOut, intp iOutBit, intp nOutBytes, const void *pIn, intp iInBit, intp nInBytes, intp nBits )
+{
+	Assert( nBits >= 0 );
+	Assert( iOutBit + nBits <= nOutBytes * CHAR_BIT && iInBit + nBits <= nInBytes * CHAR_BIT );
+
+	auto *pOutBytes = static_cast<unsigned char *>( pOut );
+	const auto *pInBytes = static_cast<const unsigned char *>( pIn );
+
+#ifdef VALVE_BIG_ENDIAN
+	for ( ; nBits > 0; --nBits, ++iOutBit, ++iInBit )
+	{
+		const unsigned char bit = 1u << ( iOutBit & 7 );
+		if ( pInBytes[iInBit >> 3] & ( 1u << ( iInBit & 7 ) ) )
+			pOutBytes[iOutBit >> 3] |= bit;
+		else
+			pOutBytes[iOutBit >> 3] &= ~bit;
+	}
+#else
+	// Same bit within a byte on both sides, so whole bytes in between can be memcpy'd.
+	if ( ( ( iOutBit ^ iInBit ) & 7 ) == 0 && nBits >= 2 * kBitWindowChunkBits )
+	{
+		const int nHeadBits = static_cast<int>( -iOutBit & 7 );
+		if ( nHeadBits )
+		{
+			CopyBitChunk( pOutBytes, nOutBytes, iOutBit, pInBytes, nInBytes, iInBit, nHeadBits );
+			iOutBit += nHeadBits;
+			iInBit += nHeadBits;
+			nBits -= nHeadBits;
+		}
+
+		const intp nBytes = nBits >> 3;
+		memcpy( pOutBytes + ( iOutBit >> 3 ), pInBytes + ( iInBit >> 3 ), static_cast<size_t>( nBytes ) );
+		iOutBit += nBytes * CHAR_BIT;
+		iInBit += nBytes * CHAR_BIT;
+		nBits -= nBytes * CHAR_BIT;
+	}
+
+	while ( nBits > 0 )
+	{
+		const int nChunkBits = static_cast<int>( min( nBits, (intp)kBitWindowChunkBits ) );
+		CopyBitChunk( pOutBytes, nOutBytes, iOutBit, pInBytes, nInBytes, iInBit, nChunkBits );
+		iOutBit += nChunkBits;
+		iInBit += nChunkBits;
+		nBits -= nChunkBits;
+	}
+#endif
+}
+
+
 // ---------------------------------------------------------------------------------------- //
 // bf_write
 // ---------------------------------------------------------------------------------------- //
@@ -209,6 +293,39 @@ void bf_write::WriteSBitLong( int32 data, int numbits )
 
 void bf_write::WriteVarInt32( uint32 data )
 {
+#if BITBUF_64BIT_WINDOWS
+	// Encode in a register and store it through one window, aligned or not.
+	const intp iByte = m_iCurBit >> 3;
+	if ( m_iCurBit + (intp)bitbuf::kMaxVarint32Bytes * CHAR_BIT <= m_nDataBits &&
+		iByte + (intp)sizeof(uint64) <= m_nDataBytes )
+	{
+		const int nBits = ByteSizeVarInt32( data ) * CHAR_BIT;
+
+#if BITBUF_BMI2
+		uint64 encoded = _pdep_u64( data, 0x0000007F7F7F7F7Full );
+#else
+		uint64 encoded = ( data & 0x7Fu ) |
+			( uint64{ data & ( 0x7Fu << 7 ) } << 1 ) |
+			( uint64{ data & ( 0x7Fu << 14 ) } << 2 ) |
+			( uint64{ data & ( 0x7Fu << 21 ) } << 3 ) |
+			( uint64{ data & ( 0xFu << 28 ) } << 4 );
+#endif
+		// Continuation bit on every byte but the last.
+		encoded |= 0x0000008080808080ull & bitbuf::LowBits64( ~uint64{0}, nBits - CHAR_BIT );
+
+		const unsigned iShift = m_iCurBit & 7;
+		const uint64 mask = bitbuf::LowBits64( ~uint64{0}, nBits ) << iShift;
+
+		byte *pOut = (byte*)m_pData + iByte;
+		uint64 window = bitbuf::LoadWindow64( pOut );
+		window ^= mask & ( ( encoded << iShift ) ^ window );
+		bitbuf::StoreWindow64( pOut, window );
+
+		m_iCurBit += nBits;
+		return;
+	}
+#endif
+
 	// Check if align and we have room, slow path if not
 	if ( (m_iCurBit & 7) == 0 && (m_iCurBit + (intp)bitbuf::kMaxVarint32Bytes * CHAR_BIT ) <= m_nDataBits)
 	{
@@ -437,9 +554,6 @@ bool bf_write::WriteBits(const void *pInData, intp nBits)
 	VPROF( "bf_write::WriteBits" );
 #endif
 
-	const auto *pOut = (const unsigned char*)pInData;
-	intp nBitsLeft = nBits;
-
 	// Bounds checking..
 	if ( (m_iCurBit+nBits) > m_nDataBits )
 	{
@@ -448,73 +562,8 @@ bool bf_write::WriteBits(const void *pInData, intp nBits)
 		return false;
 	}
 
-	// Align output to dword boundary
-	while (((uintp)pOut & 3) != 0 && nBitsLeft >= CHAR_BIT)
-	{
-		WriteUBitLong( *pOut, CHAR_BIT, false );
-		++pOut;
-		nBitsLeft -= CHAR_BIT;
-	}
-	
-	if ( (nBitsLeft >= 32) && (m_iCurBit & 7) == 0 )
-	{
-		// current bit is byte aligned, do block copy
-		intp numbytes = nBitsLeft / CHAR_BIT; 
-		intp numbits = numbytes * CHAR_BIT;
-		
-		Q_memcpy( (char*)m_pData+(m_iCurBit>>3), pOut, numbytes );
-		pOut += numbytes;
-		nBitsLeft -= numbits;
-		m_iCurBit += numbits;
-	}
-
-	constexpr int kUint32Bits = CHAR_BIT * sizeof(uint32);
-
-	if ( nBitsLeft >= kUint32Bits )
-	{
-		unsigned iBitsRight = (m_iCurBit & 31);
-		unsigned iBitsLeft = kUint32Bits - iBitsRight;
-		unsigned bitMaskLeft = g_BitWriteMasks[iBitsRight][kUint32Bits];
-		unsigned bitMaskRight = g_BitWriteMasks[0][iBitsRight];
-
-		unsigned *pData = &m_pData[m_iCurBit>>5];
-
-		// Read dwords.
-		while ( nBitsLeft >= kUint32Bits )
-		{
-			uint32 curData = *(uint32 *)pOut;
-			pOut += sizeof(uint32);
-
-			*pData &= bitMaskLeft;
-			*pData |= curData << iBitsRight;
-
-			pData++; 
-
-			if ( iBitsLeft < kUint32Bits )
-			{
-				curData >>= iBitsLeft;
-				*pData &= bitMaskRight;
-				*pData |= curData;
-			}
-
-			nBitsLeft -= kUint32Bits;
-			m_iCurBit += kUint32Bits;
-		}
-	}
-
-	// write remaining bytes
-	while ( nBitsLeft >= CHAR_BIT )
-	{
-		WriteUBitLong( *pOut, CHAR_BIT, false );
-		++pOut;
-		nBitsLeft -= CHAR_BIT;
-	}
-	
-	// write remaining bits
-	if ( nBitsLeft )
-	{
-		WriteUBitLong( *pOut, static_cast<int>(nBitsLeft), false );
-	}
+	bitbuf::CopyBits( m_pData, m_iCurBit, m_nDataBytes, pInData, 0, BitByte( nBits ), nBits );
+	m_iCurBit += nBits;
 
 	return !IsOverflowed();
 }
@@ -522,16 +571,30 @@ bool bf_write::WriteBits(const void *pInData, intp nBits)
 
 bool bf_write::WriteBitsFromBuffer( bf_read *pIn, intp nBits )
 {
-	constexpr int kUint32Bits = CHAR_BIT * sizeof(uint32);
+	Assert( nBits >= 0 );
 
-	// This could be optimized a little by
-	while ( nBits > kUint32Bits )
+	// Both buffers are checked once for the whole run instead of once per dword.
+	if ( pIn->GetNumBitsLeft() < nBits )
 	{
-		WriteUBitLong( pIn->ReadUBitLong( kUint32Bits ), kUint32Bits );
-		nBits -= kUint32Bits;
+		pIn->m_iCurBit = pIn->m_nDataBits;
+		pIn->SetOverflowFlag();
+		CallErrorHandler( BITBUFERROR_BUFFER_OVERRUN, pIn->GetDebugName() );
+		return false;
 	}
 
-	WriteUBitLong( pIn->ReadUBitLong( static_cast<int>(nBits) ), static_cast<int>(nBits) );
+	if ( GetNumBitsLeft() < nBits )
+	{
+		m_iCurBit = m_nDataBits;
+		SetOverflowFlag();
+		CallErrorHandler( BITBUFERROR_BUFFER_OVERRUN, GetDebugName() );
+		pIn->m_iCurBit += nBits;
+		return false;
+	}
+
+	bitbuf::CopyBits( m_pData, m_iCurBit, m_nDataBytes, pIn->m_pData, pIn->m_iCurBit, pIn->m_nDataBytes, nBits );
+	m_iCurBit += nBits;
+	pIn->m_iCurBit += nBits;
+
 	return !IsOverflowed() && !pIn->IsOverflowed();
 }
 
@@ -888,6 +951,15 @@ void bf_read::ReadBits(void *pOutData, intp nBits)
 
 	uint8 *pOut = static_cast<uint8 *>(pOutData);
 	intp nBitsLeft = nBits;
+
+	if ( nBits > 0 && GetNumBitsLeft() >= nBits )
+	{
+		// Bits past nBits in the last byte are zeroed, as below.
+		pOut[ BitByte( nBits ) - 1 ] = 0;
+		bitbuf::CopyBits( pOut, 0, BitByte( nBits ), m_pData, m_iCurBit, m_nDataBytes, nBits );
+		m_iCurBit += nBits;
+		return;
+	}
 	
 	// align output to dword boundary
 	while( ((size_t)pOut & 3) != 0 && nBitsLeft >= CHAR_BIT )
@@ -1015,6 +1087,37 @@ int32 bf_read::ReadSBitLong( int numbits )
 
 uint32 bf_read::ReadVarInt32()
 {
+#if BITBUF_64BIT_WINDOWS
+	// All 5 bytes a varint32 may take are in one window, decode in a register.
+	const intp iByte = m_iCurBit >> 3;
+	if ( GetNumBitsLeft() >= bitbuf::kMaxVarint32Bytes * CHAR_BIT &&
+		iByte + (intp)sizeof(uint64) <= m_nDataBytes )
+	{
+		const uint64 window = bitbuf::LoadWindow64( m_pData + iByte ) >> ( m_iCurBit & 7 );
+
+#if BITBUF_BMI2
+		// The first byte without a continuation bit ends it, the 5th always does.
+		const uint64 stops = ( ~window & 0x0000008080808080ull ) | ( uint64{1} << 39 );
+		const int nBits = static_cast<int>( ( _tzcnt_u64( stops ) >> 3 ) + 1 ) * CHAR_BIT;
+		m_iCurBit += nBits;
+		return static_cast<uint32>( _pext_u64( bitbuf::LowBits64( window, nBits ), 0x0000007F7F7F7F7Full ) );
+#else
+		uint32 result = 0;
+		int count = 0;
+		uint64 b;
+		do
+		{
+			b = window >> ( CHAR_BIT * count );
+			result |= static_cast<uint32>( b & 0x7F ) << ( 7 * count );
+			++count;
+		} while ( ( b & 0x80 ) && count < bitbuf::kMaxVarint32Bytes );
+
+		m_iCurBit += count * CHAR_BIT;
+		return result;
+#endif
+	}
+#endif
+
 	uint32 result = 0;
 	int count = 0;
 	uint32 b;
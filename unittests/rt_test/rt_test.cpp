@@ -1,5 +1,8 @@
 // Copyright Valve Corporation, All rights reserved.
 
+#include <random>
+#include <vector>
+
 #include "tier0/platform.h"
 #include "tier0/progressbar.h"
 #include "bitmap/float_bm.h"
@@ -9,6 +12,114 @@
 #include "raytrace.h"
 #include "bitmap/tgawriter.h"
 
+namespace {
+
+struct TestRay {
+  Vector start;
+  Vector end;
+};
+
+bool IsSameHit(const RayTracingSingleResult &a,
+               const RayTracingSingleResult &b) {
+  // Hits past ray end depend on which rays are traced together.
+  const bool a_hit = a.HitID != -1 && a.HitDistance < a.ray_length;
+  const bool b_hit = b.HitID != -1 && b.HitDistance < b.ray_length;
+
+  if (a_hit != b_hit) return false;
+  if (!a_hit) return true;
+
+  // Ray which hits shared edge may report either triangle.
+  return a.HitID == b.HitID || a.HitDistance == b.HitDistance;
+}
+
+// Traces rays |passes_count| times through stream and returns rays per second.
+template <typename Stream>
+double TraceRays(RayTracingEnvironment &env, const std::vector<TestRay> &rays,
+                 std::vector<RayTracingSingleResult> &results,
+                 int passes_count) {
+  results.resize(rays.size());
+
+  const double start_time = Plat_FloatTime();
+  for (int pass = 0; pass < passes_count; pass++) {
+    Stream stream;
+    for (size_t i = 0; i < rays.size(); i++) {
+      env.AddToRayStream(stream, rays[i].start, rays[i].end, &results[i]);
+    }
+    env.FinishRayStream(stream);
+  }
+  const double elapsed = Plat_FloatTime() - start_time;
+
+  return passes_count * rays.size() / elapsed;
+}
+
+bool CheckSameHits(const char *name,
+                   const std::vector<RayTracingSingleResult> &expected,
+                   const std::vector<RayTracingSingleResult> &actual) {
+  size_t hits = 0, mismatches = 0;
+  for (size_t i = 0; i < expected.size(); i++) {
+    if (expected[i].HitID != -1 &&
+        expected[i].HitDistance < expected[i].ray_length)
+      hits++;
+    if (!IsSameHit(expected[i], actual[i])) mismatches++;
+  }
+
+  printf("%s: %zu hits, %zu mismatches of %zu rays - %s\n", name, hits,
+         mismatches, expected.size(), mismatches ? "FAILED" : "PASSED");
+  return mismatches == 0;
+}
+
+// Traces same random rays with SSE 4 wide, SSE and AVX2 8 wide packets, and
+// compares hits and rays per second.
+bool CompareTracers(RayTracingEnvironment &env) {
+  constexpr int kRaysCount = 1 << 18;
+  constexpr int kPassesCount = 4;
+
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> xz(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> above(0.5f, 1.5f);
+  std::uniform_real_distribution<float> terrain(-0.1f, 0.4f);
+
+  std::vector<TestRay> rays(kRaysCount);
+  for (size_t i = 0; i < rays.size(); i++) {
+    rays[i].start.Init(xz(rng), above(rng), xz(rng));
+    rays[i].end.Init(xz(rng), terrain(rng), xz(rng));
+
+    // Cover all direction octants.
+    if (i % 4 == 3) std::swap(rays[i].start, rays[i].end);
+  }
+
+  const bool was_avx2 = RayTracingEnvironment::EnableAVX2Tracing(false);
+
+  std::vector<RayTracingSingleResult> sse4, sse8, avx8;
+  const double sse4_rate = TraceRays<RayStream>(env, rays, sse4, kPassesCount);
+  const double sse8_rate =
+      TraceRays<SortedRayStream>(env, rays, sse8, kPassesCount);
+
+  printf("SSE stream rays per second := %f\n", sse4_rate);
+  printf("SSE sorted stream rays per second := %f\n", sse8_rate);
+
+  bool ok = CheckSameHits("SSE sorted stream", sse4, sse8);
+
+  RayTracingEnvironment::EnableAVX2Tracing(true);
+  if (RayTracingEnvironment::IsAVX2TracingEnabled()) {
+    const double avx8_rate =
+        TraceRays<SortedRayStream>(env, rays, avx8, kPassesCount);
+
+    printf("AVX2 sorted stream rays per second := %f (%.2fx)\n", avx8_rate,
+           avx8_rate / sse4_rate);
+
+    ok = CheckSameHits("AVX2 sorted stream", sse4, avx8) && ok;
+  } else {
+    printf("AVX2 is not supported, skipped AVX2 tracer\n");
+  }
+
+  RayTracingEnvironment::EnableAVX2Tracing(was_avx2);
+
+  return ok;
+}
+
+}  // namespace
+
 int main(int argc, char **argv) {
   InitCommandLineProgram(argc, argv);
 
@@ -69,6 +180,9 @@ int main(int argc, char **argv) {
   rt_Env.SetupAccelerationStructure();
   printf("kd built time := %d\n", (int)(Plat_FloatTime() - stime));
 
+  ReportProgress("Comparing tracers", 0, 0);
+  const bool tracers_ok = CompareTracers(rt_Env);
+
   rt_Env.AddInfinitePointLight(Vector(0, 5, 0), Vector(.1, .1, .1));
   // lets render a frame
   auto *buf =
@@ -93,5 +207,5 @@ int main(int argc, char **argv) {
 
   MemAlloc_FreeAligned(buf);
 
-  return 0;
+  return tracers_ok ? 0 : 1;
 }
@@ -0,0 +1,358 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Unit test program and benchmarks for bf_write / bf_read
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "unitlib/unitlib.h"
+#include "tier1/bitbuf.h"
+#include "tier0/fasttimer.h"
+#include "tier1/strtools.h"
+#include "tier0/dbg.h"
+
+
+DEFINE_TESTSUITE( BitBufTestSuite )
+
+// Deterministic so failures and timings are reproducible.
+static uint32 NextRandom( uint32 &seed )
+{
+	seed = seed * 1664525u + 1013904223u;
+	return seed;
+}
+
+static int ReferenceBit( const unsigned char *pData, intp iBit )
+{
+	return ( pData[iBit >> 3] >> ( iBit & 7 ) ) & 1;
+}
+
+static void ReferenceSetBit( unsigned char *pData, intp iBit, int nValue )
+{
+	if ( nValue )
+		pData[iBit >> 3] |= 1u << ( iBit & 7 );
+	else
+		pData[iBit >> 3] &= ~( 1u << ( iBit & 7 ) );
+}
+
+
+DEFINE_TESTCASE( BitBufTestUBitLong, BitBufTestSuite )
+{
+	Msg( "bf_write::WriteUBitLong / bf_read::ReadUBitLong test...\n" );
+
+	alignas(8) unsigned char data[256];
+	alignas(8) unsigned char reference[256];
+	uint32 seed = 1;
+
+	for ( int nPass = 0; nPass < 64; ++nPass )
+	{
+		memset( data, 0xCD, sizeof( data ) );
+		memcpy( reference, data, sizeof( reference ) );
+
+		int nStartBit = nPass;
+		bf_write buf( "BitBufTestUBitLong", data, sizeof( data ) );
+		buf.SeekToBit( nStartBit );
+
+		uint32 values[128];
+		int bits[128];
+		int nValues = 0;
+		intp iRefBit = nStartBit;
+
+		// Fill right up to the end so the last dwords take the tail path.
+		while ( nValues < 128 )
+		{
+			bits[nValues] = 1 + NextRandom( seed ) % 32;
+			if ( buf.GetNumBitsLeft() < bits[nValues] )
+				break;
+
+			values[nValues] = NextRandom( seed ) & ( bits[nValues] == 32 ? ~0u : ( 1u << bits[nValues] ) - 1 );
+			buf.WriteUBitLong( values[nValues], bits[nValues] );
+
+			for ( int i = 0; i < bits[nValues]; ++i )
+				ReferenceSetBit( reference, iRefBit++, ( values[nValues] >> i ) & 1 );
+
+			++nValues;
+		}
+
+		Shipping_Assert( !buf.IsOverflowed() );
+		Shipping_Assert( buf.GetNumBitsWritten() == iRefBit );
+		Shipping_Assert( !memcmp( data, reference, sizeof( data ) ) );
+
+		bf_read read( "BitBufTestUBitLong", data, sizeof( data ) );
+		read.Seek( nStartBit );
+		for ( int i = 0; i < nValues; ++i )
+		{
+			Shipping_Assert( read.ReadUBitLong( bits[i] ) == values[i] );
+		}
+		Shipping_Assert( !read.IsOverflowed() );
+	}
+}
+
+
+DEFINE_TESTCASE( BitBufTestVarInt, BitBufTestSuite )
+{
+	Msg( "bf_write::WriteVarInt32 / bf_read::ReadVarInt32 test...\n" );
+
+	alignas(8) unsigned char data[1024];
+	uint32 seed = 2;
+
+	for ( int nStartBit = 0; nStartBit < 8; ++nStartBit )
+	{
+		bf_write buf( "BitBufTestVarInt", data, sizeof( data ) );
+		buf.SeekToBit( nStartBit );
+
+		uint32 values[64];
+		for ( int i = 0; i < 64; ++i )
+		{
+			// All encoded lengths, including the ones written near the end of the buffer.
+			values[i] = NextRandom( seed ) >> ( NextRandom( seed ) % 32 );
+			buf.WriteVarInt32( values[i] );
+			buf.WriteSignedVarInt32( -(int32)values[i] );
+		}
+		Shipping_Assert( !buf.IsOverflowed() );
+
+		bf_read read( "BitBufTestVarInt", data, buf.GetNumBytesWritten(), buf.GetNumBitsWritten() );
+		read.Seek( nStartBit );
+		for ( int i = 0; i < 64; ++i )
+		{
+			Shipping_Assert( read.ReadVarInt32() == values[i] );
+			Shipping_Assert( read.ReadSignedVarInt32() == -(int32)values[i] );
+		}
+		Shipping_Assert( !read.IsOverflowed() );
+		Shipping_Assert( read.GetNumBitsLeft() == 0 );
+	}
+}
+
+
+DEFINE_TESTCASE( BitBufTestBulkCopy, BitBufTestSuite )
+{
+	Msg( "bf_write::WriteBitsFromBuffer / WriteBits / bf_read::ReadBits test...\n" );
+
+	alignas(8) unsigned char in[512];
+	alignas(8) unsigned char out[512];
+	alignas(8) unsigned char reference[512];
+	uint32 seed = 3;
+
+	for ( auto &b : in )
+		b = (unsigned char)NextRandom( seed );
+
+	for ( int nPass = 0; nPass < 4096; ++nPass )
+	{
+		memset( out, 0x5A, sizeof( out ) );
+		memcpy( reference, out, sizeof( reference ) );
+
+		const intp nBits = NextRandom( seed ) % ( 256 * CHAR_BIT );
+		const intp iInBit = NextRandom( seed ) % ( sizeof( in ) * CHAR_BIT - nBits + 1 );
+		const intp iOutBit = NextRandom( seed ) % ( sizeof( out ) * CHAR_BIT - nBits + 1 );
+
+		for ( intp i = 0; i < nBits; ++i )
+			ReferenceSetBit( reference, iOutBit + i, ReferenceBit( in, iInBit + i ) );
+
+		bf_read read( "BitBufTestBulkCopy", in, sizeof( in ) );
+		read.Seek( iInBit );
+		bf_write buf( "BitBufTestBulkCopy", out, sizeof( out ) );
+		buf.SeekToBit( iOutBit );
+
+		Shipping_Assert( buf.WriteBitsFromBuffer( &read, nBits ) );
+		Shipping_Assert( read.GetNumBitsRead() == iInBit + nBits );
+		Shipping_Assert( buf.GetNumBitsWritten() == iOutBit + nBits );
+		Shipping_Assert( !memcmp( out, reference, sizeof( out ) ) );
+
+		// Same bits again from a byte buffer.
+		alignas(8) unsigned char bytes[256 + 1];
+		read.Seek( iInBit );
+		read.ReadBits( bytes, nBits );
+		Shipping_Assert( !read.IsOverflowed() );
+
+		memset( out, 0x5A, sizeof( out ) );
+		buf.SeekToBit( iOutBit );
+		Shipping_Assert( buf.WriteBits( bytes, nBits ) );
+		Shipping_Assert( !memcmp( out, reference, sizeof( out ) ) );
+	}
+
+	// Overflowing copies fail without writing past either buffer.
+	bf_read read( "BitBufTestBulkCopy", in, 16 );
+	bf_write buf( "BitBufTestBulkCopy", out, sizeof( out ) );
+	buf.SetAssertOnOverflow( false );
+	read.SetAssertOnOverflow( false );
+	Shipping_Assert( !buf.WriteBitsFromBuffer( &read, 16 * CHAR_BIT + 1 ) );
+	Shipping_Assert( read.IsOverflowed() );
+}
+
+
+//-----------------------------------------------------------------------------
+// Benchmarks. Times are printed, not checked.
+//-----------------------------------------------------------------------------
+
+static constexpr int kBenchmarkPasses = 2000;
+
+static void ReportBenchmark( const char *pName, CFastTimer &timer, intp nOps )
+{
+	const double flMs = timer.GetDuration().GetMillisecondsF();
+	Msg( "  %-28s %8.2f ms, %6.2f ns/op\n", pName, flMs, nOps ? flMs * 1000000.0 / nOps : 0.0 );
+}
+
+DEFINE_TESTCASE( BitBufBenchmarkVarInt, BitBufTestSuite )
+{
+	Msg( "bf_write / bf_read varint benchmark...\n" );
+
+	alignas(8) static unsigned char data[4096];
+	uint32 values[512];
+	uint32 seed = 4;
+	for ( auto &v : values )
+		v = NextRandom( seed ) >> ( NextRandom( seed ) % 32 );
+
+	// Odd start bit so most varints are unaligned, as they are after prop indices.
+	CFastTimer timer;
+	timer.Start();
+	for ( int nPass = 0; nPass < kBenchmarkPasses; ++nPass )
+	{
+		bf_write buf( "BitBufBenchmarkVarInt", data, sizeof( data ) );
+		buf.WriteOneBit( 1 );
+		for ( auto v : values )
+			buf.WriteVarInt32( v );
+	}
+	timer.End();
+	ReportBenchmark( "WriteVarInt32", timer, kBenchmarkPasses * ssize( values ) );
+
+	uint32 sum = 0;
+	timer.Start();
+	for ( int nPass = 0; nPass < kBenchmarkPasses; ++nPass )
+	{
+		bf_read read( "BitBufBenchmarkVarInt", data, sizeof( data ) );
+		read.Seek( 1 );
+		for ( intp i = 0; i < ssize( values ); ++i )
+			sum += read.ReadVarInt32();
+	}
+	timer.End();
+	ReportBenchmark( "ReadVarInt32", timer, kBenchmarkPasses * ssize( values ) );
+
+	Shipping_Assert( sum != 0 );
+}
+
+DEFINE_TESTCASE( BitBufBenchmarkCoord, BitBufTestSuite )
+{
+	Msg( "bf_write / bf_read coord benchmark...\n" );
+
+	alignas(8) static unsigned char data[8192];
+	Vector values[512];
+	uint32 seed = 5;
+	for ( auto &v : values )
+	{
+		for ( int i = 0; i < 3; ++i )
+			v[i] = (float)( (int)( NextRandom( seed ) % 65536 ) - 32768 ) / 8.0f;
+	}
+
+	CFastTimer timer;
+	timer.Start();
+	for ( int nPass = 0; nPass < kBenchmarkPasses; ++nPass )
+	{
+		bf_write buf( "BitBufBenchmarkCoord", data, sizeof( data ) );
+		for ( const auto &v : values )
+			buf.WriteBitVec3Coord( v );
+	}
+	timer.End();
+	ReportBenchmark( "WriteBitVec3Coord", timer, kBenchmarkPasses * ssize( values ) );
+
+	Vector sum( 0, 0, 0 );
+	timer.Start();
+	for ( int nPass = 0; nPass < kBenchmarkPasses; ++nPass )
+	{
+		bf_read read( "BitBufBenchmarkCoord", data, sizeof( data ) );
+		for ( intp i = 0; i < ssize( values ); ++i )
+		{
+			Vector v;
+			read.ReadBitVec3Coord( v );
+			sum += v;
+		}
+	}
+	timer.End();
+	ReportBenchmark( "ReadBitVec3Coord", timer, kBenchmarkPasses * ssize( values ) );
+
+	Shipping_Assert( sum.IsValid() );
+}
+
+DEFINE_TESTCASE( BitBufBenchmarkNormal, BitBufTestSuite )
+{
+	Msg( "bf_write / bf_read normal benchmark...\n" );
+
+	alignas(8) static unsigned char data[4096];
+	Vector values[512];
+	uint32 seed = 6;
+	for ( auto &v : values )
+	{
+		for ( int i = 0; i < 3; ++i )
+			v[i] = (float)( (int)( NextRandom( seed ) % 2001 ) - 1000 );
+		VectorNormalize( v );
+	}
+
+	CFastTimer timer;
+	timer.Start();
+	for ( int nPass = 0; nPass < kBenchmarkPasses; ++nPass )
+	{
+		bf_write buf( "BitBufBenchmarkNormal", data, sizeof( data ) );
+		for ( const auto &v : values )
+			buf.WriteBitVec3Normal( v );
+	}
+	timer.End();
+	ReportBenchmark( "WriteBitVec3Normal", timer, kBenchmarkPasses * ssize( values ) );
+
+	Vector sum( 0, 0, 0 );
+	timer.Start();
+	for ( int nPass = 0; nPass < kBenchmarkPasses; ++nPass )
+	{
+		bf_read read( "BitBufBenchmarkNormal", data, sizeof( data ) );
+		for ( intp i = 0; i < ssize( values ); ++i )
+		{
+			Vector v;
+			read.ReadBitVec3Normal( v );
+			sum += v;
+		}
+	}
+	timer.End();
+	ReportBenchmark( "ReadBitVec3Normal", timer, kBenchmarkPasses * ssize( values ) );
+
+	Shipping_Assert( sum.IsValid() );
+}
+
+DEFINE_TESTCASE( BitBufBenchmarkBulkCopy, BitBufTestSuite )
+{
+	Msg( "bf_write::WriteBitsFromBuffer benchmark...\n" );
+
+	alignas(8) static unsigned char in[4096];
+	alignas(8) static unsigned char out[4096];
+	uint32 seed = 7;
+	for ( auto &b : in )
+		b = (unsigned char)NextRandom( seed );
+
+	// Prop sized runs as copied by SendTable_WritePropList, then whole packets.
+	const int runBits[] = { 7, 33, 96, 1024, 8 * 1024 };
+	for ( int nRunBits : runBits )
+	{
+		for ( int nPhase = 0; nPhase < 2; ++nPhase )
+		{
+			intp nOps = 0;
+
+			CFastTimer timer;
+			timer.Start();
+			for ( int nPass = 0; nPass < kBenchmarkPasses; ++nPass )
+			{
+				bf_read read( "BitBufBenchmarkBulkCopy", in, sizeof( in ) );
+				bf_write buf( "BitBufBenchmarkBulkCopy", out, sizeof( out ) );
+				// Same bit phase on both sides, or off by 3 bits.
+				read.Seek( 5 );
+				buf.SeekToBit( nPhase ? 2 : 5 );
+
+				while ( read.GetNumBitsLeft() >= nRunBits && buf.GetNumBitsLeft() >= nRunBits )
+				{
+					buf.WriteBitsFromBuffer( &read, nRunBits );
+					++nOps;
+				}
+			}
+			timer.End();
+
+			char name[64];
+			V_sprintf_safe( name, "%d bit runs, %s", nRunBits, nPhase ? "unaligned" : "same phase" );
+			ReportBenchmark( name, timer, nOps );
+		}
+	}
+}
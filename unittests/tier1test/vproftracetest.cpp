@@ -0,0 +1,120 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Unit test program for the VProf timeline trace export
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "unitlib/unitlib.h"
+#include "tier0/vprof_trace.h"
+#include "tier0/threadtools.h"
+#include "tier1/utlbuffer.h"
+#include "tier1/strtools.h"
+#include "tier0/dbg.h"
+
+
+DEFINE_TESTSUITE( VProfTraceTestSuite )
+
+static void WriteToUtlBuffer( const void *pData, size_t nBytes, void *pContext )
+{
+	static_cast<CUtlBuffer *>( pContext )->Put( pData, static_cast<intp>( nBytes ) );
+}
+
+static int CountOccurrences( const char *pszText, const char *pszNeedle )
+{
+	int nCount = 0;
+	const intp nNeedle = V_strlen( pszNeedle );
+	for ( const char *p = V_strstr( pszText, pszNeedle ); p; p = V_strstr( p + nNeedle, pszNeedle ) )
+	{
+		++nCount;
+	}
+	return nCount;
+}
+
+static unsigned TraceWorkerThread( void * )
+{
+	ThreadSetDebugName( "VProfTraceTestWorker" );
+
+	for ( int i = 0; i < 100; ++i )
+	{
+		CVProfTraceScope outer( "VProfTraceTestJob" );
+		VProfTraceBegin( "VProfTraceTestInner" );
+		VProfTraceEnd();
+	}
+	return 0;
+}
+
+
+DEFINE_TESTCASE( VProfTraceTestJSON, VProfTraceTestSuite )
+{
+	Msg( "VProf trace JSON export test...\n" );
+
+	const bool bWasEnabled = VProfTraceIsEnabled();
+	VProfTraceEnable( true );
+
+	// Left open on purpose: the export must still close it.
+	VProfTraceBegin( "VProfTraceTestOpen" );
+
+	ThreadHandle_t hThread = CreateSimpleThread( TraceWorkerThread, NULL );
+	ThreadJoin( hThread );
+	ReleaseThreadHandle( hThread );
+
+	CUtlBuffer buf( 0, 0, CUtlBuffer::TEXT_BUFFER );
+	const int nEvents = VProfTraceWrite( VPROF_TRACE_FORMAT_JSON, 0, WriteToUtlBuffer, &buf );
+	buf.PutChar( '\0' );
+
+	VProfTraceEnd();
+	VProfTraceEnable( bWasEnabled );
+
+	const char *pszJSON = static_cast<const char *>( buf.Base() );
+	Shipping_Assert( nEvents >= 402 );
+	Shipping_Assert( !V_strncmp( pszJSON, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 39 ) );
+	Shipping_Assert( CountOccurrences( pszJSON, "\"name\":\"VProfTraceTestJob\"" ) == 100 );
+	Shipping_Assert( CountOccurrences( pszJSON, "\"name\":\"VProfTraceTestInner\"" ) == 100 );
+	Shipping_Assert( CountOccurrences( pszJSON, "\"name\":\"VProfTraceTestOpen\"" ) >= 1 );
+	Shipping_Assert( V_strstr( pszJSON, "\"args\":{\"name\":\"VProfTraceTestWorker\"}" ) );
+
+	// Every begin is matched by an end, including the slice still open at export.
+	Shipping_Assert( CountOccurrences( pszJSON, "\"ph\":\"B\"" ) == CountOccurrences( pszJSON, "\"ph\":\"E\"" ) );
+}
+
+static unsigned TraceShortLivedThread( void *pContext )
+{
+	char szName[32];
+	V_snprintf( szName, sizeof( szName ), "VProfTraceTestShort%d", static_cast<int>( reinterpret_cast<intp>( pContext ) ) );
+	VProfTraceBeginCopy( szName );
+	VProfTraceEnd();
+	return 0;
+}
+
+
+DEFINE_TESTCASE( VProfTraceTestThreadReuse, VProfTraceTestSuite )
+{
+	Msg( "VProf trace buffer reuse test...\n" );
+
+	const bool bWasEnabled = VProfTraceIsEnabled();
+	VProfTraceEnable( true );
+
+	// More threads than buffers, one at a time, so exited threads' buffers get taken over.
+	const int nThreads = 2 * VPROF_TRACE_MAX_THREADS;
+	for ( int i = 0; i < nThreads; ++i )
+	{
+		ThreadHandle_t hThread = CreateSimpleThread( TraceShortLivedThread, reinterpret_cast<void *>( static_cast<intp>( i ) ) );
+		ThreadJoin( hThread );
+		ReleaseThreadHandle( hThread );
+	}
+
+	CUtlBuffer buf( 0, 0, CUtlBuffer::TEXT_BUFFER );
+	VProfTraceWrite( VPROF_TRACE_FORMAT_JSON, 0, WriteToUtlBuffer, &buf );
+	buf.PutChar( '\0' );
+
+	VProfTraceEnable( bWasEnabled );
+
+	char szLast[64];
+	V_snprintf( szLast, sizeof( szLast ), "\"name\":\"VProfTraceTestShort%d\"", nThreads - 1 );
+
+	const char *pszJSON = static_cast<const char *>( buf.Base() );
+	Shipping_Assert( CountOccurrences( pszJSON, szLast ) == 1 );
+	Shipping_Assert( CountOccurrences( pszJSON, "\"name\":\"VProfTraceTestShort0\"" ) == 0 );
+	Shipping_Assert( CountOccurrences( pszJSON, "\"ph\":\"B\"" ) == CountOccurrences( pszJSON, "\"ph\":\"E\"" ) );
+}
@@ -0,0 +1,274 @@
+// Copyright Valve Corporation, All rights reserved.
+//
+// Dependency driven job graph for tools.
+
+#include "job_graph.h"
+
+#include "cmdlib.h"
+#include "winlite.h"
+
+#include "tier0/platform.h"
+
+namespace {
+
+std::atomic_int g_job_graph_runs{0};
+
+}  // namespace
+
+namespace se::utils::common {
+
+struct JobGraph::Job {
+  JobId id;
+  const char *name;
+  ThreadWorkerFn item_fn;
+  RunThreadsFn task_fn;
+  void *user_data;
+
+  int items_count;
+  int chunk_size;
+
+  std::atomic_int next_item;
+  std::atomic_int done_items;
+  std::atomic_int pending_dependencies;
+  std::atomic_bool cancelled;
+
+  std::vector<JobId> successors;
+
+  double start_time;
+  double end_time;
+};
+
+JobGraph::JobGraph(int threads_count)
+    : threads_count_{threads_count > 0 ? threads_count : 1},
+      run_id_{++g_job_graph_runs},
+      next_thread_index_{0},
+      pending_jobs_{0},
+      pool_{nullptr},
+      done_event_{true},
+      start_time_{0},
+      end_time_{0} {}
+
+JobGraph::~JobGraph() {
+  if (pool_) {
+    pool_->Stop();
+    DestroyThreadPool(pool_);
+  }
+}
+
+JobGraph::JobId JobGraph::AddJob(const char *name, int items_count,
+                                 ThreadWorkerFn fn) {
+  return Add(name, items_count, fn, nullptr, nullptr);
+}
+
+JobGraph::JobId JobGraph::AddTask(const char *name, RunThreadsFn fn,
+                                  void *user_data) {
+  return Add(name, 1, nullptr, fn, user_data);
+}
+
+JobGraph::JobId JobGraph::Add(const char *name, int items_count,
+                              ThreadWorkerFn item_fn, RunThreadsFn task_fn,
+                              void *user_data) {
+  auto job = std::make_unique<Job>();
+  job->id = static_cast<JobId>(jobs_.size());
+  job->name = name;
+  job->item_fn = item_fn;
+  job->task_fn = task_fn;
+  job->user_data = user_data;
+  job->items_count = items_count > 0 ? items_count : 0;
+  // Enough chunks to balance uneven items, but not so many that claiming
+  // them costs anything.
+  job->chunk_size = max(1, job->items_count / (threads_count_ * 32));
+  job->next_item = 0;
+  job->done_items = 0;
+  job->pending_dependencies = 0;
+  job->cancelled = false;
+  job->start_time = 0;
+  job->end_time = 0;
+
+  const JobId id{job->id};
+  jobs_.emplace_back(std::move(job));
+
+  return id;
+}
+
+void JobGraph::AddDependency(JobId job, JobId depends_on) {
+  Assert(job != depends_on);
+  Assert(!pool_);
+
+  jobs_[depends_on]->successors.push_back(job);
+  ++jobs_[job]->pending_dependencies;
+}
+
+void JobGraph::Cancel(JobId job) {
+  jobs_[job]->cancelled.store(true, std::memory_order::memory_order_release);
+}
+
+void JobGraph::Run() {
+  Assert(!pool_);
+
+  busy_seconds_.assign(jobs_.size() * threads_count_, 0.0);
+  pending_jobs_ = static_cast<int>(jobs_.size());
+
+  if (jobs_.empty()) return;
+
+  pool_ = CreateThreadPool();
+
+  ThreadPoolStartParams_t params;
+  params.nThreads = threads_count_;
+  params.fDistribute = TRS_FALSE;
+  // Main thread only waits, so job thread indices stay in [0, threads count).
+  params.bExecOnThreadPoolThreadsOnly = true;
+  if (g_bLowPriorityThreads) params.iThreadPriority = THREAD_PRIORITY_LOWEST;
+
+  if (!pool_->Start(params, "JobGraph")) {
+    Error("Unable to start pool of %d threads for job graph.\n",
+          threads_count_);
+  }
+
+  // Let ScopedThreadsLock guard non thread-safe paths in jobs.
+  const bool old_threads_lock{EnableScopedThreadsLock(true)};
+
+  start_time_ = Plat_FloatTime();
+
+  // Collect roots first, as root may complete and ready others before loop
+  // ends.
+  std::vector<Job *> roots;
+  for (auto &job : jobs_) {
+    if (job->pending_dependencies == 0) roots.push_back(job.get());
+  }
+
+  AssertMsg(!roots.empty(), "Job graph has dependency cycle.\n");
+
+  for (auto *job : roots) Ready(job);
+
+  done_event_.Wait();
+
+  end_time_ = Plat_FloatTime();
+
+  EnableScopedThreadsLock(old_threads_lock);
+}
+
+void JobGraph::Ready(Job *job) {
+  job->start_time = Plat_FloatTime();
+
+  if (job->cancelled.load(std::memory_order::memory_order_acquire) ||
+      job->items_count == 0) {
+    Complete(job);
+    return;
+  }
+
+  const int chunks_count{(job->items_count + job->chunk_size - 1) /
+                         job->chunk_size};
+  const int runners_count{min(chunks_count, threads_count_)};
+
+  for (int i = 0; i < runners_count; ++i) {
+    pool_->QueueCall(this, &JobGraph::RunItems, job)->Release();
+  }
+}
+
+void JobGraph::Complete(Job *job) {
+  job->end_time = Plat_FloatTime();
+
+  for (JobId successor : job->successors) {
+    Job *next{jobs_[successor].get()};
+
+    if (--next->pending_dependencies == 0) Ready(next);
+  }
+
+  if (--pending_jobs_ == 0) done_event_.Set();
+}
+
+void JobGraph::RunItems(Job *job) {
+  const int thread{ThreadIndex()};
+  double &busy_seconds{busy_seconds_[job->id * threads_count_ + thread]};
+
+  while (true) {
+    const int begin{job->next_item.fetch_add(job->chunk_size)};
+    if (begin >= job->items_count) break;
+
+    const int end{min(begin + job->chunk_size, job->items_count)};
+
+    const double chunk_start_time{Plat_FloatTime()};
+
+    if (job->task_fn) {
+      job->task_fn(thread, job->user_data);
+    } else {
+      for (int item = begin; item < end; ++item) job->item_fn(thread, item);
+    }
+
+    busy_seconds += Plat_FloatTime() - chunk_start_time;
+
+    // Last finished chunk completes job.
+    if (job->done_items.fetch_add(end - begin) + (end - begin) ==
+        job->items_count) {
+      Complete(job);
+    }
+  }
+}
+
+int JobGraph::ThreadIndex() {
+  // Pool threads are not shared between graphs, but thread ids may be reused,
+  // so remember graph which assigned index.
+  thread_local int owner_run_id{0};
+  thread_local int thread_index{0};
+
+  if (owner_run_id != run_id_) {
+    owner_run_id = run_id_;
+    thread_index = next_thread_index_++;
+
+    Assert(thread_index < threads_count_);
+  }
+
+  return thread_index;
+}
+
+void JobGraph::PrintStats() const {
+  const double wall_seconds{end_time_ - start_time_};
+
+  double total_busy_seconds{0};
+  for (double busy : busy_seconds_) total_busy_seconds += busy;
+
+  Msg("Job graph: %.2fs on %d threads, %.1f%% utilization.\n", wall_seconds,
+      threads_count_,
+      wall_seconds > 0
+          ? 100.0 * total_busy_seconds / (wall_seconds * threads_count_)
+          : 0.0);
+  Msg("  %-28s %9s %9s %9s %9s %6s\n", "Job", "Start", "Wall", "Busy",
+      "Items", "Util");
+
+  for (size_t i = 0; i < jobs_.size(); ++i) {
+    const Job &job{*jobs_[i]};
+
+    // Skipped ones only add noise.
+    if (job.cancelled.load(std::memory_order::memory_order_relaxed)) continue;
+
+    double job_busy_seconds{0};
+    for (int t = 0; t < threads_count_; ++t) {
+      job_busy_seconds += busy_seconds_[i * threads_count_ + t];
+    }
+
+    const double job_wall_seconds{job.end_time - job.start_time};
+
+    Msg("  %-28s %8.2fs %8.2fs %8.2fs %9d %5.1f%%\n", job.name,
+        job.start_time - start_time_, job_wall_seconds, job_busy_seconds,
+        job.items_count,
+        job_wall_seconds > 0
+            ? 100.0 * job_busy_seconds / (job_wall_seconds * threads_count_)
+            : 0.0);
+  }
+
+  Msg("  Thread busy:");
+  for (int t = 0; t < threads_count_; ++t) {
+    double thread_busy_seconds{0};
+    for (size_t i = 0; i < jobs_.size(); ++i) {
+      thread_busy_seconds += busy_seconds_[i * threads_count_ + t];
+    }
+
+    Msg(" %.0f%%", wall_seconds > 0
+                        ? 100.0 * thread_busy_seconds / wall_seconds
+                        : 0.0);
+  }
+  Msg("\n");
+}
+
+}  // namespace se::utils::common
@@ -0,0 +1,104 @@
+// Copyright Valve Corporation, All rights reserved.
+//
+// Dependency driven job graph for tools.
+
+#ifndef SRC_UTILS_COMMON_JOB_GRAPH_H_
+#define SRC_UTILS_COMMON_JOB_GRAPH_H_
+
+#include "threads.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace se::utils::common {
+
+/**
+ * @brief Graph of jobs run on a private thread pool.  Job is queued as soon as
+ * all jobs it depends on are finished.  Only jobs with no dependency path
+ * between them can run at the same time, a chain of dependent jobs runs one
+ * after another like RunThreadsOn calls.  Work items of a job are claimed by
+ * pool threads in chunks.
+ *
+ * Jobs receive thread index in [0, threads count), so arrays indexed by thread
+ * work like with RunThreadsOn.
+ */
+class JobGraph {
+ public:
+  using JobId = int;
+
+  explicit JobGraph(int threads_count);
+  ~JobGraph();
+
+  JobGraph(JobGraph &) = delete;
+  JobGraph &operator=(JobGraph &) = delete;
+
+  /**
+   * @brief Adds job which runs fn(thread, item) for each item in [0,
+   * items_count).
+   * @param name Job name for stats.  Should outlive graph.
+   * @return Job id.
+   */
+  JobId AddJob(const char *name, int items_count, ThreadWorkerFn fn);
+
+  /**
+   * @brief Adds job which runs fn(thread, user_data) once.
+   * @param name Job name for stats.  Should outlive graph.
+   * @return Job id.
+   */
+  JobId AddTask(const char *name, RunThreadsFn fn, void *user_data = nullptr);
+
+  /**
+   * @brief Job will not start until depends_on job is finished.  Should be
+   * called before Run.
+   */
+  void AddDependency(JobId job, JobId depends_on);
+
+  /**
+   * @brief Skips job which has not started yet.  Skipped job finishes without
+   * running, so jobs which depend on it still run.  May be called from jobs.
+   */
+  void Cancel(JobId job);
+
+  /**
+   * @brief Runs all jobs and waits until they are finished.  Can be called
+   * once.
+   */
+  void Run();
+
+  /**
+   * @brief Prints wall and busy time and threads utilization of each job and
+   * whole graph.
+   */
+  void PrintStats() const;
+
+ private:
+  struct Job;
+
+  JobId Add(const char *name, int items_count, ThreadWorkerFn item_fn,
+            RunThreadsFn task_fn, void *user_data);
+
+  void Ready(Job *job);
+  void Complete(Job *job);
+  void RunItems(Job *job);
+
+  int ThreadIndex();
+
+  const int threads_count_;
+  const int run_id_;
+  std::atomic_int next_thread_index_;
+  std::atomic_int pending_jobs_;
+
+  IThreadPool *pool_;
+  CThreadEvent done_event_;
+
+  std::vector<std::unique_ptr<Job>> jobs_;
+  // threads_count_ busy seconds per job.
+  std::vector<double> busy_seconds_;
+
+  double start_time_, end_time_;
+};
+
+}  // namespace se::utils::common
+
+#endif  // !SRC_UTILS_COMMON_JOB_GRAPH_H_
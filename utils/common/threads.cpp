@@ -100,6 +100,12 @@ ScopedThreadsLock::ScopedThreadsLock() noexcept {
 
 ScopedThreadsLock::~ScopedThreadsLock() noexcept = default;
 
+bool EnableScopedThreadsLock(bool enable) {
+  const bool old_enable{enable_threads};
+  enable_threads = enable;
+  return old_enable;
+}
+
 int GetThreadWork() {
   const ScopedCriticalSectionLock lock{g_threads_critical_section.Lock()};
 
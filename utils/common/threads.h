@@ -55,6 +55,10 @@ extern bool g_bLowPriorityThreads;
 
 int GetThreadWork();
 
+// Makes ScopedThreadsLock lock for threads not started by RunThreads_Start,
+// like thread pool ones.  Returns old state.
+bool EnableScopedThreadsLock(bool enable);
+
 class ScopedThreadsLock {
  public:
   ScopedThreadsLock() noexcept;
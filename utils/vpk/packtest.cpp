@@ -97,6 +97,12 @@ CUtlString s_sPublicKeyFile;
       "            and <keybasemame>.privatekey.vdf\n"
       "            Remember: your private key should be kept private.\n"
 #endif
+      "\n"
+      "BENCHMARK:\n"
+      "  vpk mapbench <vpkfile> [files count]\n"
+      "            Compare mount time, RSS and open + read latency of\n"
+      "            mapped and unmapped VPK.  Creates <vpkfile> with\n"
+      "            10000 (or files count) small files if it is missing.\n"
       "\n"
       "\n"
       "Options:\n"
@@ -1891,6 +1897,177 @@ static void DroppedDirectory(const char *pszDirectoryArg) {
   builder.BuildFromInputKeys();
 }
 
+// Synthetic content of benchmark file |index|, so reads can be checked.
+void FillMapBenchFile(int index, CUtlVector<uint8> &data) {
+  // 256 bytes .. 8KiB, like scripts, materials and small models.
+  data.SetCount(256 + (index * 7919) % (8 * 1024 - 256));
+
+  unsigned random = static_cast<unsigned>(index) * 2654435761u + 1;
+  for (auto &b : data) {
+    random = random * 1664525u + 1013904223u;
+    b = static_cast<uint8>(random >> 24);
+  }
+}
+
+void MakeMapBenchFileName(int index, char (&name)[MAX_PATH]) {
+  V_sprintf_safe(name, "mapbench/dir%02d/file%05d.bin", index % 64, index);
+}
+
+void MakeMapBenchPack(const char *pszVpkFilename, int files_count) {
+  char szActualFileName[MAX_PATH];
+  CPackedStore mypack(pszVpkFilename, szActualFileName,
+                      ssize(szActualFileName), g_pFullFileSystem, true);
+  mypack.SetWriteChunkSize(s_iMultichunkSize * 1024 * 1024);
+
+  CUtlVector<uint8> data;
+  char name[MAX_PATH];
+  for (int i = 0; i < files_count; i++) {
+    FillMapBenchFile(i, data);
+    MakeMapBenchFileName(i, name);
+
+    // Archive chunks, not dir file, like shipped packs.
+    if (mypack.AddFile(name, 0, data.Base(), data.Count(), true) ==
+        EPADD_ERROR)
+      Error("Error adding %s\n", name);
+  }
+
+  mypack.HashEverything();
+  mypack.Write();
+}
+
+struct MapBenchResult {
+  double mount_ms;
+  double rss_mib;
+  double read_us;
+  double direct_us;
+  int bad_files;
+  int direct_files;
+};
+
+// Mounts pack, then opens and reads every file via ReadData copy and via
+// DirectData when it is available.
+MapBenchResult RunMapBench(const char *pszVpkFilename, int files_count,
+                           bool map_files) {
+  MapBenchResult result = {};
+
+  const bool was_mapping = CPackedStore::EnableMapping(map_files);
+  const size_t rss_before = ApproximateProcessMemoryUsage();
+
+  double start = Plat_FloatTime();
+  char szActualFileName[MAX_PATH];
+  auto mypack = std::make_unique<CPackedStore>(
+      pszVpkFilename, szActualFileName, ssize(szActualFileName),
+      g_pFullFileSystem);
+  result.mount_ms = (Plat_FloatTime() - start) * 1000.0;
+
+  CUtlVector<uint8> expected, actual;
+  char name[MAX_PATH];
+
+  start = Plat_FloatTime();
+  for (int i = 0; i < files_count; i++) {
+    MakeMapBenchFileName(i, name);
+    CPackedStoreFileHandle handle = mypack->OpenFile(name);
+    if (!handle) {
+      result.bad_files++;
+      continue;
+    }
+
+    actual.SetCount(handle.m_nFileSize);
+    if (mypack->ReadData(handle, actual.Base(), actual.Count()) !=
+        actual.Count()) {
+      result.bad_files++;
+      continue;
+    }
+
+    FillMapBenchFile(i, expected);
+    if (expected.Count() != actual.Count() ||
+        memcmp(expected.Base(), actual.Base(), actual.Count()) != 0)
+      result.bad_files++;
+  }
+  result.read_us = (Plat_FloatTime() - start) * 1e6 / files_count;
+
+  start = Plat_FloatTime();
+  unsigned checksum = 0;
+  for (int i = 0; i < files_count; i++) {
+    MakeMapBenchFileName(i, name);
+    CPackedStoreFileHandle handle = mypack->OpenFile(name);
+    const auto *data = handle ? static_cast<const uint8 *>(handle.DirectData())
+                              : nullptr;
+    if (!data) continue;
+
+    // Touch every page, as real consumer would.
+    for (int j = 0; j < handle.m_nFileSize; j += 4096) checksum += data[j];
+    result.direct_files++;
+  }
+  result.direct_us = (Plat_FloatTime() - start) * 1e6 / files_count;
+
+  // Direct data checked after timing, not to mix memcmp into latency.
+  for (int i = 0; i < files_count && result.direct_files; i++) {
+    MakeMapBenchFileName(i, name);
+    CPackedStoreFileHandle handle = mypack->OpenFile(name);
+    const void *data = handle ? handle.DirectData() : nullptr;
+    if (!data) continue;
+
+    FillMapBenchFile(i, expected);
+    if (expected.Count() != handle.m_nFileSize ||
+        memcmp(expected.Base(), data, handle.m_nFileSize) != 0)
+      result.bad_files++;
+  }
+
+  const size_t rss_after = ApproximateProcessMemoryUsage();
+  result.rss_mib = rss_after >= rss_before
+                       ? (rss_after - rss_before) / (1024.0 * 1024.0)
+                       : 0.0;
+
+  mypack.reset();
+  CPackedStore::EnableMapping(was_mapping);
+
+  if (s_bBeVerbose) printf("direct data checksum %u\n", checksum);
+
+  return result;
+}
+
+// Compares mount time, RSS growth and per file open + read latency of pack
+// read through file handles and of mapped pack.  Builds pack of small files
+// first if there is none.
+static void MapBench(const char *pszVpkFilename, int files_count) {
+  // Packs of archive chunks always have _dir file.
+  char szDirFileName[MAX_PATH];
+  V_StripExtension(pszVpkFilename, szDirFileName);
+  const intp base_length = V_strlen(szDirFileName);
+  if (base_length < 4 ||
+      V_stricmp(szDirFileName + base_length - 4, "_dir") != 0)
+    V_strcat_safe(szDirFileName, "_dir");
+  V_strcat_safe(szDirFileName, ".vpk");
+
+  if (!g_pFullFileSystem->FileExists(szDirFileName)) {
+    printf("Creating %s with %d files...\n", szDirFileName, files_count);
+    MakeMapBenchPack(pszVpkFilename, files_count);
+  }
+
+  // Warm OS file cache, so both runs read same resident pages.
+  RunMapBench(pszVpkFilename, files_count, false);
+
+  const MapBenchResult unmapped =
+      RunMapBench(pszVpkFilename, files_count, false);
+  const MapBenchResult mapped = RunMapBench(pszVpkFilename, files_count, true);
+
+  printf("%d files, RSS is %s.\n", files_count,
+         ApproximateProcessMemoryUsage() ? "growth of resident set"
+                                         : "not available on this platform");
+  printf("          | mount, ms | RSS, MiB | open+read, us | open+direct, us\n");
+  printf("handles   | %9.2f | %8.2f | %13.2f | %15s\n", unmapped.mount_ms,
+         unmapped.rss_mib, unmapped.read_us, "n/a");
+  printf("mapped    | %9.2f | %8.2f | %13.2f | %15.2f\n", mapped.mount_ms,
+         mapped.rss_mib, mapped.read_us,
+         mapped.direct_files ? mapped.direct_us : 0.0);
+
+  const int bad_files = unmapped.bad_files + mapped.bad_files;
+  printf("%d zero-copy files, %d bad files - %s\n", mapped.direct_files,
+         bad_files, bad_files ? "FAILED" : "PASSED");
+  if (bad_files) exit(1);
+}
+
 }  // namespace
 
 int main(int argc, char **argv) {
@@ -2090,6 +2267,20 @@ int main(int argc, char **argv) {
     // stime = Plat_FloatTime();
     // BenchMark( files );
     // printf( " time pack = %f\n", Plat_FloatTime() - stime );
+  } else if (V_strcmp(pszCommand, "mapbench") == 0) {
+    if (argc != 3 && argc != 4) {
+      fprintf(stderr, "Incorrect number of arguments for '%s' command.\n",
+              pszCommand);
+      exit(EINVAL);
+    }
+
+    const int files_count = argc == 4 ? V_atoi(argv[3]) : 10000;
+    if (files_count <= 0) {
+      fprintf(stderr, "Invalid files count %s\n", argv[3]);
+      exit(EINVAL);
+    }
+
+    MapBench(argv[2], files_count);
   } else if (V_strcmp(pszCommand, "rehash") == 0) {
     if (argc != 3) {
       fprintf(stderr, "Incorrect number of arguments for '%s' command.\n",
@@ -59,7 +59,7 @@ private:
 	RayTracingSingleResult *m_pResults;
 	int *m_pShooterPatches;
 	int *m_pRecieverPatches;
-	RayStream m_RayStream;
+	SortedRayStream m_RayStream;
 	transfer_t *m_AllTransfers;
 };
 
@@ -460,6 +460,36 @@ void BuildVisLeafs( int threadnum, void *pUserData )
 }
 
 
+//-----------------------------------------------------------------------------
+// Per cluster version for job graph. Each thread keeps own transfers buffer
+// until BuildVisLeafs_FreeIndividual.
+//-----------------------------------------------------------------------------
+static transfer_t *g_pThreadTransfers[MAX_TOOL_THREADS+1];
+
+void BuildVisLeafs_Individual( int threadnum, int iCluster )
+{
+	transfer_t *&transfers = g_pThreadTransfers[threadnum];
+	if ( !transfers )
+	{
+		transfers = BuildVisLeafs_Start();
+	}
+
+	BuildVisLeafs_Cluster( threadnum, transfers, iCluster, NULL );
+}
+
+void BuildVisLeafs_FreeIndividual()
+{
+	for ( auto &transfers : g_pThreadTransfers )
+	{
+		if ( transfers )
+		{
+			BuildVisLeafs_End( transfers );
+			transfers = NULL;
+		}
+	}
+}
+
+
 /*
 ==============
 BuildVisMatrix
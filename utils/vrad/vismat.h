@@ -29,6 +29,10 @@ void BuildVisLeafs_Cluster(
 
 void BuildVisLeafs_End( transfer_t *transfers );
 
+// Job graph uses these.
+void BuildVisLeafs_Individual( int threadnum, int iCluster );
+void BuildVisLeafs_FreeIndividual();
+
 
 
 #endif // VISMAT_H
@@ -17,6 +17,8 @@
 #include "vmpi_tools_shared.h"
 #include "leaf_ambient_lighting.h"
 #include "tools_minidump.h"
+#include "job_graph.h"
+#include "vismat.h"
 #include "loadcmdline.h"
 #include "byteswap.h"
 #include "bspflags.h"
@@ -62,6 +64,7 @@ bool	    bDumpNormals = false;
 bool		g_bDumpRtEnv = false;
 bool		bRed2Black = true;
 bool		g_bFastAmbient = false;
+bool		g_bJobGraph = false;
 bool        g_bNoSkyRecurse = false;
 bool		g_bDumpPropLightmaps = false;
 
@@ -1534,116 +1537,121 @@ void PreGetBumpNormalsForDisp( texinfo_t *pTexinfo, Vector &vecU, Vector &vecV,
 	vecV = vecTexV;
 }
 
-void GatherLight (int threadnum, void *pUserData)
+static void GatherPatchLight (int threadnum, int j)
 {
-	int			i, j, k;
+	int			i, k;
 	transfer_t	*trans;
 	int			num;
 	CPatch		*patch;
 	Vector		sum, v;
 
-	while (1)
-	{
-		j = GetThreadWork ();
-		if (j == -1)
-			break;
+	patch = &g_Patches[j];
 
-		patch = &g_Patches[j];
+	trans = patch->transfers;
+	num = patch->numtransfers;
+	if ( patch->needsBumpmap )
+	{
+		Vector delta;
+		Vector bumpSum[NUM_BUMP_VECTS+1];
+		Vector normals[NUM_BUMP_VECTS+1];
 
-		trans = patch->transfers;
-		num = patch->numtransfers;
-		if ( patch->needsBumpmap )
+		// Disps
+		bool bDisp = ( g_pFaces[patch->faceNumber].dispinfo != -1 ); 
+		if ( bDisp )
+		{
+			normals[0] = patch->normal;
+			texinfo_t *pTexinfo = &texinfo[g_pFaces[patch->faceNumber].texinfo];
+			Vector vecTexU, vecTexV;
+			PreGetBumpNormalsForDisp( pTexinfo, vecTexU, vecTexV, normals[0] );
+			
+			Vector bumpNormals[NUM_BUMP_VECTS];
+			// use facenormal along with the smooth normal to build the three bump map vectors
+			GetBumpNormals( vecTexU, vecTexV, normals[0], normals[0], bumpNormals );
+			memcpy( &normals[1], bumpNormals, sizeof(bumpNormals) );
+		}
+		else
 		{
-			Vector delta;
-			Vector bumpSum[NUM_BUMP_VECTS+1];
-			Vector normals[NUM_BUMP_VECTS+1];
+			GetPhongNormal( patch->faceNumber, patch->origin, normals[0] );
 
-			// Disps
-			bool bDisp = ( g_pFaces[patch->faceNumber].dispinfo != -1 ); 
-			if ( bDisp )
-			{
-				normals[0] = patch->normal;
-				texinfo_t *pTexinfo = &texinfo[g_pFaces[patch->faceNumber].texinfo];
-				Vector vecTexU, vecTexV;
-				PreGetBumpNormalsForDisp( pTexinfo, vecTexU, vecTexV, normals[0] );
-				
-				Vector bumpNormals[NUM_BUMP_VECTS];
-				// use facenormal along with the smooth normal to build the three bump map vectors
-				GetBumpNormals( vecTexU, vecTexV, normals[0], normals[0], bumpNormals );
-				memcpy( &normals[1], bumpNormals, sizeof(bumpNormals) );
-			}
-			else
-			{
-				GetPhongNormal( patch->faceNumber, patch->origin, normals[0] );
+			texinfo_t *pTexinfo = &texinfo[g_pFaces[patch->faceNumber].texinfo];
+			// use facenormal along with the smooth normal to build the three bump map vectors
+			
+			Vector bumpNormals[NUM_BUMP_VECTS];
+			GetBumpNormals( pTexinfo->textureVecsTexelsPerWorldUnits[0], 
+				pTexinfo->textureVecsTexelsPerWorldUnits[1], patch->normal, 
+				normals[0], bumpNormals );
+			memcpy( &normals[1], bumpNormals, sizeof(bumpNormals) );
+		}
 
-				texinfo_t *pTexinfo = &texinfo[g_pFaces[patch->faceNumber].texinfo];
-				// use facenormal along with the smooth normal to build the three bump map vectors
-				
-				Vector bumpNormals[NUM_BUMP_VECTS];
-				GetBumpNormals( pTexinfo->textureVecsTexelsPerWorldUnits[0], 
-					pTexinfo->textureVecsTexelsPerWorldUnits[1], patch->normal, 
-					normals[0], bumpNormals );
-				memcpy( &normals[1], bumpNormals, sizeof(bumpNormals) );
-			}
+		// force the base lightmap to use the flat normal instead of the phong normal
+		// FIXME: why does the patch not use the phong normal?
+		normals[0] = patch->normal;
 
-			// force the base lightmap to use the flat normal instead of the phong normal
-			// FIXME: why does the patch not use the phong normal?
-			normals[0] = patch->normal;
+		for ( i = 0; i < NUM_BUMP_VECTS+1; i++ )
+		{
+			VectorFill( bumpSum[i], 0 );
+		}
 
-			for ( i = 0; i < NUM_BUMP_VECTS+1; i++ )
+		float dot;
+		for (k=0 ; k<num ; k++, trans++)
+		{
+			CPatch *patch2 = &g_Patches[trans->patch];
+
+			// get vector to other patch
+			VectorSubtract (patch2->origin, patch->origin, delta);
+			VectorNormalize (delta);
+			// find light emitted from other patch
+			for(i=0; i<3; i++)
 			{
-				VectorFill( bumpSum[i], 0 );
+				v[i] = emitlight[trans->patch][i] * patch2->reflectivity[i];
 			}
-
-			float dot;
-			for (k=0 ; k<num ; k++, trans++)
+			// remove normal already factored into transfer steradian
+			float scale = 1.0f / DotProduct (delta, patch->normal);
+			VectorScale( v, trans->transfer * scale, v );
+			
+			Vector bumpTransfer;
+			for ( i = 0; i < NUM_BUMP_VECTS+1; i++ )
 			{
-				CPatch *patch2 = &g_Patches[trans->patch];
-
-				// get vector to other patch
-				VectorSubtract (patch2->origin, patch->origin, delta);
-				VectorNormalize (delta);
-				// find light emitted from other patch
-				for(i=0; i<3; i++)
+				dot = DotProduct( delta, normals[i] );
+				if ( dot <= 0 )
 				{
-					v[i] = emitlight[trans->patch][i] * patch2->reflectivity[i];
-				}
-				// remove normal already factored into transfer steradian
-				float scale = 1.0f / DotProduct (delta, patch->normal);
-				VectorScale( v, trans->transfer * scale, v );
-				
-				Vector bumpTransfer;
-				for ( i = 0; i < NUM_BUMP_VECTS+1; i++ )
-				{
-					dot = DotProduct( delta, normals[i] );
-					if ( dot <= 0 )
-					{
 //						Assert( i > 0 ); // if this hits, then the transfer shouldn't be here.  It doesn't face the flat normal of this face!
-						continue;
-					}
-					bumpTransfer = v * dot;
-					VectorAdd( bumpSum[i], bumpTransfer, bumpSum[i] );
+					continue;
 				}
-			}
-			for ( i = 0; i < NUM_BUMP_VECTS+1; i++ )
-			{
-				VectorCopy( bumpSum[i], addlight[j].light[i] );
+				bumpTransfer = v * dot;
+				VectorAdd( bumpSum[i], bumpTransfer, bumpSum[i] );
 			}
 		}
-		else
+		for ( i = 0; i < NUM_BUMP_VECTS+1; i++ )
 		{
-			VectorFill( sum, 0 );
-			for (k=0 ; k<num ; k++, trans++)
+			VectorCopy( bumpSum[i], addlight[j].light[i] );
+		}
+	}
+	else
+	{
+		VectorFill( sum, 0 );
+		for (k=0 ; k<num ; k++, trans++)
+		{
+			for(i=0; i<3; i++)
 			{
-				for(i=0; i<3; i++)
-				{
-					v[i] = emitlight[trans->patch][i] * g_Patches[trans->patch].reflectivity[i];
-				}
-				VectorScale( v, trans->transfer, v );
-				VectorAdd( sum, v, sum );
+				v[i] = emitlight[trans->patch][i] * g_Patches[trans->patch].reflectivity[i];
 			}
-			VectorCopy( sum, addlight[j].light[0] );
+			VectorScale( v, trans->transfer, v );
+			VectorAdd( sum, v, sum );
 		}
+		VectorCopy( sum, addlight[j].light[0] );
+	}
+}
+
+void GatherLight (int threadnum, void *pUserData)
+{
+	while (1)
+	{
+		int j = GetThreadWork ();
+		if (j == -1)
+			break;
+
+		GatherPatchLight( threadnum, j );
 	}
 }
 
@@ -1653,12 +1661,9 @@ void GatherLight (int threadnum, void *pUserData)
 BounceLight
 =============
 */
-void BounceLight (void)
+static void BounceLight_Start (void)
 {
 	unsigned i;
-	Vector	added;
-	char		name[64];
-	qboolean	bouncing = numbounce > 0;
 
 	unsigned int uiPatchCount = g_Patches.Count();
 	for (i=0 ; i<uiPatchCount; i++)
@@ -1702,6 +1707,42 @@ void BounceLight (void)
 		Msg("\n");
 	}
 #endif
+}
+
+// Finishes bounce i after GatherLight, returns true if one more bounce is needed.
+static bool BounceLight_Collect (unsigned i)
+{
+	Vector	added;
+	char	name[64];
+	bool	bouncing = true;
+
+	// move newly received light (addlight) to light to be sent out (emitlight)
+	// start at children and pull light up to parents
+	// light is always received to leaf patches
+	CollectLight( added );
+
+	qprintf ("\tBounce #%i added RGB(%.0f, %.0f, %.0f)\n", i+1, added[0], added[1], added[2] );
+
+	if ( i+1 == numbounce || (added[0] < 1.0 && added[1] < 1.0 && added[2] < 1.0) )
+		bouncing = false;
+
+	i++;
+	if ( g_bDumpPatches && !bouncing && i != 1)
+	{
+		// dimhotepus: %i -> %u
+		V_sprintf_safe (name, "bounce%u.txt", i);
+		WriteWorld (name, 0);
+	}
+
+	return bouncing;
+}
+
+void BounceLight (void)
+{
+	unsigned i;
+	qboolean	bouncing = numbounce > 0;
+
+	BounceLight_Start();
 
 	i = 0;
 	while ( bouncing )
@@ -1710,23 +1751,9 @@ void BounceLight (void)
 		// this moves shooter->emitlight to receiver->addlight
 		unsigned int uiPatchCount = g_Patches.Count();
 		RunThreadsOn (uiPatchCount, true, GatherLight);
-		// move newly received light (addlight) to light to be sent out (emitlight)
-		// start at children and pull light up to parents
-		// light is always received to leaf patches
-		CollectLight( added );
-
-		qprintf ("\tBounce #%i added RGB(%.0f, %.0f, %.0f)\n", i+1, added[0], added[1], added[2] );
-
-		if ( i+1 == numbounce || (added[0] < 1.0 && added[1] < 1.0 && added[2] < 1.0) )
-			bouncing = false;
 
+		bouncing = BounceLight_Collect( i );
 		i++;
-		if ( g_bDumpPatches && !bouncing && i != 1)
-		{
-			// dimhotepus: %i -> %u
-			V_sprintf_safe (name, "bounce%u.txt", i);
-			WriteWorld (name, 0);
-		}
 	}
 }
 
@@ -1924,6 +1951,14 @@ void BuildFacesVisibleToLights( bool bAllVisible )
 
 
 
+static void PrintTransfersStats (void)
+{
+	Msg("transfers %d, max %d\n", static_cast<int>(total_transfer), static_cast<int>(max_transfer) );
+
+	qprintf ("transfer lists: %s\n"
+		, V_pretifymem( (float)total_transfer * sizeof(transfer_t), 2, true ) );
+}
+
 void MakeAllScales (void)
 {
 	// determine visibility between patches
@@ -1932,10 +1967,7 @@ void MakeAllScales (void)
 	// release visibility matrix
 	FreeVisMatrix ();
 
-	Msg("transfers %d, max %d\n", static_cast<int>(total_transfer), static_cast<int>(max_transfer) );
-
-	qprintf ("transfer lists: %s\n"
-		, V_pretifymem( (float)total_transfer * sizeof(transfer_t), 2, true ) );
+	PrintTransfersStats ();
 }
 
 
@@ -2000,6 +2032,138 @@ void MakeAllScales (void)
 #endif
 
 
+//-----------------------------------------------------------------------------
+// Job graph lighting. Phases keep the serial order, but each one is split in
+// jobs and the single threaded steps between them run as tasks, so no thread
+// waits on a RunThreadsOn barrier. Lightmap offsets need styles of all faces
+// and each bounce gathers from all patches, so these stay whole graph
+// barriers.
+//-----------------------------------------------------------------------------
+using se::utils::common::JobGraph;
+
+static JobGraph *g_pLightingGraph = NULL;
+// GatherLight and CollectLight job of each bounce.
+static CUtlVector<JobGraph::JobId> g_BounceJobs;
+
+static void DirectLightingDone( int iThread, void *pUserData )
+{
+	// Figure out the offset into lightmap data for each face.
+	PrecompLightmapOffsets();
+
+	// free up the direct lights now that we have facelights
+	ExportDirectLightsToWorldLights();
+
+	if ( g_bDumpPatches )
+	{
+		for( int iBump = 0; iBump < 4; ++iBump )
+		{
+			char szName[64];
+			V_sprintf_safe ( szName, "bounce0_%d.txt", iBump );
+			WriteWorld( szName, iBump );
+		}
+	}
+}
+
+static void TransfersDone( int iThread, void *pUserData )
+{
+	BuildVisLeafs_FreeIndividual();
+	FreeVisMatrix();
+
+	PrintTransfersStats();
+
+	BounceLight_Start();
+}
+
+static void CollectBounceLight( int iThread, void *pUserData )
+{
+	const unsigned bounce = static_cast<unsigned>( reinterpret_cast<uintp>( pUserData ) );
+
+	if ( !BounceLight_Collect( bounce ) )
+	{
+		// Light converged, skip the rest of bounces.
+		for ( intp i = 2 * ( bounce + 1 ); i < g_BounceJobs.Count(); ++i )
+		{
+			g_pLightingGraph->Cancel( g_BounceJobs[i] );
+		}
+	}
+}
+
+static void BuildDispHashTables( int iThread, void *pUserData )
+{
+	//
+	// displacement surface luxel accumulation
+	//
+	StaticDispMgr()->StartTimer( "Build Patch/Sample Hash Table(s)..." );
+	StaticDispMgr()->InsertSamplesDataIntoHashTable();
+	StaticDispMgr()->InsertPatchSampleDataIntoHashTable();
+	StaticDispMgr()->EndTimer();
+
+	// FinalLightFace is the only job left after this one.
+	VMPI_SetCurrentStage( "FinalLightFace" );
+}
+
+static void RadWorld_RunJobGraph()
+{
+	JobGraph graph( numthreads );
+	g_pLightingGraph = &graph;
+
+	const JobGraph::JobId facelights = graph.AddJob( "BuildFacelights", numfaces, BuildFacelights );
+	const JobGraph::JobId directLighting = graph.AddTask( "PrecompLightmapOffsets", DirectLightingDone );
+	graph.AddDependency( directLighting, facelights );
+
+	g_BounceJobs.RemoveAll();
+
+	// Phases run in the same order as the serial path: transfers read the patch
+	// lighting written by BuildFacelights and the hash tables read the bounced
+	// patch light, so only the work inside each phase is spread over threads.
+	JobGraph::JobId previous = directLighting;
+
+	if ( numbounce > 0 )
+	{
+		// allocate memory for emitlight/addlight
+		emitlight.SetSize( g_Patches.Count() );
+		memset( emitlight.Base(), 0, g_Patches.Count() * sizeof( Vector ) );
+		addlight.SetSize( g_Patches.Count() );
+		memset( addlight.Base(), 0, g_Patches.Count() * sizeof( bumplights_t ) );
+
+		// determine visibility between patches
+		const JobGraph::JobId visLeafs = graph.AddJob( "BuildVisLeafs", dvis->numclusters, BuildVisLeafs_Individual );
+		graph.AddDependency( visLeafs, directLighting );
+		const JobGraph::JobId transfers = graph.AddTask( "BounceLightStart", TransfersDone );
+		graph.AddDependency( transfers, visLeafs );
+
+		// spread light around
+		previous = transfers;
+		for ( unsigned i = 0; i < numbounce; ++i )
+		{
+			const JobGraph::JobId gather = graph.AddJob( "GatherLight", g_Patches.Count(), GatherPatchLight );
+			const JobGraph::JobId collect = graph.AddTask( "CollectLight", CollectBounceLight, reinterpret_cast<void *>( static_cast<uintp>( i ) ) );
+			graph.AddDependency( gather, previous );
+			graph.AddDependency( collect, gather );
+
+			g_BounceJobs.AddToTail( gather );
+			g_BounceJobs.AddToTail( collect );
+
+			previous = collect;
+		}
+	}
+
+	const JobGraph::JobId dispHashTables = graph.AddTask( "BuildDispHashTables", BuildDispHashTables );
+	graph.AddDependency( dispHashTables, previous );
+
+	const JobGraph::JobId finalLight = graph.AddJob( "FinalLightFace", numfaces, FinalLightFace );
+	graph.AddDependency( finalLight, dispHashTables );
+
+	// blend bounced light into direct light and save
+	graph.Run();
+
+	graph.PrintStats();
+
+	g_BounceJobs.Purge();
+	g_pLightingGraph = NULL;
+}
+
+
 bool RadWorld_Go()
 {
 	g_iCurFace.store(0, std::memory_order::memory_order_relaxed);
@@ -2021,6 +2185,16 @@ bool RadWorld_Go()
 		BuildFacesVisibleToLights( true );
 	}
 
+	// Phases on the job graph still run one after another, it only replaces the
+	// RunThreadsOn calls, so it is opt-in.
+	if ( g_bJobGraph && !g_bUseMPI && !g_pIncremental )
+	{
+		RadWorld_RunJobGraph();
+
+		Msg("FinalLightFace Done\n"); fflush(stdout);
+		return true;
+	}
+
 	// build initial facelights
 	if (g_bUseMPI) 
 	{
@@ -2509,6 +2683,11 @@ static int ParseCommandLine( int argc, char **argv, bool *onlydetail )
 			Msg( "--fast-ambient: true\n" );
 			g_bFastAmbient = true;
 		}
+		else if ( !Q_stricmp(argv[i], "-jobgraph") )
+		{
+			Msg( "--job-graph: true\n" );
+			g_bJobGraph = true;
+		}
 		else if (!Q_stricmp(argv[i],"-fast"))
 		{
 			Msg( "--fast: true\n" );
@@ -2880,6 +3059,8 @@ void PrintUsage( int argc, char **argv )
 		"  -lights <file>  : Load a lights file in addition to lights.rad and the\n"
 		"                    level lights file.\n"
 		"  -noextra        : Disable supersampling.\n"
+		"  -jobgraph       : Run lighting phases on a job graph instead of\n"
+		"                    RunThreadsOn calls. Phases still run in order.\n"
 		"  -debugextra     : Places debugging data in lightmaps to visualize\n"
 		"                    supersampling.\n"
 		"  -smooth #       : Set the threshold for smoothing groups, in degrees\n"
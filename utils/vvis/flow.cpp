@@ -7,6 +7,7 @@
 //=============================================================================//
 #include "vis.h"
 #include "vmpi.h"
+#include "threads.h"
 
 int g_TraceClusterStart = -1;
 int g_TraceClusterStop = -1;
@@ -29,16 +30,94 @@ int g_TraceClusterStop = -1;
   void CalcMightSee (leaf_t *leaf, 
 */
 
+static inline int CountWordBits (uint64 v)
+{
+	v = v - ((v >> 1) & 0x5555555555555555ull);
+	v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+	v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+	return (int)((v * 0x0101010101010101ull) >> 56);
+}
+
 int CountBits (byte *bits, int numbits)
 {
 	int c = 0;
-	for (int i=0 ; i<numbits ; i++)
+
+	// whole words, then the bits left over
+	const int numwords = numbits >> 6;
+	for (int i=0 ; i<numwords ; i++)
+	{
+		uint64 word;
+		memcpy (&word, bits + i*sizeof(word), sizeof(word));
+		c += CountWordBits (word);
+	}
+
+	for (int i=numwords<<6 ; i<numbits ; i++)
 		if ( CheckBit( bits, i ) )
 			c++;
 
 	return c;
 }
 
+
+static bool s_bVisAVX2 = GetCPUInformation()->m_bAVX2;
+
+void EnableVisAVX2( bool bEnable )
+{
+	s_bVisAVX2 = bEnable && GetCPUInformation()->m_bAVX2;
+}
+
+bool IsVisAVX2Enabled()
+{
+	return s_bVisAVX2;
+}
+
+/*
+==============
+MightSeeMore
+
+might = prevMight & test, true if that has any portal vis doesn't
+==============
+*/
+static inline bool MightSeeMore (uint64 *might, const uint64 *prevMight, const uint64 *test, const uint64 *vis)
+{
+	if ( s_bVisAVX2 )
+		return MightSeeMoreAVX2( might, prevMight, test, vis, portalwords );
+
+	uint64 more = 0;
+	for (int j=0 ; j<portalwords ; j++)
+	{
+		might[j] = prevMight[j] & test[j];
+		more |= might[j] & ~vis[j];
+	}
+	return more != 0;
+}
+
+
+// mightsee bit strings of each recursion depth, per thread, kept from portal to portal
+static CUtlVector<uint64 *> g_FlowStacks[MAX_TOOL_THREADS+1];
+
+static uint64 *GetFlowStackMightSee (int iThread, int depth)
+{
+	CUtlVector<uint64 *> &stacks = g_FlowStacks[iThread];
+	while ( stacks.Count() <= depth )
+	{
+		stacks.AddToTail( (uint64 *)malloc( portalwords * sizeof(uint64) ) );
+	}
+	return stacks[depth];
+}
+
+void FreePortalFlowStacks (void)
+{
+	for ( auto &stacks : g_FlowStacks )
+	{
+		for ( uint64 *mightsee : stacks )
+		{
+			free( mightsee );
+		}
+		stacks.Purge();
+	}
+}
+
 int		c_fullskip;
 int		c_portalskip, c_leafskip;
 int		c_vistest, c_mighttest;
@@ -453,8 +532,7 @@ void RecursiveLeafFlow (int leafnum, threaddata_t *thread, pstack_t *prevstack)
 {
 	pstack_t	stack;
 	plane_t		backplane;
-	int			j;
-	long		*test, *might, *vis, more;
+	const uint64	*test;
 	
 	// Early-out if we're a VMPI worker that's told to exit. If we don't do this here, then the
 	// worker might spin its wheels for a while on an expensive work unit and not be available to the pool.
@@ -476,9 +554,10 @@ void RecursiveLeafFlow (int leafnum, threaddata_t *thread, pstack_t *prevstack)
 	stack.next = NULL;
 	stack.leaf = leaf;
 	stack.portal = NULL;
+	stack.depth = prevstack->depth + 1;
+	stack.mightsee = GetFlowStackMightSee( thread->thread, stack.depth );
 
-	might = (long *)stack.mightsee;
-	vis = (long *)thread->base->portalvis;
+	const uint64 *vis = (const uint64 *)thread->base->portalvis;
 	
 	// check all portals for flowing into other leafs	
 	for (intp i=0 ; i<leaf->portals.Count() ; i++)
@@ -486,7 +565,7 @@ void RecursiveLeafFlow (int leafnum, threaddata_t *thread, pstack_t *prevstack)
 		portal_t *p = leaf->portals[i];
 		int pnum = p - portals;
 
-		if ( ! (prevstack->mightsee[pnum >> 3] & (1<<(pnum&7)) ) )
+		if ( !CheckBit( (const byte *)prevstack->mightsee, pnum ) )
 		{
 			continue;	// can't possibly see it
 		}
@@ -494,19 +573,14 @@ void RecursiveLeafFlow (int leafnum, threaddata_t *thread, pstack_t *prevstack)
 		// if the portal can't see anything we haven't allready seen, skip it
 		if (p->status == stat_done)
 		{
-			test = (long *)p->portalvis;
+			test = (const uint64 *)p->portalvis;
 		}
 		else
 		{
-			test = (long *)p->portalflood;
+			test = (const uint64 *)p->portalflood;
 		}
 
-		more = 0;
-		for (j=0 ; j<portallongs ; j++)
-		{
-			might[j] = ((long *)prevstack->mightsee)[j] & test[j];
-			more |= (might[j] & ~vis[j]);
-		}
+		const bool more = MightSeeMore( stack.mightsee, prevstack->mightsee, test, vis );
 		
 		if ( !more && CheckBit( thread->base->portalvis, pnum ) )
 		{	// can't see anything new
@@ -603,13 +677,15 @@ void PortalFlow (int iThread, int portalnum)
 	
 	threaddata_t	data;
 	memset (&data, 0, sizeof(data));
+	data.thread = iThread;
 	data.base = p;
 	
+	// the first leaf only reads mightsee
 	data.pstack_head.portal = p;
 	data.pstack_head.source = p->winding;
 	data.pstack_head.portalplane = p->plane;
-	for (int i=0 ; i<portallongs ; i++)
-		((long *)data.pstack_head.mightsee)[i] = ((long *)p->portalflood)[i];
+	data.pstack_head.mightsee = (uint64 *)p->portalflood;
+	data.pstack_head.depth = 0;
 
 	RecursiveLeafFlow (p->leaf, &data, &data.pstack_head);
 
@@ -776,9 +852,9 @@ RecursiveLeafBitFlow
 
 ==================
 */
-void RecursiveLeafBitFlow (int leafnum, byte *mightsee, byte *cansee)
+void RecursiveLeafBitFlow (int leafnum, uint64 *mightsee, uint64 *cansee)
 {
-	alignas(long) byte		newmight[MAX_PORTALS/8];
+	uint64		newmight[MAX_PORTALS/64];
 
 	leaf_t *leaf = &leafs[leafnum];
 	
@@ -788,22 +864,14 @@ void RecursiveLeafBitFlow (int leafnum, byte *mightsee, byte *cansee)
 		int pnum = p - portals;
 
 		// if some previous portal can't see it, skip
-		if ( !CheckBit( mightsee, pnum ) )
+		if ( !CheckBit( (byte *)mightsee, pnum ) )
 			continue;
 
 		// if this portal can see some portals we mightsee, recurse
-		long more = 0;
-		for (int j=0 ; j<portallongs ; j++)
-		{
-			((long *)newmight)[j] = ((long *)mightsee)[j] 
-				& ((long *)p->portalflood)[j];
-			more |= ((long *)newmight)[j] & ~((long *)cansee)[j];
-		}
-
-		if (!more)
+		if ( !MightSeeMore( newmight, mightsee, (uint64 *)p->portalflood, cansee ) )
 			continue;	// can't see anything new
 
-		SetBit( cansee, pnum );
+		SetBit( (byte *)cansee, pnum );
 
 		RecursiveLeafBitFlow (p->leaf, newmight, cansee);
 	}
@@ -818,7 +886,7 @@ void BetterPortalVis (int portalnum)
 {
 	portal_t *p = portals + portalnum;
 
-	RecursiveLeafBitFlow (p->leaf, p->portalflood, p->portalvis);
+	RecursiveLeafBitFlow (p->leaf, (uint64 *)p->portalflood, (uint64 *)p->portalvis);
 
 	// build leaf vis information
 	p->nummightsee = CountBits (p->portalvis, g_numportals*2);
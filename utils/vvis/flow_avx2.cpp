@@ -0,0 +1,44 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: 256 bit wide portal bit string operations for PortalFlow.
+//
+// Selected at runtime, so this file is not built with /arch:AVX2. MSVC allows
+// AVX2 intrinsics anyway, gcc and clang get a per function target attribute.
+//
+//=============================================================================//
+
+#include "vis.h"
+
+#include <immintrin.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define VIS_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define VIS_AVX2_TARGET
+#endif
+
+VIS_AVX2_TARGET bool MightSeeMoreAVX2( uint64 *might, const uint64 *prevMight, const uint64 *test, const uint64 *vis, int words )
+{
+	__m256i more = _mm256_setzero_si256();
+
+	int j = 0;
+	for ( ; j + 4 <= words; j += 4 )
+	{
+		const __m256i newMight = _mm256_and_si256(
+			_mm256_loadu_si256( (const __m256i *)( prevMight + j ) ),
+			_mm256_loadu_si256( (const __m256i *)( test + j ) ) );
+		_mm256_storeu_si256( (__m256i *)( might + j ), newMight );
+
+		more = _mm256_or_si256( more, _mm256_andnot_si256( _mm256_loadu_si256( (const __m256i *)( vis + j ) ), newMight ) );
+	}
+
+	// strings are padded to 64 bits, not 256
+	uint64 moreTail = 0;
+	for ( ; j < words; j++ )
+	{
+		might[j] = prevMight[j] & test[j];
+		moreTail |= might[j] & ~vis[j];
+	}
+
+	return !_mm256_testz_si256( more, more ) || moreTail != 0;
+}
@@ -66,7 +66,8 @@ struct leaf_t
 	
 struct pstack_t
 {
-	byte		mightsee[MAX_PORTALS/8];		// bit string
+	uint64		*mightsee;		// bit string, portalwords long
+	int			depth;
 	pstack_t	*next;
 	leaf_t		*leaf;
 	portal_t	*portal;	// portal exiting
@@ -81,6 +82,7 @@ struct pstack_t
 
 struct threaddata_t
 {
+	int			thread;
 	portal_t	*base;
 	int			c_chains;
 	pstack_t	pstack_head;
@@ -105,6 +107,7 @@ extern	byte		*uncompressed;
 
 extern	int		leafbytes, leaflongs;
 extern	int		portalbytes, portallongs;
+extern	int		portalwords;			// portal bit strings are padded to whole 64 bit words
 
 
 void LeafFlow (int leafnum);
@@ -113,8 +116,14 @@ void LeafFlow (int leafnum);
 void BasePortalVis (int iThread, int portalnum);
 void BetterPortalVis (int portalnum);
 void PortalFlow (int iThread, int portalnum);
+void FreePortalFlowStacks (void);
 void WritePortalTrace( const char *source );
 
+// Portal bit string operations are done 256 bits at a time when the CPU has AVX2
+void EnableVisAVX2( bool bEnable );
+bool IsVisAVX2Enabled();
+bool MightSeeMoreAVX2( uint64 *might, const uint64 *prevMight, const uint64 *test, const uint64 *vis, int words );
+
 extern	portal_t	*sorted_portals[MAX_MAP_PORTALS*2];
 extern int g_TraceClusterStart, g_TraceClusterStop;
 
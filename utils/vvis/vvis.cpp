@@ -25,6 +25,9 @@
 
 #include "winlite.h"
 
+#include <algorithm>
+#include <atomic>
+
 int			g_numportals;
 int			portalclusters;
 
@@ -44,9 +47,14 @@ int			leafbytes;				// (portalclusters+63)>>3
 int			leaflongs;
 
 int			portalbytes, portallongs;
+int			portalwords;
 
 bool		fastvis;
 bool		nosort;
+// Cost scheduling hands out expensive portals first, before the cheap ones
+// they could prune against have finished, so it is opt-in until timed on
+// stock maps.
+bool		linearflow = true;
 
 int			totalvis;
 
@@ -173,7 +181,7 @@ Merges the portal visibility for a leaf
 */
 void ClusterMerge (int clusternum)
 {
-	alignas(long) byte portalvector[MAX_PORTALS/4];      // 4 because portal bytes is * 2
+	alignas(uint64) byte portalvector[MAX_PORTALS/4];      // 4 because portal bytes is * 2
 	byte		uncompressed[MAX_MAP_LEAFS/8];
 	int			numvis;
 	int			pnum;
@@ -188,8 +196,8 @@ void ClusterMerge (int clusternum)
 	{
 		if (p->status != stat_done)
 			Error ("portal not done %zd 0x%p 0x%p\n", i, p, portals);
-		for (int j=0 ; j<portallongs ; j++)
-			((long *)portalvector)[j] |= ((long *)p->portalvis)[j];
+		for (int j=0 ; j<portalwords ; j++)
+			((uint64 *)portalvector)[j] |= ((uint64 *)p->portalvis)[j];
 		pnum = p - portals;
 		SetBit( portalvector, pnum );
 
@@ -258,6 +266,180 @@ static int CompressAndCrosscheckClusterVis( int clusternum )
 }
 
 
+/*
+==================
+PortalFlow scheduling
+
+Portals are sorted cheapest first, so expensive portals can use the finished
+portalvis of cheaper ones. The most expensive portals would then start last
+and keep one thread busy long after the others are done, so those go first.
+Portals are dealt out to per thread queues in that order, and a thread that
+runs out of work steals the last, most expensive portal of the queue with the
+most estimated work left.
+==================
+*/
+struct portalqueue_t
+{
+	CThreadFastMutex	mutex;
+	CUtlVector<int>		work;		// indices into sorted_portals
+	int					front;
+	int					back;		// one past the last
+	double				cost;		// estimated cost of the work left
+};
+
+static portalqueue_t	g_PortalQueues[MAX_TOOL_THREADS];
+static int				g_numPortalQueues;
+static std::atomic<int>	g_PortalFlowDone;
+static CThreadFastMutex	g_PortalFlowPacifierMutex;
+static double			g_PortalFlowThreadEnd[MAX_TOOL_THREADS];
+
+// mightsee is a rough measure of how many portal chains the flow has to walk
+static double PortalFlowCost (int portalnum)
+{
+	const double mightsee = sorted_portals[portalnum]->nummightsee;
+	return mightsee * mightsee;
+}
+
+static int PopPortalFlowWork (portalqueue_t &queue, bool bBack)
+{
+	AUTO_LOCK( queue.mutex );
+
+	if ( queue.front == queue.back )
+		return -1;
+
+	const int work = bBack ? queue.work[--queue.back] : queue.work[queue.front++];
+	queue.cost -= PortalFlowCost( work );
+	return work;
+}
+
+static int StealPortalFlowWork (int iThread)
+{
+	while ( true )
+	{
+		// unlocked read, only picks the victim
+		int victim = -1;
+		double victimCost = 0;
+		for ( int i = 0; i < g_numPortalQueues; i++ )
+		{
+			const portalqueue_t &queue = g_PortalQueues[i];
+			if ( i != iThread && queue.front != queue.back && ( victim < 0 || queue.cost > victimCost ) )
+			{
+				victim = i;
+				victimCost = queue.cost;
+			}
+		}
+
+		if ( victim < 0 )
+			return -1;
+
+		const int work = PopPortalFlowWork( g_PortalQueues[victim], true );
+		if ( work >= 0 )
+			return work;
+	}
+}
+
+static void PortalFlowWorker (int iThread, void *)
+{
+	while ( true )
+	{
+		int work = PopPortalFlowWork( g_PortalQueues[iThread], false );
+		if ( work < 0 )
+		{
+			work = StealPortalFlowWork( iThread );
+			if ( work < 0 )
+				break;
+		}
+
+		PortalFlow( iThread, work );
+
+		const int done = ++g_PortalFlowDone;
+
+		AUTO_LOCK( g_PortalFlowPacifierMutex );
+		UpdatePacifier( (float)done / (g_numportals*2) );
+	}
+
+	g_PortalFlowThreadEnd[iThread] = Plat_FloatTime();
+}
+
+static void RunPortalFlow (void)
+{
+	const int numwork = g_numportals*2;
+
+	g_numPortalQueues = std::clamp( numthreads, 1, MAX_TOOL_THREADS );
+
+	double totalCost = 0;
+	for ( int i = 0; i < numwork; i++ )
+	{
+		totalCost += PortalFlowCost( i );
+	}
+
+	// portals that may take a good part of a thread's share go first, most expensive first
+	const double heavyCost = totalCost / g_numPortalQueues / 8;
+
+	CUtlVector<int> order;
+	order.EnsureCapacity( numwork );
+	for ( int i = 0; i < numwork; i++ )
+	{
+		if ( PortalFlowCost( i ) > heavyCost )
+		{
+			order.AddToTail( i );
+		}
+	}
+	const int numheavy = order.Count();
+	std::sort( order.begin(), order.end(), []( int a, int b ) { return PortalFlowCost( a ) > PortalFlowCost( b ); } );
+	for ( int i = 0; i < numwork; i++ )
+	{
+		if ( PortalFlowCost( i ) <= heavyCost )
+		{
+			order.AddToTail( i );
+		}
+	}
+
+	for ( int i = 0; i < g_numPortalQueues; i++ )
+	{
+		portalqueue_t &queue = g_PortalQueues[i];
+		queue.work.RemoveAll();
+		queue.front = 0;
+		queue.cost = 0;
+	}
+	for ( int i = 0; i < numwork; i++ )
+	{
+		portalqueue_t &queue = g_PortalQueues[i % g_numPortalQueues];
+		queue.work.AddToTail( order[i] );
+		queue.cost += PortalFlowCost( order[i] );
+	}
+	for ( int i = 0; i < g_numPortalQueues; i++ )
+	{
+		g_PortalQueues[i].back = g_PortalQueues[i].work.Count();
+	}
+
+	g_PortalFlowDone = 0;
+
+	const double start = Plat_FloatTime();
+	RunThreadsOn( numwork, true, PortalFlowWorker );
+	const double end = Plat_FloatTime();
+
+	// how long threads waited for the last portals
+	double idle = 0;
+	double firstEnd = end;
+	for ( int i = 0; i < g_numPortalQueues; i++ )
+	{
+		idle += end - g_PortalFlowThreadEnd[i];
+		firstEnd = std::min( firstEnd, g_PortalFlowThreadEnd[i] );
+	}
+	if ( end > start )
+	{
+		Msg( "PortalFlow: %d expensive portals started first, threads idle %.1f%% of %.2fs, first thread done %.2fs before the last.\n",
+			numheavy, 100.0 * idle / ( g_numPortalQueues * ( end - start ) ), end - start, end - firstEnd );
+	}
+
+	for ( int i = 0; i < g_numPortalQueues; i++ )
+	{
+		g_PortalQueues[i].work.Purge();
+	}
+}
+
+
 /*
 ==================
 CalcPortalVis
@@ -279,14 +461,22 @@ void CalcPortalVis (void)
 	}
 
 
+	Msg ("PortalFlow bit strings: %s\n", IsVisAVX2Enabled() ? "AVX2" : "64 bit");
+
     if (g_bUseMPI) 
 	{
  		RunMPIPortalFlow();
 	}
-	else 
+	else if (linearflow)
 	{
 		RunThreadsOnIndividual (g_numportals*2, true, PortalFlow);
 	}
+	else
+	{
+		RunPortalFlow ();
+	}
+
+	FreePortalFlowStacks ();
 }
 
 
@@ -297,6 +487,7 @@ void CalcVisTrace (void)
 	// NOTE: We only schedule the one-way portals out of the start cluster here
 	// so don't run g_numportals*2 in this case
 	RunThreadsOnIndividual (g_numportals, true, PortalFlow);
+	FreePortalFlowStacks ();
 }
 
 /*
@@ -473,6 +664,7 @@ void LoadPortals (char *name)
 	
 	portalbytes = ((g_numportals*2+63)&~63)>>3;
 	portallongs = portalbytes/sizeof(long);
+	portalwords = portalbytes/sizeof(uint64);
 
 	// each file portal is split into two memory portals
 	portals = (portal_t*)calloc(2*g_numportals, sizeof(portal_t));
@@ -967,6 +1159,21 @@ int ParseCommandLine( int argc, char **argv )
 			Msg ("--no-sort: true\n");
 			nosort = true;
 		}
+		else if (!Q_stricmp (argv[i],"-linearflow"))
+		{
+			Msg ("--linear-flow: true\n");
+			linearflow = true;
+		}
+		else if (!Q_stricmp (argv[i],"-costflow"))
+		{
+			Msg ("--cost-flow: true\n");
+			linearflow = false;
+		}
+		else if (!Q_stricmp (argv[i],"-noavx2"))
+		{
+			Msg ("--no-avx2: true\n");
+			EnableVisAVX2( false );
+		}
 		else if (!Q_stricmp (argv[i],"-tmpin"))
 		{
 			Msg ("--tmpin: Read from /tmp\n");
@@ -1059,6 +1266,11 @@ void PrintUsage( int argc, char **argv )
 		"  -threads        : Control the number of threads vbsp uses (defaults to the #\n"
 		"                    or processors on your machine).\n"
 		"  -nosort         : Don't sort portals (sorting is an optimization).\n"
+		"  -linearflow     : Hand out portals to PortalFlow threads in sorted order,\n"
+		"                    without cost scheduling or work stealing (default).\n"
+		"  -costflow       : Hand out the most expensive portals first and let idle\n"
+		"                    PortalFlow threads steal work.\n"
+		"  -noavx2         : Don't use AVX2 for portal bit strings.\n"
 		"  -tmpin          : Make portals come from \\tmp\\<mapname>.\n"
 		"  -tmpout         : Make portals come from \\tmp\\<mapname>.\n"
 		"  -trace <start cluster> <end cluster> : Writes a linefile that traces the vis from one cluster to another for debugging map vis.\n"
@@ -21,6 +21,11 @@
 
 #ifdef IS_WINDOWS_PC
 #include "winlite.h"
+#elif defined( POSIX )
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 // memdbgon must be the last include file in a .cpp file!!!
@@ -74,6 +79,90 @@ struct CFileHeaderFixedData
 
 #define PACKEDFILE_DIR_HASH_SIZE 43
 
+// Multi-GB pack sets don't fit 32 bit address space, so map on 64 bit only.
+static bool s_bPackMappingEnabled = IsPlatform64Bits();
+
+bool CPackedStore::EnableMapping( bool bEnable )
+{
+	const bool bWasEnabled = s_bPackMappingEnabled;
+	s_bPackMappingEnabled = bEnable;
+	return bWasEnabled;
+}
+
+bool CPackedStore::IsMappingEnabled( void )
+{
+	return s_bPackMappingEnabled;
+}
+
+bool PackMappedFile_t::Map( char const *pszFileName )
+{
+	Assert( !m_pData );
+
+#ifdef IS_WINDOWS_PC
+	HANDLE hFile = CreateFile( pszFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if ( hFile == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER nSize;
+	void *pData = nullptr;
+	if ( GetFileSizeEx( hFile, &nSize ) && nSize.QuadPart > 0 )
+	{
+		HANDLE hMapping = CreateFileMapping( hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+		if ( hMapping )
+		{
+			// the view keeps the mapping object alive
+			pData = MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 );
+			CloseHandle( hMapping );
+		}
+	}
+	CloseHandle( hFile );
+
+	if ( !pData )
+		return false;
+
+	m_pData = static_cast<const uint8 *>( pData );
+	m_nSize = nSize.QuadPart;
+	return true;
+#elif defined( POSIX )
+	int fd = open( pszFileName, O_RDONLY | O_CLOEXEC );
+	if ( fd < 0 )
+		return false;
+
+	struct stat st;
+	void *pData = MAP_FAILED;
+	if ( fstat( fd, &st ) == 0 && st.st_size > 0 )
+	{
+		pData = mmap( nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	}
+	// the mapping keeps the file alive
+	close( fd );
+
+	if ( pData == MAP_FAILED )
+		return false;
+
+	m_pData = static_cast<const uint8 *>( pData );
+	m_nSize = st.st_size;
+	return true;
+#else
+	return false;
+#endif
+}
+
+void PackMappedFile_t::Unmap( void )
+{
+	if ( !m_pData )
+		return;
+
+#ifdef IS_WINDOWS_PC
+	UnmapViewOfFile( m_pData );
+#elif defined( POSIX )
+	munmap( const_cast<uint8 *>( m_pData ), m_nSize );
+#endif
+
+	m_pData = nullptr;
+	m_nSize = 0;
+}
+
 static intp s_FileHeaderSize( char const *pName, int nNumDataParts, int nNumMetaDataBytes )
 {
 	return 1 + strlen( pName ) + 							// name plus nul
@@ -214,6 +303,8 @@ void CPackedStore::Init( void )
 	memset( m_pExtensionData, 0, sizeof( m_pExtensionData ) );
 	m_nDirectoryDataSize = 0;
 	m_nWriteChunkSize = k_nVPKDefaultChunkSize;
+	m_pMappedDirectoryData = nullptr;
+	m_bMapFiles = false;
 
 	m_nSizeOfSignedData = 0;
 	m_Signature.Purge();
@@ -255,7 +346,7 @@ void CPackedStore::BuildHashTables( void )
 
 bool CPackedStore::IsEmpty( void ) const
 {
-	return ( m_DirectoryData.Count() <= 1 );
+	return ( DirectoryDataSize() <= 1 );
 }
 
 static void StripTrailingString( char *pszBuf, const char *pszStrip )
@@ -275,6 +366,8 @@ CPackedStore::CPackedStore( char const *pFileBasename, char *pszFName, intp fnam
 	m_pFileSystem = pFS;
 	m_PackedStoreReadCache.m_pPackedStore = this;
 	m_DirectoryData.AddToTail( 0 );
+	// packs opened for write get their directory and chunks modified, keep those in heap
+	m_bMapFiles = !bOpenForWrite && s_bPackMappingEnabled;
 
 	if ( pFileBasename )
 	{
@@ -338,8 +431,19 @@ CPackedStore::CPackedStore( char const *pFileBasename, char *pszFName, intp fnam
 			uint32 nSizeOfHeader = dirFile.Tell();
 			int nSize = dirHeader.m_nDirectorySize;
 			m_nDirectoryDataSize = dirHeader.m_nDirectorySize;
-			m_DirectoryData.SetCount( nSize );
-			dirFile.MustRead( DirectoryData(), nSize );
+			if ( m_bMapFiles && nSize > 0 && m_DirFileMapping.Map( pszFName ) &&
+				m_DirFileMapping.Contains( nSizeOfHeader, nSize ) )
+			{
+				// use the directory tree in place, pages are brought in as lookups touch them
+				m_pMappedDirectoryData = const_cast<uint8 *>( m_DirFileMapping.m_pData ) + nSizeOfHeader;
+				dirFile.Seek( nSizeOfHeader + nSize );
+			}
+			else
+			{
+				m_DirFileMapping.Unmap();
+				m_DirectoryData.SetCount( nSize );
+				dirFile.MustRead( DirectoryData(), nSize );
+			}
 			// now, if we are opening for write, read the entire contents of the embedded data chunk in the dir into ram
 			if ( bOpenForWrite && bNewFileFormat )
 			{
@@ -457,6 +561,9 @@ CPackedStore::~CPackedStore( void )
 		extensionData.Purge();
 	}
 
+	// MD5 requests may still read mapped archives
+	m_PackedStoreReadCache.CheckMappedMD5Results( true );
+
 	for ( auto &&fileHandle : m_FileHandles )
 	{
 		if ( fileHandle.m_nFileNumber != -1 )
@@ -466,7 +573,7 @@ CPackedStore::~CPackedStore( void )
 #else
 			m_pFileSystem->Close( fileHandle.m_hFileHandle );
 #endif
-
+			fileHandle.m_Mapping.Unmap();
 		}
 	}
 
@@ -478,6 +585,9 @@ CPackedStore::~CPackedStore( void )
 		m_dirContents[i]->PurgeAndDeleteElements();
 		delete m_dirContents[i];
 	}
+
+	m_pMappedDirectoryData = nullptr;
+	m_DirFileMapping.Unmap();
 }
 
 void SplitFileComponents( char const *pFileName, char (&pDirOut)[MAX_PATH], char (&pBaseOut)[MAX_PATH], char (&pExtOut)[MAX_PATH] )
@@ -1101,6 +1211,75 @@ void CPackedStoreReadCache::RetryBadCacheLine( CachedVPKRead_t &cachedVPKRead )
 }
 
 
+// submit MD5 requests for the 1MB fractions of a mapped archive touched by a read for the first time
+void CPackedStoreReadCache::NoteMappedRead( FileHandleTracker_t &fHandle, int nDesiredPos, int nNumBytes )
+{
+	if ( !m_pFileTracker || !fHandle.m_pMappedFractionsHashed || nNumBytes <= 0 ) // file tracker doesn't exist in the VPK command line tool
+		return;
+
+	const int nFirstFraction = nDesiredPos / k_cubCacheBufferSize;
+	const int nLastFraction = Min( ( nDesiredPos + nNumBytes - 1 ) / k_cubCacheBufferSize, fHandle.m_nMappedFractions - 1 );
+	for ( int i = nFirstFraction; i <= nLastFraction; i++ )
+	{
+		if ( fHandle.m_pMappedFractionsHashed[i].exchange( true, std::memory_order_relaxed ) )
+			continue;
+
+		CachedVPKRead_t cachedVPKRead;
+		cachedVPKRead.m_nPackFileNumber = fHandle.m_nFileNumber;
+		cachedVPKRead.m_nFileFraction = i * k_cubCacheBufferSize;
+		cachedVPKRead.m_cubBuffer = static_cast<int>( Min<int64>( k_cubCacheBufferSize, fHandle.m_Mapping.m_nSize - cachedVPKRead.m_nFileFraction ) );
+		// the tracker only reads the buffer, so mapped read-only pages are fine
+		cachedVPKRead.m_pubBuffer = const_cast<uint8 *>( fHandle.m_Mapping.m_pData ) + cachedVPKRead.m_nFileFraction;
+		cachedVPKRead.m_hMD5RequestHandle = m_pFileTracker->SubmitThreadedMD5Request( cachedVPKRead.m_pubBuffer, cachedVPKRead.m_cubBuffer, m_pPackedStore->m_PackFileID, cachedVPKRead.m_nPackFileNumber, cachedVPKRead.m_nFileFraction );
+		if ( cachedVPKRead.m_hMD5RequestHandle )
+		{
+			AUTO_LOCK( m_MappedMD5Mutex );
+			m_vecMappedMD5Pending.AddToTail( cachedVPKRead );
+		}
+	}
+
+	CheckMappedMD5Results( false );
+}
+
+
+// check the MD5 requests on mapped fractions which are done, or all of them if bBlock
+void CPackedStoreReadCache::CheckMappedMD5Results( bool bBlock )
+{
+	if ( bBlock )
+	{
+		m_MappedMD5Mutex.Lock();
+	}
+	else if ( !m_MappedMD5Mutex.TryLock() )
+	{
+		// somebody else is checking
+		return;
+	}
+
+	FOR_EACH_VEC_BACK( m_vecMappedMD5Pending, i )
+	{
+		CachedVPKRead_t &cachedVPKRead = m_vecMappedMD5Pending[i];
+		if ( bBlock )
+		{
+			m_pFileTracker->BlockUntilMD5RequestComplete( cachedVPKRead.m_hMD5RequestHandle, &cachedVPKRead.m_md5Value );
+		}
+		else if ( !m_pFileTracker->IsMD5RequestComplete( cachedVPKRead.m_hMD5RequestHandle, &cachedVPKRead.m_md5Value ) )
+		{
+			continue;
+		}
+		cachedVPKRead.m_hMD5RequestHandle = 0;
+
+		// error stats are shared with the cache lines
+		m_rwlock.LockForWrite();
+		CheckMd5Result( cachedVPKRead );
+		m_rwlock.UnlockWrite();
+
+		m_vecMappedMD5Pending.FastRemove( i );
+	}
+
+	m_MappedMD5Mutex.Unlock();
+}
+
+
 // try reloading anything that failed its md5 check
 // this is currently only for gathering information, doesnt do anything to repair the cache
 void CPackedStoreReadCache::RetryAllBadCacheLines()
@@ -1178,39 +1357,74 @@ int CPackedStore::ReadData( CPackedStoreFileHandle &handle, void *pOutData, int
 			FileHandleTracker_t &fHandle = GetFileHandle( handle.m_nFileNumber );
 			int nDesiredPos = handle.m_nFileOffset + handle.m_nCurrentFileOffset - handle.m_nMetaDataSize;
 			int nRead;
-			fHandle.m_Mutex.Lock();
 			if ( handle.m_nFileNumber == VPKFILENUMBER_EMBEDDED_IN_DIR_FILE )
 			{
 				// for file data in the directory header, all offsets are relative to the size of the dir header.
 				nDesiredPos += m_nDirectoryDataSize + sizeof( VPKDirHeader_t );
 			}
 
-			if ( m_PackedStoreReadCache.BCanSatisfyFromReadCache( (uint8 *)pOutData, handle, fHandle, nDesiredPos, nNumBytes, nRead ) )
+			if ( fHandle.m_Mapping.Contains( nDesiredPos, nNumBytes ) )
 			{
-				handle.m_nCurrentFileOffset += nRead;
+				// mapped archive, neither seek nor handle lock needed
+				memcpy( pOutData, fHandle.m_Mapping.m_pData + nDesiredPos, nNumBytes );
+				m_PackedStoreReadCache.NoteMappedRead( fHandle, nDesiredPos, nNumBytes );
+				handle.m_nCurrentFileOffset += nNumBytes;
+				nRet += nNumBytes;
 			}
 			else
 			{
+				fHandle.m_Mutex.Lock();
+				if ( m_PackedStoreReadCache.BCanSatisfyFromReadCache( (uint8 *)pOutData, handle, fHandle, nDesiredPos, nNumBytes, nRead ) )
+				{
+					handle.m_nCurrentFileOffset += nRead;
+				}
+				else
+				{
 #ifdef IS_WINDOWS_PC
-				if ( nDesiredPos != fHandle.m_nCurOfs )
-					SetFilePointer ( fHandle.m_hFileHandle, nDesiredPos, NULL,  FILE_BEGIN); 
-				ReadFile( fHandle.m_hFileHandle, pOutData, nNumBytes, (LPDWORD) &nRead, NULL );
+					if ( nDesiredPos != fHandle.m_nCurOfs )
+						SetFilePointer ( fHandle.m_hFileHandle, nDesiredPos, NULL,  FILE_BEGIN); 
+					ReadFile( fHandle.m_hFileHandle, pOutData, nNumBytes, (LPDWORD) &nRead, NULL );
 #else
-				m_pFileSystem->Seek( fHandle.m_hFileHandle, nDesiredPos, FILESYSTEM_SEEK_HEAD );
-				nRead = m_pFileSystem->Read( pOutData, nNumBytes, fHandle.m_hFileHandle );
+					m_pFileSystem->Seek( fHandle.m_hFileHandle, nDesiredPos, FILESYSTEM_SEEK_HEAD );
+					nRead = m_pFileSystem->Read( pOutData, nNumBytes, fHandle.m_hFileHandle );
 #endif
-				handle.m_nCurrentFileOffset += nRead;
-				fHandle.m_nCurOfs = nRead + nDesiredPos;
+					handle.m_nCurrentFileOffset += nRead;
+					fHandle.m_nCurOfs = nRead + nDesiredPos;
+				}
+				Assert( nRead == nNumBytes );
+				nRet += nRead;
+				fHandle.m_Mutex.Unlock();
 			}
-			Assert( nRead == nNumBytes );
-			nRet += nRead;
-			fHandle.m_Mutex.Unlock();
 		}
 	}
 	m_PackedStoreReadCache.RetryAllBadCacheLines();
 	return nRet;
 }
 
+const void *CPackedStore::DirectData( CPackedStoreFileHandle &handle )
+{
+	// all of the file is preload data
+	if ( handle.m_nFileSize <= handle.m_nMetaDataSize )
+		return handle.m_pMetaData;
+
+	// split between preload data and archive, has to be copied together
+	if ( handle.m_nMetaDataSize != 0 || !m_bMapFiles )
+		return nullptr;
+
+	FileHandleTracker_t &fHandle = GetFileHandle( handle.m_nFileNumber );
+	int nDesiredPos = handle.m_nFileOffset;
+	if ( handle.m_nFileNumber == VPKFILENUMBER_EMBEDDED_IN_DIR_FILE )
+	{
+		nDesiredPos += m_nDirectoryDataSize + sizeof( VPKDirHeader_t );
+	}
+
+	if ( !fHandle.m_Mapping.Contains( nDesiredPos, handle.m_nFileSize ) )
+		return nullptr;
+
+	m_PackedStoreReadCache.NoteMappedRead( fHandle, nDesiredPos, handle.m_nFileSize );
+	return fHandle.m_Mapping.m_pData + nDesiredPos;
+}
+
 bool CPackedStore::HashEntirePackFile( CPackedStoreFileHandle &handle, int64 &nFileSize, int nFileFraction, int nFractionSize, FileHash_t &fileHash )
 {
 #define	CRC_CHUNK_SIZE	(32*1024)
@@ -1355,7 +1569,7 @@ void CPackedStore::ComputeDirectoryHash( MD5Value_t &md5Directory )
 	MD5Context_t ctx;
 	memset(&ctx, 0, sizeof(MD5Context_t));
 	MD5Init(&ctx);
-	MD5Update(&ctx, m_DirectoryData.Base(), m_DirectoryData.Count() );
+	MD5Update(&ctx, DirectoryData(), DirectoryDataSize() );
 	MD5Final( md5Directory.bits, &ctx);
 }
 
@@ -1464,6 +1678,13 @@ FileHandleTracker_t & CPackedStore::GetFileHandle( int nFileNumber )
 			handle.m_nFileNumber = nFileNumber;
 		}
 #endif
+		// mapped before the handle is returned, so readers never see it half set up
+		if ( handle.m_nFileNumber == nFileNumber && m_bMapFiles && handle.m_Mapping.Map( pszDataFileName ) )
+		{
+			constexpr int nFractionSize = CPackedStoreReadCache::k_cubCacheBufferSize;
+			handle.m_nMappedFractions = static_cast<int>( ( handle.m_Mapping.m_nSize + nFractionSize - 1 ) / nFractionSize );
+			handle.m_pMappedFractionsHashed = std::make_unique<std::atomic_bool[]>( handle.m_nMappedFractions );
+		}
 		return handle;
 	}
 	Error( "Exceeded limit of number of vpk files supported (%d)!\n", MAX_ARCHIVE_FILES_TO_KEEP_OPEN_AT_ONCE );
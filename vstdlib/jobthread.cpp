@@ -175,6 +175,112 @@ private:
 
 };
 
+//-----------------------------------------------------------------------------
+// Chase-Lev work-stealing deque, see "Correct and Efficient Work-Stealing for
+// Weak Memory Models" (Le, Pop, Cohen, Zappa Nardelli). Only the owner thread
+// may Push and Pop at the bottom, any thread may Steal from the top.
+//
+// Capacity is fixed, Push fails when full and the caller should fall back to
+// the injection queue.
+//-----------------------------------------------------------------------------
+class CWorkStealingDeque
+{
+public:
+	CWorkStealingDeque() :
+		m_nTop( 0 ),
+		m_nBottom( 0 )
+	{
+		for ( auto &job : m_Jobs )
+		{
+			job.store( NULL, std::memory_order_relaxed );
+		}
+	}
+
+	intp Count() const
+	{
+		const intp nCount = m_nBottom.load( std::memory_order_relaxed ) - m_nTop.load( std::memory_order_relaxed );
+		return nCount > 0 ? nCount : 0;
+	}
+
+	bool Push( CJob *pJob )
+	{
+		const intp b = m_nBottom.load( std::memory_order_relaxed );
+		const intp t = m_nTop.load( std::memory_order_acquire );
+
+		if ( b - t >= CAPACITY )
+		{
+			return false;
+		}
+
+		m_Jobs[b & ( CAPACITY - 1 )].store( pJob, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_release );
+		m_nBottom.store( b + 1, std::memory_order_relaxed );
+		return true;
+	}
+
+	bool Pop( CJob **ppJob )
+	{
+		const intp b = m_nBottom.load( std::memory_order_relaxed ) - 1;
+		m_nBottom.store( b, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		intp t = m_nTop.load( std::memory_order_relaxed );
+
+		if ( t > b )
+		{
+			// Empty
+			m_nBottom.store( b + 1, std::memory_order_relaxed );
+			return false;
+		}
+
+		*ppJob = m_Jobs[b & ( CAPACITY - 1 )].load( std::memory_order_relaxed );
+
+		if ( t == b )
+		{
+			// Last item, race against stealers
+			const bool bWon = m_nTop.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed );
+			m_nBottom.store( b + 1, std::memory_order_relaxed );
+			return bWon;
+		}
+
+		return true;
+	}
+
+	bool Steal( CJob **ppJob )
+	{
+		intp t = m_nTop.load( std::memory_order_acquire );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		const intp b = m_nBottom.load( std::memory_order_acquire );
+
+		if ( t >= b )
+		{
+			return false;
+		}
+
+		CJob *pJob = m_Jobs[t & ( CAPACITY - 1 )].load( std::memory_order_relaxed );
+		if ( !m_nTop.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+		{
+			// Lost race to the owner or another stealer
+			return false;
+		}
+
+		*ppJob = pJob;
+		return true;
+	}
+
+private:
+	enum
+	{
+		CAPACITY = 1024 // must be power of 2
+	};
+
+	// Keep top (stealers) and bottom (owner) on different cache lines.
+	std::atomic<intp>	m_nTop;
+	char				m_TopPad[64 - sizeof( std::atomic<intp> )];
+	std::atomic<intp>	m_nBottom;
+	char				m_BottomPad[64 - sizeof( std::atomic<intp> )];
+	std::atomic<CJob *>	m_Jobs[CAPACITY];
+};
+
 //-----------------------------------------------------------------------------
 //
 // CThreadPool
@@ -261,6 +367,14 @@ private:
 	CJob *PeekJob();
 	CJob *GetDummyJob() override;
 
+	//-----------------------------------------------------
+	// Work-stealing mode (ThreadPoolStartParams_t::bWorkStealing)
+	//-----------------------------------------------------
+	void PushStealableJob( CJob *pJob );
+	bool PopStealableJob( CJob **ppJob, CJobThread *pThread, JobPriority_t priority );
+	bool PopStealableJob( CJob **ppJob, CJobThread *pThread );
+	void OnStealableJobsDrained();
+
 	//-----------------------------------------------------
 	// Thread functions
 	//-----------------------------------------------------
@@ -270,6 +384,15 @@ private:
 	friend class CJobThread;
 
 	CJobQueue				m_SharedQueue;
+
+	// Work-stealing mode. Jobs added from outside the pool go to the injection
+	// queue, jobs added from pool threads go to their own deques.
+	bool					m_bWorkStealing;
+	CTSQueue<CJob *>		*m_pInjectionQueues[JP_HIGH + 1];
+	std::atomic_int			m_nStealableJobs;
+	std::atomic<intp>		m_nStealVictims;	// started threads jobs may be stolen from
+	CThreadManualEvent		m_StealableJobAvailableEvent;
+
 	CInterlockedInt			m_nIdleThreads;
 	CUtlVector<CJobThread *> m_Threads;
 	CUtlVector<CThreadEvent *>		m_IdleEvents;
@@ -315,6 +438,12 @@ public:
 			// Cap the GlobPool threads at 4.
 			startParams.nThreadsMax = 4;
 		}
+
+		if ( CommandLine()->FindParm( "-threadpool_worksteal" ) )
+		{
+			startParams.bWorkStealing = true;
+		}
+
 		return CThreadPool::Start( startParams, "Glob" );
 	}
 
@@ -332,11 +461,28 @@ class CJobThread final : public CAlignedNewDelete<16, CWorkerThread>
 public:
 	CJobThread( CThreadPool *pOwner, intp iThread ) : 
 		m_SharedQueue( pOwner->m_SharedQueue ),
+		m_JobAvailableEvent( pOwner->m_bWorkStealing ? pOwner->m_StealableJobAvailableEvent : pOwner->m_SharedQueue.GetEventHandle() ),
 		m_pOwner( pOwner ),
-		m_iThread( iThread )
+		m_iThread( iThread ),
+		m_nStealSeed( static_cast<uint32>( iThread ) * 2654435761u + 1 )
 	{
 	}
 
+	CWorkStealingDeque &AccessStealableQueue( JobPriority_t priority )
+	{
+		return m_StealableQueues[priority];
+	}
+
+	// Victim to start stealing from, spreads stealers over the pool.
+	intp NextStealVictim( intp nVictims )
+	{
+		// xorshift32
+		m_nStealSeed ^= m_nStealSeed << 13;
+		m_nStealSeed ^= m_nStealSeed >> 17;
+		m_nStealSeed ^= m_nStealSeed << 5;
+		return m_nStealSeed % nVictims;
+	}
+
 	CThreadEvent &GetIdleEvent()
 	{
 		return m_IdleEvent;
@@ -365,7 +511,7 @@ private:
 		HANDLE	 waitHandles[NUM_EVENTS];
 		
 		waitHandles[CALL_FROM_MASTER]	= GetCallHandle().GetHandle();
-		waitHandles[SHARED_QUEUE]		= m_SharedQueue.GetEventHandle().GetHandle();
+		waitHandles[SHARED_QUEUE]		= m_JobAvailableEvent.GetHandle();
 		waitHandles[DIRECT_QUEUE] 		= m_DirectQueue.GetEventHandle().GetHandle();
 		
 #ifdef _DEBUG
@@ -385,7 +531,7 @@ private:
 		while( !bSet )
 		{
 			// Jobs are typically enqueued to the shared job queue so wait on it first.
-			bSet = m_SharedQueue.GetEventHandle().Wait( nWaitTime );
+			bSet = m_JobAvailableEvent.Wait( nWaitTime );
 			if( !bSet )
 				bSet = m_DirectQueue.GetEventHandle().Wait( 10 );
 			if ( !bSet )
@@ -410,6 +556,8 @@ private:
 
 		tmZone( TELEMETRY_LEVEL0, TMZF_NONE, "%s", __FUNCTION__ );
 
+		s_pCurrentJobThread = this;
+
 		++m_pOwner->m_nIdleThreads;
 		m_IdleEvent.Set();
 		while (!bExit && ( ( waitResult = Wait() ) != WAIT_FAILED ) )
@@ -460,8 +608,16 @@ private:
 				{
 					if ( !m_DirectQueue.Pop( &pJob) )
 					{
-						if ( !m_SharedQueue.Pop( &pJob ) )
+						const bool bPopped = m_pOwner->m_bWorkStealing
+							? m_pOwner->PopStealableJob( &pJob, this )
+							: m_SharedQueue.Pop( &pJob );
+						if ( !bPopped )
 						{
+							if ( m_pOwner->m_bWorkStealing )
+							{
+								m_pOwner->OnStealableJobsDrained();
+							}
+
 							// Nothing to process, return to wait state
 							break;
 						}
@@ -485,16 +641,32 @@ private:
 		}
 		--m_pOwner->m_nIdleThreads;
 		m_IdleEvent.Reset();
+		s_pCurrentJobThread = NULL;
 		return 0;
 	}
 
+public:
+	// Pool thread running on this thread, if any.
+	static thread_local CJobThread *s_pCurrentJobThread;
+
+	CThreadPool *GetOwner() const
+	{
+		return m_pOwner;
+	}
+
+private:
 	CJobQueue			m_DirectQueue;
 	CJobQueue &			m_SharedQueue;
+	CThreadEvent &		m_JobAvailableEvent;
 	CThreadPool *		m_pOwner;
 	CThreadManualEvent	m_IdleEvent;
 	intp				m_iThread;
+	uint32				m_nStealSeed;
+	CWorkStealingDeque	m_StealableQueues[JP_HIGH + 1];
 };
 
+thread_local CJobThread *CJobThread::s_pCurrentJobThread = NULL;
+
 //-----------------------------------------------------------------------------
 
 CGlobalThreadPool g_ThreadPool;
@@ -507,11 +679,18 @@ IThreadPool *g_pThreadPool = &g_ThreadPool;
 //-----------------------------------------------------------------------------
 
 CThreadPool::CThreadPool() :
+	m_bWorkStealing( false ),
+	m_nStealableJobs( 0 ),
+	m_nStealVictims( 0 ),
 	m_nIdleThreads( 0 ),
 	m_nSuspend( 0 ),
 	m_nJobs( 0 ),
 	m_bExecOnThreadPoolThreadsOnly( 0 )
 {
+	for ( auto &queue : m_pInjectionQueues )
+	{
+		queue = new CTSQueue<CJob *>;
+	}
 }
 
 //---------------------------------------------------------
@@ -519,6 +698,11 @@ CThreadPool::CThreadPool() :
 CThreadPool::~CThreadPool()
 {
 	Stop();
+
+	for ( auto *queue : m_pInjectionQueues )
+	{
+		delete queue;
+	}
 }
 
 //---------------------------------------------------------
@@ -621,7 +805,8 @@ int CThreadPool::YieldWait( CThreadEvent **pEvents, int nEvents, bool bWaitAll,
 	timeout = 0;
 	while ( ( result = ThreadWaitForEvents( nEvents, pEvents, bWaitAll, timeout ) ) == WAIT_TIMEOUT )
 	{
-		if ( !m_bExecOnThreadPoolThreadsOnly && m_SharedQueue.Pop( &pJob ) )
+		if ( !m_bExecOnThreadPoolThreadsOnly &&
+			( m_bWorkStealing ? PopStealableJob( &pJob, NULL ) : m_SharedQueue.Pop( &pJob ) ) )
 		{
 			ServiceJobAndRelease( pJob );
 			--m_nJobs;
@@ -743,6 +928,12 @@ void CThreadPool::InsertJobInQueue( CJob *pJob )
 		int iThread = pJob->GetServiceThread();
 		if ( iThread == -1 || !m_Threads.IsValidIndex( iThread ) )
 		{
+			if ( m_bWorkStealing )
+			{
+				PushStealableJob( pJob );
+				return;
+			}
+
 			pQueue = &m_SharedQueue;
 		}
 		else
@@ -758,6 +949,82 @@ void CThreadPool::InsertJobInQueue( CJob *pJob )
 	m_nJobs -= pQueue->Push( pJob );
 }
 
+//---------------------------------------------------------
+// Work-stealing mode queues
+//---------------------------------------------------------
+
+void CThreadPool::PushStealableJob( CJob *pJob )
+{
+	pJob->AddRef();
+
+	const JobPriority_t priority = pJob->GetPriority();
+
+	// Jobs spawned by jobs stay on the spawning thread unless stolen.
+	CJobThread *pThread = CJobThread::s_pCurrentJobThread;
+	if ( !pThread || pThread->GetOwner() != this || !pThread->AccessStealableQueue( priority ).Push( pJob ) )
+	{
+		m_pInjectionQueues[priority]->PushItem( pJob );
+	}
+
+	if ( m_nStealableJobs.fetch_add( 1 ) == 0 )
+	{
+		m_StealableJobAvailableEvent.Set();
+	}
+}
+
+bool CThreadPool::PopStealableJob( CJob **ppJob, CJobThread *pThread, JobPriority_t priority )
+{
+	if ( ( pThread && pThread->AccessStealableQueue( priority ).Pop( ppJob ) ) ||
+		m_pInjectionQueues[priority]->PopItem( ppJob ) )
+	{
+		--m_nStealableJobs;
+		return true;
+	}
+
+	const intp nVictims = m_nStealVictims.load( std::memory_order_acquire );
+	if ( nVictims == 0 )
+	{
+		return false;
+	}
+
+	const intp iFirstVictim = pThread ? pThread->NextStealVictim( nVictims ) : 0;
+	for ( intp i = 0; i < nVictims; ++i )
+	{
+		CJobThread *pVictim = m_Threads[( iFirstVictim + i ) % nVictims];
+		if ( pVictim != pThread && pVictim->AccessStealableQueue( priority ).Steal( ppJob ) )
+		{
+			--m_nStealableJobs;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool CThreadPool::PopStealableJob( CJob **ppJob, CJobThread *pThread )
+{
+	for ( int i = JP_HIGH; i >= 0; --i )
+	{
+		if ( PopStealableJob( ppJob, pThread, (JobPriority_t)i ) )
+		{
+			return true;
+		}
+	}
+
+	*ppJob = NULL;
+	return false;
+}
+
+void CThreadPool::OnStealableJobsDrained()
+{
+	// Jobs may be pushed between failed pop and reset, set event back for them.
+	m_StealableJobAvailableEvent.Reset();
+	if ( m_nStealableJobs.load() > 0 )
+	{
+		m_StealableJobAvailableEvent.Set();
+	}
+}
+
 //---------------------------------------------------------
 // Add an function object to the queue (master thread)
 //---------------------------------------------------------
@@ -791,7 +1058,14 @@ void CThreadPool::ChangePriority( CJob *pJob, JobPriority_t priority )
 	if ( pJob->GetPriority() < priority )
 	{
 		pJob->SetPriority( priority );
-		m_SharedQueue.Push( pJob );
+		if ( m_bWorkStealing )
+		{
+			PushStealableJob( pJob );
+		}
+		else
+		{
+			m_SharedQueue.Push( pJob );
+		}
 	}
 	else
 	{
@@ -864,6 +1138,29 @@ int CThreadPool::ExecuteToPriority( JobPriority_t iToPriority, JobFilter_t pfnFi
 			--m_nJobs;
 			nExecuted++;
 		}
+
+		// Pool threads are suspended, so their deques are drained by stealing.
+		while ( m_bWorkStealing && PopStealableJob( &pJob, NULL, (JobPriority_t)iCurPriority ) )
+		{
+			if ( pfnFilter && !(*pfnFilter)( pJob ) )
+			{
+				if ( pJob->CanExecute() )
+				{
+					jobsToPutBack.EnsureCapacity( nJobsTotal );
+					jobsToPutBack.AddToTail( pJob );
+				}
+				else
+				{
+					--m_nJobs;
+					pJob->Release(); // see above
+				}
+				continue;
+			}
+
+			ServiceJobAndRelease( pJob );
+			--m_nJobs;
+			nExecuted++;
+		}
 	}
 
 	for ( auto &&j : jobsToPutBack )
@@ -906,6 +1203,13 @@ int CThreadPool::AbortAll()
 
 	}
 
+	while ( m_bWorkStealing && PopStealableJob( &pJob, NULL ) )
+	{
+		pJob->Abort();
+		pJob->Release();
+		iAborted++;
+	}
+
 	m_nJobs = 0;
 
 	ResumeExecution();
@@ -922,6 +1226,7 @@ bool CThreadPool::Start( const ThreadPoolStartParams_t &startParams, const char
 	int nThreads = startParams.nThreads;
 
 	m_bExecOnThreadPoolThreadsOnly = startParams.bExecOnThreadPoolThreadsOnly;
+	m_bWorkStealing = startParams.bWorkStealing;
 
 	if ( nThreads < 0 )
 	{
@@ -1023,6 +1328,9 @@ bool CThreadPool::Start( const ThreadPoolStartParams_t &startParams, const char
 #endif
 	}
 
+	// All threads are set up, allow stealing from them.
+	m_nStealVictims.store( m_Threads.Count(), std::memory_order_release );
+
 	Distribute( bDistribute, startParams.bUseAffinityTable ? (int *)startParams.iAffinityTable : NULL );
 
 	return true;
@@ -1122,10 +1430,26 @@ bool CThreadPool::Stop( [[maybe_unused]] int timeout )
 		{
 			ThreadSleep( 0 );
 		}
+	}
+
+	// Abort jobs left in work-stealing deques before threads are gone.
+	CJob *pJob;
+	while ( PopStealableJob( &pJob, NULL ) )
+	{
+		pJob->Abort();
+		pJob->Release();
+	}
+
+	m_nStealVictims.store( 0, std::memory_order_release );
+
+	for ( auto &&t : m_Threads )
+	{
 		delete t;
 	}
 
 	m_nJobs = 0;
+	m_nStealableJobs = 0;
+	m_StealableJobAvailableEvent.Reset();
 	m_SharedQueue.Flush();
 	m_nIdleThreads = 0;
 	m_Threads.RemoveAll();